@@ -334,7 +334,9 @@ void centry()
     working_end = working_p + EARLY_WORKING_SIZE;
     general = &working_heap;
     init_runtime(&working_heap, &working_heap);
-    init_tuples(allocate_tagged_region(&working_heap, tag_table_tuple));
+    init_tuples(allocate_tagged_region(&working_heap, tag_table_tuple),
+                allocate_tagged_region(&working_heap, tag_schema_tuple),
+                allocate_tagged_region(&working_heap, tag_integer));
     init_symbols(allocate_tagged_region(&working_heap, tag_symbol), &working_heap);
     init_sg(&working_heap);
     init_extra_prints();
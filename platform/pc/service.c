@@ -254,7 +254,11 @@ static void __attribute__((noinline)) init_service_new_stack()
     init_page_tables((heap)heap_linear_backed(kh));
     bytes pagesize = is_low_memory_machine(kh) ? PAGESIZE : PAGESIZE_2M;
     init_tuples(locking_heap_wrapper(heap_general(kh),
-                allocate_tagged_region(kh, tag_table_tuple, pagesize)));
+                allocate_tagged_region(kh, tag_table_tuple, pagesize)),
+                locking_heap_wrapper(heap_general(kh),
+                allocate_tagged_region(kh, tag_schema_tuple, pagesize)),
+                locking_heap_wrapper(heap_general(kh),
+                allocate_tagged_region(kh, tag_integer, pagesize)));
     init_symbols(allocate_tagged_region(kh, tag_symbol, pagesize), heap_locked(kh));
 
     for_regions(e) {
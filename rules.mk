@@ -132,6 +132,8 @@ ifeq ($(MEMDEBUG),mcache)
 CFLAGS+= -DMEMDEBUG_MCACHE
 else ifeq ($(MEMDEBUG),backed)
 CFLAGS+= -DMEMDEBUG_BACKED
+else ifeq ($(MEMDEBUG),closures)
+CFLAGS+= -DMEMDEBUG_CLOSURES
 else ifeq ($(MEMDEBUG),all)
 CFLAGS+= -DMEMDEBUG_ALL
 endif
@@ -1,6 +1,10 @@
 #define spin_try(x) (true)
 #define spin_lock(x) ((void)x)
 #define spin_unlock(x) ((void)x)
+#define spin_wlock(x) ((void)x)
+#define spin_wunlock(x) ((void)x)
+#define spin_rlock(x) ((void)x)
+#define spin_runlock(x) ((void)x)
 
 static inline u64 spin_lock_irq(spinlock l)
 {
@@ -19,3 +23,9 @@ static inline void spin_lock_init(spinlock l)
 {
     *&l->w = 0;
 }
+
+static inline void spin_rw_lock_init(rw_spinlock l)
+{
+    spin_lock_init(&l->l);
+    l->readers = 0;
+}
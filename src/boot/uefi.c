@@ -251,7 +251,9 @@ efi_status efi_main(void *image_handle, efi_system_table system_table)
     aligned_heap.dealloc = leak;
     aligned_heap.pagesize = PAGESIZE;
     init_runtime(&general, &general);
-    init_tuples(allocate_tagged_region(&general, tag_table_tuple));
+    init_tuples(allocate_tagged_region(&general, tag_table_tuple),
+                allocate_tagged_region(&general, tag_schema_tuple),
+                allocate_tagged_region(&general, tag_integer));
     init_symbols(allocate_tagged_region(&general, tag_symbol), &general);
     init_sg(&general);
     struct uefi_arch_options options;
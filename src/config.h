@@ -16,9 +16,6 @@
 
 #define PAGE_INVAL_QUEUE_LENGTH  4096
 
-/* maximum buckets that can fit within a PAGESIZE_2M mcache */
-#define TABLE_MAX_BUCKETS 131072
-
 /* runloop timer minimum and maximum */
 #define RUNLOOP_TIMER_MAX_PERIOD_US     100000
 #define RUNLOOP_TIMER_MIN_PERIOD_US     1000
@@ -48,6 +45,18 @@
 /* Log compaction is not triggered if the ratio between total entries and
  * obsolete entries is above the constant below. */
 #define TFS_LOG_COMPACT_RATIO   2
+/* Upper bound of the adaptive window during which concurrent sync requests
+ * are gathered into a single log commit and device flush. */
+#define TFS_SYNC_WINDOW_MAX_US  2000
+/* Storage space is split into allocation groups no smaller than the minimum
+ * size below, so that files created on different CPUs do not interleave their
+ * extents. */
+#define TFS_ALLOC_GROUPS_MAX        16
+#define TFS_ALLOC_GROUP_MIN_SIZE    (256*MB)
+/* Amount of file data held by a compressed extent, and default size limit of
+ * the cache of decompressed extents. */
+#define TFS_COMPRESS_UNIT           (128*KB)
+#define TFS_COMPRESSED_CACHE_SIZE   (8*MB)
 
 /* Xen stuff */
 #define XENNET_INIT_RX_BUFFERS_FACTOR 4
@@ -68,6 +77,19 @@
 /* must be large enough for vendor code that use malloc/free interface */
 #define MAX_MCACHE_ORDER 16
 
+/* per-CPU magazines of the locked kernel heap: largest cached object size (order) and number of
+   objects per magazine */
+#define LOCKED_HEAP_MAG_MAX_ORDER   11
+#define LOCKED_HEAP_MAG_ROUNDS      32
+
+/* per-CPU page caches of the physical and virtual page heaps: largest cached block (page order,
+   up to 32KB) and number of pages held per order, i.e. at most 512KB per CPU and heap, plus a
+   separate cache of up to PAGE_CACHE_LARGE_ROUNDS 2MB blocks */
+#define PAGE_CACHE_MAX_ORDER        3
+#define PAGE_CACHE_ROUNDS           32
+#define PAGE_CACHE_LARGE_ORDER      (PAGELOG_2M - PAGELOG)
+#define PAGE_CACHE_LARGE_ROUNDS     2
+
 /* ftrace buffer size */
 #define DEFAULT_TRACE_ARRAY_SIZE        (512ULL << 20)
 
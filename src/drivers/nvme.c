@@ -173,6 +173,9 @@ declare_closure_struct(1, 0, void, nvme_bh_service,
 declare_closure_struct(3, 3, void, nvme_io,
                        struct nvme *, n, u32, namespace, boolean, write,
                        void *, buf, range, blocks, status_handler, sh);
+declare_closure_struct(1, 1, void, nvme_req_handler,
+                       struct nvme *, n,
+                       storage_req, req);
 
 typedef struct nvme {
     heap general, contiguous;
@@ -190,12 +193,15 @@ typedef struct nvme {
     int attach_id;
     closure_struct(nvme_io_irq, io_irq);
     struct list pending_reqs, free_reqs, done_reqs;
+    u32 plugged;    /* pending requests are not submitted while nonzero */
     vector cmds;
     struct list free_cmds;
     closure_struct(nvme_bh_service, bh_service);
     closure_struct(nvme_io, r);
     closure_struct(nvme_io, w);
-    closure_struct(storage_simple_req_handler, req_handler);
+    closure_struct(storage_simple_req_handler, simple_req_handler);
+    storage_req_handler io_req_handler;
+    closure_struct(nvme_req_handler, req_handler);
     struct spinlock lock;
 } *nvme;
 
@@ -336,6 +342,8 @@ static nvme_iocmd nvme_get_iocmd(nvme n, boolean allocate)
 /* Called with the lock held. */
 static void nvme_service_pending(nvme n, boolean allocate)
 {
+    if (n->plugged)
+        return;
     boolean new_reqs = false;
     list l;
     while ((l = list_get_next(&n->pending_reqs))) {
@@ -404,15 +412,14 @@ define_closure_function(3, 3, void, nvme_io,
     spin_unlock_irq(&n->lock, irqflags);
 }
 
-define_closure_function(1, 0, void, nvme_io_irq,
-                        nvme, n)
+/* Called with the lock held. */
+static void nvme_io_service(nvme n)
 {
-    nvme_debug("%s", __func__);
-    nvme n = bound(n);
-    spin_lock(&n->lock);
     boolean done_empty = list_empty(&n->done_reqs);
+    boolean reaped = false;
     struct nvme_cqe *cqe;
     while ((cqe = nvme_get_cqe(&n->iocq))) {
+        reaped = true;
         n->iosq.head = NVME_SQ_HEAD(cqe->dw2);
         nvme_iocmd cmd = vector_get(n->cmds, NVME_CMD_ID(cqe->dw3));
         nvme_debug("  cmd ID 0x%0x complete", cmd->id);
@@ -428,13 +435,50 @@ define_closure_function(1, 0, void, nvme_io_irq,
         if (req_complete)
             list_push_back(&n->done_reqs, &req->l);
     }
+    if (!reaped)
+        return;
     nvme_cq_doorbell(n, NVME_IOQ_IDX, &n->iocq);
     nvme_service_pending(n, false);
     if (done_empty && !list_empty(&n->done_reqs))
         enqueue(bhqueue, &n->bh_service);
+}
+
+define_closure_function(1, 0, void, nvme_io_irq,
+                        nvme, n)
+{
+    nvme_debug("%s", __func__);
+    nvme n = bound(n);
+    spin_lock(&n->lock);
+    nvme_io_service(n);
     spin_unlock(&n->lock);
 }
 
+define_closure_function(1, 1, void, nvme_req_handler,
+                        nvme, n,
+                        storage_req, req)
+{
+    nvme n = bound(n);
+    if (req->op == STORAGE_OP_POLL) {
+        /* reap completions without waiting for the I/O queue interrupt */
+        u64 irqflags = spin_lock_irq(&n->lock);
+        nvme_io_service(n);
+        spin_unlock_irq(&n->lock, irqflags);
+    } else if (req->op == STORAGE_OP_PLUG) {
+        u64 irqflags = spin_lock_irq(&n->lock);
+        n->plugged++;
+        spin_unlock_irq(&n->lock, irqflags);
+    } else if (req->op == STORAGE_OP_UNPLUG) {
+        /* submit the requests queued while plugged, with a single doorbell write */
+        u64 irqflags = spin_lock_irq(&n->lock);
+        assert(n->plugged > 0);
+        if (--n->plugged == 0)
+            nvme_service_pending(n, true);
+        spin_unlock_irq(&n->lock, irqflags);
+    } else {
+        apply(n->io_req_handler, req);
+    }
+}
+
 define_closure_function(1, 0, void, nvme_bh_service,
                         nvme, n)
 {
@@ -461,10 +505,10 @@ closure_function(4, 0, void, nvme_ns_attach,
     nvme n = bound(n);
     u32 ns_id = bound(ns_id);
     u64 disk_size = bound(disk_size);
-    apply(bound(a),
-          storage_init_req_handler(&n->req_handler, init_closure(&n->r, nvme_io, n, ns_id, false),
-                                   init_closure(&n->w, nvme_io, n, ns_id, true)),
-          disk_size, n->attach_id);
+    n->io_req_handler = storage_init_req_handler(&n->simple_req_handler,
+                                                 init_closure(&n->r, nvme_io, n, ns_id, false),
+                                                 init_closure(&n->w, nvme_io, n, ns_id, true));
+    apply(bound(a), init_closure(&n->req_handler, nvme_req_handler, n), disk_size, n->attach_id);
     closure_finish();
 }
 
@@ -891,6 +935,7 @@ closure_function(3, 1, boolean, nvme_probe,
     }
     n->attach_id = -1;
     list_init(&n->pending_reqs);
+    n->plugged = 0;
     list_init(&n->free_reqs);
     list_init(&n->done_reqs);
     list_init(&n->free_cmds);
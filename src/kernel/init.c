@@ -136,6 +136,11 @@ closure_function(2, 2, void, fsstarted,
     assert(wrapped_root != INVALID_ADDRESS);
     // XXX use wrapped_root after root fs is separate
     tuple root = filesystem_getroot(root_fs);
+    if (get(root, sym(fs_fua)))
+        filesystem_set_fua(fs, true);
+    u64 cache_size;
+    if (get_u64(root, sym(fs_compressed_cache), &cache_size))
+        filesystem_set_compressed_cache(fs, cache_size);
     tuple mounts = get_tuple(root, sym(mounts));
     if (mounts)
         storage_set_mountpoints(mounts);
@@ -198,8 +203,12 @@ void mm_service(void)
     mm_debug("%s: total %ld, alloc %ld, free %ld\n", __func__,
              heap_total(phys), heap_allocated(phys), free);
     if (free < PAGECACHE_DRAIN_CUTOFF) {
+        /* return pages held in per-CPU caches, so that they can be coalesced and used anywhere */
+        u64 drained = id_heap_drain_page_caches(heap_physical(init_heaps));
+        if (drained > 0)
+            mm_debug("   drained %ld from page caches\n", drained);
         u64 drain_bytes = PAGECACHE_DRAIN_CUTOFF - free;
-        u64 drained = pagecache_drain(drain_bytes);
+        drained = pagecache_drain(drain_bytes);
         if (drained > 0)
             mm_debug("   drained %ld / %ld requested...\n", drained, drain_bytes);
         free = heap_free(phys);
@@ -365,7 +374,19 @@ void kernel_runtime_init(kernel_heaps kh)
 
     init_debug("start_secondary_cores");
     count_cpus_present();
+    if (!locking_heap_enable_magazines(locked, LOCKED_HEAP_MAG_MAX_ORDER, LOCKED_HEAP_MAG_ROUNDS,
+                                       present_processors))
+        msg_err("failed to enable per-CPU magazines for locked heap\n");
+    if (!is_low_memory_machine(kh) &&
+        (!id_heap_enable_page_caches(heap_physical(kh), PAGE_CACHE_MAX_ORDER, PAGE_CACHE_ROUNDS,
+                                     PAGE_CACHE_LARGE_ORDER, PAGE_CACHE_LARGE_ROUNDS,
+                                     present_processors) ||
+         !id_heap_enable_page_caches(heap_virtual_page(kh), PAGE_CACHE_MAX_ORDER,
+                                     PAGE_CACHE_ROUNDS, PAGE_CACHE_LARGE_ORDER,
+                                     PAGE_CACHE_LARGE_ROUNDS, present_processors)))
+        msg_err("failed to enable per-CPU page caches\n");
     init_scheduler_cpus(misc);
+    init_random_cpus(misc);
     start_secondary_cores(kh);
 
 #ifdef CONFIG_TRACELOG
@@ -359,6 +359,7 @@ static inline void clear_fault_handler(void)
             context __ctx = get_current_context(current_cpu());         \
             context_debug("contextual_closure(%s, ...) ctx %p type %d\n", #__name, __ctx, __ctx->type); \
             heap __h = __ctx->transient_heap;                           \
+            closure_alloc_trace(__name);                                \
             struct _closure_##__name * __n = allocate(__h, sizeof(struct _closure_##__name)); \
             __closure((u64_from_pointer(__ctx) |                        \
                        (CLOSURE_COMMON_CTX_DEALLOC_ON_FINISH | CLOSURE_COMMON_CTX_IS_CONTEXT)), \
@@ -369,6 +370,7 @@ static inline void clear_fault_handler(void)
         context __ctx = get_current_context(current_cpu());             \
         context_debug("contextual_closure_alloc(%s, ...) ctx %p\n", #__name, __ctx); \
         heap __h = __ctx->transient_heap;                               \
+        closure_alloc_trace(__name);                                    \
         __var = allocate(__h, sizeof(struct _closure_##__name));        \
         if (__var != INVALID_ADDRESS) {                                 \
             __var->__apply = __name;                                    \
@@ -505,7 +507,6 @@ void unmap_and_free_phys(u64 virtual, u64 length);
 #if !defined(BOOT)
 
 heap allocate_tagged_region(kernel_heaps kh, u64 tag, bytes pagesize);
-heap locking_heap_wrapper(heap meta, heap parent);
 
 #endif
 
@@ -541,6 +542,7 @@ static inline boolean in_interrupt(void)
 
 void init_scheduler(heap);
 void init_scheduler_cpus(heap h);
+void init_random_cpus(heap h);
 void mm_service(void);
 
 typedef closure_type(balloon_deflater, u64, u64);
@@ -579,6 +581,7 @@ typedef closure_type(shutdown_handler, void, int, merge);
 void add_shutdown_completion(shutdown_handler h);
 extern int shutdown_vector;
 void wakeup_or_interrupt_cpu_all();
+void wakeup_cpu(u64 cpu);
 
 typedef closure_type(halt_handler, void, int);
 extern halt_handler vm_halt;
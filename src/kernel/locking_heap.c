@@ -1,6 +1,29 @@
+#ifdef KERNEL
 #include <kernel.h>
+#define heaplock_cpu_id()   (current_cpu()->id)
+#else
+#include <runtime.h>
+#define heaplock_cpu_id()   0
+#endif
 #include <management.h>
 
+/* A per-CPU magazine holds up to mag_rounds free objects of a given size class, so that objects
+   can be allocated and freed on the local CPU without taking the heap lock. An empty magazine is
+   refilled, and a full magazine is flushed, by half its capacity at a time with a single lock
+   acquisition, the parent heap acting as the depot shared between CPUs. */
+typedef struct heaplock_mag {
+    u64 count;
+    u64 *rounds;
+} *heaplock_mag;
+
+typedef struct heaplock_cpu {
+    u64 alloc_hits;
+    u64 alloc_misses;
+    u64 free_hits;
+    u64 free_misses;
+    struct heaplock_mag mags[0];
+} *heaplock_cpu;
+
 typedef struct heaplock {
     struct heap h;
     struct spinlock lock;
@@ -8,14 +31,97 @@ typedef struct heaplock {
     heap meta;
     tuple mgmt;
     tuple parent_mgmt;
+    heaplock_cpu *cpus;         /* per-CPU magazines (optional) */
+    int ncpus;
+    int mag_classes;
+    int mag_rounds;
 } *heaplock;
 
 #define lock_heap(hl) u64 _flags = spin_lock_irq(&hl->lock)
 #define unlock_heap(hl) spin_unlock_irq(&hl->lock, _flags)
 
+/* Returns the magazine size class for an allocation size, or -1 if not cached. */
+static int heaplock_mag_class(heaplock hl, bytes size)
+{
+    if (!hl->cpus || (size == -1ull))
+        return -1;
+    int class = mcache_size_class(hl->parent, size);
+    return (class < hl->mag_classes) ? class : -1;
+}
+
+/* Returns the magazine size class of an allocated object, or -1 if not cached. The class is that
+   of the cache the object was allocated from, rather than the one matching the size given on
+   free, which may well differ from the allocation size; objects whose size does not fit their
+   cache are left for the parent heap to report. */
+static int heaplock_object_mag_class(heaplock hl, u64 x, bytes size)
+{
+    if (!hl->cpus)
+        return -1;
+    int class = mcache_object_class(hl->parent, x, size);
+    return (class < hl->mag_classes) ? class : -1;
+}
+
+/* Called with interrupts disabled. */
+static heaplock_cpu heaplock_get_cpu(heaplock hl)
+{
+    u32 id = heaplock_cpu_id();
+    return (id < hl->ncpus) ? hl->cpus[id] : 0;
+}
+
+static u64 heaplock_mag_alloc(heaplock hl, heaplock_cpu hc, int class)
+{
+    heaplock_mag mag = &hc->mags[class];
+    if (mag->count) {
+        hc->alloc_hits++;
+        return mag->rounds[--mag->count];
+    }
+    hc->alloc_misses++;
+    bytes size = mcache_class_size(hl->parent, class);
+    lock_heap(hl);
+    u64 a = allocate_u64(hl->parent, size);
+    if (a != INVALID_PHYSICAL) {
+        while (mag->count < hl->mag_rounds / 2) {
+            u64 obj = allocate_u64(hl->parent, size);
+            if (obj == INVALID_PHYSICAL)
+                break;
+            mag->rounds[mag->count++] = obj;
+        }
+    }
+    unlock_heap(hl);
+    return a;
+}
+
+static void heaplock_mag_dealloc(heaplock hl, heaplock_cpu hc, int class, u64 x)
+{
+    heaplock_mag mag = &hc->mags[class];
+    if (mag->count < hl->mag_rounds) {
+        hc->free_hits++;
+        mag->rounds[mag->count++] = x;
+        return;
+    }
+    hc->free_misses++;
+    bytes size = mcache_class_size(hl->parent, class);
+    lock_heap(hl);
+    deallocate_u64(hl->parent, x, size);
+    while (mag->count > hl->mag_rounds / 2)
+        deallocate_u64(hl->parent, mag->rounds[--mag->count], size);
+    unlock_heap(hl);
+}
+
 static u64 heaplock_alloc(heap h, bytes size)
 {
     heaplock hl = (heaplock)h;
+    int class = heaplock_mag_class(hl, size);
+    if (class >= 0) {
+        u64 irqflags = irq_disable_save();
+        heaplock_cpu hc = heaplock_get_cpu(hl);
+        if (hc) {
+            u64 a = heaplock_mag_alloc(hl, hc, class);
+            irq_restore(irqflags);
+            return a;
+        }
+        irq_restore(irqflags);
+    }
     lock_heap(hl);
     u64 a = allocate_u64(hl->parent, size);
     unlock_heap(hl);
@@ -25,6 +131,17 @@ static u64 heaplock_alloc(heap h, bytes size)
 static void heaplock_dealloc(heap h, u64 x, bytes size)
 {
     heaplock hl = (heaplock)h;
+    int class = heaplock_object_mag_class(hl, x, size);
+    if (class >= 0) {
+        u64 irqflags = irq_disable_save();
+        heaplock_cpu hc = heaplock_get_cpu(hl);
+        if (hc) {
+            heaplock_mag_dealloc(hl, hc, class, x);
+            irq_restore(irqflags);
+            return;
+        }
+        irq_restore(irqflags);
+    }
     lock_heap(hl);
     deallocate_u64(hl->parent, x, size);
     unlock_heap(hl);
@@ -34,6 +151,21 @@ static void heaplock_dealloc(heap h, u64 x, bytes size)
 static void heaplock_destroy(heap h)
 {
     heaplock hl = (heaplock)h;
+    if (hl->cpus) {
+        bytes cpu_size = sizeof(struct heaplock_cpu) +
+                         hl->mag_classes * (sizeof(struct heaplock_mag) + hl->mag_rounds * sizeof(u64));
+        for (int i = 0; i < hl->ncpus; i++) {
+            heaplock_cpu hc = hl->cpus[i];
+            for (int class = 0; class < hl->mag_classes; class++) {
+                heaplock_mag mag = &hc->mags[class];
+                while (mag->count)
+                    deallocate_u64(hl->parent, mag->rounds[--mag->count],
+                                   mcache_class_size(hl->parent, class));
+            }
+            deallocate(hl->parent, hc, cpu_size);
+        }
+        deallocate(hl->parent, hl->cpus, hl->ncpus * sizeof(heaplock_cpu));
+    }
     destroy_heap(hl->parent);
     deallocate(hl->meta, hl, sizeof(*hl));
 }
@@ -85,6 +217,39 @@ closure_function(1, 1, boolean, heaplock_iterate,
     return result;
 }
 
+closure_function(2, 0, value, heaplock_get_stat,
+                 u64 *, stat, value, v)
+{
+    return value_rewrite_u64(bound(v), *bound(stat));
+}
+
+#define register_mag_stat(hl, n, t, hc, name) do {                      \
+        value v = value_from_u64(hl->meta, 0);                          \
+        symbol s = sym(name);                                           \
+        set(t, s, v);                                                   \
+        tuple_notifier_register_get_notify(n, s, closure(hl->meta, heaplock_get_stat, \
+                                                         &hc->name, v)); \
+    } while (0)
+
+static tuple heaplock_mags_management(heaplock hl)
+{
+    tuple mags = allocate_tuple();
+    assert(mags != INVALID_ADDRESS);
+    for (int i = 0; i < hl->ncpus; i++) {
+        heaplock_cpu hc = hl->cpus[i];
+        tuple t = allocate_tuple();
+        assert(t != INVALID_ADDRESS);
+        tuple_notifier n = tuple_notifier_wrap(t);
+        assert(n != INVALID_ADDRESS);
+        register_mag_stat(hl, n, t, hc, alloc_hits);
+        register_mag_stat(hl, n, t, hc, alloc_misses);
+        register_mag_stat(hl, n, t, hc, free_hits);
+        register_mag_stat(hl, n, t, hc, free_misses);
+        set(mags, intern_u64(i), n);
+    }
+    return mags;
+}
+
 static value heaplock_management(heap h)
 {
     heaplock hl = (heaplock)h;
@@ -98,6 +263,8 @@ static value heaplock_management(heap h)
                                        closure(hl->meta, heaplock_set, hl),
                                        closure(hl->meta, heaplock_iterate, hl));
     set(v, sym(parent), ft);
+    if (hl->cpus)
+        set(v, sym(magazines), heaplock_mags_management(hl));
 
     value pm = heap_management(hl->parent);
     lock_heap(hl);
@@ -124,6 +291,43 @@ heap locking_heap_wrapper(heap meta, heap parent)
     hl->meta = meta;
     hl->mgmt = 0;
     hl->parent_mgmt = 0;
+    hl->cpus = 0;
     spin_lock_init(&hl->lock);
     return (heap)hl;
 }
+
+/* Puts per-CPU magazines in front of the parent heap, which must be an mcache, for the size
+   classes of objects up to 2^max_order. Objects cached in magazines are accounted as allocated in
+   the parent heap. */
+boolean locking_heap_enable_magazines(heap h, int max_order, int rounds, int ncpus)
+{
+    heaplock hl = (heaplock)h;
+    assert(!hl->cpus);
+    int classes = mcache_size_class(hl->parent, U64_FROM_BIT(max_order)) + 1;
+    if ((classes <= 0) || (rounds < 2) || (ncpus <= 0))
+        return false;
+    heaplock_cpu *cpus = allocate(h, ncpus * sizeof(heaplock_cpu));
+    if (cpus == INVALID_ADDRESS)
+        return false;
+    bytes cpu_size = sizeof(struct heaplock_cpu) +
+                     classes * (sizeof(struct heaplock_mag) + rounds * sizeof(u64));
+    for (int i = 0; i < ncpus; i++) {
+        heaplock_cpu hc = allocate_zero(h, cpu_size);
+        if (hc == INVALID_ADDRESS) {
+            while (--i >= 0)
+                deallocate(h, cpus[i], cpu_size);
+            deallocate(h, cpus, ncpus * sizeof(heaplock_cpu));
+            return false;
+        }
+        u64 *rounds_base = (u64 *)&hc->mags[classes];
+        for (int class = 0; class < classes; class++)
+            hc->mags[class].rounds = rounds_base + class * rounds;
+        cpus[i] = hc;
+    }
+    hl->ncpus = ncpus;
+    hl->mag_classes = classes;
+    hl->mag_rounds = rounds;
+    write_barrier();
+    hl->cpus = cpus;
+    return true;
+}
@@ -399,6 +399,25 @@ static pagecache_page allocate_page_nodelocked(pagecache_node pn, u64 offset)
     return INVALID_ADDRESS;
 }
 
+/* Requests that are recycled via the free lists in the pagecache */
+
+static list pagecache_get_req(pagecache pc, struct list *free)
+{
+    pagecache_lock_state(pc);
+    list l = list_get_next(free);
+    if (l)
+        list_delete(l);
+    pagecache_unlock_state(pc);
+    return l;
+}
+
+static void pagecache_put_req(pagecache pc, struct list *free, struct list *l)
+{
+    pagecache_lock_state(pc);
+    list_insert_after(free, l);
+    pagecache_unlock_state(pc);
+}
+
 #ifndef PAGECACHE_READ_ONLY
 static u64 evict_from_list_locked(pagecache pc, struct pagelist *pl, vector evictlist, u64 pages)
 {
@@ -473,10 +492,31 @@ static pagecache_page touch_or_fill_page_by_num_nodelocked(pagecache_node pn, u6
     return pp;
 }
 
-closure_function(6, 1, void, pagecache_write_sg_finish,
-                 pagecache_node, pn, range, q, sg_list, sg, status_handler, completion, boolean, complete, context, saved_ctx,
-                 status, s)
+declare_closure_struct(6, 1, void, pagecache_write_sg_finish,
+                       pagecache_node, pn, range, q, sg_list, sg, status_handler, completion, boolean, complete, context, saved_ctx,
+                       status, s);
+
+/* A write request holds the merge of the page fills for a write, whose completion issues the write
+   and then handles its completion. */
+typedef struct pagecache_write_req {
+    struct list l;
+    struct merge m;
+    closure_struct(pagecache_write_sg_finish, finish);
+} *pagecache_write_req;
+
+static pagecache_write_req allocate_write_req(pagecache pc)
 {
+    list l = pagecache_get_req(pc, &pc->write_reqs);
+    if (l)
+        return struct_from_list(l, pagecache_write_req, l);
+    return allocate(pc->h, sizeof(struct pagecache_write_req));
+}
+
+define_closure_function(6, 1, void, pagecache_write_sg_finish,
+                        pagecache_node, pn, range, q, sg_list, sg, status_handler, completion, boolean, complete, context, saved_ctx,
+                        status, s)
+{
+    pagecache_write_req req = struct_from_field(closure_self(), pagecache_write_req, finish);
     pagecache_node pn = bound(pn);
     pagecache pc = pn->pv->pc;
     range q = bound(q);
@@ -528,7 +568,7 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
                 deallocate_sg_list(sg);
         }
         pagecache_unlock_node(pn);
-        closure_finish();
+        pagecache_put_req(pc, &pc->write_reqs, &req->l);
         return;
     }
 
@@ -542,7 +582,7 @@ closure_function(6, 1, void, pagecache_write_sg_finish,
         if (write_sg == INVALID_ADDRESS) {
             pagecache_unlock_node(pn);
             apply(bound(completion), timm("result", "failed to allocate write sg"));
-            closure_finish();
+            pagecache_put_req(pc, &pc->write_reqs, &req->l);
             return;
         }
     } else {
@@ -649,8 +689,15 @@ closure_function(1, 3, void, pagecache_write_sg,
 #endif
 
     /* prepare pages for writing */
-    merge m = allocate_merge(pc->h, closure(pc->h, pagecache_write_sg_finish, pn, q, sg,
-                                            completion, false, ctx));
+    pagecache_write_req req = allocate_write_req(pc);
+    if (req == INVALID_ADDRESS) {
+        pagecache_unlock_node(pn);
+        apply(completion, timm("result", "failed to allocate write request"));
+        return;
+    }
+    merge m = &req->m;
+    init_merge(m, init_closure(&req->finish, pagecache_write_sg_finish, pn, q, sg,
+                               completion, false, ctx));
     status_handler sh = apply_merge(m);
 
     /* initiate reads for rmw start and/or end */
@@ -805,14 +852,171 @@ void pagecache_sync_node(pagecache_node pn, status_handler complete)
     pagecache_scan_node(pn);
     pagecache_finish_pending_writes(pn->pv->pc, 0, pn, complete);
 }
+
+/* Direct I/O
+
+   Direct reads and writes transfer data between storage and the buffers supplied by the caller,
+   bypassing the cache. Cached pages overlapping the range of a direct operation are kept
+   coherent: the operation is issued once any reads and writes of these pages have completed
+   (dirty pages of shared mappings are committed before a direct read), and a direct write
+   updates the contents of cached pages with the data being written. */
+
+/* Returns the first page of the node at or after page index pi. */
+static pagecache_page page_lookup_next_nodelocked(pagecache_node pn, u64 pi)
+{
+    struct pagecache_page k;
+    k.state_offset = pi;
+    rbnode n = rbtree_lookup_max_lte(&pn->pages, &k.rbnode);
+    if (n == INVALID_ADDRESS)
+        return (pagecache_page)rbtree_find_first(&pn->pages);
+    if (page_offset((pagecache_page)n) < pi)
+        n = rbnode_get_next(n);
+    return (pagecache_page)n;
+}
+
+#define page_foreach_in_range_nodelocked(pn, r, pp)                                    \
+    for (pagecache_page pp = page_lookup_next_nodelocked(pn, (r).start);              \
+         (pp != INVALID_ADDRESS) && (page_offset(pp) < (r).end);                      \
+         pp = (pagecache_page)rbnode_get_next(&pp->rbnode))
+
+/* Returns true if any page in r (in pages) has I/O in progress, in which case sh is applied once
+   that I/O completes. */
+static boolean pagecache_node_wait_io_nodelocked(pagecache_node pn, range r, status_handler sh)
+{
+    pagecache pc = pn->pv->pc;
+    merge m = 0;
+    pagecache_lock_state(pc);
+    page_foreach_in_range_nodelocked(pn, r, pp) {
+        int state = page_state(pp);
+        if ((state == PAGECACHE_PAGESTATE_READING) || (state == PAGECACHE_PAGESTATE_WRITING)) {
+            if (!m)
+                m = allocate_merge(pc->h, sh);
+            enqueue_page_completion_statelocked(pc, pp, apply_merge(m));
+        }
+    }
+    pagecache_unlock_state(pc);
+    if (!m)
+        return false;
+    apply(apply_merge(m), STATUS_OK);
+    return true;
+}
+
+closure_function(5, 1, void, pagecache_direct_io,
+                 pagecache_node, pn, sg_list, sg, range, q, boolean, write,
+                 status_handler, completion,
+                 status, s)
+{
+    pagecache_node pn = bound(pn);
+    pagecache pc = pn->pv->pc;
+    sg_list sg = bound(sg);
+    range q = bound(q);
+    boolean write = bound(write);
+    status_handler completion = bound(completion);
+    range r = range_rshift_pad(q, pc->page_order);
+    pagecache_debug("%s: node %p, q %R, sg %p, write %d\n", __func__, pn, q, sg, write);
+
+    /* The status of page I/O waited for is not relevant to this operation. */
+    pagecache_lock_node(pn);
+    if (pagecache_node_wait_io_nodelocked(pn, r, (status_handler)closure_self())) {
+        pagecache_unlock_node(pn);
+        return;
+    }
+    if (write) {
+        pagecache_lock_state(pc);
+        page_foreach_in_range_nodelocked(pn, r, pp) {
+            int state = page_state(pp);
+            if ((state == PAGECACHE_PAGESTATE_NEW) || (state == PAGECACHE_PAGESTATE_ACTIVE) ||
+                (state == PAGECACHE_PAGESTATE_DIRTY)) {
+                range i = range_intersection(byte_range_from_page(pc, pp), q);
+                sg_peek_to_buf(pp->kvirt + (i.start & MASK(pc->page_order)), sg,
+                               i.start - q.start, range_span(i));
+            }
+        }
+        pagecache_unlock_state(pc);
+    }
+    pagecache_unlock_node(pn);
+    closure_finish();
+    apply(write ? pn->fs_write : pn->fs_read, sg, q, completion);
+}
+
+static void pagecache_node_direct_io(pagecache_node pn, sg_list sg, range q, boolean write,
+                                     status_handler complete)
+{
+    pagecache pc = pn->pv->pc;
+    if (range_span(q) == 0) {
+        apply(complete, STATUS_OK);
+        return;
+    }
+    status_handler sh = closure(pc->h, pagecache_direct_io, pn, sg, q, write, complete);
+    if (sh == INVALID_ADDRESS) {
+        apply(complete, timm("result", "failed to allocate direct I/O completion"));
+        return;
+    }
+#ifdef KERNEL
+    if (!write)
+        pagecache_node_scan_and_commit_shared_pages(pn, q);
+#endif
+    apply(sh, STATUS_OK);
+}
+
+/* The range q must be aligned to the volume block size, and sg must have enough buffer space to
+   hold it. */
+void pagecache_node_direct_read(pagecache_node pn, sg_list sg, range q, status_handler complete)
+{
+    pagecache_node_direct_io(pn, sg, q, false, complete);
+}
+
+void pagecache_node_direct_write(pagecache_node pn, sg_list sg, range q, status_handler complete)
+{
+    pagecache_node_direct_io(pn, sg, q, true, complete);
+}
 #endif /* !PAGECACHE_READ_ONLY */
 
 typedef closure_type(pp_handler, void, pagecache_page);
 
-closure_function(5, 1, void, pagecache_node_fetch_complete,
-                 pagecache, pc, pagecache_page, first_page, u64, page_count, sg_list, sg, status_handler, complete,
-                 status, s)
+declare_closure_struct(5, 1, void, pagecache_node_fetch_complete,
+                       pagecache, pc, pagecache_page, first_page, u64, page_count, sg_list, sg, status_handler, complete,
+                       status, s);
+
+/* A fetch run reads a run of contiguous pages from the filesystem. */
+typedef struct pagecache_fetch_run {
+    struct list l;
+    closure_struct(pagecache_node_fetch_complete, complete);
+} *pagecache_fetch_run;
+
+declare_closure_struct(2, 1, void, pagecache_node_fetched,
+                       pagecache, pc, status_handler, completion,
+                       status, s);
+
+/* A fetch request holds the merge of the page runs and pending page fills of a node fetch; the
+   caller completion is applied once the request is recycled. */
+typedef struct pagecache_fetch_req {
+    struct list l;
+    struct merge m;
+    closure_struct(pagecache_node_fetched, complete);
+} *pagecache_fetch_req;
+
+static pagecache_fetch_run allocate_fetch_run(pagecache pc)
 {
+    list l = pagecache_get_req(pc, &pc->fetch_runs);
+    if (l)
+        return struct_from_list(l, pagecache_fetch_run, l);
+    return allocate(pc->h, sizeof(struct pagecache_fetch_run));
+}
+
+static pagecache_fetch_req allocate_fetch_req(pagecache pc)
+{
+    list l = pagecache_get_req(pc, &pc->fetch_reqs);
+    if (l)
+        return struct_from_list(l, pagecache_fetch_req, l);
+    return allocate(pc->h, sizeof(struct pagecache_fetch_req));
+}
+
+define_closure_function(5, 1, void, pagecache_node_fetch_complete,
+                        pagecache, pc, pagecache_page, first_page, u64, page_count, sg_list, sg, status_handler, complete,
+                        status, s)
+{
+    pagecache_fetch_run run = struct_from_field(closure_self(), pagecache_fetch_run, complete);
     pagecache pc = bound(pc);
     pagecache_page pp = bound(first_page);
     u64 page_count = bound(page_count);
@@ -828,20 +1032,37 @@ closure_function(5, 1, void, pagecache_node_fetch_complete,
     pagecache_unlock_state(pc);
     sg_list_release(sg);
     deallocate_sg_list(sg);
-    apply(bound(complete), s);
-    closure_finish();
+    status_handler complete = bound(complete);
+    pagecache_put_req(pc, &pc->fetch_runs, &run->l);
+    apply(complete, s);
+}
+
+define_closure_function(2, 1, void, pagecache_node_fetched,
+                        pagecache, pc, status_handler, completion,
+                        status, s)
+{
+    pagecache_fetch_req req = struct_from_field(closure_self(), pagecache_fetch_req, complete);
+    pagecache pc = bound(pc);
+    status_handler completion = bound(completion);
+    pagecache_put_req(pc, &pc->fetch_reqs, &req->l);
+#ifdef KERNEL
+    async_apply_status_handler(completion, s);
+#else
+    apply(completion, s);
+#endif
 }
 
 static boolean pagecache_node_fetch_sg(pagecache pc, pagecache_node pn, range r, sg_list sg,
                                        pagecache_page pp, merge m)
 {
     status_handler fetch_sh = apply_merge(m);
-    status_handler fetch_complete = closure(pc->h, pagecache_node_fetch_complete, pc,
-        pp, range_span(r) >> pc->page_order, sg, fetch_sh);
-    if (fetch_complete == INVALID_ADDRESS) {
+    pagecache_fetch_run run = allocate_fetch_run(pc);
+    if (run == INVALID_ADDRESS) {
         apply(fetch_sh, timm("result", "failed to allocate fetch completion"));
         return false;
     }
+    status_handler fetch_complete = init_closure(&run->complete, pagecache_node_fetch_complete, pc,
+        pp, range_span(r) >> pc->page_order, sg, fetch_sh);
     pagecache_debug("fetching %R from node %p\n", r, pn);
     apply(pn->fs_read, sg, r, fetch_complete);
     return true;
@@ -851,7 +1072,13 @@ static void pagecache_node_fetch_internal(pagecache_node pn, range q, pp_handler
                                           status_handler completion)
 {
     pagecache pc = pn->pv->pc;
-    merge m = allocate_merge(pc->h, completion);
+    pagecache_fetch_req req = allocate_fetch_req(pc);
+    if (req == INVALID_ADDRESS) {
+        apply(completion, timm("result", "failed to allocate fetch request"));
+        return;
+    }
+    merge m = &req->m;
+    init_merge(m, init_closure(&req->complete, pagecache_node_fetched, pc, completion));
     status_handler sh = apply_merge(m);
     struct pagecache_page k;
     if (q.end > pn->length)
@@ -1464,6 +1691,9 @@ void init_pagecache(heap general, heap contiguous, heap physical, u64 pagesize)
     page_list_init(&pc->dirty);
     list_init(&pc->volumes);
     list_init(&pc->shared_maps);
+    list_init(&pc->write_reqs);
+    list_init(&pc->fetch_reqs);
+    list_init(&pc->fetch_runs);
     init_closure(&pc->page_compare, pagecache_page_compare);
     init_closure(&pc->page_print_key, pagecache_page_print_key, pc);
 
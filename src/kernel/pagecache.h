@@ -30,6 +30,10 @@ sg_io pagecache_node_get_reader(pagecache_node pn);
 
 sg_io pagecache_node_get_writer(pagecache_node pn);
 
+void pagecache_node_direct_read(pagecache_node pn, sg_list sg, range q, status_handler complete);
+
+void pagecache_node_direct_write(pagecache_node pn, sg_list sg, range q, status_handler complete);
+
 #ifdef KERNEL
 void pagecache_node_add_shared_map(pagecache_node pn , range v /* bytes */, u64 node_offset);
 
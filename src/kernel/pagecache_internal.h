@@ -44,6 +44,11 @@ typedef struct pagecache {
     struct list volumes;
     struct list shared_maps;
 
+    /* free lists of recycled I/O requests, also covered by state_lock */
+    struct list write_reqs;
+    struct list fetch_reqs;
+    struct list fetch_runs;
+
     boolean scan_in_progress;
     struct timer scan_timer;
     closure_struct(pagecache_scan_timer, do_scan_timer);
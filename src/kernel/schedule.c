@@ -53,7 +53,7 @@ void wakeup_or_interrupt_cpu_all()
     }
 }
 
-static void wakeup_cpu(u64 cpu)
+void wakeup_cpu(u64 cpu)
 {
     if (bitmap_test_and_set_atomic(idle_cpu_mask, cpu, 0)) {
         sched_debug("waking up CPU %d\n", cpu);
@@ -120,10 +120,23 @@ static void init_kernel_heaps_management(tuple root)
     set(heaps, sym(physical), heap_management((heap)heap_physical(kh)));
     set(heaps, sym(general), heap_management((heap)heap_general(kh)));
     set(heaps, sym(locked), heap_management((heap)heap_locked(kh)));
+    set(heaps, sym(symbols), symbol_management(heap_locked(kh)));
+#if defined(MEMDEBUG_CLOSURES) || defined(MEMDEBUG_ALL)
+    set(heaps, sym(closures), mem_debug_closure_management(heap_locked(kh)));
+#endif
     set(heaps, sym(no_encode), null_value);
     set(root, sym(heaps), heaps);
 }
 
+static void init_filesystem_management(tuple root, filesystem fs)
+{
+    tuple filesystems = allocate_tuple();
+    assert(filesystems);
+    set(filesystems, sym(root), filesystem_management(fs));
+    set(filesystems, sym(no_encode), null_value);
+    set(root, sym(filesystems), filesystems);
+}
+
 closure_function(6, 0, void, startup,
                  kernel_heaps, kh, tuple, root, filesystem, fs, merge, m, status_handler, start, status_handler, completion)
 {
@@ -149,6 +162,7 @@ closure_function(6, 0, void, startup,
     /* register root tuple with management and kick off interfaces, if any */
     init_management_root(root);
     init_kernel_heaps_management(root);
+    init_filesystem_management(root, fs);
 #if 0
     http_listener hl = allocate_http_listener(general, 9090);
     assert(hl != INVALID_ADDRESS);
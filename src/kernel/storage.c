@@ -116,6 +116,8 @@ closure_function(2, 2, void, volume_link,
         } else {
             v->fs = fs;
             v->mount_dir = mount_dir;
+            if (get(filesystem_getroot(storage.root_fs), sym(fs_fua)))
+                filesystem_set_fua(fs, true);
             storage_debug("volume mounted, mount directory %p, filesystem %p", mount_dir, fs);
             notify_mount_change_locked();
         }
@@ -185,11 +187,16 @@ define_closure_function(2, 1, void, storage_simple_req_handler,
         storage_io_sg(bound(read), req->data, req->blocks, req->completion);
         break;
     case STORAGE_OP_WRITESG:
+    case STORAGE_OP_WRITESG_FUA:    /* no volatile cache to bypass; see STORAGE_OP_FLUSH */
         storage_io_sg(bound(write), req->data, req->blocks, req->completion);
         break;
     case STORAGE_OP_FLUSH:
         apply(req->completion, STATUS_OK);
         break;
+    case STORAGE_OP_POLL:
+    case STORAGE_OP_PLUG:
+    case STORAGE_OP_UNPLUG:
+        break;
     case STORAGE_OP_READ:
         apply(bound(read), req->data, req->blocks, req->completion);
         break;
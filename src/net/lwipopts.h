@@ -48,8 +48,6 @@
 #define LWIP_NO_LIMITS_H 1
 #define LWIP_NO_CTYPE_H 1
 
-#define LWIP_CHKSUM_ALGORITHM   3
-
 #define LWIP_WND_SCALE 1
 #define TCP_MSS 1460            /* Assuming ethernet; may want to derive this */
 #define TCP_WND 65535
@@ -159,6 +157,8 @@ void lwip_memset(void *x, unsigned char v, unsigned long len);
 int lwip_memcmp(const void *x, const void *y, unsigned long len);
 int lwip_strcmp(const char *x, const char *y);
 int lwip_strncmp(const char *x, const char *y, unsigned long len);
+u16_t lwip_csum(const void *dataptr, int len);
+u16_t lwip_csum_copy(void *dst, const void *src, u16_t len);
 
 #define memcpy(__a, __b, __c) lwip_memcpy(__a, __b, __c)
 #define memcmp(__a, __b, __c) lwip_memcmp(__a, __b, __c)
@@ -169,6 +169,10 @@ int lwip_strncmp(const char *x, const char *y, unsigned long len);
 #define strcmp(__a, __b) lwip_strcmp(__a, __b)
 #define atoi(__a) lwip_atoi(__a)
 
+#define LWIP_CHKSUM lwip_csum
+#define LWIP_CHECKSUM_ON_COPY 1
+#define LWIP_CHKSUM_COPY(__d, __s, __l) lwip_csum_copy(__d, __s, __l)
+
 static inline void *calloc(size_t n, size_t s)
 {
     void *x =  lwip_allocate(n*s);
@@ -140,6 +140,16 @@ int lwip_memcmp(const void *x, const void *y, unsigned long len)
     return runtime_memcmp(x, y, len);
 }
 
+u16_t lwip_csum(const void *dataptr, int len)
+{
+    return ip_checksum(dataptr, len);
+}
+
+u16_t lwip_csum_copy(void *dst, const void *src, u16_t len)
+{
+    return ip_checksum_copy(dst, src, len);
+}
+
 int lwip_strcmp(const char *x, const char *y)
 {
     return runtime_strcmp(x, y);
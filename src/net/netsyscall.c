@@ -139,6 +139,13 @@ static sysreturn netsock_sendmsg(struct sock *sock, const struct msghdr *msg,
                                  int flags);
 static sysreturn netsock_recvmsg(struct sock *sock, struct msghdr *msg,
                                  int flags);
+static sysreturn netsock_accept_nb(struct sock *sock, thread t, struct sockaddr *addr,
+                                  socklen_t *addrlen, int flags);
+static sysreturn netsock_connect_nb(struct sock *sock, thread t, struct sockaddr *addr,
+                                   socklen_t addrlen);
+static sysreturn netsock_sendmsg_nb(struct sock *sock, thread t, const struct msghdr *msg,
+                                   int flags);
+static sysreturn netsock_recvmsg_nb(struct sock *sock, thread t, struct msghdr *msg, int flags);
 
 BSS_RO_AFTER_INIT static thunk net_loop_poll;
 static boolean net_loop_poll_queued;
@@ -1074,6 +1081,9 @@ static sysreturn netsock_shutdown(struct sock *sock, int how)
         }
         lwip_unlock();
         netsock_check_loop();
+
+        /* the change in TCP state is not signaled by any lwIP callback */
+        fdesc_notify_events(&s->sock.f);
         break;
     case SOCK_DGRAM:
         rv = -ENOTCONN;
@@ -1166,6 +1176,10 @@ static int allocate_sock(process p, int af, int type, u32 flags, netsock *rs)
     s->sock.sendmsg = netsock_sendmsg;
     s->sock.recvmsg = netsock_recvmsg;
     s->sock.shutdown = netsock_shutdown;
+    s->sock.accept_nb = netsock_accept_nb;
+    s->sock.connect_nb = netsock_connect_nb;
+    s->sock.sendmsg_nb = netsock_sendmsg_nb;
+    s->sock.recvmsg_nb = netsock_recvmsg_nb;
     s->ipv6only = 0;
     set_lwip_error(s, ERR_OK);
     fd = s->sock.fd = allocate_fd(p, s);
@@ -1405,6 +1419,7 @@ closure_function(2, 1, sysreturn, connect_tcp_bh,
                 s->info.tcp.state = TCP_SOCK_ABORTING_CONNECTION;
             }
             lwip_unlock();
+            fdesc_notify_events(&s->sock.f);
             rv = -ERESTARTSYS;
         }
         goto out;
@@ -1443,8 +1458,9 @@ static err_t connect_tcp_complete(void* arg, struct tcp_pcb* tpcb, err_t err)
    return ERR_OK;
 }
 
-static inline sysreturn connect_tcp(netsock s, const ip_addr_t* address,
-                                    unsigned short port)
+/* Initiates a connection; returns 0 if the connection is in progress. */
+static sysreturn connect_tcp_start(netsock s, const ip_addr_t* address,
+                                   unsigned short port)
 {
     sysreturn rv;
     net_debug("sock %d, tcp state %d, port %d\n", s->sock.fd,
@@ -1478,32 +1494,43 @@ static inline sysreturn connect_tcp(netsock s, const ip_addr_t* address,
     if (err != ERR_OK)
         return lwip_to_errno(err);
     netsock_check_loop();
-
-    return blockq_check(s->sock.txbq, current,
-                        contextual_closure(connect_tcp_bh, s, current), false);
+    return 0;
   unlock_out:
     lwip_unlock();
     return rv;
 }
 
-static sysreturn netsock_connect(struct sock *sock, struct sockaddr *addr,
-        socklen_t addrlen)
+static inline sysreturn connect_tcp(netsock s, const ip_addr_t* address,
+                                    unsigned short port)
+{
+    sysreturn rv = connect_tcp_start(s, address, port);
+    if (rv)
+        return rv;
+    return blockq_check(s->sock.txbq, current,
+                        contextual_closure(connect_tcp_bh, s, current), false);
+}
+
+static sysreturn netsock_connect_internal(netsock s, struct sockaddr *addr,
+                                          socklen_t addrlen, boolean nonblock)
 {
-    netsock s = (netsock) sock;
     ip_addr_t ipaddr;
     u16 port;
     sysreturn ret = sockaddr_to_addrport(s, addr, addrlen, &ipaddr,
         &port);
     if (ret)
-        goto out;
+        return ret;
     if (s->sock.type == SOCK_STREAM) {
         if (s->info.tcp.state == TCP_SOCK_IN_CONNECTION) {
             ret = -EALREADY;
         } else if (s->info.tcp.state == TCP_SOCK_OPEN) {
             ret = -EISCONN;
         } else if (s->info.tcp.state == TCP_SOCK_LISTENING) {
-            msg_warn("attempt to connect on listening socket fd = %d; ignored\n", sock->fd);
+            msg_warn("attempt to connect on listening socket fd = %d; ignored\n", s->sock.fd);
             ret = -EINVAL;
+        } else if (nonblock) {
+            ret = connect_tcp_start(s, &ipaddr, port);
+            if (ret == 0)
+                ret = -EINPROGRESS;
         } else {
             ret = connect_tcp(s, &ipaddr, port);
         }
@@ -1516,11 +1543,36 @@ static sysreturn netsock_connect(struct sock *sock, struct sockaddr *addr,
         msg_err("can't connect on socket type %d\n", s->sock.type);
         ret = -EINVAL;
     }
-  out:
+    return ret;
+}
+
+static sysreturn netsock_connect(struct sock *sock, struct sockaddr *addr,
+        socklen_t addrlen)
+{
+    sysreturn ret = netsock_connect_internal((netsock) sock, addr, addrlen, false);
     socket_release(sock);
     return ret;
 }
 
+static sysreturn netsock_connect_nb(struct sock *sock, thread t, struct sockaddr *addr,
+                                   socklen_t addrlen)
+{
+    netsock s = (netsock) sock;
+    if (addr)
+        return netsock_connect_internal(s, addr, addrlen, true);
+    if (sock->type != SOCK_STREAM)
+        return 0;
+    switch (s->info.tcp.state) {
+    case TCP_SOCK_IN_CONNECTION:
+        return -EINPROGRESS;
+    case TCP_SOCK_OPEN:
+    case TCP_SOCK_UNDEFINED:    /* the connection attempt failed */
+        return lwip_to_errno(get_lwip_error(s));
+    default:
+        return -ECONNABORTED;
+    }
+}
+
 sysreturn connect(int sockfd, struct sockaddr *addr, socklen_t addrlen)
 {
     if (!validate_user_memory(addr, addrlen, false))
@@ -1653,6 +1705,38 @@ static sysreturn netsock_sendmsg(struct sock *s, const struct msghdr *msg,
         current, false, completion);
 }
 
+static sysreturn netsock_sendmsg_nb(struct sock *sock, thread t, const struct msghdr *msg,
+                                   int flags)
+{
+    netsock s = (netsock) sock;
+    void *buf;
+    u64 len;
+    sysreturn rv;
+
+    if ((sock->type == SOCK_STREAM) && (s->info.tcp.state != TCP_SOCK_OPEN))
+        return -EPIPE;
+    if (msg->msg_iovlen == 1) {
+        /* no need to gather the data into a separate buffer */
+        rv = sendto_prepare(sock, flags);
+        buf = msg->msg_iov[0].iov_base;
+        len = msg->msg_iov[0].iov_len;
+        if ((rv < 0) || (len == 0))
+            return rv;
+    } else {
+        rv = sendmsg_prepare(sock, msg, flags, &buf, &len);
+        if (rv <= 0)
+            return rv;
+    }
+    if (sock->type == SOCK_STREAM)
+        rv = socket_write_tcp_bh_internal(s, t, buf, len, flags | MSG_DONTWAIT,
+                                          io_completion_ignore, 0);
+    else
+        rv = socket_write_udp(s, buf, len, msg->msg_name, msg->msg_namelen);
+    if (msg->msg_iovlen != 1)
+        deallocate(sock->h, buf, len);
+    return rv;
+}
+
 sysreturn sendmsg(int sockfd, const struct msghdr *msg, int flags)
 {
     if (!validate_msghdr(msg, false))
@@ -1854,6 +1938,43 @@ static sysreturn netsock_recvmsg(struct sock *sock, struct msghdr *msg,
     return rv;
 }
 
+static sysreturn netsock_recvmsg_nb(struct sock *sock, thread t, struct msghdr *msg, int flags)
+{
+    netsock s = (netsock) sock;
+    u64 total_len;
+    void *buf;
+    sysreturn rv;
+
+    if ((sock->type == SOCK_STREAM) && (s->info.tcp.state != TCP_SOCK_OPEN))
+        return (s->info.tcp.state == TCP_SOCK_UNDEFINED) ? 0 : -ENOTCONN;
+    total_len = iov_total_len(msg->msg_iov, msg->msg_iovlen);
+    if (total_len == 0)
+        return 0;
+    if (msg->msg_iovlen == 1) {
+        buf = msg->msg_iov[0].iov_base;
+    } else {
+        buf = allocate(sock->h, total_len);
+        if (buf == INVALID_ADDRESS)
+            return -ENOMEM;
+    }
+    rv = sock_read_bh_internal(s, t, buf, total_len, flags | MSG_DONTWAIT, msg->msg_name,
+                               &msg->msg_namelen, io_completion_ignore, 0);
+    if (msg->msg_iovlen != 1) {
+        s64 offset = 0;
+        for (int iv = 0; offset < rv; iv++) {
+            struct iovec *iov = &msg->msg_iov[iv];
+            runtime_memcpy(iov->iov_base, buf + offset, MIN(iov->iov_len, rv - offset));
+            offset += iov->iov_len;
+        }
+        deallocate(sock->h, buf, total_len);
+    }
+    if (rv >= 0) {
+        msg->msg_controllen = 0;
+        msg->msg_flags = 0;
+    }
+    return rv;
+}
+
 sysreturn recvmsg(int sockfd, struct msghdr *msg, int flags)
 {
     if (!validate_msghdr(msg, true))
@@ -1953,46 +2074,27 @@ sysreturn listen(int sockfd, int backlog)
     return sock->listen(sock, backlog);
 }
 
-closure_function(5, 1, sysreturn, accept_bh,
-                 netsock, s, thread, t, struct sockaddr *, addr, socklen_t *, addrlen, int, flags,
-                 u64, bqflags)
+/* Dequeues a connection from a listening socket; returns -EAGAIN if none is pending. */
+static sysreturn netsock_accept_child(netsock s, struct sockaddr *addr, socklen_t *addrlen,
+                                      int flags)
 {
-    netsock s = bound(s);
-    thread t = bound(t);
-    sysreturn rv = 0;
-
     err_t err = get_lwip_error(s);
-    net_debug("sock %d, target thread %ld, lwip err %d\n", s->sock.fd, t->tid,
-            err);
-
-    if (err != ERR_OK) {
-        rv = lwip_to_errno(err);
-        goto out;
-    }
-
-    if (bqflags & BLOCKQ_ACTION_NULLIFY) {
-        rv = -ERESTARTSYS;
-        goto out;
-    }
+    if (err != ERR_OK)
+        return lwip_to_errno(err);
 
     netsock child = dequeue(s->incoming);
-    if (child == INVALID_ADDRESS) {
-        if (s->sock.f.flags & SOCK_NONBLOCK) {
-            rv = -EAGAIN;
-            goto out;
-        }
-        return blockq_block_required(t, bqflags);               /* block */
-    }
+    if (child == INVALID_ADDRESS)
+        return -EAGAIN;
 
-    child->sock.f.flags |= bound(flags);
-    if (bound(addr)) {
+    child->sock.f.flags |= flags;
+    if (addr) {
         if (child->info.tcp.state == TCP_SOCK_OPEN)
-            remote_sockaddr(child, bound(addr), bound(addrlen));
+            remote_sockaddr(child, addr, addrlen);
         else
             /* The new socket is disconnected already, we can't retrieve the address of the remote
              * peer. */
             addrport_to_sockaddr(child->sock.domain, (ip_addr_t *)IP_ADDR_ANY, 0,
-                bound(addr), bound(addrlen));
+                addr, addrlen);
     }
 
     /* report falling edge in case of edge trigger */
@@ -2006,8 +2108,31 @@ closure_function(5, 1, sysreturn, accept_bh,
         lwip_unlock();
     }
 
-    rv = child->sock.fd;
+    sysreturn rv = child->sock.fd;
     fdesc_put(&child->sock.f);
+    return rv;
+}
+
+closure_function(5, 1, sysreturn, accept_bh,
+                 netsock, s, thread, t, struct sockaddr *, addr, socklen_t *, addrlen, int, flags,
+                 u64, bqflags)
+{
+    netsock s = bound(s);
+    thread t = bound(t);
+    sysreturn rv = 0;
+
+    err_t err = get_lwip_error(s);
+    net_debug("sock %d, target thread %ld, lwip err %d\n", s->sock.fd, t->tid,
+            err);
+
+    if ((bqflags & BLOCKQ_ACTION_NULLIFY) && (err == ERR_OK)) {
+        rv = -ERESTARTSYS;
+        goto out;
+    }
+
+    rv = netsock_accept_child(s, bound(addr), bound(addrlen), bound(flags));
+    if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK))
+        return blockq_block_required(t, bqflags);               /* block */
   out:
     syscall_return(t, rv);
 
@@ -2039,6 +2164,18 @@ static sysreturn netsock_accept4(struct sock *sock, struct sockaddr *addr,
     return rv;
 }
 
+static sysreturn netsock_accept_nb(struct sock *sock, thread t, struct sockaddr *addr,
+                                  socklen_t *addrlen, int flags)
+{
+    netsock s = (netsock) sock;
+    if (sock->type != SOCK_STREAM)
+        return -EOPNOTSUPP;
+    if ((s->info.tcp.state != TCP_SOCK_LISTENING) ||
+            (flags & ~(SOCK_NONBLOCK | SOCK_CLOEXEC)))
+        return -EINVAL;
+    return netsock_accept_child(s, addr, addrlen, flags);
+}
+
 sysreturn accept4(int sockfd, struct sockaddr *addr, socklen_t *addrlen,
         int flags)
 {
@@ -134,6 +134,11 @@ typedef struct spinlock {
     word w;
 } *spinlock;
 
+typedef struct rw_spinlock {
+    struct spinlock l;
+    u64 readers;
+} *rw_spinlock;
+
 /* returns -1 if x == 0, caller must check */
 static inline __attribute__((always_inline)) u64 msb(u64 x)
 {
@@ -316,4 +316,5 @@
 #define SYS_openat2                      437
 #define SYS_pidfd_getfd                  438
 #define SYS_faccessat2                   439
-#define SYS_MAX                          440
+#define SYS_futex_waitv                  449
+#define SYS_MAX                          450
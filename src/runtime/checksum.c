@@ -0,0 +1,121 @@
+#include <runtime.h>
+
+/* Internet checksum (RFC 1071) helpers. The 16-bit words are summed as they are laid out in memory,
+ * which gives the same ones' complement sum regardless of the byte order and of the alignment of
+ * the buffer, so the result can be stored into a packet as is. The returned value is the folded
+ * sum, not its complement, as expected by lwIP for LWIP_CHKSUM. */
+
+/* Adding the two 32-bit halves of each 64-bit word to a 64-bit accumulator cannot overflow for
+ * any realistic buffer size, so carries don't need to be propagated in the loop. */
+#define csum_add_u64(sum, w)    ((sum) + (u32)(w) + ((w) >> 32))
+
+static inline u16 csum_fold(u64 sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+static inline u64 csum_tail(const u8 *p, bytes len, u64 sum)
+{
+    if (len & sizeof(u32)) {
+        sum += *(u32 *)p;
+        p += sizeof(u32);
+    }
+    if (len & sizeof(u16)) {
+        sum += *(u16 *)p;
+        p += sizeof(u16);
+    }
+    if (len & 1)
+        sum += *p;
+    return sum;
+}
+
+u16 ip_checksum(const void *buf, bytes len)
+{
+    const u8 *p = buf;
+    u64 sum = 0;
+#if defined(__x86_64__)
+    /* add-with-carry chain over 64 bytes per iteration */
+    if (len >= 64) {
+        u64 acc = 0;
+        for (bytes n = len / 64; n > 0; n--) {
+            asm("addq 0(%[p]), %[acc]\n\t"
+                "adcq 8(%[p]), %[acc]\n\t"
+                "adcq 16(%[p]), %[acc]\n\t"
+                "adcq 24(%[p]), %[acc]\n\t"
+                "adcq 32(%[p]), %[acc]\n\t"
+                "adcq 40(%[p]), %[acc]\n\t"
+                "adcq 48(%[p]), %[acc]\n\t"
+                "adcq 56(%[p]), %[acc]\n\t"
+                "adcq $0, %[acc]"
+                : [acc] "+r" (acc) : [p] "r" (p), "m" (*(const u8 (*)[64])p) : "cc");
+            p += 64;
+        }
+        sum = csum_add_u64(sum, acc);
+        len &= 63;
+    }
+#else
+    u64 sum1 = 0;
+    for (; len >= 2 * sizeof(u64); len -= 2 * sizeof(u64), p += 2 * sizeof(u64)) {
+        u64 w0 = *(u64 *)p, w1 = *(u64 *)(p + sizeof(u64));
+        sum = csum_add_u64(sum, w0);
+        sum1 = csum_add_u64(sum1, w1);
+    }
+    sum += (sum1 & 0xffffffff) + (sum1 >> 32);
+#endif
+    for (; len >= sizeof(u64); len -= sizeof(u64), p += sizeof(u64)) {
+        u64 w = *(u64 *)p;
+        sum = csum_add_u64(sum, w);
+    }
+    return csum_fold(csum_tail(p, len, sum));
+}
+
+#define CHECKSUM_COPY_FUSED_MAX 1024
+
+/* Copies len bytes from src to dst and returns the checksum of the copied data, reading the source
+ * only once. The buffers must not overlap. */
+u16 ip_checksum_copy(void *dst, const void *src, bytes len)
+{
+    const u8 *s = src;
+    u8 *d = dst;
+    u64 sum = 0;
+#if defined(__x86_64__)
+    /* larger copies are faster with the string instructions used by runtime_memcpy, while the
+       destination is still in the cache for summing */
+    if (len >= CHECKSUM_COPY_FUSED_MAX) {
+        runtime_memcpy(dst, src, len);
+        return ip_checksum(dst, len);
+    }
+    if (len >= 32) {
+        u64 acc = 0;
+        for (bytes n = len / 32; n > 0; n--) {
+            u64 w0 = ((u64 *)s)[0], w1 = ((u64 *)s)[1], w2 = ((u64 *)s)[2], w3 = ((u64 *)s)[3];
+            ((u64 *)d)[0] = w0;
+            ((u64 *)d)[1] = w1;
+            ((u64 *)d)[2] = w2;
+            ((u64 *)d)[3] = w3;
+            asm("addq %[w0], %[acc]\n\t"
+                "adcq %[w1], %[acc]\n\t"
+                "adcq %[w2], %[acc]\n\t"
+                "adcq %[w3], %[acc]\n\t"
+                "adcq $0, %[acc]"
+                : [acc] "+r" (acc) : [w0] "r" (w0), [w1] "r" (w1), [w2] "r" (w2), [w3] "r" (w3)
+                : "cc");
+            s += 32;
+            d += 32;
+        }
+        sum = csum_add_u64(sum, acc);
+        len &= 31;
+    }
+#endif
+    for (; len >= sizeof(u64); len -= sizeof(u64), s += sizeof(u64), d += sizeof(u64)) {
+        u64 w = *(u64 *)s;
+        *(u64 *)d = w;
+        sum = csum_add_u64(sum, w);
+    }
+    runtime_memcpy(d, s, len);
+    return csum_fold(csum_tail(s, len, sum));
+}
@@ -21,7 +21,17 @@ struct _closure_common {
 #define ctx_from_context(__c) (u64_from_pointer(__c) | CLOSURE_COMMON_CTX_DEALLOC_ON_FINISH | \
                                CLOSURE_COMMON_CTX_IS_CONTEXT)
 
+#if defined(MEMDEBUG_CLOSURES) || defined(MEMDEBUG_ALL)
+/* count heap-allocated closures by name, see mem_debug.c */
+void mem_debug_closure_alloc(const char *name, bytes size);
+#define closure_alloc_trace(__name) \
+    mem_debug_closure_alloc(#__name, sizeof(struct _closure_##__name))
+#else
+#define closure_alloc_trace(__name)
+#endif
+
 #define closure_alloc(__h, __name, __var)   do {                \
+    closure_alloc_trace(__name);                                \
     __var = allocate(__h, sizeof(struct _closure_##__name));    \
     if (__var != INVALID_ADDRESS) {                             \
         __var->__apply = __name;                                \
@@ -36,6 +46,7 @@ struct _closure_common {
     closure_alloc(__h, __name, __var)
 
 #define closure(__h, __name, ...) ({                                    \
+    closure_alloc_trace(__name);                                        \
     struct _closure_##__name * __n = allocate(__h, sizeof(struct _closure_##__name)); \
     __closure(ctx_from_heap(__h), __n, sizeof(struct _closure_##__name), __name, ##__VA_ARGS__);})
 
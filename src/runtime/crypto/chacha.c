@@ -104,8 +104,10 @@ chacha_ctrsave(const chacha_ctx *x, u8 *counter)
 }
 #endif
 
-LOCAL void
-chacha_encrypt_bytes(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
+/* With a null m, the keystream itself is written to c; being inlined in both callers, the core
+   loop of the keystream generator has no input loads or XORs. */
+static inline __attribute__((always_inline)) void
+chacha_blocks(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
 {
   u32 x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15;
   u32 j0, j1, j2, j3, j4, j5, j6, j7, j8, j9, j10, j11, j12, j13, j14, j15;
@@ -134,10 +136,10 @@ chacha_encrypt_bytes(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
 
   for (;;) {
     if (bytes < 64) {
-#ifndef KEYSTREAM_ONLY
-      for (i = 0;i < bytes;++i) tmp[i] = m[i];
-      m = tmp;
-#endif
+      if (m) {
+        for (i = 0;i < bytes;++i) tmp[i] = m[i];
+        m = tmp;
+      }
       ctarget = c;
       c = tmp;
     }
@@ -184,24 +186,24 @@ chacha_encrypt_bytes(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
     x14 = PLUS(x14,j14);
     x15 = PLUS(x15,j15);
 
-#ifndef KEYSTREAM_ONLY
-    x0 = XOR(x0,U8TO32_LITTLE(m + 0));
-    x1 = XOR(x1,U8TO32_LITTLE(m + 4));
-    x2 = XOR(x2,U8TO32_LITTLE(m + 8));
-    x3 = XOR(x3,U8TO32_LITTLE(m + 12));
-    x4 = XOR(x4,U8TO32_LITTLE(m + 16));
-    x5 = XOR(x5,U8TO32_LITTLE(m + 20));
-    x6 = XOR(x6,U8TO32_LITTLE(m + 24));
-    x7 = XOR(x7,U8TO32_LITTLE(m + 28));
-    x8 = XOR(x8,U8TO32_LITTLE(m + 32));
-    x9 = XOR(x9,U8TO32_LITTLE(m + 36));
-    x10 = XOR(x10,U8TO32_LITTLE(m + 40));
-    x11 = XOR(x11,U8TO32_LITTLE(m + 44));
-    x12 = XOR(x12,U8TO32_LITTLE(m + 48));
-    x13 = XOR(x13,U8TO32_LITTLE(m + 52));
-    x14 = XOR(x14,U8TO32_LITTLE(m + 56));
-    x15 = XOR(x15,U8TO32_LITTLE(m + 60));
-#endif
+    if (m) {
+      x0 = XOR(x0,U8TO32_LITTLE(m + 0));
+      x1 = XOR(x1,U8TO32_LITTLE(m + 4));
+      x2 = XOR(x2,U8TO32_LITTLE(m + 8));
+      x3 = XOR(x3,U8TO32_LITTLE(m + 12));
+      x4 = XOR(x4,U8TO32_LITTLE(m + 16));
+      x5 = XOR(x5,U8TO32_LITTLE(m + 20));
+      x6 = XOR(x6,U8TO32_LITTLE(m + 24));
+      x7 = XOR(x7,U8TO32_LITTLE(m + 28));
+      x8 = XOR(x8,U8TO32_LITTLE(m + 32));
+      x9 = XOR(x9,U8TO32_LITTLE(m + 36));
+      x10 = XOR(x10,U8TO32_LITTLE(m + 40));
+      x11 = XOR(x11,U8TO32_LITTLE(m + 44));
+      x12 = XOR(x12,U8TO32_LITTLE(m + 48));
+      x13 = XOR(x13,U8TO32_LITTLE(m + 52));
+      x14 = XOR(x14,U8TO32_LITTLE(m + 56));
+      x15 = XOR(x15,U8TO32_LITTLE(m + 60));
+    }
 
     j12 = PLUSONE(j12);
     if (!j12) {
@@ -249,8 +251,19 @@ chacha_encrypt_bytes(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
     }
     bytes -= 64;
     c += 64;
-#ifndef KEYSTREAM_ONLY
-    m += 64;
-#endif
+    if (m)
+      m += 64;
   }
 }
+
+LOCAL void
+chacha_encrypt_bytes(chacha_ctx *x,const u8 *m,u8 *c,u32 bytes)
+{
+  chacha_blocks(x, m, c, bytes);
+}
+
+LOCAL void
+chacha_keystream_bytes(chacha_ctx *x,u8 *c,u32 bytes)
+{
+  chacha_blocks(x, NULL, c, bytes);
+}
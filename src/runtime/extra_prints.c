@@ -153,6 +153,8 @@ static void print_value_internal(buffer dest, value v, table* visited, s32 inden
         }
     } else if (is_symbol(v)) {
         bprintf(dest, "%b", symbol_string((symbol)v));
+    } else if (is_integer(v)) {
+        print_number(dest, *(u64 *)v, 10, 0);
     } else if (v == null_value) {
         bprintf(dest, "<null>");
     } else {
@@ -22,6 +22,9 @@ typedef struct backed_heap {
 heap debug_heap(heap m, heap p);
 heap mem_debug(heap m, heap p, u64 padsize);
 heap mem_debug_objcache(heap meta, heap parent, u64 objsize, u64 pagesize);
+#if defined(MEMDEBUG_CLOSURES) || defined(MEMDEBUG_ALL)
+value mem_debug_closure_management(heap h);
+#endif
 
 static inline u64 heap_allocated(heap h)
 {
@@ -49,6 +52,11 @@ heap allocate_wrapped_objcache(heap meta, heap parent, bytes objsize, bytes page
 boolean objcache_validate(heap h);
 heap objcache_from_object(u64 obj, bytes parent_pagesize);
 heap allocate_mcache(heap meta, heap parent, int min_order, int max_order, bytes pagesize);
+int mcache_size_class(heap h, bytes size);
+bytes mcache_class_size(heap h, int class);
+int mcache_object_class(heap h, u64 a, bytes size);
+heap locking_heap_wrapper(heap meta, heap parent);
+boolean locking_heap_enable_magazines(heap h, int max_order, int rounds, int ncpus);
 
 // really internals
 
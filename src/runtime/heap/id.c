@@ -1,7 +1,9 @@
 #ifdef KERNEL
 #include <kernel.h>
+#define id_cache_cpu_id()   (current_cpu()->id)
 #else
 #include <runtime.h>
+#define id_cache_cpu_id()   0
 #endif
 #include <management.h>
 
@@ -220,18 +222,118 @@ closure_function(1, 1, void, destruct_id_range,
     deallocate(bound(i)->meta, r, sizeof(struct id_range));
 }
 
+/* A per-CPU page cache holds, for each page order up to max_order, free blocks of 2^order pages
+   aligned to their size. Freed blocks are coalesced with their buddy if it is in the same cache,
+   and allocations with an empty cache split a larger cached block, before falling back to the
+   heap lock, which is then taken once to refill or drain half a cache. Each order holds at most
+   the same number of pages, so a CPU caches at most (max_order + 1) * rounds pages. Optionally,
+   blocks of a single larger order (e.g. 2MB) are cached separately, up to large_rounds of them,
+   without coalescing or splitting. Cached pages are not accounted as allocated, and all caches
+   are drained when the heap runs out of pages. A cache is only used by its CPU, with interrupts
+   disabled; its lock serializes that with drains from other CPUs. */
+typedef struct id_cache {
+    u64 count;
+    u64 capacity;
+    u64 *ids;
+} *id_cache;
+
+typedef struct id_cache_cpu {
+    struct spinlock lock;
+    u64 cached;                 /* pages held in the caches */
+    u64 alloc_hits;
+    u64 alloc_misses;
+    u64 free_hits;
+    u64 free_misses;
+    struct id_cache caches[0];
+} *id_cache_cpu;
+
+typedef struct id_heap_locking {
+    struct id_heap i;
+    struct spinlock lock;
+    id_cache_cpu *cpus;         /* per-CPU page caches (optional) */
+    int ncpus;
+    int max_order;
+    int rounds;
+    int large_order;            /* -1 if no large blocks are cached */
+    int large_rounds;
+} *id_heap_locking;
+
+/* the cache of large blocks, if any, follows those of orders up to max_order */
+static inline int id_cache_count(id_heap_locking il)
+{
+    return il->max_order + 1 + (il->large_order >= 0);
+}
+
+static inline id_cache id_cache_of(id_heap_locking il, id_cache_cpu cc, int order)
+{
+    return &cc->caches[(order <= il->max_order) ? order : il->max_order + 1];
+}
+
+static inline u64 id_cache_capacity(id_heap_locking il, int order)
+{
+    return (order <= il->max_order) ? il->rounds >> order : il->large_rounds;
+}
+
+/* the block arrays of all caches follow them */
+static bytes id_cache_cpu_size(id_heap_locking il)
+{
+    bytes size = sizeof(struct id_cache_cpu) + id_cache_count(il) * sizeof(struct id_cache);
+    for (int order = 0; order <= il->max_order; order++)
+        size += id_cache_capacity(il, order) * sizeof(u64);
+    if (il->large_order >= 0)
+        size += id_cache_capacity(il, il->large_order) * sizeof(u64);
+    return size;
+}
+
+static inline void id_cache_push(id_heap_locking il, id_cache_cpu cc, int order, u64 a)
+{
+    id_cache c = id_cache_of(il, cc, order);
+    c->ids[c->count++] = a;
+    cc->cached += U64_FROM_BIT(order);
+}
+
+static inline u64 id_cache_pop(id_heap_locking il, id_cache_cpu cc, int order)
+{
+    id_cache c = id_cache_of(il, cc, order);
+    cc->cached -= U64_FROM_BIT(order);
+    return c->ids[--c->count];
+}
+
+static void id_cache_drain_order(id_heap_locking il, id_cache_cpu cc, int order)
+{
+    id_heap i = &il->i;
+    id_cache c = id_cache_of(il, cc, order);
+    while (c->count)
+        id_dealloc(&i->h, id_cache_pop(il, cc, order), page_size(i) << order);
+}
+
+/* called with the cache lock and the heap lock held */
+static u64 id_cache_drain(id_heap_locking il, id_cache_cpu cc)
+{
+    u64 pages = cc->cached;
+    for (int order = 0; order <= il->max_order; order++)
+        id_cache_drain_order(il, cc, order);
+    if (il->large_order >= 0)
+        id_cache_drain_order(il, cc, il->large_order);
+    return pages;
+}
+
 static inline bytes id_size(void)
 {
-    return sizeof(struct id_heap)
-#ifdef KERNEL
-        + sizeof(struct spinlock)
-#endif
-        ;
+    return sizeof(struct id_heap_locking);
 }
 
 static void id_destroy(heap h)
 {
     id_heap i = (id_heap)h;
+    id_heap_locking il = (id_heap_locking)h;
+    if (il->cpus) {
+        for (int cpu = 0; cpu < il->ncpus; cpu++) {
+            id_cache_drain(il, il->cpus[cpu]);
+            deallocate(i->meta, il->cpus[cpu], id_cache_cpu_size(il));
+        }
+        deallocate(i->meta, il->cpus, il->ncpus * sizeof(id_cache_cpu));
+    }
     deallocate_rangemap(i->ranges, stack_closure(destruct_id_range, i));
     deallocate(i->meta, i, id_size());
 }
@@ -256,7 +358,16 @@ closure_function(4, 1, void, set_intersection,
 
 static u64 id_allocated(heap h)
 {
-    return ((id_heap)h)->allocated;
+    id_heap i = (id_heap)h;
+    id_heap_locking il = (id_heap_locking)h;
+    if (il->cpus) {
+        /* not serialized with the caches, which is good enough for statistics */
+        u64 cached = 0;
+        for (int cpu = 0; cpu < il->ncpus; cpu++)
+            cached += il->cpus[cpu]->cached;
+        return i->allocated - (cached << page_order(i));
+    }
+    return i->allocated;
 }
 
 static u64 id_total(heap h)
@@ -328,14 +439,145 @@ static inline void set_next(id_heap i, bytes count, u64 next)
     }
 }
 
-#ifdef KERNEL
 /* locking variants */
 
-/* spinlock lies just after invariants */
-#define id_lock(h) ((spinlock)(((id_heap)h) + 1))
+#define id_lock(h) (&((id_heap_locking)(h))->lock)
+
+/* Returns the page order of an allocation that may be cached, or -1. */
+static int id_cache_order(id_heap_locking il, u64 a, bytes count)
+{
+    id_heap i = &il->i;
+    if (!il->cpus || (count == 0) || (count & page_mask(i)))
+        return -1;
+    u64 pages = count >> page_order(i);
+    int order = find_order(pages);
+    if ((pages != U64_FROM_BIT(order)) || (a & (count - 1)) ||
+        ((order > il->max_order) && (order != il->large_order)))
+        return -1;
+    return order;
+}
+
+/* Called with interrupts disabled. */
+static id_cache_cpu id_cache_get_cpu(id_heap_locking il)
+{
+    u32 id = id_cache_cpu_id();
+    return (id < il->ncpus) ? il->cpus[id] : 0;
+}
+
+static u64 id_cache_alloc(id_heap_locking il, id_cache_cpu cc, int order)
+{
+    id_heap i = &il->i;
+    id_cache c = id_cache_of(il, cc, order);
+    if (c->count) {
+        cc->alloc_hits++;
+        return id_cache_pop(il, cc, order);
+    }
+
+    /* split the smallest larger block; the caches of the orders in between are empty */
+    for (int o = order + 1; o <= il->max_order; o++) {
+        if (!cc->caches[o].count)
+            continue;
+        u64 a = id_cache_pop(il, cc, o);
+        while (o > order) {
+            o--;
+            id_cache_push(il, cc, o, a + (page_size(i) << o));
+        }
+        cc->alloc_hits++;
+        return a;
+    }
+
+    cc->alloc_misses++;
+    bytes size = page_size(i) << order;
+    u64 flags = spin_lock_irq(id_lock(il));
+    u64 a = id_alloc(&i->h, size);
+    if (a == INVALID_PHYSICAL) {
+        /* give back what this CPU holds, in case it makes up a free block */
+        id_cache_drain(il, cc);
+        a = id_alloc(&i->h, size);
+    } else {
+        while (c->count < c->capacity / 2) {
+            u64 id = id_alloc(&i->h, size);
+            if (id == INVALID_PHYSICAL)
+                break;
+            id_cache_push(il, cc, order, id);
+        }
+    }
+    spin_unlock_irq(id_lock(il), flags);
+    return a;
+}
+
+static void id_cache_dealloc(id_heap_locking il, id_cache_cpu cc, int order, u64 a)
+{
+    id_heap i = &il->i;
+    while (order < il->max_order) {
+        id_cache c = &cc->caches[order];
+        u64 buddy = a ^ (page_size(i) << order);
+        u64 n;
+        for (n = 0; n < c->count; n++) {
+            if (c->ids[n] == buddy)
+                break;
+        }
+        if (n == c->count)
+            break;
+        c->ids[n] = c->ids[c->count - 1];
+        id_cache_pop(il, cc, order);
+        a = MIN(a, buddy);
+        order++;
+    }
+    id_cache c = id_cache_of(il, cc, order);
+    if (c->count < c->capacity) {
+        cc->free_hits++;
+        id_cache_push(il, cc, order, a);
+        return;
+    }
+    cc->free_misses++;
+    bytes size = page_size(i) << order;
+    u64 flags = spin_lock_irq(id_lock(il));
+    id_dealloc(&i->h, a, size);
+    while (c->count > c->capacity / 2)
+        id_dealloc(&i->h, id_cache_pop(il, cc, order), size);
+    spin_unlock_irq(id_lock(il), flags);
+}
+
+/* Returns the caches of all CPUs to the heap; returns the number of bytes drained. */
+static u64 id_caches_drain(id_heap_locking il)
+{
+    u64 pages = 0;
+    for (int cpu = 0; cpu < il->ncpus; cpu++) {
+        id_cache_cpu cc = il->cpus[cpu];
+        if (!cc->cached)
+            continue;
+        u64 flags = spin_lock_irq(&cc->lock);
+        spin_lock(id_lock(il));
+        pages += id_cache_drain(il, cc);
+        spin_unlock(id_lock(il));
+        spin_unlock_irq(&cc->lock, flags);
+    }
+    return pages << il->i.page_order;
+}
 
 static u64 id_alloc_locking(heap h, bytes count)
 {
+    id_heap_locking il = (id_heap_locking)h;
+    int order = id_cache_order(il, 0, count);
+    if (order >= 0) {
+        u64 irqflags = irq_disable_save();
+        id_cache_cpu cc = id_cache_get_cpu(il);
+        if (cc) {
+            spin_lock(&cc->lock);
+            u64 a = id_cache_alloc(il, cc, order);
+            spin_unlock(&cc->lock);
+            irq_restore(irqflags);
+            if (a != INVALID_PHYSICAL)
+                return a;
+
+            /* the caches of other CPUs may hold enough free pages */
+            if (!id_caches_drain(il))
+                return a;
+        } else {
+            irq_restore(irqflags);
+        }
+    }
     u64 flags = spin_lock_irq(id_lock(h));
     u64 a = id_alloc(h, count);
     spin_unlock_irq(id_lock(h), flags);
@@ -344,6 +586,20 @@ static u64 id_alloc_locking(heap h, bytes count)
 
 static void id_dealloc_locking(heap h, u64 a, bytes count)
 {
+    id_heap_locking il = (id_heap_locking)h;
+    int order = id_cache_order(il, a, count);
+    if (order >= 0) {
+        u64 irqflags = irq_disable_save();
+        id_cache_cpu cc = id_cache_get_cpu(il);
+        if (cc) {
+            spin_lock(&cc->lock);
+            id_cache_dealloc(il, cc, order, a);
+            spin_unlock(&cc->lock);
+            irq_restore(irqflags);
+            return;
+        }
+        irq_restore(irqflags);
+    }
     u64 flags = spin_lock_irq(id_lock(h));
     id_dealloc(h, a, count);
     spin_unlock_irq(id_lock(h), flags);
@@ -387,10 +643,12 @@ static void set_next_locking(id_heap i, bytes count, u64 next)
     spin_unlock_irq(id_lock(i), flags);
 }
 
+#ifdef KERNEL
+
 closure_function(2, 0, value, id_get_allocated,
                  id_heap, i, value, v)
 {
-    return value_rewrite_u64(bound(v), bound(i)->allocated);
+    return value_rewrite_u64(bound(v), id_allocated(&bound(i)->h));
 }
 
 closure_function(2, 0, value, id_get_total,
@@ -402,7 +660,51 @@ closure_function(2, 0, value, id_get_total,
 closure_function(2, 0, value, id_get_free,
                  id_heap, i, value, v)
 {
-    return value_rewrite_u64(bound(v), bound(i)->total - bound(i)->allocated);
+    return value_rewrite_u64(bound(v), bound(i)->total - id_allocated(&bound(i)->h));
+}
+
+closure_function(2, 0, value, id_cache_get_stat,
+                 u64 *, stat, value, v)
+{
+    return value_rewrite_u64(bound(v), *bound(stat));
+}
+
+closure_function(3, 0, value, id_cache_get_cached,
+                 id_heap_locking, il, id_cache_cpu, cc, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(cc)->cached << bound(il)->i.page_order);
+}
+
+#define register_cache_stat(i, n, t, cc, name) do {                     \
+        value v = value_from_u64(i->meta, 0);                           \
+        symbol s = sym(name);                                           \
+        set(t, s, v);                                                   \
+        tuple_notifier_register_get_notify(n, s, closure(i->meta, id_cache_get_stat, \
+                                                         &cc->name, v)); \
+    } while (0)
+
+static tuple id_caches_management(id_heap_locking il)
+{
+    id_heap i = &il->i;
+    tuple caches = allocate_tuple();
+    assert(caches != INVALID_ADDRESS);
+    for (int cpu = 0; cpu < il->ncpus; cpu++) {
+        id_cache_cpu cc = il->cpus[cpu];
+        tuple t = allocate_tuple();
+        assert(t != INVALID_ADDRESS);
+        tuple_notifier n = tuple_notifier_wrap(t);
+        assert(n != INVALID_ADDRESS);
+        register_cache_stat(i, n, t, cc, alloc_hits);
+        register_cache_stat(i, n, t, cc, alloc_misses);
+        register_cache_stat(i, n, t, cc, free_hits);
+        register_cache_stat(i, n, t, cc, free_misses);
+        value v = value_from_u64(i->meta, 0);
+        symbol s = sym(cached);
+        set(t, s, v);
+        tuple_notifier_register_get_notify(n, s, closure(i->meta, id_cache_get_cached, il, cc, v));
+        set(caches, intern_u64(cpu), n);
+    }
+    return caches;
 }
 
 #define register_stat(i, n, t, name)                                    \
@@ -425,11 +727,76 @@ static value id_management(heap h)
     register_stat(i, n, t, allocated);
     register_stat(i, n, t, total);
     register_stat(i, n, t, free);
+    if (((id_heap_locking)i)->cpus)
+        set(t, sym(caches), id_caches_management((id_heap_locking)i));
     i->mgmt = (tuple)n;
     return n;
 }
 
-#endif /* KERNEL */
+#endif
+
+static void id_cache_init(id_heap_locking il, id_cache_cpu cc, int order, u64 **ids)
+{
+    id_cache c = id_cache_of(il, cc, order);
+    c->capacity = id_cache_capacity(il, order);
+    c->ids = *ids;
+    *ids += c->capacity;
+}
+
+/* Puts per-CPU page caches in front of a locking id heap, for blocks of up to 2^max_order pages,
+   and, if large_order is not negative, for blocks of 2^large_order pages. A cache for order n up
+   to max_order holds up to rounds >> n blocks, and the cache of large blocks up to large_rounds
+   blocks; either must be at least 2. */
+boolean id_heap_enable_page_caches(id_heap i, int max_order, int rounds, int large_order,
+                                   int large_rounds, int ncpus)
+{
+    id_heap_locking il = (id_heap_locking)i;
+    assert(i->h.alloc == id_alloc_locking);
+    assert(!il->cpus);
+    if ((max_order < 0) || (max_order >= 32) || ((rounds >> max_order) < 2) || (ncpus <= 0))
+        return false;
+    if ((large_order >= 0) && ((large_order <= max_order) || (large_order >= 32) ||
+                               (large_rounds < 2)))
+        return false;
+    il->max_order = max_order;
+    il->rounds = rounds;
+    il->large_order = large_order;
+    il->large_rounds = large_rounds;
+    id_cache_cpu *cpus = allocate(i->meta, ncpus * sizeof(id_cache_cpu));
+    if (cpus == INVALID_ADDRESS)
+        return false;
+    bytes cpu_size = id_cache_cpu_size(il);
+    int cpu;
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        id_cache_cpu cc = allocate_zero(i->meta, cpu_size);
+        if (cc == INVALID_ADDRESS)
+            goto fail;
+        spin_lock_init(&cc->lock);
+        u64 *ids = (u64 *)&cc->caches[id_cache_count(il)];
+        for (int order = 0; order <= max_order; order++)
+            id_cache_init(il, cc, order, &ids);
+        if (large_order >= 0)
+            id_cache_init(il, cc, large_order, &ids);
+        cpus[cpu] = cc;
+    }
+    il->ncpus = ncpus;
+    write_barrier();
+    il->cpus = cpus;
+    return true;
+  fail:
+    while (--cpu >= 0)
+        deallocate(i->meta, cpus[cpu], cpu_size);
+    deallocate(i->meta, cpus, ncpus * sizeof(id_cache_cpu));
+    return false;
+}
+
+/* Returns the pages held in per-CPU caches to the heap, e.g. under memory pressure; returns the
+   number of bytes drained. */
+u64 id_heap_drain_page_caches(id_heap i)
+{
+    id_heap_locking il = (id_heap_locking)i;
+    return il->cpus ? id_caches_drain(il) : 0;
+}
 
 closure_function(2, 1, void, node_foreach_handler,
                  range_handler, rh, int, order,
@@ -444,6 +811,41 @@ boolean id_heap_range_foreach(id_heap i, range_handler rh)
                                  stack_closure(node_foreach_handler, rh, page_order(i)));
 }
 
+closure_function(2, 1, void, free_range_foreach_handler,
+                 range_handler, rh, int, order,
+                 rmnode, n)
+{
+    u64 *map = bitmap_base(((id_range)n)->b);
+    u64 pages = range_span(n->r);
+    u64 start = infinity;
+    for (u64 bit = 0; bit < pages; bit++) {
+        u64 w = map[bit >> 6];
+
+        /* skip whole words that cannot begin or end a free run */
+        if ((bit & 63) == 0 && bit + 64 <= pages && w == (start == infinity ? -1ull : 0)) {
+            bit += 63;
+            continue;
+        }
+        boolean allocated = (w & U64_FROM_BIT(bit & 63)) != 0;
+        if (!allocated && start == infinity) {
+            start = bit;
+        } else if (allocated && start != infinity) {
+            apply(bound(rh), range_lshift(irange(n->r.start + start, n->r.start + bit),
+                                          bound(order)));
+            start = infinity;
+        }
+    }
+    if (start != infinity)
+        apply(bound(rh), range_lshift(irange(n->r.start + start, n->r.end), bound(order)));
+}
+
+/* Calls rh for each maximal run of unallocated ids. Not serialized with allocations. */
+boolean id_heap_free_range_foreach(id_heap i, range_handler rh)
+{
+    return rangemap_range_lookup(i->ranges, (range){0, infinity},
+                                 stack_closure(free_range_foreach_handler, rh, page_order(i)));
+}
+
 id_heap allocate_id_heap(heap meta, heap map, bytes pagesize, boolean locking)
 {
     assert((pagesize & (pagesize-1)) == 0); /* pagesize is power of 2 */
@@ -459,6 +861,10 @@ id_heap allocate_id_heap(heap meta, heap map, bytes pagesize, boolean locking)
 
 #ifdef KERNEL
     i->h.management = id_management;
+#else
+    i->h.management = 0;
+#endif
+    ((id_heap_locking)i)->cpus = 0;
     if (locking) {
         spin_lock_init(id_lock(i));
         i->h.alloc = id_alloc_locking;
@@ -468,11 +874,7 @@ id_heap allocate_id_heap(heap meta, heap map, bytes pagesize, boolean locking)
         i->set_randomize = set_randomize_locking;
         i->alloc_subrange = alloc_subrange_locking;
         i->set_next = set_next_locking;
-    } else
-#else
-    i->h.management = 0;
-#endif
-    {
+    } else {
         i->h.alloc = id_alloc;
         i->h.dealloc = id_dealloc;
         i->add_range = add_range;
@@ -22,6 +22,10 @@ id_heap create_id_heap(heap meta, heap map, u64 base, u64 length, bytes pagesize
 id_heap create_id_heap_backed(heap meta, heap map, heap parent, bytes pagesize, boolean locking);
 id_heap allocate_id_heap(heap meta, heap map, bytes pagesize, boolean locking); /* id heap with no ranges */
 boolean id_heap_range_foreach(id_heap i, range_handler rh);
+boolean id_heap_free_range_foreach(id_heap i, range_handler rh);
+boolean id_heap_enable_page_caches(id_heap i, int max_order, int rounds, int large_order,
+                                   int large_rounds, int ncpus);
+u64 id_heap_drain_page_caches(id_heap i);
 #define destroy_id_heap(__h) destroy_heap(&(__h)->h)
 #define id_heap_add_range(__h, __b, __l) ((__h)->add_range(__h, __b, __l))
 #define id_heap_set_area(__h, __b, __l, __v, __a) ((__h)->set_area(__h, __b, __l, __v, __a))
@@ -2,8 +2,24 @@
 
    This heap multiplexes allocations across a set of objcaches of
    varying sizes. Allocations are made from the cache of the smallest
-   size greater than or equal to the alloc size. Allocations of sizes
-   greater than the largest cache size are served from the parent heap.
+   size greater than or equal to the alloc size, which is looked up in
+   a precomputed index. Allocations of sizes greater than the largest
+   cache size are served from the parent heap.
+
+   Besides powers of 2, size classes include intermediate sizes
+   (MCACHE_SUBCLASSES per power of 2, up to the largest cache size),
+   so as to limit the space wasted when rounding up allocation sizes.
+   Intermediate sizes are multiples of MCACHE_ALIGN, which is the
+   minimum alignment of allocated objects. The spacing was chosen by
+   replaying allocation traces of the TFS tools (mkfs and dump of a
+   4k-file tree): besides small objects, a large share of live memory
+   is in 4-64KB buffers, which a second class at 1.5 * 2^n serves
+   with little rounding, while finer spacing adds partially used
+   slabs for a negligible gain in rounding.
+
+   Defining MCACHE_HISTOGRAM makes the heap collect a histogram of
+   allocation sizes (with MCACHE_ALIGN granularity), exported in the
+   management tuple, which can be used to tune the size classes.
 
    To facilitate vendor code in the kernel that requires a malloc /
    free interface, deallocations may be made with a size of -1ull,
@@ -14,25 +30,44 @@
 */
 
 //#define MCACHE_DEBUG
+//#define MCACHE_HISTOGRAM
 
 #include <runtime.h>
 #include <management.h>
 
+#define MCACHE_SUBCLASSES           2
+#define MCACHE_ALIGN_ORDER          4
+#define MCACHE_ALIGN                U64_FROM_BIT(MCACHE_ALIGN_ORDER)
+
 typedef struct mcache {
     struct heap h;
     heap parent;
     heap meta;
     vector caches;
+    u8 *class_index;        /* cache index for each multiple of MCACHE_ALIGN up to parent_threshold */
+    u64 class_index_len;
     u64 pagesize;
     u64 allocated;
     u64 parent_threshold;
+#ifdef MCACHE_HISTOGRAM
+    u64 *histogram;         /* class_index_len buckets, plus one for parent allocations */
+#endif
     tuple mgmt;
 } *mcache;
 
+static inline u64 mcache_index_from_size(bytes b)
+{
+    return (b + MCACHE_ALIGN - 1) >> MCACHE_ALIGN_ORDER;
+}
+
 u64 mcache_alloc(heap h, bytes b)
 {
     mcache m = (mcache)h;
     heap o;
+#ifdef MCACHE_HISTOGRAM
+    fetch_and_add(&m->histogram[b > m->parent_threshold ? m->class_index_len :
+                                mcache_index_from_size(b)], 1);
+#endif
 #ifdef MCACHE_DEBUG
     rputs("mcache_alloc:   heap ");
     print_u64(u64_from_pointer(h));
@@ -54,40 +89,36 @@ u64 mcache_alloc(heap h, bytes b)
 #endif
             return a;
         }
-    }
-
-    /* Could become a binary search if search set is large... */
-    vector_foreach(m->caches, o) {
-	if (o && b <= o->pagesize) {
 #ifdef MCACHE_DEBUG
-	    rputs("match cache ");
-	    print_u64(u64_from_pointer(o));
-	    rputs(" obj size ");
-	    print_u64(o->pagesize);
-	    rputs(", pre validate...");
-	    if (objcache_validate((heap)o))
-		rputs("pass, alloc ");
-	    else
-		halt("failed!\n");
+        rputs("no matching cache; fail\n");
 #endif
-	    u64 a = allocate_u64(o, o->pagesize);
-	    if (a != INVALID_PHYSICAL)
-		m->allocated += o->pagesize;
+        return INVALID_PHYSICAL;
+    }
+
+    o = vector_get(m->caches, m->class_index[mcache_index_from_size(b)]);
 #ifdef MCACHE_DEBUG
-	    print_u64(a);
-	    rputs(", post validate...");
-	    if (objcache_validate((heap)o))
-		rputs("pass\n");
-	    else
-		halt("failed!\n");
+    rputs("match cache ");
+    print_u64(u64_from_pointer(o));
+    rputs(" obj size ");
+    print_u64(o->pagesize);
+    rputs(", pre validate...");
+    if (objcache_validate((heap)o))
+        rputs("pass, alloc ");
+    else
+        halt("failed!\n");
 #endif
-	    return a;
-	}
-    }
+    u64 a = allocate_u64(o, o->pagesize);
+    if (a != INVALID_PHYSICAL)
+        m->allocated += o->pagesize;
 #ifdef MCACHE_DEBUG
-    rputs("no matching cache; fail\n");
+    print_u64(a);
+    rputs(", post validate...");
+    if (objcache_validate((heap)o))
+        rputs("pass\n");
+    else
+        halt("failed!\n");
 #endif
-    return INVALID_PHYSICAL;
+    return a;
 }
 
 void mcache_dealloc(heap h, u64 a, bytes b)
@@ -178,9 +209,53 @@ void destroy_mcache(heap h)
 	if (o)
 	    o->destroy(o);
     }
+    deallocate_vector(m->caches);
+    if (m->class_index)
+        deallocate(m->meta, m->class_index, m->class_index_len);
+#ifdef MCACHE_HISTOGRAM
+    if (m->histogram)
+        deallocate(m->meta, m->histogram, (m->class_index_len + 1) * sizeof(u64));
+#endif
     deallocate(m->meta, m, sizeof(struct mcache));
 }
 
+/* Returns the index of the size class serving allocations of the given size, or -1 if these are
+   served by the parent heap. */
+int mcache_size_class(heap h, bytes size)
+{
+    mcache m = (mcache)h;
+    if (size > m->parent_threshold)
+        return -1;
+    return m->class_index[mcache_index_from_size(size)];
+}
+
+/* Returns the index of the size class of the cache an object was allocated from, or -1 if the
+   object was served by the parent heap, or if its size (unless -1ull) exceeds that of its cache. */
+int mcache_object_class(heap h, u64 a, bytes size)
+{
+    mcache m = (mcache)h;
+    if ((size != -1ull) && (size > m->parent_threshold))
+        return -1;
+    heap o = objcache_from_object(a, m->pagesize);
+    if ((o == INVALID_ADDRESS) || ((size != -1ull) && (size > o->pagesize)))
+        return -1;
+
+    /* a first cache smaller than MCACHE_ALIGN only serves zero-sized allocations */
+    int class = m->class_index[mcache_index_from_size(o->pagesize)];
+    if (vector_get(m->caches, class) != o) {
+        class = 0;
+        if (vector_get(m->caches, class) != o)
+            return -1;
+    }
+    return class;
+}
+
+bytes mcache_class_size(heap h, int class)
+{
+    heap o = vector_get(((mcache)h)->caches, class);
+    return o ? o->pagesize : 0;
+}
+
 static u64 mcache_allocated(heap h)
 {
     return ((mcache)h)->allocated;
@@ -216,6 +291,25 @@ closure_function(2, 0, value, mcache_get_free,
     return value_rewrite_u64(bound(v), mcache_total(h) - mcache_allocated(h));
 }
 
+#ifdef MCACHE_HISTOGRAM
+/* Renders the histogram as a list of "<max size>:<count>" pairs, with parent allocations listed
+   with a size of 0. */
+closure_function(2, 0, value, mcache_get_histogram,
+                 mcache, m, value, v)
+{
+    mcache m = bound(m);
+    buffer b = (buffer)bound(v);
+    buffer_clear(b);
+    for (u64 i = 0; i <= m->class_index_len; i++) {
+        u64 count = m->histogram[i];
+        if (count)
+            bprintf(b, "%s%ld:%ld", buffer_length(b) ? " " : "",
+                    (i < m->class_index_len) ? i << MCACHE_ALIGN_ORDER : 0, count);
+    }
+    return b;
+}
+#endif
+
 #define register_stat(m, n, t, name)                                    \
     v = value_from_u64(m->meta, 0);                                     \
     s = sym(name);                                                      \
@@ -244,6 +338,12 @@ static value mcache_management(heap h)
             set(c, intern_u64(o->pagesize), heap_management(o));
     }
     set(t, sym(caches), c);
+#ifdef MCACHE_HISTOGRAM
+    v = allocate_buffer(m->meta, 64);
+    s = sym(histogram);
+    set(t, s, v);
+    tuple_notifier_register_get_notify(n, s, closure(m->meta, mcache_get_histogram, m, v));
+#endif
     m->mgmt = (tuple)n;
     return n;
 }
@@ -290,30 +390,57 @@ heap allocate_mcache(heap meta, heap parent, int min_order, int max_order, bytes
     m->pagesize = pagesize;
     m->allocated = 0;
     m->parent_threshold = U64_FROM_BIT(max_order);
+    m->class_index_len = mcache_index_from_size(m->parent_threshold) + 1;
+#ifdef MCACHE_HISTOGRAM
+    m->histogram = 0;
+#endif
     m->mgmt = 0;
+    m->class_index = allocate(meta, m->class_index_len);
+    if (m->class_index == INVALID_ADDRESS) {
+        m->class_index = 0;
+        destroy_mcache((heap)m);
+        return INVALID_ADDRESS;
+    }
+#ifdef MCACHE_HISTOGRAM
+    m->histogram = allocate_zero(meta, (m->class_index_len + 1) * sizeof(u64));
+    if (m->histogram == INVALID_ADDRESS) {
+        m->histogram = 0;
+        destroy_mcache((heap)m);
+        return INVALID_ADDRESS;
+    }
+#endif
 
-    for(int i = 0, order = min_order; order <= max_order; i++, order++) {
-	u64 obj_size = U64_FROM_BIT(order);
+    u64 index = 0;
+    for (int i = 0, order = min_order; order <= max_order; order++) {
+        u64 step = U64_FROM_BIT(order);
+        if (order < max_order)
+            step = MAX(step / MCACHE_SUBCLASSES, MCACHE_ALIGN);
+        for (u64 obj_size = U64_FROM_BIT(order); (obj_size < U64_FROM_BIT(order + 1)) &&
+             (obj_size <= m->parent_threshold); obj_size += step, i++) {
 #if defined(MEMDEBUG_MCACHE) || defined(MEMDEBUG_ALL)
-	heap h = mem_debug_objcache(meta, parent, obj_size, pagesize);
+            heap h = mem_debug_objcache(meta, parent, obj_size, pagesize);
 #else
-	heap h = allocate_objcache(meta, parent, obj_size, pagesize);
+            heap h = allocate_objcache(meta, parent, obj_size, pagesize);
 #endif
 #ifdef MCACHE_DEBUG
-	rputs(" - cache size ");
-	print_u64(obj_size);
-	rputs(": ");
-	print_u64(u64_from_pointer(h));
-	rputs("\n");
+            rputs(" - cache size ");
+            print_u64(obj_size);
+            rputs(": ");
+            print_u64(u64_from_pointer(h));
+            rputs("\n");
 #endif
-	if (h == INVALID_ADDRESS) {
-	    rputs("allocate_mcache: failed to allocate objcache of size ");
-	    print_u64(obj_size);
-	    rputs("\n");
-	    destroy_mcache((heap)m);
-	    return INVALID_ADDRESS;
-	}
-	assert(vector_set(m->caches, i, h));
+            if (h == INVALID_ADDRESS) {
+                rputs("allocate_mcache: failed to allocate objcache of size ");
+                print_u64(obj_size);
+                rputs("\n");
+                destroy_mcache((heap)m);
+                return INVALID_ADDRESS;
+            }
+            assert(vector_set(m->caches, i, h));
+            assert(i < U64_FROM_BIT(8));
+            while ((index < m->class_index_len) && ((index << MCACHE_ALIGN_ORDER) <= obj_size))
+                m->class_index[index++] = i;
+        }
     }
     return (heap)m;
 }
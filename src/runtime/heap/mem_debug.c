@@ -243,3 +243,73 @@ backed_heap mem_debug_backed(heap meta, backed_heap parent, u64 padsize, boolean
     return &mbh->bh;
 }
 #endif
+
+#if defined(MEMDEBUG_CLOSURES) || defined(MEMDEBUG_ALL)
+#include <management.h>
+
+/* Closure allocation tracer: counts the closures allocated from a heap or context (i.e. not
+ * embedded or stack closures) by closure name, so that code paths that allocate a closure per
+ * operation can be found. Entries are keyed by the address of the (static) name string and are
+ * inserted without locking in a fixed-size open-addressing table; allocations that find no free
+ * entry are only counted as dropped. */
+#define CLOSURE_TRACE_ORDER     10
+#define CLOSURE_TRACE_ENTRIES   U64_FROM_BIT(CLOSURE_TRACE_ORDER)
+
+static struct closure_trace_entry {
+    u64 name;
+    word count;
+    word bytes;
+} closure_trace[CLOSURE_TRACE_ENTRIES];
+static word closure_trace_dropped;
+
+void mem_debug_closure_alloc(const char *name, bytes size)
+{
+    u64 n = u64_from_pointer(name);
+    u64 i = (n * 0x9e3779b97f4a7c15ull) >> (64 - CLOSURE_TRACE_ORDER);
+    for (u64 probe = 0; probe < CLOSURE_TRACE_ENTRIES; probe++) {
+        struct closure_trace_entry *e = &closure_trace[(i + probe) & (CLOSURE_TRACE_ENTRIES - 1)];
+        u64 en = *(volatile u64 *)&e->name;
+        if (!en && compare_and_swap_64(&e->name, 0, n))
+            en = n;
+        else if (!en)
+            en = *(volatile u64 *)&e->name;
+        if (en == n) {
+            fetch_and_add(&e->count, 1);
+            fetch_and_add(&e->bytes, size);
+            return;
+        }
+    }
+    fetch_and_add(&closure_trace_dropped, 1);
+}
+
+/* Renders the table as a list of "<name>:<count>:<bytes>" entries. */
+closure_function(1, 0, value, mem_debug_closure_get_allocs,
+                 value, v)
+{
+    buffer b = (buffer)bound(v);
+    buffer_clear(b);
+    for (u64 i = 0; i < CLOSURE_TRACE_ENTRIES; i++) {
+        struct closure_trace_entry *e = &closure_trace[i];
+        if (e->name)
+            bprintf(b, "%s%s:%ld:%ld", buffer_length(b) ? " " : "",
+                    pointer_from_u64(e->name), e->count, e->bytes);
+    }
+    if (closure_trace_dropped)
+        bprintf(b, "%sdropped:%ld", buffer_length(b) ? " " : "", closure_trace_dropped);
+    return b;
+}
+
+value mem_debug_closure_management(heap h)
+{
+    tuple t = allocate_tuple();
+    assert(t != INVALID_ADDRESS);
+    tuple_notifier n = tuple_notifier_wrap(t);
+    assert(n != INVALID_ADDRESS);
+    value v = allocate_buffer(h, 64);
+    assert(v != INVALID_ADDRESS);
+    symbol s = sym(allocations);
+    set(t, s, v);
+    tuple_notifier_register_get_notify(n, s, closure(h, mem_debug_closure_get_allocs, v));
+    return n;
+}
+#endif
@@ -0,0 +1,178 @@
+#include <runtime.h>
+
+/* LZ4 block format
+
+   A block is a sequence of (literals, match) pairs. Each sequence begins with a token byte,
+   holding the literal length in its upper nibble and the match length minus LZ4_MIN_MATCH in its
+   lower nibble; a nibble value of 15 is followed by additional length bytes, each added to the
+   length, until a byte other than 255. The literals follow, then the match offset as a 16-bit
+   little-endian value, then any additional match length bytes. The last sequence has no match,
+   and holds at least the last LZ4_LAST_LITERALS bytes of the input. */
+
+#define LZ4_MIN_MATCH       4
+#define LZ4_LAST_LITERALS   5
+#define LZ4_MFLIMIT         12      /* no match may start in the last 12 bytes */
+#define LZ4_MAX_OFFSET      65535
+#define LZ4_HASH_BITS       12
+#define LZ4_RUN_MASK        15
+
+static inline u32 lz4_read32(const u8 *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static inline u32 lz4_hash(u32 seq)
+{
+    return (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+static inline u64 lz4_length_bytes(u64 length)
+{
+    return (length >= LZ4_RUN_MASK) ? (length - LZ4_RUN_MASK) / 255 + 1 : 0;
+}
+
+static inline u8 *lz4_put_length(u8 *op, u64 length)
+{
+    for (length -= LZ4_RUN_MASK; length >= 255; length -= 255)
+        *op++ = 255;
+    *op++ = length;
+    return op;
+}
+
+/* Emits a sequence; a zero match length denotes the last sequence. Returns 0 if the output
+   buffer is too small. */
+static u8 *lz4_put_sequence(u8 *op, u8 *oend, const u8 *literals, u64 lit_len, u64 offset,
+                            u64 match_len)
+{
+    u64 ml = match_len ? match_len - LZ4_MIN_MATCH : 0;
+    u64 needed = 1 + lz4_length_bytes(lit_len) + lit_len;
+    if (match_len)
+        needed += 2 + lz4_length_bytes(ml);
+    if (needed > oend - op)
+        return 0;
+    u8 *token = op++;
+    *token = MIN(lit_len, LZ4_RUN_MASK) << 4;
+    if (lit_len >= LZ4_RUN_MASK)
+        op = lz4_put_length(op, lit_len);
+    runtime_memcpy(op, literals, lit_len);
+    op += lit_len;
+    if (match_len) {
+        *op++ = offset;
+        *op++ = offset >> 8;
+        *token |= MIN(ml, LZ4_RUN_MASK);
+        if (ml >= LZ4_RUN_MASK)
+            op = lz4_put_length(op, ml);
+    }
+    return op;
+}
+
+/* Compresses len bytes at src into dst, using a workmem area of LZ4_WORKMEM_SIZE bytes. Returns
+   the compressed length, or 0 if it would exceed dst_len. */
+u64 lz4_compress(const void *src, u64 len, void *dst, u64 dst_len, void *workmem)
+{
+    const u8 *in = src;
+    const u8 *ip = in;
+    const u8 *anchor = in;
+    const u8 *iend = in + len;
+    u8 *op = dst;
+    u8 *oend = op + dst_len;
+    u32 *table = workmem;
+
+    zero(table, LZ4_WORKMEM_SIZE);
+    if (len > LZ4_MFLIMIT) {
+        const u8 *mflimit = iend - LZ4_MFLIMIT;
+        const u8 *matchlimit = iend - LZ4_LAST_LITERALS;
+        while (ip < mflimit) {
+            u32 seq = lz4_read32(ip);
+            u32 h = lz4_hash(seq);
+            const u8 *ref = in + table[h];
+            table[h] = ip - in;
+            if ((ref >= ip) || (ip - ref > LZ4_MAX_OFFSET) || (lz4_read32(ref) != seq)) {
+                ip++;
+                continue;
+            }
+
+            /* extend the match backward over pending literals, then forward */
+            while ((ip > anchor) && (ref > in) && (ip[-1] == ref[-1])) {
+                ip--;
+                ref--;
+            }
+            const u8 *match = ip;
+            u64 offset = ip - ref;
+            ip += LZ4_MIN_MATCH;
+            ref += LZ4_MIN_MATCH;
+            while ((ip < matchlimit) && (*ip == *ref)) {
+                ip++;
+                ref++;
+            }
+            op = lz4_put_sequence(op, oend, anchor, match - anchor, offset, ip - match);
+            if (!op)
+                return 0;
+            anchor = ip;
+            if (ip < mflimit)
+                table[lz4_hash(lz4_read32(ip - 2))] = ip - 2 - in;
+        }
+    }
+    op = lz4_put_sequence(op, oend, anchor, iend - anchor, 0, 0);
+    if (!op)
+        return 0;
+    return op - (u8 *)dst;
+}
+
+static inline boolean lz4_get_length(const u8 **ip, const u8 *iend, u64 *length)
+{
+    u8 b;
+    do {
+        if (*ip >= iend)
+            return false;
+        b = *(*ip)++;
+        *length += b;
+    } while (b == 255);
+    return true;
+}
+
+/* Decompresses a block of len bytes at src into dst. Returns the decompressed length, or -1 if
+   the block is malformed or its contents exceed dst_len. */
+s64 lz4_decompress(const void *src, u64 len, void *dst, u64 dst_len)
+{
+    const u8 *ip = src;
+    const u8 *iend = ip + len;
+    u8 *op = dst;
+    u8 *oend = op + dst_len;
+
+    while (ip < iend) {
+        u8 token = *ip++;
+        u64 lit_len = token >> 4;
+        if ((lit_len == LZ4_RUN_MASK) && !lz4_get_length(&ip, iend, &lit_len))
+            return -1;
+        if ((lit_len > iend - ip) || (lit_len > oend - op))
+            return -1;
+        runtime_memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == iend)
+            break;  /* last sequence */
+        if (iend - ip < 2)
+            return -1;
+        u64 offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ((offset == 0) || (offset > op - (u8 *)dst))
+            return -1;
+        u64 match_len = token & LZ4_RUN_MASK;
+        if ((match_len == LZ4_RUN_MASK) && !lz4_get_length(&ip, iend, &match_len))
+            return -1;
+        match_len += LZ4_MIN_MATCH;
+        if (match_len > oend - op)
+            return -1;
+        const u8 *ref = op - offset;
+        if (offset >= match_len) {
+            runtime_memcpy(op, ref, match_len);
+            op += match_len;
+        } else {
+            /* overlapping match: replicate the last offset bytes */
+            while (match_len-- > 0)
+                *op++ = *ref++;
+        }
+    }
+    return op - (u8 *)dst;
+}
@@ -1,5 +1,69 @@
 #include <runtime.h>
 
+#if defined(__x86_64__)
+/* Copies and fills of at least memops_rep_min bytes are done with the string instructions, which
+ * with the Enhanced REP MOVSB/STOSB (ERMS) feature move whole cache lines at a time; with Fast Short
+ * REP MOV (FSRM), they are also the fastest option for short copies. Only general-purpose registers
+ * are used, so that kernel code does not need to preserve the user FPU/SIMD state. Large
+ * non-overlapping copies use non-temporal stores, which bypass the cache instead of evicting the
+ * working set. Until init_memops() has run, the generic implementations below are used. */
+#define CPUID_7_EBX_ERMS    U64_FROM_BIT(9)
+#define CPUID_7_EDX_FSRM    U64_FROM_BIT(4)
+
+#define MEMOPS_ERMS_MIN             128
+#define MEMOPS_NONTEMPORAL_MIN      (1 * MB)
+
+static bytes memops_rep_min = -1ull;
+
+void init_memops(void)
+{
+    u32 a, b, c, d;
+    asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0));
+    if (a < 7)
+        return;
+    asm volatile("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (7), "c" (0));
+    if (d & CPUID_7_EDX_FSRM)
+        memops_rep_min = 0;
+    else if (b & CPUID_7_EBX_ERMS)
+        memops_rep_min = MEMOPS_ERMS_MIN;
+}
+
+static inline void memcpy_rep(void *dst, const void *src, bytes len)
+{
+    asm volatile("rep movsb" : "+D" (dst), "+S" (src), "+c" (len) : : "memory");
+}
+
+static inline void memset_rep(void *dst, u8 b, bytes len)
+{
+    asm volatile("rep stosb" : "+D" (dst), "+c" (len) : "a" (b) : "memory");
+}
+
+/* The destination is aligned to 8 bytes, then written 64 bytes at a time with non-temporal stores;
+ * the source may be misaligned. */
+static void memcpy_nontemporal(void *dst, const void *src, bytes len)
+{
+    bytes head = -u64_from_pointer(dst) & (sizeof(u64) - 1);
+    memcpy_rep(dst, src, head);
+    dst += head;
+    src += head;
+    len -= head;
+    u64 *d = dst;
+    const u64 *s = src;
+    for (bytes n = len / 64; n > 0; n--) {
+        for (int i = 0; i < 8; i++)
+            asm volatile("movnti %1, %0" : "=m" (d[i]) : "r" (s[i]));
+        d += 8;
+        s += 8;
+    }
+    asm volatile("sfence" ::: "memory");
+    memcpy_rep(d, s, len & 63);
+}
+#else
+void init_memops(void)
+{
+}
+#endif
+
 /* Copy by advancing memory addresses in forward direction. */
 static inline void memcpyf_8(void *dst, const void *src, bytes len)
 {
@@ -45,6 +109,16 @@ void runtime_memcpy(void *a, const void *b, bytes len)
     unsigned long long_word1;
     unsigned long long_word2;
 
+#if defined(__x86_64__)
+    /* a forward string copy is also correct when the destination precedes an overlapping source */
+    if ((len >= memops_rep_min) && ((a < b) || (a >= b + len))) {
+        if ((len >= MEMOPS_NONTEMPORAL_MIN) && ((a + len <= b) || (a >= b + len)))
+            memcpy_nontemporal(a, b, len);
+        else
+            memcpy_rep(a, b, len);
+        return;
+    }
+#endif
     if ((unsigned long)a < (unsigned long)b) {
         if (len < sizeof(long)) {
             memcpyf_8(a, b, len);
@@ -126,6 +200,12 @@ void runtime_memcpy(void *a, const void *b, bytes len)
 
 void runtime_memset(u8 *a, u8 b, bytes len)
 {
+#if defined(__x86_64__)
+    if (len >= memops_rep_min) {
+        memset_rep(a, b, len);
+        return;
+    }
+#endif
     if (len < sizeof(long)) {
         memset_8(a, b, len);
         return;
@@ -154,6 +234,18 @@ void runtime_memset(u8 *a, u8 b, bytes len)
 
 int runtime_memcmp(const void *a, const void *b, bytes len)
 {
+#if defined(__x86_64__)
+    /* unaligned loads are cheap, and byte-swapping the first mismatching words gives the sign */
+    while (len >= sizeof(u64)) {
+        u64 wa = *(u64 *)a, wb = *(u64 *)b;
+        if (wa != wb)
+            return __builtin_bswap64(wa) < __builtin_bswap64(wb) ? -1 : 1;
+        a += sizeof(u64);
+        b += sizeof(u64);
+        len -= sizeof(u64);
+    }
+    return memcmp_8(a, b, len);
+#else
     unsigned long res;
 
     if (len < sizeof(long)) {
@@ -203,4 +295,5 @@ int runtime_memcmp(const void *a, const void *b, bytes len)
         }
     }
     return memcmp_8(a + len - end_len, p_long_b, end_len);
+#endif
 }
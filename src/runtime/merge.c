@@ -6,55 +6,55 @@
 
 typedef closure_type(merge_apply, status_handler);
 
-struct merge {
-   heap h;
-   word count;
-   merge_apply apply;
-   status_handler completion;
-   status last_status;
-};
-
-closure_function(1, 1, void, merge_join,
-                 merge, m,
-                 status, s)
+define_closure_function(0, 1, void, merge_join,
+                        status, s)
 {
-    merge m = bound(m);
+    merge m = struct_from_field(closure_self(), merge, join);
     if (s != STATUS_OK)
         m->last_status = s; // last failed status
 
     word n = fetch_and_add(&m->count, (word)-1);
     if (n == 1) {
+        status_handler completion = m->completion;
+        status last_status = m->last_status;
+        if (m->h)
+            deallocate(m->h, m, sizeof(struct merge));
 #if KERNEL
-        async_apply_status_handler(m->completion, m->last_status);
+        async_apply_status_handler(completion, last_status);
 #else
-        apply(m->completion, m->last_status);
+        apply(completion, last_status);
 #endif
-        deallocate_closure(m->apply);
-        deallocate(m->h, m, sizeof(struct merge));
-        closure_finish();
     }
 }
 
-closure_function(2, 0, status_handler, merge_add,
-                 merge, m, status_handler, sh)
+define_closure_function(0, 0, status_handler, merge_add)
+{
+    merge m = struct_from_field(closure_self(), merge, add);
+    fetch_and_add(&m->count, 1);
+    return (status_handler)&m->join;
+}
+
+void init_merge(merge m, status_handler completion)
 {
-    fetch_and_add(&bound(m)->count, 1);
-    return bound(sh);
+    m->h = 0;
+    m->count = 0;
+    m->completion = completion;
+    m->last_status = STATUS_OK;
+    init_closure(&m->join, merge_join);
+    init_closure(&m->add, merge_add);
 }
 
 merge allocate_merge(heap h, status_handler completion)
 {
-    merge m = allocate_zero(h, sizeof(struct merge));
+    merge m = allocate(h, sizeof(struct merge));
     assert(m != INVALID_ADDRESS);
+    init_merge(m, completion);
     m->h = h;
-    status_handler sh = closure(h, merge_join, m);
-    m->apply = closure(h, merge_add, m, sh);
-    m->completion = completion;
-    m->last_status = STATUS_OK;
     return m;
 }
 
 status_handler apply_merge(merge m)
 {
-    return apply(m->apply);
+    merge_apply add = (merge_apply)&m->add;
+    return apply(add);
 }
@@ -25,7 +25,11 @@
  *
  */
 
+#ifdef KERNEL
+#include <kernel.h>
+#else
 #include <runtime.h>
+#endif
 #include <crypto/chacha.h>
 
 /*
@@ -37,14 +41,22 @@
 #define CHACHA20_RESEED_BYTES   65536
 #define CHACHA20_RESEED_SECONDS 300
 #define CHACHA20_KEYBYTES       32
-#define CHACHA20_BUFFER_SIZE    64
 
+/* keystream generated ahead for small requests, such as random_u64() */
+#define CHACHA20_BUFFER_SIZE    (4 * CHACHA_BLOCKLEN)
+
+/* large requests are generated in chunks, each with its own range of block counters */
+#define CHACHA20_CHUNK_SIZE     (4 * KB)
+
+/* In the kernel, each CPU has its own generator, so that callers on different CPUs neither share
+   a cache line nor serialize on the generator state. */
 struct chacha20_s {
-    int numbytes;
+    u64 numbytes;
     u64 t_reseed;
-    u8 m_buffer[CHACHA20_BUFFER_SIZE];
+    u32 avail;          /* unused bytes at the end of m_buffer */
     struct chacha_ctx ctx;
-};
+    u8 m_buffer[CHACHA20_BUFFER_SIZE];
+} __attribute__((aligned(64)));
 
 extern u64 random_seed();
 
@@ -60,7 +72,6 @@ chacha20_randomstir(struct chacha20_s *chacha20, timestamp t)
     for (int i = 0; i < sizeof(key); i += sizeof(seed)) {
         seed = random_seed();
         *(u64 *) (key + i) = seed;
-        i += sizeof(seed);
     }
 
     u64 now_sec = sec_from_timestamp(t);
@@ -71,38 +82,102 @@ chacha20_randomstir(struct chacha20_s *chacha20, timestamp t)
     /* Reset for next reseed cycle. */
     chacha20->t_reseed = now_sec + CHACHA20_RESEED_SECONDS;
     chacha20->numbytes = 0;
+    zero(chacha20->m_buffer, sizeof(chacha20->m_buffer));
+    chacha20->avail = 0;
 }
 
-// should be per-CPU structure
+static void chacha20_check_reseed(struct chacha20_s *chacha20, bytes len)
+{
+    timestamp t = now(CLOCK_ID_MONOTONIC_RAW);
+    if ((chacha20->numbytes > CHACHA20_RESEED_BYTES) || (sec_from_timestamp(t) > chacha20->t_reseed))
+        chacha20_randomstir(chacha20, t);
+    chacha20->numbytes += len;
+}
+
+/* Used until the per-CPU generators are set up, and outside of the kernel. Until first used, a
+   generator has a zero t_reseed, so that it is seeded on its first request. */
 static struct chacha20_s chacha20inst;
 
+#ifdef KERNEL
+
+static struct chacha20_s *chacha20_percpu;
+
+void init_random_cpus(heap h)
+{
+    struct chacha20_s *p = allocate_zero(h, present_processors * sizeof(struct chacha20_s));
+    assert(p != INVALID_ADDRESS);
+    __atomic_store_n(&chacha20_percpu, p, __ATOMIC_RELEASE);
+}
+
+/* called with interrupts disabled */
+static inline struct chacha20_s *chacha20_get(void)
+{
+    struct chacha20_s *p = __atomic_load_n(&chacha20_percpu, __ATOMIC_ACQUIRE);
+    return p ? &p[current_cpu()->id] : &chacha20inst;
+}
+
+#define chacha20_lock()         u64 _irqflags = irq_disable_save()
+#define chacha20_unlock()       irq_restore(_irqflags)
+
+#else
+
+#define chacha20_get()          (&chacha20inst)
+#define chacha20_lock()
+#define chacha20_unlock()
+
+#endif
+
 void init_random()
 {
     assert(CHACHA20_KEYBYTES*8 >= CHACHA_MINKEYLEN);
     chacha20_randomstir(&chacha20inst, now(CLOCK_ID_MONOTONIC_RAW));
 }
 
+/* Small requests are served from keystream generated ahead, which is wiped as it is consumed.
+   Larger requests reserve a range of block counters with the generator locked, then produce the
+   keystream directly into the destination; the copy of the context is wiped afterwards. As the
+   destination may be user memory, it is never written with interrupts disabled. */
 void
 arc4rand(void *ptr, bytes len)
 {
-    struct chacha20_s *chacha20 = &chacha20inst;
-    bytes length;
-    u8 *p;
-
-    timestamp t = now(CLOCK_ID_MONOTONIC_RAW);
-    u64 now_sec = sec_from_timestamp(t);
-    if ((chacha20->numbytes > CHACHA20_RESEED_BYTES) || (now_sec > chacha20->t_reseed))
-        chacha20_randomstir(chacha20, t);
-
-    p = ptr;
+    u8 *p = ptr;
     while (len) {
-        length = MIN(CHACHA20_BUFFER_SIZE, len);
-        chacha_encrypt_bytes(&chacha20->ctx, chacha20->m_buffer, p, length);
-        p += length;
-        len -= length;
-        chacha20->numbytes += length;
-        if (chacha20->numbytes > CHACHA20_RESEED_BYTES) {
-            chacha20_randomstir(chacha20, t);
+        struct chacha20_s *chacha20;
+        if (len < CHACHA20_BUFFER_SIZE) {
+            u8 tmp[CHACHA20_BUFFER_SIZE];
+            chacha20_lock();
+            chacha20 = chacha20_get();
+            if (!chacha20->avail) {
+                chacha20_check_reseed(chacha20, CHACHA20_BUFFER_SIZE);
+                chacha_keystream_bytes(&chacha20->ctx, chacha20->m_buffer, CHACHA20_BUFFER_SIZE);
+                chacha20->avail = CHACHA20_BUFFER_SIZE;
+            }
+            bytes length = MIN(len, chacha20->avail);
+            u8 *ks = chacha20->m_buffer + CHACHA20_BUFFER_SIZE - chacha20->avail;
+            runtime_memcpy(tmp, ks, length);
+            zero(ks, length);
+            chacha20->avail -= length;
+            chacha20_unlock();
+            runtime_memcpy(p, tmp, length);
+            zero(tmp, length);
+            p += length;
+            len -= length;
+        } else {
+            struct chacha_ctx ctx;
+            bytes length = MIN(len, CHACHA20_CHUNK_SIZE) & ~(CHACHA_BLOCKLEN - 1);
+            u64 blocks = length / CHACHA_BLOCKLEN;
+            chacha20_lock();
+            chacha20 = chacha20_get();
+            chacha20_check_reseed(chacha20, length);
+            ctx = chacha20->ctx;
+            u64 counter = (chacha20->ctx.input[12] | ((u64)chacha20->ctx.input[13] << 32)) + blocks;
+            chacha20->ctx.input[12] = counter;
+            chacha20->ctx.input[13] = counter >> 32;
+            chacha20_unlock();
+            chacha_keystream_bytes(&ctx, p, length);
+            zero(&ctx, sizeof(ctx));
+            p += length;
+            len -= length;
         }
     }
 }
@@ -60,6 +60,8 @@ void print_frame_trace_from_here();
 
 #define build_assert(x) _Static_assert((x), "build assertion failure")
 
+void init_memops(void);
+
 void runtime_memcpy(void *a, const void *b, bytes len);
 
 void runtime_memset(u8 *a, u8 b, bytes len);
@@ -134,6 +136,13 @@ boolean validate_virtual_writable(void *base, u64 length);
 
 void sha256(buffer dest, buffer source);
 
+#define LZ4_WORKMEM_SIZE    (4096 * sizeof(u32))
+u64 lz4_compress(const void *src, u64 len, void *dst, u64 dst_len, void *workmem);
+s64 lz4_decompress(const void *src, u64 len, void *dst, u64 dst_len);
+
+u16 ip_checksum(const void *buf, bytes len);
+u16 ip_checksum_copy(void *dst, const void *src, bytes len);
+
 #define stack_allocate __builtin_alloca
 
 typedef struct buffer *buffer;
@@ -171,7 +180,7 @@ typedef struct flush_entry *flush_entry;
    A value is a pointer whose type can be meaningfully inquired.
 
    The tag is not necessarily the value type. For instance, a tuple may be one
-   of a number of tags (tag_table_tuple, tag_function_tuple). Rather, the tag
+   of a number of tags (tag_table_tuple, tag_function_tuple, tag_schema_tuple). Rather, the tag
    steers us toward the correct access methods.
 
    We practically have 8 bits to work with for x86_64 and aarch64, but try to
@@ -183,7 +192,9 @@ typedef struct flush_entry *flush_entry;
 #define tag_symbol         (2ull) /* struct symbol */
 #define tag_table_tuple    (3ull) /* table-based tuple */
 #define tag_function_tuple (4ull) /* backed tuple; struct function_tuple */
-#define tag_max            (6ull)
+#define tag_integer        (5ull) /* unsigned integer; u64 */
+#define tag_schema_tuple   (6ull) /* fixed-schema tuple; struct schema_tuple */
+#define tag_max            (7ull)
 
 #include <symbol.h>
 
@@ -253,9 +264,25 @@ extern value null_value;
 
 #define cstring(b, t) ({buffer_clear(t); push_buffer((t), (b)); push_u8((t), 0); (char*)(t)->contents;})
 
-typedef struct merge *merge;
+declare_closure_struct(0, 1, void, merge_join,
+                       status, s);
+declare_closure_struct(0, 0, status_handler, merge_add);
+
+typedef struct merge {
+    heap h;
+    word count;
+    status_handler completion;
+    status last_status;
+    closure_struct(merge_join, join);
+    closure_struct(merge_add, add);
+} *merge;
 
 merge allocate_merge(heap h, status_handler completion);
+
+/* Sets up a merge embedded in another structure; the merge is not accessed after its completion is
+   applied, so the structure may be reused from the completion. */
+void init_merge(merge m, status_handler completion);
+
 status_handler apply_merge(merge m);
 
 void __stack_chk_guard_init();
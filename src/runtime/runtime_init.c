@@ -120,6 +120,7 @@ void init_runtime(heap general, heap safe)
 {
     // environment specific
     transient = safe;
+    init_memops();
     register_format('p', format_pointer, 0);
     register_format('x', format_number, 1);
     register_format('d', format_number, 1);
@@ -78,6 +78,48 @@ u64 sg_copy_to_buf(void *target, sg_list sg, u64 n)
     return n - remain;
 }
 
+/* copy length bytes from source into the buffers of sg, releasing filled buffers */
+u64 sg_copy_from_buf(void *source, sg_list sg, u64 n)
+{
+    sg_buf sgb;
+    u64 remain = n;
+    while (remain > 0 && (sgb = sg_list_head_peek(sg)) != INVALID_ADDRESS) {
+        assert(sgb->size > sgb->offset);
+        u64 len = MIN(remain, sg_buf_len(sgb));
+        runtime_memcpy(sgb->buf + sgb->offset, source, len);
+        source += len;
+        sgb->offset += len;
+        remain -= len;
+        if (sgb->offset < sgb->size)
+            break;
+        sg_list_head_remove(sg);
+        sg_buf_release(sgb);
+    }
+    return n - remain;
+}
+
+/* copy up to n bytes of the content of sg, starting at offset, into target, without consuming any
+   buffers */
+u64 sg_peek_to_buf(void *target, sg_list sg, u64 offset, u64 n)
+{
+    u64 remain = n;
+    sg_list_foreach(sg, sgb) {
+        if (remain == 0)
+            break;
+        u64 len = sg_buf_len(sgb);
+        if (offset >= len) {
+            offset -= len;
+            continue;
+        }
+        len = MIN(remain, len - offset);
+        runtime_memcpy(target, sgb->buf + sgb->offset + offset, len);
+        target += len;
+        remain -= len;
+        offset = 0;
+    }
+    return n - remain;
+}
+
 u64 sg_move(sg_list dest, sg_list src, u64 n)
 {
     sg_buf ssgb;
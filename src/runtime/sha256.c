@@ -46,14 +46,34 @@ static const u32 k[64] = {
 };
 
 /*********************** FUNCTION DEFINITIONS ***********************/
+/* The rounds are unrolled by 8 so that the working variables rotate by renaming rather than by
+   moves, and the message schedule is kept as a rolling window of 16 words. */
+#define ROUND(a,b,c,d,e,f,g,h,w,i) \
+	t1 = h + EP1(e) + CH(e,f,g) + k[i] + (w); \
+	d += t1; \
+	h = t1 + EP0(a) + MAJ(a,b,c);
+
+#define SCHEDULE(i) \
+	(m[(i) & 15] += SIG1(m[((i) - 2) & 15]) + m[((i) - 7) & 15] + SIG0(m[((i) - 15) & 15]))
+
+#define ROUNDS8(w, i) \
+	ROUND(a,b,c,d,e,f,g,h,w(i + 0),i + 0) \
+	ROUND(h,a,b,c,d,e,f,g,w(i + 1),i + 1) \
+	ROUND(g,h,a,b,c,d,e,f,w(i + 2),i + 2) \
+	ROUND(f,g,h,a,b,c,d,e,w(i + 3),i + 3) \
+	ROUND(e,f,g,h,a,b,c,d,w(i + 4),i + 4) \
+	ROUND(d,e,f,g,h,a,b,c,w(i + 5),i + 5) \
+	ROUND(c,d,e,f,g,h,a,b,w(i + 6),i + 6) \
+	ROUND(b,c,d,e,f,g,h,a,w(i + 7),i + 7)
+
+#define MESSAGE(i) m[i]
+
 void sha256_transform(sha256_ctx *ctx, const u8 data[])
 {
-	u32 a, b, c, d, e, f, g, h, i, j, t1, t2, m[64];
+	u32 a, b, c, d, e, f, g, h, i, j, t1, m[16];
 
 	for (i = 0, j = 0; i < 16; ++i, j += 4)
-		m[i] = (data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | (data[j + 3]);
-	for ( ; i < 64; ++i)
-		m[i] = SIG1(m[i - 2]) + m[i - 7] + SIG0(m[i - 15]) + m[i - 16];
+		m[i] = ((u32)data[j] << 24) | (data[j + 1] << 16) | (data[j + 2] << 8) | (data[j + 3]);
 
 	a = ctx->state[0];
 	b = ctx->state[1];
@@ -64,17 +84,11 @@ void sha256_transform(sha256_ctx *ctx, const u8 data[])
 	g = ctx->state[6];
 	h = ctx->state[7];
 
-	for (i = 0; i < 64; ++i) {
-		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
-		t2 = EP0(a) + MAJ(a,b,c);
-		h = g;
-		g = f;
-		f = e;
-		e = d + t1;
-		d = c;
-		c = b;
-		b = a;
-		a = t1 + t2;
+	for (i = 0; i < 16; i += 8) {
+		ROUNDS8(MESSAGE, i)
+	}
+	for ( ; i < 64; i += 8) {
+		ROUNDS8(SCHEDULE, i)
 	}
 
 	ctx->state[0] += a;
@@ -101,18 +115,29 @@ void sha256_init(sha256_ctx *ctx)
 	ctx->state[7] = 0x5be0cd19;
 }
 
+/* Whole blocks are hashed in place; only the head and tail of the input that do not make up a
+   block are copied. */
 void sha256_update(sha256_ctx *ctx, const u8 data[], bytes len)
 {
-	u32 i;
-
-	for (i = 0; i < len; ++i) {
-		ctx->data[ctx->datalen] = data[i];
-		ctx->datalen++;
-		if (ctx->datalen == 64) {
-			sha256_transform(ctx, ctx->data);
-			ctx->bitlen += 512;
-			ctx->datalen = 0;
-		}
+	if (ctx->datalen) {
+		bytes n = MIN(64 - ctx->datalen, len);
+		runtime_memcpy(ctx->data + ctx->datalen, data, n);
+		ctx->datalen += n;
+		data += n;
+		len -= n;
+		if (ctx->datalen < 64)
+			return;
+		sha256_transform(ctx, ctx->data);
+		ctx->bitlen += 512;
+		ctx->datalen = 0;
+	}
+	for ( ; len >= 64; data += 64, len -= 64) {
+		sha256_transform(ctx, data);
+		ctx->bitlen += 512;
+	}
+	if (len) {
+		runtime_memcpy(ctx->data, data, len);
+		ctx->datalen = len;
 	}
 }
 
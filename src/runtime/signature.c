@@ -28,6 +28,11 @@ closure_function(2, 2, boolean, tuple_signature_each,
     buffer_signature(symbol_string(n), buffer_ref(b, 0));
     if (is_tuple(v)) {
         tuple_signature(v, buffer_ref(b, slen));
+    } else if (is_integer(v)) {
+        /* same signature as the equivalent number string */
+        buffer n = little_stack_buffer(24);
+        print_number(n, *(u64 *)v, 10, 0);
+        buffer_signature(n, buffer_ref(b, slen));
     } else {
         // XXX type
         buffer_signature(v, buffer_ref(b, slen));
@@ -77,6 +77,10 @@ enum storage_op {
     STORAGE_OP_READSG,
     STORAGE_OP_WRITESG,
     STORAGE_OP_FLUSH,
+    STORAGE_OP_WRITESG_FUA,     /* completes only after data is on stable media */
+    STORAGE_OP_POLL,            /* reap completed requests without waiting for an interrupt */
+    STORAGE_OP_PLUG,            /* queue new requests without submitting them to the device... */
+    STORAGE_OP_UNPLUG,          /* ...until unplugged (plugs nest) */
 };
 
 typedef struct storage_req {
@@ -4,10 +4,33 @@
 #include <runtime.h>
 #endif
 
-BSS_RO_AFTER_INIT static table symbols;
+/* Symbols are indexed by an open-addressing hash set of (hash, symbol) slots, which is looked up
+   without locking: a slot is published only once its symbol is complete, and when the set grows,
+   the new set is filled before being published. Since lookups may still be going on in a set
+   that has been replaced, old sets are not freed; their total size is bounded by the size of the
+   current set. Insertions are serialized by a lock. */
+struct symbol_slot {
+    u64 hash;
+    symbol s;
+};
+
+typedef struct symbol_set {
+    u64 mask;
+    struct symbol_slot slots[];
+} *symbol_set;
+
+#define SYMBOL_SET_INITIAL_SIZE 512
+
+static symbol_set symbols;
 BSS_RO_AFTER_INIT static heap sheap;
 BSS_RO_AFTER_INIT static heap iheap;
 
+static struct {
+    u64 count;
+    u64 static_names;   /* symbols whose name is referenced rather than copied */
+    u64 bytes;          /* symbols, copied names and hash sets, including replaced sets */
+} symbol_stats;
+
 #ifdef KERNEL
 
 static struct spinlock slock;
@@ -29,29 +52,84 @@ struct symbol {
     key k;
 };
 
-symbol intern_u64(u64 u)
+static symbol_set allocate_symbol_set(u64 size)
 {
-    buffer b = little_stack_buffer(20);
-    print_number(b, u, 10, 0);
-    return intern(b);
+    bytes b = sizeof(struct symbol_set) + size * sizeof(struct symbol_slot);
+    symbol_set set = allocate_zero(iheap, b);
+    if (set == INVALID_ADDRESS)
+        return set;
+    set->mask = size - 1;
+    symbol_stats.bytes += b;
+    return set;
 }
 
-symbol intern(string name)
+static symbol symbol_set_find(symbol_set set, u64 hash, string name)
 {
-    symbol s;
+    for (u64 i = hash & set->mask; ; i = (i + 1) & set->mask) {
+        struct symbol_slot *slot = &set->slots[i];
+        symbol s = __atomic_load_n(&slot->s, __ATOMIC_ACQUIRE);
+        if (!s)
+            return 0;
+        if ((slot->hash == hash) && buffer_compare(s->s, name))
+            return s;
+    }
+}
+
+static void symbol_set_insert(symbol_set set, u64 hash, symbol s)
+{
+    u64 i = hash & set->mask;
+    while (set->slots[i].s)
+        i = (i + 1) & set->mask;
+    set->slots[i].hash = hash;
+    __atomic_store_n(&set->slots[i].s, s, __ATOMIC_RELEASE);
+}
+
+/* called with the lock held */
+static boolean symbols_grow(void)
+{
+    symbol_set old = symbols;
+    symbol_set set = allocate_symbol_set(2 * (old->mask + 1));
+    if (set == INVALID_ADDRESS)
+        return false;
+    for (u64 i = 0; i <= old->mask; i++) {
+        if (old->slots[i].s)
+            symbol_set_insert(set, old->slots[i].hash, old->slots[i].s);
+    }
+    __atomic_store_n(&symbols, set, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* If copy is false, the name must stay valid and unchanged for the lifetime of the symbol. */
+static symbol intern_name(string name, boolean copy)
+{
+    u64 hash = fnv64(name);
+    symbol s = symbol_set_find(__atomic_load_n(&symbols, __ATOMIC_ACQUIRE), hash, name);
+    if (s)
+        return s;
     sym_lock();
-    if (!(s = table_find(symbols, name))) {
-        // shouldnt really be on transient
-        buffer b = allocate_buffer(iheap, buffer_length(name));
-        if (b == INVALID_ADDRESS)
+    if (!(s = symbol_set_find(symbols, hash, name))) {
+        /* keep the set at most half full */
+        if (((symbol_stats.count + 1) * 2 > symbols->mask + 1) && !symbols_grow())
             goto alloc_fail;
-        assert(push_buffer(b, name));
+        buffer b = name;
+        if (copy) {
+            // shouldnt really be on transient
+            b = allocate_buffer(iheap, buffer_length(name));
+            if (b == INVALID_ADDRESS)
+                goto alloc_fail;
+            assert(push_buffer(b, name));
+            symbol_stats.bytes += sizeof(struct buffer) + buffer_length(name);
+        } else {
+            symbol_stats.static_names++;
+        }
         s = allocate(sheap, sizeof(struct symbol));
         if (s == INVALID_ADDRESS)
             goto alloc_fail;
         s->k = random_u64();
         s->s = b;
-        table_set(symbols, b, s);
+        symbol_set_insert(symbols, hash, s);
+        symbol_stats.count++;
+        symbol_stats.bytes += sizeof(struct symbol);
     }
     sym_unlock();
     return s;
@@ -59,6 +137,23 @@ symbol intern(string name)
     halt("intern: alloc fail\n");
 }
 
+symbol intern_u64(u64 u)
+{
+    buffer b = little_stack_buffer(20);
+    print_number(b, u, 10, 0);
+    return intern(b);
+}
+
+symbol intern(string name)
+{
+    return intern_name(name, true);
+}
+
+symbol intern_static(string name)
+{
+    return intern_name(name, false);
+}
+
 string symbol_string(symbol s)
 {
     return s->s;
@@ -70,11 +165,41 @@ key key_from_symbol(void *z)
     return s->k;
 }
 
+#ifdef KERNEL
+
+closure_function(2, 0, value, symbol_get_stat,
+                 u64 *, stat, value, v)
+{
+    return value_rewrite_u64(bound(v), *bound(stat));
+}
+
+#define register_stat(n, t, name, stat)                                 \
+    v = value_from_u64(h, 0);                                           \
+    s = sym(name);                                                      \
+    set(t, s, v);                                                       \
+    tuple_notifier_register_get_notify(n, s, closure(h, symbol_get_stat, stat, v));
+
+value symbol_management(heap h)
+{
+    value v;
+    symbol s;
+    tuple t = allocate_tuple();
+    assert(t != INVALID_ADDRESS);
+    tuple_notifier n = tuple_notifier_wrap(t);
+    assert(n != INVALID_ADDRESS);
+    register_stat(n, t, count, &symbol_stats.count);
+    register_stat(n, t, static_names, &symbol_stats.static_names);
+    register_stat(n, t, bytes, &symbol_stats.bytes);
+    return n;
+}
+
+#endif
+
 void init_symbols(heap h, heap init)
 {
     sheap = h;
-    iheap = init;    
-    symbols = allocate_table(iheap, fnv64, buffer_compare);
+    iheap = init;
+    symbols = allocate_symbol_set(SYMBOL_SET_INITIAL_SIZE);
+    assert(symbols != INVALID_ADDRESS);
     sym_lock_init();
 }
-
@@ -1,16 +1,34 @@
 extern void init_symbols(heap h, heap init);
 typedef struct symbol *symbol;
 symbol intern(buffer);
+symbol intern_static(buffer);
 symbol intern_u64(u64);
 
 string symbol_string(symbol s);
+value symbol_management(heap h);
 
 #define sym_intern(name, intern)\
     ({static symbol __s = 0;\
       if (!__s){char x[] = #name; __s = intern(alloca_wrap_buffer(x, sizeof(x)-1));} \
      __s;})              
 
+#ifdef KLIB
 #define sym(name)   sym_intern(name, intern)
+#else
+/* The symbol is cached at each call site, so only the first use looks it up. Its name is a
+   string constant, which is referenced instead of being copied. */
+#define sym(name)                                                       \
+    ({static symbol __s = 0;                                            \
+      symbol __r = __s;                                                 \
+      if (!__r) {                                                       \
+          static struct buffer __b = {.end = sizeof(#name) - 1,         \
+                                      .length = sizeof(#name) - 1,      \
+                                      .wrapped = true,                  \
+                                      .contents = #name};               \
+          __s = __r = intern_static(&__b);                              \
+      }                                                                 \
+      __r;})
+#endif
 
 #define sym_this(name)\
     (intern(alloca_wrap_buffer(name, runtime_strlen(name))))
@@ -6,6 +6,21 @@
 
 #define EMPTY ((void *)0)
 
+/* Control byte values; a used slot holds the low 7 bits of the hash of its key. Unused control
+   bytes have the top bit set, and CTRL_SENTINEL pads the single group of tables with fewer slots
+   than a group. */
+#define CTRL_EMPTY      0x80
+#define CTRL_DELETED    0xfe
+#define CTRL_SENTINEL   0xff
+
+#define GROUP_LSBS      0x0101010101010101ull
+#define GROUP_MSBS      0x8080808080808080ull
+
+#define TABLE_MIN_CAPACITY      1
+
+/* slots of the old table migrated on each insertion while resizing */
+#define TABLE_MIGRATE_SLOTS     (4 * TABLE_GROUP_SIZE)
+
 boolean pointer_equal(void *a, void *b)
 {
     return a == b;
@@ -22,33 +37,208 @@ key identity_key(void *a)
 #define table_paranoia(t, n)
 #endif
 
+/* Keys are often pointers or small integers, so they are mixed before being split into the group
+   index (high bits) and the control byte tag (low 7 bits). */
+static inline u64 table_hash(key k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    return k;
+}
+
+#define hash_tag(h)     ((h) & 0x7f)
+#define hash_group(h)   ((h) >> 7)
+
+static inline u32 table_groups(u32 capacity)
+{
+    return capacity > TABLE_GROUP_SIZE ? capacity / TABLE_GROUP_SIZE : 1;
+}
+
+/* A table made of a single group can be filled up, as lookups in it never go past its group. */
+static inline u32 table_max_load(u32 capacity)
+{
+    if (capacity <= TABLE_GROUP_SIZE)
+        return capacity;
+    return ((u64)capacity * 7) / 8;
+}
+
+static inline bytes table_alloc_size(u32 capacity)
+{
+    return table_groups(capacity) * TABLE_GROUP_SIZE + capacity * sizeof(struct table_slot);
+}
+
+static inline table_slot table_slots(u8 *ctrl, u32 capacity)
+{
+    return (table_slot)(ctrl + table_groups(capacity) * TABLE_GROUP_SIZE);
+}
+
+static inline u64 group_load(u8 *ctrl, u32 g)
+{
+    return *(u64 *)(ctrl + g * TABLE_GROUP_SIZE);
+}
+
+/* The group functions below return a mask with the top bit set in each matching control byte. A
+   tag match may have false positives, which are weeded out by comparing the keys. */
+static inline u64 group_match(u64 group, u8 tag)
+{
+    u64 x = group ^ (GROUP_LSBS * tag);
+    return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
+
+static inline u64 group_match_empty(u64 group)
+{
+    return group & (~group << 6) & GROUP_MSBS;
+}
+
+static inline u64 group_match_free(u64 group)
+{
+    return group & ~(group << 7) & GROUP_MSBS;
+}
+
+#define group_slot(g, mask) ((g) * TABLE_GROUP_SIZE + (__builtin_ctzll(mask) >> 3))
+
+/* Groups are probed in triangular sequence, which visits each group once. */
+static s64 slots_find(table t, u8 *ctrl, u32 capacity, u64 h, key k, void *c)
+{
+    table_slot slots = table_slots(ctrl, capacity);
+    u32 mask = table_groups(capacity) - 1;
+    u32 g = hash_group(h) & mask;
+    for (u32 i = 0; i <= mask; i++) {
+        u64 group = group_load(ctrl, g);
+        for (u64 m = group_match(group, hash_tag(h)); m; m &= m - 1) {
+            u32 s = group_slot(g, m);
+            if ((slots[s].k == k) && t->equals_function(slots[s].c, c))
+                return s;
+        }
+        if (group_match_empty(group))
+            break;
+        g = (g + i + 1) & mask;
+    }
+    return -1;
+}
+
+static s64 slots_find_free(u8 *ctrl, u32 capacity, u64 h)
+{
+    u32 mask = table_groups(capacity) - 1;
+    u32 g = hash_group(h) & mask;
+    for (u32 i = 0; i <= mask; i++) {
+        u64 m = group_match_free(group_load(ctrl, g));
+        if (m)
+            return group_slot(g, m);
+        g = (g + i + 1) & mask;
+    }
+    return -1;
+}
+
+static boolean table_insert_slot(table t, u64 h, key k, void *c, void *v)
+{
+    if (!t->capacity)
+        return false;
+    s64 s = slots_find_free(t->ctrl, t->capacity, h);
+    if (s < 0)
+        return false;
+    if ((t->ctrl[s] == CTRL_EMPTY) && t->growth_left)
+        t->growth_left--;
+    t->ctrl[s] = hash_tag(h);
+    table_slot slot = table_slots(t->ctrl, t->capacity) + s;
+    slot->k = k;
+    slot->c = c;
+    slot->v = v;
+    return true;
+}
+
+static void table_remove_slot(table t, u32 s)
+{
+    /* A probe sequence reaching this group would end here anyway if the group has an empty slot,
+       so the slot can be made empty instead of deleted. */
+    if (group_match_empty(group_load(t->ctrl, s / TABLE_GROUP_SIZE))) {
+        t->ctrl[s] = CTRL_EMPTY;
+        t->growth_left++;
+    } else {
+        t->ctrl[s] = CTRL_DELETED;
+    }
+    t->count--;
+}
+
+static void table_free_old(table t)
+{
+    deallocate(t->h, t->old_ctrl, table_alloc_size(t->old_capacity));
+    t->old_ctrl = 0;
+    t->old_capacity = 0;
+}
+
+/* Migrated slots are marked deleted, so that lookups in the old slots still follow the probe
+   sequences of the remaining ones. */
+static void table_migrate(table t, u32 n)
+{
+    u32 end = MIN(t->migrate_pos + n, t->old_capacity);
+    table_slot old_slots = table_slots(t->old_ctrl, t->old_capacity);
+    for (u32 i = t->migrate_pos; i < end; i++) {
+        if (t->old_ctrl[i] & CTRL_EMPTY)
+            continue;
+        table_slot s = &old_slots[i];
+        if (!table_insert_slot(t, table_hash(s->k), s->k, s->c, s->v))
+            halt("%s: table %p full\n", __func__, t);
+        t->old_ctrl[i] = CTRL_DELETED;
+    }
+    t->migrate_pos = end;
+    if (end == t->old_capacity)
+        table_free_old(t);
+}
+
+/* Doubles the capacity, or rebuilds the table at the same capacity if it is mostly made of deleted
+   slots. If the new slots cannot be allocated, the table keeps using its remaining free slots. */
+static void table_grow(table t)
+{
+    if (t->old_ctrl)
+        table_migrate(t, t->old_capacity);
+    u32 capacity = t->capacity;
+    if (!capacity)
+        capacity = TABLE_MIN_CAPACITY;
+    else if (t->count >= table_max_load(capacity) / 2)
+        capacity *= 2;
+    u8 *ctrl = allocate(t->h, table_alloc_size(capacity));
+    if (ctrl == INVALID_ADDRESS)
+        return;
+    runtime_memset(ctrl, CTRL_EMPTY, capacity);
+    if (capacity < TABLE_GROUP_SIZE)
+        runtime_memset(ctrl + capacity, CTRL_SENTINEL, TABLE_GROUP_SIZE - capacity);
+    t->old_ctrl = t->ctrl;
+    t->old_capacity = t->capacity;
+    t->migrate_pos = 0;
+    t->ctrl = ctrl;
+    t->capacity = capacity;
+    t->growth_left = table_max_load(capacity);
+    if (t->old_ctrl && !t->count)
+        table_free_old(t);
+    table_paranoia(t, "grow");
+}
+
 void table_validate(table t, char *n)
 {
-    void *last;
-    for(int i = 0; i < t->buckets; i++) {
-        for (entry j = t->entries[i]; last = j, j; j = j->next) {
-            if (j == INVALID_ADDRESS) {
-                print_frame_trace_from_here();
-                halt("table_validate fail on %s: table %p, last %p\n", n, t, last);
-            }
+    int count = 0;
+    table_foreach(t, c, v) {
+        if (table_find(t, c) != v) {
+            print_frame_trace_from_here();
+            halt("table_validate fail on %s: table %p, name %p not found\n", n, t, c);
         }
+        count++;
+    }
+    if (count != t->count) {
+        print_frame_trace_from_here();
+        halt("table_validate fail on %s: table %p, count %d, found %d\n", n, t, t->count, count);
     }
 }
 
 table allocate_table(heap h, u64 (*key_function)(void *x), boolean (*equals_function)(void *x, void *y))
 {
-    table t = allocate(h, sizeof(struct table));
+    table t = allocate_zero(h, sizeof(struct table));
     if (t == INVALID_ADDRESS)
         return t;
 
+    /* slots are allocated on the first insertion */
     t->h = h;
-    t->count = 0;
-    t->buckets = 4;
-    t->entries = allocate_zero(h, t->buckets * sizeof(void *));
-    if (t->entries == INVALID_ADDRESS) {
-        deallocate(h, t, sizeof(struct table));
-        return INVALID_ADDRESS;
-    }
     t->key_function = key_function;
     t->equals_function = equals_function;
     return t;
@@ -57,44 +247,27 @@ table allocate_table(heap h, u64 (*key_function)(void *x), boolean (*equals_func
 void deallocate_table(table t)
 {
     table_paranoia(t, "deallocate");
-    table_clear(t);
-    deallocate(t->h, t->entries, t->buckets * sizeof(void *));
+    if (t->old_ctrl)
+        table_free_old(t);
+    if (t->ctrl)
+        deallocate(t->h, t->ctrl, table_alloc_size(t->capacity));
     deallocate(t->h, t, sizeof(struct table));
 }
 
-static inline key position(int buckets, key x)
-{
-    return x & (buckets-1);
-}
-
-static void resize_table(table t, int buckets)
-{
-    assert((buckets & (buckets - 1)) == 0);
-    assert(buckets <= TABLE_MAX_BUCKETS);
-    entry *nentries = allocate_zero(t->h, buckets * sizeof(void *));
-    if (nentries == INVALID_ADDRESS)
-        halt("resize_table: allocate fail for %d buckets\n", buckets);
-    for (int i = 0; i < t->buckets; i++) {
-        for (entry n, j = t->entries[i]; j; j = n) {
-            n = j->next;
-            key km = position(buckets, j->k);
-            j->next = nentries[km];
-            nentries[km] = j;
-        }
-    }
-    deallocate(t->h, t->entries, t->buckets * sizeof(void *));
-    t->entries = nentries;
-    t->buckets = buckets;
-    table_paranoia(t, "resize");
-}
-
 void *table_find(table t, void *c)
 {
     assert(t);
+    if (!t->count)
+        return EMPTY;
     key k = t->key_function(c);
-    for (entry i = t->entries[position(t->buckets, k)]; i; i = i->next){
-        if ((i->k == k) && t->equals_function(i->c, c))
-            return(i->v);
+    u64 h = table_hash(k);
+    s64 s = slots_find(t, t->ctrl, t->capacity, h, k, c);
+    if (s >= 0)
+        return table_slots(t->ctrl, t->capacity)[s].v;
+    if (t->old_ctrl) {
+        s = slots_find(t, t->old_ctrl, t->old_capacity, h, k, c);
+        if (s >= 0)
+            return table_slots(t->old_ctrl, t->old_capacity)[s].v;
     }
     return EMPTY;
 }
@@ -102,42 +275,69 @@ void *table_find(table t, void *c)
 void table_set(table t, void *c, void *v)
 {
     key k = t->key_function(c);
-    key p = position(t->buckets, k);
-    entry *e = t->entries + p;
-    for (; *e; e = &(*e)->next) {
-        if (((*e)->k == k) && t->equals_function((*e)->c, c)) {
+    u64 h = table_hash(k);
+    s64 s;
+    if (t->count) {
+        s = slots_find(t, t->ctrl, t->capacity, h, k, c);
+        if (s >= 0) {
             if (v == EMPTY) {
-                assert(t->count > 0);
-                t->count--;
-                entry z = *e;
-                *e = (*e)->next;
+                table_remove_slot(t, s);
                 table_paranoia(t, "remove");
-                deallocate(t->h, z, sizeof(struct entry));
             } else {
-                (*e)->v = v;
+                table_slots(t->ctrl, t->capacity)[s].v = v;
             }
             return;
         }
+        if (t->old_ctrl) {
+            s = slots_find(t, t->old_ctrl, t->old_capacity, h, k, c);
+            if (s >= 0) {
+                if (v == EMPTY) {
+                    t->old_ctrl[s] = CTRL_DELETED;
+                    t->count--;
+                    table_paranoia(t, "remove");
+                } else {
+                    table_slots(t->old_ctrl, t->old_capacity)[s].v = v;
+                }
+                return;
+            }
+        }
     }
 
     if (v != EMPTY) {
-        entry n = allocate(t->h, sizeof(struct entry));
-        if (n == INVALID_ADDRESS)
-            halt("couldn't allocate table entry\n");
-
-        n->v = v;
-        n->k = k;
-        n->c = c;
-        n->next = 0;
-        *e = n;
-        
-        if (t->count++ > t->buckets && t->buckets <= TABLE_MAX_BUCKETS / 2) {
-            resize_table(t, t->buckets*2);
-        } else {
-            /* resize will do a check */
-            table_paranoia(t, "add, no resize");
+        if (!t->growth_left)
+            table_grow(t);
+        if (t->old_ctrl)
+            table_migrate(t, TABLE_MIGRATE_SLOTS);
+        if (!table_insert_slot(t, h, k, c, v))
+            halt("couldn't allocate table slots\n");
+        t->count++;
+        table_paranoia(t, "add");
+    }
+}
+
+table_slot table_next_slot(table t, table_slot s)
+{
+    u32 i;
+
+    /* the slots being migrated, if any, are visited first */
+    if (t->old_ctrl) {
+        table_slot old_slots = table_slots(t->old_ctrl, t->old_capacity);
+        if (!s || ((s >= old_slots) && (s < old_slots + t->old_capacity))) {
+            for (i = s ? s - old_slots + 1 : 0; i < t->old_capacity; i++) {
+                if (!(t->old_ctrl[i] & CTRL_EMPTY))
+                    return &old_slots[i];
+            }
+            s = 0;
         }
     }
+    if (!t->ctrl)
+        return 0;
+    table_slot slots = table_slots(t->ctrl, t->capacity);
+    for (i = s ? s - slots + 1 : 0; i < t->capacity; i++) {
+        if (!(t->ctrl[i] & CTRL_EMPTY))
+            return &slots[i];
+    }
+    return 0;
 }
 
 int table_elements(table t)
@@ -147,16 +347,11 @@ int table_elements(table t)
 
 void table_clear(table t)
 {
-    for(int i = 0; i < t->buckets; i++) {
-        entry e = t->entries[i];
-        if (!e)
-            continue;
-        do {
-            entry next = e->next;
-            deallocate(t->h, e, sizeof(struct entry));
-            e = next;
-        } while (e);
-        t->entries[i] = 0;
+    if (t->old_ctrl)
+        table_free_old(t);
+    if (t->ctrl) {
+        runtime_memset(t->ctrl, CTRL_EMPTY, t->capacity);
+        t->growth_left = table_max_load(t->capacity);
     }
     t->count = 0;
 }
@@ -2,18 +2,30 @@ typedef struct table *table;
 
 typedef u64 key;
 
-typedef struct entry {
-    void *v;
+/* Open-addressing hash table. Slots hold the key, name and value inline and are grouped by
+   TABLE_GROUP_SIZE, each slot having a control byte that is either empty, deleted or holds 7 bits of
+   the hash; a lookup matches the control bytes of a whole group at once and compares only the slots
+   whose hash bits match. The slots follow the control bytes in the same allocation. When the table
+   grows, the old slots are migrated to the new ones a few groups at a time on each subsequent
+   insertion. */
+typedef struct table_slot {
     key k;
     void *c;
-    struct entry *next;        
-} *entry;
+    void *v;
+} *table_slot;
 
+#define TABLE_GROUP_SIZE    8
+
+/* Kept small, as every tuple is a table. */
 struct table {
     heap h;
-    int buckets;
     int count;
-    entry *entries;
+    u32 capacity;               /* number of slots, a power of 2 */
+    u32 growth_left;            /* insertions into empty slots allowed before resizing */
+    u32 old_capacity;
+    u32 migrate_pos;
+    u8 *ctrl;
+    u8 *old_ctrl;               /* slots being migrated after a resize, if any */
     key (*key_function)(void *x);
     boolean (*equals_function)(void *x, void *y);
 };
@@ -26,14 +38,12 @@ void *table_find(table t, void *c);
 //void *table_find_key (table t, void *c, void **kr);
 void table_set(table t, void *c, void *v);
 void table_clear(table t);
+table_slot table_next_slot(table t, table_slot s);
 
-#define eZ(x,y) ((entry) x)->y
-
+/* The current element may be removed from the table while iterating, but no element may be added. */
 #define table_foreach(__t, __k, __v)\
-    for (int __i = 0 ; __i< (__t)->buckets; __i++)                    \
-        for (void *__k, *__v, *__j = ((__t)->entries[__i]), *__next;    \
-             __j && (__next =  eZ((__j), next) , __k = eZ(__j, c), __v = eZ(__j, v)); \
-             __j = __next)
+    for (table_slot __s = table_next_slot(__t, 0); __s; __s = table_next_slot(__t, __s)) \
+        for (void *__k = __s->c, *__v = __s->v, *__once = __s; __once; __once = 0)
 
 boolean pointer_equal(void *a, void* b);
 key identity_key(void *a);
@@ -8,6 +8,15 @@
 #endif
 
 BSS_RO_AFTER_INIT static heap theap;
+BSS_RO_AFTER_INIT static heap stheap;
+BSS_RO_AFTER_INIT static heap iheap;
+
+#define TUPLE_SCHEMAS_MAX   4
+
+static struct {
+    int count;
+    tuple_schema s[TUPLE_SCHEMAS_MAX];
+} schemas;
 
 // use runtime tags directly?
 #define type_tuple 1
@@ -16,6 +25,55 @@ BSS_RO_AFTER_INIT static heap theap;
 #define immediate 1
 #define reference 0
 
+static inline int schema_attr_index(tuple_schema s, symbol a)
+{
+    for (int i = 0; i < s->count; i++)
+        if (s->attrs[i] == a)
+            return i;
+    return -1;
+}
+
+static value schema_tuple_get(schema_tuple st, symbol a)
+{
+    int i = schema_attr_index(st->schema, a);
+    if (i >= 0)
+        return st->values[i];
+    return st->extra ? table_find(st->extra, a) : 0;
+}
+
+static void schema_tuple_set(schema_tuple st, symbol a, value v)
+{
+    int i = schema_attr_index(st->schema, a);
+    if (i >= 0) {
+        st->values[i] = v;
+        return;
+    }
+    if (!st->extra) {
+        if (!v)
+            return;
+        st->extra = allocate_table(theap, key_from_symbol, pointer_equal);
+        if (st->extra == INVALID_ADDRESS)
+            halt("couldn't allocate schema tuple table\n");
+    }
+    table_set(st->extra, a, v);
+}
+
+static boolean schema_tuple_iterate(schema_tuple st, binding_handler h)
+{
+    tuple_schema s = st->schema;
+    for (int i = 0; i < s->count; i++) {
+        if (st->values[i] && !apply(h, s->attrs[i], st->values[i]))
+            return false;
+    }
+    if (st->extra) {
+        table_foreach(st->extra, a, v) {
+            if (!apply(h, a, v))
+                return false;
+        }
+    }
+    return true;
+}
+
 value get(value e, symbol a)
 {
     u16 tag = tagof(e);
@@ -25,6 +83,8 @@ value get(value e, symbol a)
         return table_find(&t->t, a);
     case tag_function_tuple:
         return apply(t->f.g, a);
+    case tag_schema_tuple:
+        return schema_tuple_get((schema_tuple)t, a);
     default:
         assert(0);
     }
@@ -41,6 +101,9 @@ void set(value e, symbol a, value v)
     case tag_function_tuple:
         apply(t->f.s, a, v);
         break;
+    case tag_schema_tuple:
+        schema_tuple_set((schema_tuple)t, a, v);
+        break;
     default:
         assert(0);
     }
@@ -59,6 +122,8 @@ boolean iterate(value e, binding_handler h)
         return true;
     case tag_function_tuple:
         return apply(t->f.i, h);
+    case tag_schema_tuple:
+        return schema_tuple_iterate((schema_tuple)t, h);
     default:
         assert(0);
     }
@@ -83,6 +148,14 @@ int tuple_count(tuple t)
     case tag_function_tuple:
         apply(t->f.i, stack_closure(tuple_count_each, &count));
         return count;
+    case tag_schema_tuple: {
+        schema_tuple st = (schema_tuple)t;
+        for (int i = 0; i < st->schema->count; i++) {
+            if (st->values[i])
+                count++;
+        }
+        return count + (st->extra ? st->extra->count : 0);
+    }
     default:
         assert(0);
     }
@@ -126,6 +199,47 @@ tuple allocate_tuple(void)
     return tag(allocate_table(theap, key_from_symbol, pointer_equal), tag_table_tuple);
 }
 
+static inline bytes schema_tuple_size(tuple_schema s)
+{
+    return sizeof(struct schema_tuple) + s->count * sizeof(value);
+}
+
+tuple allocate_schema_tuple(tuple_schema s)
+{
+    schema_tuple st = allocate_zero(stheap, schema_tuple_size(s));
+    if (st == INVALID_ADDRESS)
+        return INVALID_ADDRESS;
+    st->schema = s;
+    return tag(st, tag_schema_tuple);
+}
+
+void register_tuple_schema(tuple_schema s)
+{
+    assert(s->count <= TUPLE_SCHEMA_ATTRS_MAX);
+    assert(schemas.count < TUPLE_SCHEMAS_MAX);
+    schemas.s[schemas.count++] = s;
+}
+
+/* Decoded tuples take the schema of their first attribute, which is usually one of the attributes
+   that all tuples with that layout have. */
+static tuple allocate_decoded_tuple(symbol first)
+{
+    for (int i = 0; first && (i < schemas.count); i++) {
+        if (schema_attr_index(schemas.s[i], first) >= 0)
+            return allocate_schema_tuple(schemas.s[i]);
+    }
+    return allocate_tuple();
+}
+
+value allocate_integer(u64 n)
+{
+    u64 *i = allocate(iheap, sizeof(u64));
+    if (i == INVALID_ADDRESS)
+        return INVALID_ADDRESS;
+    *i = n;
+    return i;
+}
+
 void destruct_tuple(tuple t, boolean recursive);
 
 closure_function(2, 2, boolean, destruct_tuple_each,
@@ -219,11 +333,14 @@ value decode_value(heap h, table dictionary, buffer source, u64 *total,
 
     if (type == type_tuple) {
         tuple t;
-    
+        u64 index = 0;
+
         if (imm == immediate) {
-            t = allocate_tuple();
-            tuple_debug("decode_value: immediate, alloced tuple %v\n", t);
-            drecord(dictionary, t);
+            /* the tuple is allocated once its first attribute is known, at the index reserved
+               here, ahead of the entries that it refers to */
+            t = 0;
+            drecord(dictionary, INVALID_ADDRESS);
+            index = dictionary->count;
         } else {
             u64 e = pop_varint(source);
             t = table_find(dictionary, pointer_from_u64(e));
@@ -245,6 +362,11 @@ value decode_value(heap h, table dictionary, buffer source, u64 *total,
                 s = table_find(dictionary, pointer_from_u64(nlen));
                 if (!s) halt("indirect symbol not found: 0x%lx, offset %d\n", nlen, source->start);
             }
+            if (!t) {
+                t = allocate_decoded_tuple(s);
+                tuple_debug("decode_value: immediate, alloced tuple %p\n", t);
+                table_set(dictionary, pointer_from_u64(index), t);
+            }
             value nv = decode_value(h, dictionary, source, total, obsolete);
             if (obsolete) {
                 value old_v = get(t, s);
@@ -258,6 +380,10 @@ value decode_value(heap h, table dictionary, buffer source, u64 *total,
             if (total)
                 (*total)++;
         }
+        if (!t) {
+            t = allocate_tuple();
+            table_set(dictionary, pointer_from_u64(index), t);
+        }
         tuple_debug("decode_value: decoded tuple %v\n", t);
         return t;
     } else {
@@ -300,6 +426,11 @@ void encode_value(buffer dest, table dictionary, value v, u64 *total)
     }
     else if (is_tuple(v)) {
         encode_tuple(dest, dictionary, (tuple)v, total);
+    } else if (is_integer(v)) {
+        buffer b = little_stack_buffer(24);
+        print_number(b, *(u64 *)v, 10, 0);
+        push_header(dest, immediate, type_buffer, buffer_length(b));
+        assert(push_buffer(dest, b));
     } else {
         push_header(dest, immediate, type_buffer, buffer_length((buffer)v));
         assert(push_buffer(dest, (buffer)v));
@@ -393,6 +524,16 @@ void deallocate_value(tuple t)
     case tag_function_tuple:
         /* XXX No standard interface to remove function tuple...release a refcount? */
         break;
+    case tag_integer:
+        deallocate(iheap, t, sizeof(u64));
+        break;
+    case tag_schema_tuple: {
+        schema_tuple st = (schema_tuple)t;
+        if (st->extra)
+            deallocate_table(st->extra);
+        deallocate(stheap, st, schema_tuple_size(st->schema));
+        break;
+    }
     default:
         /* XXX assuming string buffer until we have complete type coverage */
         deallocate_buffer((buffer)t);
@@ -400,7 +541,9 @@ void deallocate_value(tuple t)
     }
 }
 
-void init_tuples(heap h)
+void init_tuples(heap h, heap sh, heap ih)
 {
     theap = h;
+    stheap = sh;
+    iheap = ih;
 }
@@ -13,6 +13,24 @@ typedef struct function_tuple {
     tuple_iterate i;
 } *function_tuple;
 
+#define TUPLE_SCHEMA_ATTRS_MAX  8
+
+typedef struct tuple_schema {
+    int count;
+    symbol attrs[TUPLE_SCHEMA_ATTRS_MAX];
+} *tuple_schema;
+
+/* A schema tuple stores the values of the attributes of its schema in place, in schema order, and
+   any other attribute in a table that is allocated on first use. It is meant for the many tuples
+   that share a small set of attributes, e.g. filesystem inodes, which would otherwise each be a
+   table; a tuple decoded from the log is given the registered schema that holds its first
+   attribute, if any. */
+typedef struct schema_tuple {
+    tuple_schema schema;
+    table extra;
+    value values[];
+} *schema_tuple;
+
 union tuple {
     struct table t;
     struct function_tuple f;
@@ -22,10 +40,13 @@ value get(value e, symbol a);
 void set(value e, symbol a, value v);
 boolean iterate(value e, binding_handler h);
 
-void init_tuples(heap theap);
+void init_tuples(heap theap, heap stheap, heap iheap);
 int tuple_count(tuple t);
 symbol tuple_get_symbol(tuple t, value v);
 tuple allocate_tuple();
+void register_tuple_schema(tuple_schema s);
+tuple allocate_schema_tuple(tuple_schema s);
+value allocate_integer(u64 n);
 void destruct_tuple(tuple t, boolean recursive);
 void deallocate_value(tuple t);
 
@@ -40,7 +61,7 @@ void encode_eav(buffer dest, table dictionary, tuple e, symbol a, value v,
 static inline boolean is_tuple(value v)
 {
     value_tag tag = tagof(v);
-    return tag == tag_table_tuple || tag == tag_function_tuple;
+    return tag == tag_table_tuple || tag == tag_function_tuple || tag == tag_schema_tuple;
 }
 
 static inline boolean is_symbol(value v)
@@ -53,10 +74,21 @@ static inline boolean is_string(value v)
     return tagof(v) == tag_unknown; // XXX tag_string
 }
 
+/* Integers are stored as a bare u64 and are encoded as their decimal string, so they can stand in
+   for number strings where memory matters, e.g. in filesystem metadata. */
+static inline boolean is_integer(value v)
+{
+    return tagof(v) == tag_integer;
+}
+
 // seriously reconsider types allowed in tuples.. in particular simple
 // ints have an anambiguous translation back and forth to strings (?)
 static inline boolean u64_from_value(value v, u64 *result)
 {
+    if (is_integer(v)) {
+        *result = *(u64 *)v;
+        return true;
+    }
     return parse_int(alloca_wrap((buffer)v), 10, result);
 }
 
@@ -70,6 +102,10 @@ static inline value value_from_u64(heap h, u64 n)
 static inline value value_rewrite_u64(value v, u64 n)
 {
     assert(!is_tuple(v));
+    if (is_integer(v)) {
+        *(u64 *)v = n;
+        return v;
+    }
     buffer_clear((buffer)v);
     print_number((buffer)v, n, 10, 0);
     return v;
@@ -100,18 +136,19 @@ static inline string get_string(value e, symbol a)
     return (v && tagof(v) == tag_unknown) ? v : 0;
 }
 
-/* TODO - change to validate number type */
-static inline string get_number(value e, symbol a)
+/* returns either an integer or a string, which is assumed to hold a number */
+static inline value get_number(value e, symbol a)
 {
-    return get_string(e, a);
+    value v = get(e, a);
+    return (v && (is_string(v) || is_integer(v))) ? v : 0;
 }
 
 static inline boolean get_u64(value e, symbol a, u64 *result)
 {
-    string s = get_number(e, a);
-    if (!s)
+    value v = get_number(e, a);
+    if (!v)
         return false;
-    return u64_from_value(s, result);
+    return u64_from_value(v, result);
 }
 
 /* really just for parser output */
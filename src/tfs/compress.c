@@ -0,0 +1,357 @@
+#include <tfs_internal.h>
+
+/* Compressed extents
+
+   File data may be stored in extents holding LZ4-compressed data: such an
+   extent maps up to TFS_COMPRESS_UNIT bytes of file data onto fewer storage
+   blocks. Compressed extents are written when building an image; since
+   they cannot be updated in place, a write to the range of a compressed
+   extent first replaces it with ordinary extents holding its decompressed
+   data.
+
+   Reads are served from a cache of decompressed extents. On a miss, the
+   compressed blocks are read and decompressed in full, and the requested
+   part is copied into the page cache pages of the read request; subsequent
+   page reads from the same extent then hit the cache. Entries not in use
+   are kept in LRU order, and evicted once the cache exceeds its size
+   limit. */
+
+#ifdef KERNEL
+#define zcache_lock_init(zc)    spin_lock_init(&(zc)->lock)
+#define zcache_lock(zc)         spin_lock(&(zc)->lock)
+#define zcache_unlock(zc)       spin_unlock(&(zc)->lock)
+#else
+#define zcache_lock_init(zc)
+#define zcache_lock(zc)         ((void)zc)
+#define zcache_unlock(zc)       ((void)zc)
+#endif
+
+struct zcache {
+    filesystem fs;
+    heap h;
+    table entries;              /* maps extent to zcache_entry */
+    struct list lru;            /* loaded entries not in use, least recently used first */
+    u64 size;                   /* decompressed bytes held by cached entries */
+    u64 max_size;
+    struct zcache_stats stats;
+#ifdef KERNEL
+    struct spinlock lock;
+#endif
+};
+
+struct zcache_entry {
+    struct list l;
+    zcache zc;
+    extent ex;                  /* zero once detached from the cache */
+    u64 start_block;
+    u64 nblocks;
+    u64 compressed;             /* length of compressed data in bytes */
+    u64 size;                   /* length of decompressed data in bytes */
+    void *data;
+    int refcount;
+    boolean loaded;
+    boolean failed;
+    vector waiters;             /* zcache_handlers waiting for the load to complete */
+};
+
+zcache zcache_new(filesystem fs, u64 max_size)
+{
+    zcache zc = allocate(fs->h, sizeof(struct zcache));
+    if (zc == INVALID_ADDRESS)
+        return zc;
+    zc->entries = allocate_table(fs->h, identity_key, pointer_equal);
+    if (zc->entries == INVALID_ADDRESS) {
+        deallocate(fs->h, zc, sizeof(struct zcache));
+        return INVALID_ADDRESS;
+    }
+    zc->fs = fs;
+    zc->h = fs->h;
+    list_init(&zc->lru);
+    zc->size = 0;
+    zc->max_size = max_size;
+    zero(&zc->stats, sizeof(zc->stats));
+    zcache_lock_init(zc);
+    return zc;
+}
+
+static void zcache_free_entry(zcache zc, zcache_entry e)
+{
+    if (e->data)
+        deallocate(zc->h, e->data, pad(e->size, PAGESIZE));
+    deallocate_vector(e->waiters);
+    deallocate(zc->h, e, sizeof(struct zcache_entry));
+}
+
+/* Called with no storage operations pending on compressed extents. */
+void zcache_destroy(zcache zc)
+{
+    table_foreach(zc->entries, k, e) {
+        (void)k;
+        zcache_free_entry(zc, e);
+    }
+    deallocate_table(zc->entries);
+    deallocate(zc->h, zc, sizeof(struct zcache));
+}
+
+/* called with cache lock held */
+static void zcache_detach(zcache zc, zcache_entry e)
+{
+    table_set(zc->entries, e->ex, 0);
+    e->ex = 0;
+    if (e->loaded)
+        zc->size -= e->size;
+}
+
+/* called with cache lock held */
+static void zcache_trim(zcache zc)
+{
+    list l;
+    while ((zc->size > zc->max_size) && (l = list_get_next(&zc->lru))) {
+        zcache_entry e = struct_from_list(l, zcache_entry, l);
+        list_delete(l);
+        zcache_detach(zc, e);
+        zcache_free_entry(zc, e);
+        zc->stats.evictions++;
+    }
+}
+
+void zcache_set_size(zcache zc, u64 max_size)
+{
+    zcache_lock(zc);
+    zc->max_size = max_size;
+    zcache_trim(zc);
+    zcache_unlock(zc);
+}
+
+struct zcache_stats *zcache_get_stats(zcache zc, u64 *size)
+{
+    *size = zc->size;
+    return &zc->stats;
+}
+
+static status zcache_error(void)
+{
+    return timm("result", "failed to read compressed extent", "fsstatus", "%d", FS_STATUS_IOERR);
+}
+
+closure_function(3, 1, void, zcache_load_complete,
+                 zcache_entry, e, sg_list, sg, void *, cdata,
+                 status, s)
+{
+    zcache_entry e = bound(e);
+    zcache zc = e->zc;
+    filesystem fs = zc->fs;
+    u64 clen = pad(e->nblocks << fs->blocksize_order, PAGESIZE);
+    sg_list_release(bound(sg));
+    deallocate_sg_list(bound(sg));
+    if (is_ok(s)) {
+        e->data = allocate(zc->h, pad(e->size, PAGESIZE));
+        if (e->data == INVALID_ADDRESS) {
+            e->data = 0;
+            s = timm("result", "failed to allocate decompression buffer",
+                     "fsstatus", "%d", FS_STATUS_NOMEM);
+        } else if (lz4_decompress(bound(cdata), e->compressed, e->data, e->size) != e->size) {
+            s = timm("result", "corrupt compressed extent at block %ld", e->start_block,
+                     "fsstatus", "%d", FS_STATUS_IOERR);
+        }
+    }
+    deallocate(zc->h, bound(cdata), clen);
+
+    boolean failed = !is_ok(s);
+    if (failed) {
+        msg_err("%v\n", s);
+        timm_dealloc(s);
+    }
+    zcache_lock(zc);
+    if (!failed) {
+        e->loaded = true;
+        if (e->ex) {
+            zc->size += e->size;
+            zc->stats.decompressed_bytes += e->size;
+        }
+    } else {
+        e->failed = true;
+        if (e->ex)
+            zcache_detach(zc, e);   /* the next request retries the load */
+    }
+    u64 nwaiters = vector_length(e->waiters);
+    zcache_unlock(zc);
+
+    /* waiters are only added before the load completes */
+    for (u64 i = 0; i < nwaiters; i++) {
+        zcache_handler h = vector_get(e->waiters, i);
+        apply(h, e, failed ? zcache_error() : STATUS_OK);
+    }
+    vector_clear(e->waiters);
+    zcache_release(e);
+    closure_finish();
+}
+
+/* Returns the cache entry of a compressed extent, starting to load it if needed; the entry is held
+   until released with zcache_release(). Called with the file lock held. */
+zcache_entry zcache_acquire(zcache zc, extent ex)
+{
+    filesystem fs = zc->fs;
+    zcache_lock(zc);
+    zcache_entry e = table_find(zc->entries, ex);
+    if (e) {
+        if (e->refcount++ == 0)
+            list_delete(&e->l);
+        if (e->loaded)
+            zc->stats.hits++;
+        zcache_unlock(zc);
+        return e;
+    }
+    zc->stats.misses++;
+    zcache_unlock(zc);
+
+    e = allocate(zc->h, sizeof(struct zcache_entry));
+    if (e == INVALID_ADDRESS)
+        return e;
+    e->waiters = allocate_vector(zc->h, 2);
+    if (e->waiters == INVALID_ADDRESS)
+        goto fail_dealloc_entry;
+    u64 clen = pad(ex->allocated << fs->blocksize_order, PAGESIZE);
+    void *cdata = allocate(zc->h, clen);
+    if (cdata == INVALID_ADDRESS)
+        goto fail_dealloc_waiters;
+    sg_list sg = tfs_page_sg(cdata, ex->allocated << fs->blocksize_order);
+    if (sg == INVALID_ADDRESS)
+        goto fail_dealloc_cdata;
+    status_handler sh = closure(zc->h, zcache_load_complete, e, sg, cdata);
+    if (sh == INVALID_ADDRESS)
+        goto fail_dealloc_sg;
+    list_init_member(&e->l);
+    e->zc = zc;
+    e->ex = ex;
+    e->start_block = ex->start_block;
+    e->nblocks = ex->allocated;
+    e->compressed = ex->compressed;
+    e->size = range_span(ex->node.r) << fs->blocksize_order;
+    e->data = 0;
+    e->refcount = 2;    /* one for the caller, one for the load */
+    e->loaded = e->failed = false;
+    zcache_lock(zc);
+    table_set(zc->entries, ex, e);
+    zc->stats.read_bytes += e->compressed;
+    zcache_unlock(zc);
+    filesystem_storage_op(fs, sg, irangel(e->start_block, e->nblocks), false, sh);
+    return e;
+  fail_dealloc_sg:
+    deallocate_sg_list(sg);
+  fail_dealloc_cdata:
+    deallocate(zc->h, cdata, clen);
+  fail_dealloc_waiters:
+    deallocate_vector(e->waiters);
+  fail_dealloc_entry:
+    deallocate(zc->h, e, sizeof(struct zcache_entry));
+    return INVALID_ADDRESS;
+}
+
+/* Applies the handler once the entry data is available (possibly immediately). */
+void zcache_wait(zcache_entry e, zcache_handler h)
+{
+    zcache zc = e->zc;
+    zcache_lock(zc);
+    boolean done = e->loaded || e->failed;
+    if (!done)
+        vector_push(e->waiters, h);
+    zcache_unlock(zc);
+    if (done)
+        apply(h, e, e->loaded ? STATUS_OK : zcache_error());
+}
+
+void zcache_release(zcache_entry e)
+{
+    zcache zc = e->zc;
+    zcache_lock(zc);
+    if (--e->refcount == 0) {
+        if (e->ex && e->loaded) {
+            list_push_back(&zc->lru, &e->l);
+            zcache_trim(zc);
+        } else {
+            zcache_free_entry(zc, e);
+        }
+    }
+    zcache_unlock(zc);
+}
+
+void *zcache_entry_data(zcache_entry e)
+{
+    return e->data;
+}
+
+/* Returns the extent that the entry was loaded from, or zero if the extent has since been
+   destroyed. Called with the file lock held. */
+extent zcache_entry_extent(zcache_entry e)
+{
+    return e->ex;
+}
+
+/* Drops the cache entry of an extent being destroyed. */
+void zcache_evict(zcache zc, extent ex)
+{
+    zcache_lock(zc);
+    zcache_entry e = table_find(zc->entries, ex);
+    if (e) {
+        zcache_detach(zc, e);
+        if (e->refcount == 0) {
+            list_delete(&e->l);
+            zcache_free_entry(zc, e);
+        }
+    }
+    zcache_unlock(zc);
+}
+
+closure_function(4, 2, void, zcache_read_complete,
+                 sg_list, sg, u64, offset, u64, length, status_handler, sh,
+                 zcache_entry, e, status, s)
+{
+    sg_list sg = bound(sg);
+    if (is_ok(s))
+        sg_copy_from_buf(zcache_entry_data(e) + bound(offset), sg, bound(length));
+    sg_list_release(sg);
+    deallocate_sg_list(sg);
+    zcache_release(e);
+    apply(bound(sh), s);
+    closure_finish();
+}
+
+/* Reads the part q (in bytes) of the data of a compressed extent into sg, consuming the
+   corresponding buffers of sg before returning. Called with the file lock held. */
+void zcache_read(zcache zc, extent ex, sg_list sg, range q, status_handler sh)
+{
+    u64 length = range_span(q);
+    zcache_entry e = zcache_acquire(zc, ex);
+    if (e == INVALID_ADDRESS) {
+        sg_consume(sg, length);
+        apply(sh, timm("result", "failed to allocate compressed extent cache entry",
+                       "fsstatus", "%d", FS_STATUS_NOMEM));
+        return;
+    }
+    zcache_lock(zc);
+    boolean loaded = e->loaded;
+    zcache_unlock(zc);
+    if (loaded) {
+        sg_copy_from_buf(e->data + q.start, sg, length);
+        zcache_release(e);
+        apply(sh, STATUS_OK);
+        return;
+    }
+    sg_list rsg = allocate_sg_list();
+    if (rsg == INVALID_ADDRESS)
+        goto fail;
+    zcache_handler h = closure(zc->h, zcache_read_complete, rsg, q.start, length, sh);
+    if (h == INVALID_ADDRESS) {
+        deallocate_sg_list(rsg);
+        goto fail;
+    }
+    sg_move(rsg, sg, length);
+    zcache_wait(e, h);
+    return;
+  fail:
+    sg_consume(sg, length);
+    zcache_release(e);
+    apply(sh, timm("result", "failed to allocate compressed read",
+                   "fsstatus", "%d", FS_STATUS_NOMEM));
+}
@@ -0,0 +1,299 @@
+#include <tfs_internal.h>
+
+/* Directory index
+
+   Children of a directory are kept in a tuple keyed by interned symbols,
+   which is what gets encoded in the log. Large directories are served instead
+   by an in-memory index, built the first time the directory is looked up or
+   listed and kept up to date by the namespace operations:
+
+   - name lookups hash the name string into an open-addressing table, so that
+     resolving a path neither interns its components nor walks a tuple;
+   - the table is grown incrementally: when a resize is due, the old slot
+     array is kept around and its entries are migrated a few at a time by
+     subsequent updates, instead of being rehashed at once with the
+     filesystem locked;
+   - each entry is assigned a cookie in increasing order of insertion; entries
+     are listed in cookie order, so that a directory offset remains valid
+     across insertion and removal of other entries.
+
+   The index is protected by the filesystem lock held exclusively. */
+
+#define DIR_INDEX_MIN_SLOTS         16
+#define DIR_INDEX_MIGRATE_ENTRIES   32
+#define DIR_INDEX_MIGRATE_SLOTS     (4 * DIR_INDEX_MIGRATE_ENTRIES)
+
+/* cookies 0 and 1 denote the "." and ".." entries */
+#define DIR_COOKIE_FIRST            2
+
+#define DIR_SLOT_EMPTY              ((dir_entry)0)
+#define DIR_SLOT_DELETED            ((dir_entry)1)
+
+typedef struct dir_entry {
+    symbol name;
+    tuple t;            /* zero if the entry has been removed */
+    u64 hash;
+    u64 cookie;
+} *dir_entry;
+
+struct dir_index {
+    heap h;
+    dir_entry *slots;
+    u64 nslots;
+    u64 used;           /* live and deleted slots */
+    dir_entry *old_slots;
+    u64 old_nslots;
+    u64 old_count;      /* live entries not yet migrated from the old slots */
+    u64 migrate_pos;
+    vector entries;     /* in cookie order, including removed entries */
+    u64 count;
+    u64 next_cookie;
+};
+
+static inline u64 dir_name_hash(buffer name)
+{
+    /* zero and one are reserved for slot markers */
+    return fnv64(name) | 2;
+}
+
+static inline boolean dir_entry_match(dir_entry e, u64 hash, buffer name)
+{
+    return (e->hash == hash) && buffer_compare(symbol_string(e->name), name);
+}
+
+static dir_entry *dir_slots_find(dir_entry *slots, u64 nslots, u64 hash, buffer name)
+{
+    u64 mask = nslots - 1;
+    for (u64 i = hash & mask; ; i = (i + 1) & mask) {
+        dir_entry e = slots[i];
+        if (e == DIR_SLOT_EMPTY)
+            return 0;
+        if ((e != DIR_SLOT_DELETED) && dir_entry_match(e, hash, name))
+            return &slots[i];
+    }
+}
+
+/* the slot array must have at least one empty slot */
+static void dir_slots_insert(dir_entry *slots, u64 nslots, dir_entry e, u64 *used)
+{
+    u64 mask = nslots - 1;
+    u64 i = e->hash & mask;
+    while ((slots[i] != DIR_SLOT_EMPTY) && (slots[i] != DIR_SLOT_DELETED))
+        i = (i + 1) & mask;
+    if (slots[i] == DIR_SLOT_EMPTY)
+        (*used)++;
+    slots[i] = e;
+}
+
+static void dir_index_free_old(dir_index di)
+{
+    deallocate(di->h, di->old_slots, di->old_nslots * sizeof(dir_entry));
+    di->old_slots = 0;
+}
+
+/* Moves up to n live entries from the old slot array, scanning at most max_slots slots, so that
+   empty and deleted slots also bound the work done; the old array is freed as soon as no live
+   entry is left. */
+static void dir_index_migrate(dir_index di, u64 n, u64 max_slots)
+{
+    while (n > 0 && max_slots-- > 0 && di->old_slots) {
+        if (!di->old_count) {
+            dir_index_free_old(di);
+            break;
+        }
+        dir_entry e = di->old_slots[di->migrate_pos++];
+        if ((e != DIR_SLOT_EMPTY) && (e != DIR_SLOT_DELETED)) {
+            dir_slots_insert(di->slots, di->nslots, e, &di->used);
+
+            /* keep the probe sequences of the old slots intact */
+            di->old_slots[di->migrate_pos - 1] = DIR_SLOT_DELETED;
+            di->old_count--;
+            n--;
+        }
+    }
+    if (di->old_slots && !di->old_count)
+        dir_index_free_old(di);
+}
+
+/* Keeps the load factor below 3/4, counting entries still in the old slot array. */
+static boolean dir_index_grow(dir_index di)
+{
+    u64 pending = di->old_slots ? di->old_count : 0;
+    if ((di->used + pending + 1) * 4 < di->nslots * 3)
+        return true;
+
+    /* finish any ongoing migration before starting a new one */
+    dir_index_migrate(di, pending, di->old_nslots);
+    u64 nslots = di->nslots;
+    if ((di->count + 1) * 2 >= nslots)
+        nslots *= 2;
+    dir_entry *slots = allocate_zero(di->h, nslots * sizeof(dir_entry));
+    if (slots == INVALID_ADDRESS)
+        return false;
+    di->old_slots = di->slots;
+    di->old_nslots = di->nslots;
+    di->old_count = di->count;
+    di->migrate_pos = 0;
+    di->slots = slots;
+    di->nslots = nslots;
+    di->used = 0;
+    return true;
+}
+
+static boolean dir_index_add(dir_index di, symbol name, tuple t)
+{
+    if (!dir_index_grow(di))
+        return false;
+    dir_entry e = allocate(di->h, sizeof(*e));
+    if (e == INVALID_ADDRESS)
+        return false;
+    e->name = name;
+    e->t = t;
+    e->hash = dir_name_hash(symbol_string(name));
+    e->cookie = di->next_cookie++;
+    vector_push(di->entries, e);
+    dir_slots_insert(di->slots, di->nslots, e, &di->used);
+    di->count++;
+    return true;
+}
+
+closure_function(2, 2, boolean, dir_index_add_each,
+                 dir_index, di, boolean *, success,
+                 value, k, value, v)
+{
+    if (!is_tuple(v))
+        return true;
+    if (!dir_index_add(bound(di), k, v)) {
+        *bound(success) = false;
+        return false;
+    }
+    return true;
+}
+
+dir_index dir_index_new(heap h, tuple c)
+{
+    dir_index di = allocate(h, sizeof(struct dir_index));
+    if (di == INVALID_ADDRESS)
+        return di;
+    di->h = h;
+    u64 count = tuple_count(c);
+    di->nslots = DIR_INDEX_MIN_SLOTS;
+    while (di->nslots * 3 <= count * 4)
+        di->nslots *= 2;
+    di->slots = allocate_zero(h, di->nslots * sizeof(dir_entry));
+    if (di->slots == INVALID_ADDRESS)
+        goto fail_dealloc_index;
+    di->entries = allocate_vector(h, count + 1);
+    if (di->entries == INVALID_ADDRESS)
+        goto fail_dealloc_slots;
+    di->used = di->count = 0;
+    di->old_slots = 0;
+    di->next_cookie = DIR_COOKIE_FIRST;
+    boolean success = true;
+    iterate(c, stack_closure(dir_index_add_each, di, &success));
+    if (!success) {
+        dir_index_destroy(di);
+        return INVALID_ADDRESS;
+    }
+    return di;
+  fail_dealloc_slots:
+    deallocate(h, di->slots, di->nslots * sizeof(dir_entry));
+  fail_dealloc_index:
+    deallocate(h, di, sizeof(struct dir_index));
+    return INVALID_ADDRESS;
+}
+
+void dir_index_destroy(dir_index di)
+{
+    dir_entry e;
+    vector_foreach(di->entries, e)
+        deallocate(di->h, e, sizeof(*e));
+    deallocate_vector(di->entries);
+    if (di->old_slots)
+        deallocate(di->h, di->old_slots, di->old_nslots * sizeof(dir_entry));
+    deallocate(di->h, di->slots, di->nslots * sizeof(dir_entry));
+    deallocate(di->h, di, sizeof(struct dir_index));
+}
+
+static dir_entry *dir_index_find(dir_index di, u64 hash, buffer name)
+{
+    dir_entry *p = dir_slots_find(di->slots, di->nslots, hash, name);
+    if (!p && di->old_slots)
+        p = dir_slots_find(di->old_slots, di->old_nslots, hash, name);
+    return p;
+}
+
+tuple dir_index_lookup(dir_index di, buffer name, symbol *s)
+{
+    dir_entry *p = dir_index_find(di, dir_name_hash(name), name);
+    if (!p)
+        return 0;
+    if (s)
+        *s = (*p)->name;
+    return (*p)->t;
+}
+
+/* Drops removed entries from the cookie-ordered vector once they make up half of it. */
+static void dir_index_compact(dir_index di)
+{
+    u64 total = vector_length(di->entries);
+    if (total < 2 * DIR_INDEX_MIN_SLOTS || di->count * 2 > total)
+        return;
+    dir_entry *entries = buffer_ref(di->entries, 0);
+    u64 n = 0;
+    for (u64 i = 0; i < total; i++) {
+        dir_entry e = entries[i];
+        if (e->t)
+            entries[n++] = e;
+        else
+            deallocate(di->h, e, sizeof(*e));
+    }
+    buffer_clear(di->entries);
+    buffer_produce(di->entries, n * sizeof(dir_entry));
+}
+
+/* Mirrors an update of the children tuple: a zero t removes the entry. */
+boolean dir_index_set(dir_index di, symbol name, tuple t)
+{
+    buffer s = symbol_string(name);
+    dir_entry *p = dir_index_find(di, dir_name_hash(s), s);
+    boolean success = true;
+    if (p) {
+        dir_entry e = *p;
+        if (t) {
+            e->t = t;
+        } else {
+            if (di->old_slots && (p >= di->old_slots) && (p < di->old_slots + di->old_nslots))
+                di->old_count--;
+            *p = DIR_SLOT_DELETED;
+            e->t = 0;
+            di->count--;
+            dir_index_compact(di);
+        }
+    } else if (t) {
+        success = dir_index_add(di, name, t);
+    }
+    dir_index_migrate(di, DIR_INDEX_MIGRATE_ENTRIES, DIR_INDEX_MIGRATE_SLOTS);
+    return success;
+}
+
+/* Invokes the handler on each entry with a cookie not lower than the given one, passing the cookie
+   of the following entry; stops when the handler returns false. */
+boolean dir_index_iterate(dir_index di, u64 cookie, dir_entry_handler h)
+{
+    dir_entry *entries = buffer_ref(di->entries, 0);
+    u64 lo = 0, hi = vector_length(di->entries);
+    while (lo < hi) {
+        u64 mid = (lo + hi) / 2;
+        if (entries[mid]->cookie < cookie)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (; lo < vector_length(di->entries); lo++) {
+        dir_entry e = entries[lo];
+        if (e->t && !apply(h, e->name, e->t, e->cookie + 1))
+            return false;
+    }
+    return true;
+}
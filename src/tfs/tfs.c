@@ -85,6 +85,10 @@ u64 fsfile_get_blocks(fsfile f)
 {
     u64 blocks = 0;
     rangemap_foreach(f->extentmap, n) {
+        extent ex = (extent)n;
+        blocks += ex->compressed ? ex->allocated : range_span(n->r);
+    }
+    rangemap_foreach(f->delalloc, n) {
         blocks += range_span(n->r);
     }
     return blocks;
@@ -151,11 +155,15 @@ static inline void filesystem_set_time(filesystem fs, tuple t, symbol s,
         u64_from_value(time_val, &cur_time);
     }
     if (tim != cur_time) {
+        if (time_val && is_integer(time_val)) {
+            value_rewrite_u64(time_val, tim);
+            return;
+        }
         if (time_val) {
             deallocate_value(time_val);
         }
-        time_val = value_from_u64(fs->h, tim);
-        assert(time_val);
+        time_val = allocate_integer(tim);
+        assert(time_val != INVALID_ADDRESS);
         set(t, s, time_val);
     }
 }
@@ -189,6 +197,51 @@ void fixup_directory(tuple parent, tuple n)
     set(n, sym_this(".."), parent);
 }
 
+/* Called with the filesystem locked exclusively. Directory indexes are built on first use; if an
+   index cannot be allocated, lookups fall back to the children tuple. */
+static dir_index fs_get_dir_index(filesystem fs, tuple dir)
+{
+    dir_index di = table_find(fs->dir_indexes, dir);
+    if (!di) {
+        di = dir_index_new(fs->h, children(dir));
+        if (di == INVALID_ADDRESS)
+            return di;
+        table_set(fs->dir_indexes, dir, di);
+    }
+    return di;
+}
+
+/* Looks up a directory entry without interning the name. */
+static tuple fs_lookup_child(filesystem fs, tuple dir, buffer name)
+{
+    if (buffer_compare_with_cstring(name, ".."))
+        return get_tuple(dir, sym_this(".."));
+    if (buffer_compare_with_cstring(name, "."))
+        return dir;
+    if (!children(dir))
+        return 0;
+    dir_index di = fs_get_dir_index(fs, dir);
+    if (di == INVALID_ADDRESS)
+        return lookup(dir, intern(name));
+    return dir_index_lookup(di, name, 0);
+}
+
+/* Cookies 0 and 1 are assigned to the "." and ".." entries. */
+fs_status filesystem_iterate_dir(filesystem fs, tuple dir, u64 cookie, dir_entry_handler h)
+{
+    if (!children(dir))
+        return FS_STATUS_NOTDIR;
+    dir_index di = fs_get_dir_index(fs, dir);
+    if (di == INVALID_ADDRESS)
+        return FS_STATUS_NOMEM;
+    if ((cookie == 0) && !apply(h, sym_this("."), dir, 1))
+        return FS_STATUS_OK;
+    if ((cookie <= 1) && !apply(h, sym_this(".."), get_tuple(dir, sym_this("..")), 2))
+        return FS_STATUS_OK;
+    dir_index_iterate(di, cookie, h);
+    return FS_STATUS_OK;
+}
+
 static inline boolean ingest_parse_int(tuple value, symbol s, u64 * i)
 {
     buffer b = get(value, s);
@@ -198,6 +251,10 @@ static inline boolean ingest_parse_int(tuple value, symbol s, u64 * i)
         msg_err("value missing %b\n", symbol_string(s));
         return false;
     }
+    if (is_integer(b)) {
+        *i = *(u64 *)b;
+        return true;
+    }
 
     /* XXX gross, but we're having issues with too many allocas in stage2 */
     bytes start = b->start;
@@ -206,6 +263,27 @@ static inline boolean ingest_parse_int(tuple value, symbol s, u64 * i)
     return retval;
 }
 
+/* Numbers decoded from the log are strings; the ones that stay in the metadata of each file are
+   replaced with integers, which take a fraction of the memory. */
+static void ingest_compact_u64(tuple t, symbol s)
+{
+    value v = get(t, s);
+    if (!v || !is_string(v))
+        return;
+    buffer b = v;
+    bytes start = b->start;
+    u64 n;
+    boolean number = parse_int(b, 10, &n) && !buffer_length(b);
+    b->start = start;
+    if (!number)
+        return;
+    value i = allocate_integer(n);
+    if (i == INVALID_ADDRESS)
+        return;
+    set(t, s, i);
+    deallocate_value(v);
+}
+
 static inline extent allocate_extent(heap h, range file_blocks, range storage_blocks)
 {
     extent e = allocate(h, sizeof(struct extent));
@@ -215,6 +293,7 @@ static inline extent allocate_extent(heap h, range file_blocks, range storage_bl
     e->start_block = storage_blocks.start;
     e->allocated = range_span(storage_blocks);
     e->uninited = 0;
+    e->compressed = 0;
     return e;
 }
 
@@ -226,25 +305,50 @@ static inline extent allocate_extent(heap h, range file_blocks, range storage_bl
 #define uninited_unlock(u)
 #endif
 
-u64 filesystem_allocate_storage(filesystem fs, u64 nblocks)
+/* Called with allocation lock held. */
+static u64 fs_storage_alloc(filesystem fs, u64 nblocks)
 {
     if (fs->storage)
         return allocate_u64((heap)fs->storage, nblocks);
     return INVALID_PHYSICAL;
 }
 
+u64 filesystem_allocate_storage(filesystem fs, u64 nblocks)
+{
+    fs_alloc_lock(fs);
+    u64 start = fs_storage_alloc(fs, nblocks);
+    fs_alloc_unlock(fs);
+    return start;
+}
+
+static boolean fs_storage_set_area(filesystem fs, range blocks, boolean allocate)
+{
+    if (!fs->storage)
+        return true;
+    fs_alloc_lock(fs);
+    boolean result = id_heap_set_area(fs->storage, blocks.start, range_span(blocks), true,
+                                      allocate);
+    fs_alloc_unlock(fs);
+    return result;
+}
+
 boolean filesystem_reserve_storage(filesystem fs, range blocks)
 {
-    if (fs->storage)
-        return id_heap_set_area(fs->storage, blocks.start, range_span(blocks), true, true);
-    return true;
+    return fs_storage_set_area(fs, blocks, true);
 }
 
 boolean filesystem_free_storage(filesystem fs, range blocks)
 {
-    if (fs->storage)
-        return id_heap_set_area(fs->storage, blocks.start, range_span(blocks), true, false);
-    return true;
+    return fs_storage_set_area(fs, blocks, false);
+}
+
+static int filesystem_current_alloc_group(filesystem fs)
+{
+#ifdef KERNEL
+    return current_cpu()->id % fs->alloc_groups;
+#else
+    return 0;
+#endif
 }
 
 void ingest_extent(fsfile f, symbol off, tuple value)
@@ -271,7 +375,15 @@ void ingest_extent(fsfile f, symbol off, tuple value)
     ex->md = value;
     if (get(value, sym(uninited)))
         ex->uninited = INVALID_ADDRESS;
+    if (get(value, sym(lz4)))
+        assert(ingest_parse_int(value, sym(lz4), &ex->compressed));
+    ingest_compact_u64(value, sym(length));
+    ingest_compact_u64(value, sym(offset));
+    ingest_compact_u64(value, sym(allocated));
+    ingest_compact_u64(value, sym(lz4));
     assert(rangemap_insert(f->extentmap, &ex->node));
+    if (rangemap_next_node(f->extentmap, &ex->node) == INVALID_ADDRESS)
+        f->alloc_goal = start_block + allocated;
 }
 
 closure_function(1, 2, boolean, tfs_ingest_extent,
@@ -297,15 +409,17 @@ closure_function(1, 2, boolean, enumerate_dir_entries_each,
 
 static boolean enumerate_dir_entries(filesystem fs, tuple t)
 {
+    ingest_compact_u64(t, sym(mtime));
+    ingest_compact_u64(t, sym(atime));
     tuple extents = get_tuple(t, sym(extents));
     if (extents) {
         fsfile f = allocate_fsfile(fs, t);
         if (f == INVALID_ADDRESS)
             return false;
         table_set(fs->files, t, f);
-        string filelength = get(t, sym(filelength));
+        ingest_compact_u64(t, sym(filelength));
         u64 len;
-        if (filelength && u64_from_value(filelength, &len))
+        if (get_u64(t, sym(filelength), &len))
             fsfile_set_length(f, len);
         return iterate(extents, stack_closure(tfs_ingest_extent, f));
     }
@@ -322,7 +436,7 @@ void filesystem_storage_op(filesystem fs, sg_list sg, range blocks, boolean writ
     tfs_debug("%s: fs %p, sg %p, sg size %ld, blocks %R, %c\n", __func__,
               fs, sg, sg->count, blocks, write ? 'w' : 'r');
     struct storage_req req = {
-        .op = write ? STORAGE_OP_WRITESG : STORAGE_OP_READSG,
+        .op = write ? (fs->fua ? STORAGE_OP_WRITESG_FUA : STORAGE_OP_WRITESG) : STORAGE_OP_READSG,
         .blocks = blocks,
         .data = sg,
         .completion = completion,
@@ -330,6 +444,34 @@ void filesystem_storage_op(filesystem fs, sg_list sg, range blocks, boolean writ
     apply(fs->req_handler, &req);
 }
 
+/* Lets the storage driver complete finished requests without waiting for an interrupt; completion
+   handlers are not invoked synchronously. */
+void filesystem_storage_poll(filesystem fs)
+{
+    struct storage_req req = {
+        .op = STORAGE_OP_POLL,
+    };
+    apply(fs->req_handler, &req);
+}
+
+/* Holds back submission of storage requests to the device until the matching
+   filesystem_storage_unplug(), so that requests issued in between are submitted as a batch. */
+void filesystem_storage_plug(filesystem fs)
+{
+    struct storage_req req = {
+        .op = STORAGE_OP_PLUG,
+    };
+    apply(fs->req_handler, &req);
+}
+
+void filesystem_storage_unplug(filesystem fs)
+{
+    struct storage_req req = {
+        .op = STORAGE_OP_UNPLUG,
+    };
+    apply(fs->req_handler, &req);
+}
+
 closure_function(2, 1, void, zero_blocks_complete,
                  sg_list, sg, status_handler, completion,
                  status, s)
@@ -368,7 +510,7 @@ void zero_blocks(filesystem fs, range blocks, merge m)
         r.start += length;
     }
     struct storage_req req = {
-        .op = STORAGE_OP_WRITESG,
+        .op = fs->fua ? STORAGE_OP_WRITESG_FUA : STORAGE_OP_WRITESG,
         .blocks = blocks,
         .data = sg,
         .completion = zero_blocks_completion,
@@ -409,7 +551,10 @@ closure_function(4, 1, void, read_extent,
     range blocks = irangel(e->start_block + e_offset, len);
     tfs_debug("%s: e %p, uninited %p, sg %p m %p blocks %R, i %R, len %ld, blocks %R\n",
               __func__, e, e->uninited, bound(sg), bound(m), bound(blocks), i, len, blocks);
-    if (!e->uninited) {
+    if (e->compressed) {
+        zcache_read(fs->zcache, e, sg, irangel(e_offset << fs->blocksize_order,
+                                               len << fs->blocksize_order), apply_merge(bound(m)));
+    } else if (!e->uninited) {
         filesystem_storage_op(fs, sg, blocks, false, apply_merge(bound(m)));
     } else if (e->uninited == INVALID_ADDRESS) {
         sg_zero_fill(sg, range_span(blocks) << fs->blocksize_order);
@@ -435,6 +580,30 @@ closure_function(3, 1, void, zero_hole,
 
 BSS_RO_AFTER_INIT io_status_handler ignore_io_status;
 
+/* Files, directories and extents are schema tuples, which hold these attributes in place; any
+   other attribute (e.g. a symlink target) goes to a table in the tuple. */
+static struct tuple_schema tfs_inode_schema;
+static struct tuple_schema tfs_extent_schema;
+
+static void tfs_init_schema(tuple_schema s, symbol *attrs, int count)
+{
+    s->count = count;
+    runtime_memcpy(s->attrs, attrs, count * sizeof(symbol));
+    register_tuple_schema(s);
+}
+
+static void tfs_init_schemas(void)
+{
+    symbol inode_attrs[] = {
+        sym_this(".."), sym(children), sym(extents), sym(filelength), sym(mtime), sym(atime),
+    };
+    symbol extent_attrs[] = {
+        sym(offset), sym(length), sym(allocated), sym(lz4),
+    };
+    tfs_init_schema(&tfs_inode_schema, inode_attrs, sizeof(inode_attrs) / sizeof(symbol));
+    tfs_init_schema(&tfs_extent_schema, extent_attrs, sizeof(extent_attrs) / sizeof(symbol));
+}
+
 /* whole block reads, file length resolved in cache */
 closure_function(2, 3, void, filesystem_storage_read,
                  filesystem, fs, fsfile, f,
@@ -448,11 +617,13 @@ closure_function(2, 3, void, filesystem_storage_read,
 
     /* read extent data and zero gaps */
     range blocks = range_rshift_pad(q, fs->blocksize_order);
-    filesystem_lock(fs);
+    filesystem_rlock(fs);
+    fsfile_lock(f);
     rangemap_range_lookup_with_gaps(f->extentmap, blocks,
                                     stack_closure(read_extent, fs, sg, m, blocks),
                                     stack_closure(zero_hole, fs, sg, blocks));
-    filesystem_unlock(fs);
+    fsfile_unlock(f);
+    filesystem_runlock(fs);
     apply(k, STATUS_OK);
 }
 
@@ -548,23 +719,184 @@ fs_status filesystem_write_eav(filesystem fs, tuple t, symbol a, value v)
         return FS_STATUS_NOSPACE;
 }
 
+/* Delayed allocation
+
+   Storage for a write is not allocated when the write is accepted by the
+   page cache; the blocks not yet backed by an extent are only accounted for
+   against the free space of the filesystem and recorded in the delalloc map
+   of the file. Extents are allocated when the data is written to storage, at
+   which point the whole run of reserved blocks can be allocated at once.
+
+   The delalloc map is covered by the file lock, and the filesystem-wide count
+   of reserved blocks by the allocation lock. */
+
+static boolean fsfile_delalloc_insert(fsfile f, range r)
+{
+    rangemap rm = f->delalloc;
+    rmnode prev = r.start > 0 ? rangemap_lookup(rm, r.start - 1) : INVALID_ADDRESS;
+    rmnode next = rangemap_lookup(rm, r.end);
+
+    /* r lies in a gap of the map, so adjoining nodes can be grown in place */
+    if (prev != INVALID_ADDRESS) {
+        if (next != INVALID_ADDRESS) {
+            r.end = next->r.end;
+            rangemap_remove_node(rm, next);
+            deallocate(f->fs->h, next, sizeof(struct rmnode));
+        }
+        prev->r.end = r.end;
+    } else if (next != INVALID_ADDRESS) {
+        next->r.start = r.start;
+    } else {
+        rmnode n = allocate(f->fs->h, sizeof(struct rmnode));
+        if (n == INVALID_ADDRESS)
+            return false;
+        rmnode_init(n, r);
+        assert(rangemap_insert(rm, n));
+    }
+    fs_alloc_lock(f->fs);
+    f->fs->delalloc_blocks += range_span(r);
+    fs_alloc_unlock(f->fs);
+    return true;
+}
+
+/* Walks the blocks in q that are neither backed by an extent nor already reserved, returning
+   their count and optionally reserving them. */
+static fs_status fsfile_delalloc_walk(fsfile f, range q, boolean reserve, u64 *count)
+{
+    u64 p = q.start;
+    *count = 0;
+    while (p < q.end) {
+        rmnode n = rangemap_lookup_at_or_next(f->extentmap, p);
+        if (n != INVALID_ADDRESS && n->r.start <= p) {
+            p = n->r.end;
+            continue;
+        }
+        u64 end = n != INVALID_ADDRESS ? MIN(n->r.start, q.end) : q.end;
+        n = rangemap_lookup_at_or_next(f->delalloc, p);
+        if (n != INVALID_ADDRESS && n->r.start <= p) {
+            p = MIN(n->r.end, end);
+            continue;
+        }
+        if (n != INVALID_ADDRESS)
+            end = MIN(n->r.start, end);
+        if (reserve && !fsfile_delalloc_insert(f, irange(p, end)))
+            return FS_STATUS_NOMEM;
+        *count += end - p;
+        p = end;
+    }
+    return FS_STATUS_OK;
+}
+
+static void fsfile_delalloc_release(fsfile f, range q)
+{
+    filesystem fs = f->fs;
+    rangemap rm = f->delalloc;
+    rmnode n = rangemap_lookup_at_or_next(rm, q.start);
+    fs_alloc_lock(fs);
+    while (n != INVALID_ADDRESS && n->r.start < q.end) {
+        rmnode next = rangemap_next_node(rm, n);
+        range i = range_intersection(n->r, q);
+        range head, tail;
+        range_difference(n->r, i, &head, &tail);
+        fs->delalloc_blocks -= range_span(i);
+        if (range_span(head)) {
+            n->r = head;
+            if (range_span(tail)) {
+                rmnode t = allocate(fs->h, sizeof(struct rmnode));
+                if (t != INVALID_ADDRESS) {
+                    rmnode_init(t, tail);
+                    assert(rangemap_insert(rm, t));
+                } else {
+                    /* give up the reservation rather than lose track of it */
+                    fs->delalloc_blocks -= range_span(tail);
+                }
+            }
+        } else if (range_span(tail)) {
+            n->r = tail;
+        } else {
+            rangemap_remove_node(rm, n);
+            deallocate(fs->h, n, sizeof(struct rmnode));
+        }
+        n = next;
+    }
+    fs_alloc_unlock(fs);
+}
+
+closure_function(1, 1, void, fsfile_delalloc_free,
+                 fsfile, f,
+                 rmnode, n)
+{
+    filesystem fs = bound(f)->fs;
+    fs_alloc_lock(fs);
+    fs->delalloc_blocks -= range_span(n->r);
+    fs_alloc_unlock(fs);
+    deallocate(fs->h, n, sizeof(struct rmnode));
+}
+
 static fs_status filesystem_truncate_locked(filesystem fs, fsfile f, u64 len)
 {
     if (f->md) {
-        value v = value_from_u64(fs->h, len);
+        value v = allocate_integer(len);
         if (v == INVALID_ADDRESS)
             return FS_STATUS_NOMEM;
         symbol l = sym(filelength);
         fs_status s = filesystem_write_eav(fs, f->md, l, v);
-        if (s != FS_STATUS_OK)
+        if (s != FS_STATUS_OK) {
+            deallocate_value(v);
             return s;
+        }
         set(f->md, l, v);
         filesystem_update_mtime(fs, f->md);
     }
+    if (len < f->length)
+        fsfile_delalloc_release(f, irange(pad(len, fs_blocksize(fs)) >> fs->blocksize_order,
+                                          infinity));
     fsfile_set_length(f, len);
     return FS_STATUS_OK;
 }
 
+/* Allocate storage for file data. Blocks following the last allocation for the file are preferred,
+   so that a growing file stays contiguous; otherwise, a next-fit search is done in the allocation
+   group of the file before falling back to the whole storage space. */
+static u64 fsfile_allocate_storage(filesystem fs, fsfile f, u64 nblocks)
+{
+    if (!fs->storage)
+        return INVALID_PHYSICAL;
+    u64 start;
+    int group;
+    fs_alloc_lock(fs);
+    if (f) {
+        u64 goal = f->alloc_goal;
+        if (goal && goal + nblocks <= fs->storage->total &&
+            id_heap_set_area(fs->storage, goal, nblocks, true, true)) {
+            start = goal;
+            goto out;
+        }
+        group = f->alloc_group;
+    } else {
+        group = filesystem_current_alloc_group(fs);
+    }
+    range g = irangel(group * fs->alloc_group_blocks, fs->alloc_group_blocks);
+    if (group == fs->alloc_groups - 1)
+        g.end = fs->storage->total;
+    start = id_heap_alloc_subrange(fs->storage, nblocks, fs->alloc_group_next[group], g.end);
+    if (start == INVALID_PHYSICAL)
+        start = id_heap_alloc_subrange(fs->storage, nblocks, g.start, g.end);
+    if (start == INVALID_PHYSICAL) {
+        start = fs_storage_alloc(fs, nblocks);
+        if (start == INVALID_PHYSICAL)
+            goto done;
+    } else {
+        fs->alloc_group_next[group] = start + nblocks;
+    }
+  out:
+    if (f)
+        f->alloc_goal = start + nblocks;
+  done:
+    fs_alloc_unlock(fs);
+    return start;
+}
+
 /* create a new extent in the filesystem
 
    The life an extent depends on a particular allocation of contiguous
@@ -576,18 +908,25 @@ static fs_status filesystem_truncate_locked(filesystem fs, fsfile f, u64 len)
 
 */
 
-static fs_status create_extent(filesystem fs, range blocks, boolean uninited, extent *ex)
+static fs_status create_extent(filesystem fs, fsfile f, range blocks, u64 nblocks,
+                               boolean uninited, extent *ex)
 {
     heap h = fs->h;
-    u64 nblocks = MAX(range_span(blocks), MIN_EXTENT_SIZE >> fs->blocksize_order);
+    u64 min_blocks = MAX(range_span(blocks), MIN_EXTENT_SIZE >> fs->blocksize_order);
+    nblocks = MAX(nblocks, min_blocks);
 
     tfs_debug("create_extent: blocks %R, uninited %p, nblocks %ld\n", blocks, uninited, nblocks);
     if (!filesystem_reserve_log_space(fs, &fs->next_extend_log_offset, 0, 0) ||
         !filesystem_reserve_log_space(fs, &fs->next_new_log_offset, 0, 0))
         return FS_STATUS_NOSPACE;
 
-    u64 start_block = filesystem_allocate_storage(fs, nblocks);
-    if (start_block == u64_from_pointer(INVALID_ADDRESS))
+    u64 start_block = fsfile_allocate_storage(fs, f, nblocks);
+    if (start_block == INVALID_PHYSICAL && nblocks > min_blocks) {
+        /* drop the speculative part of the allocation */
+        nblocks = min_blocks;
+        start_block = fsfile_allocate_storage(fs, f, nblocks);
+    }
+    if (start_block == INVALID_PHYSICAL)
         return FS_STATUS_NOSPACE;
 
     range storage_blocks = irangel(start_block, nblocks);
@@ -608,13 +947,14 @@ static void destroy_extent(filesystem fs, extent ex)
         msg_err("failed to mark extent at %R as free", q);
     if (ex->uninited && ex->uninited != INVALID_ADDRESS)
         refcount_release(&ex->uninited->refcount);
+    if (ex->compressed)
+        zcache_evict(fs->zcache, ex);
     deallocate(fs->h, ex, sizeof(*ex));
 }
 
 static fs_status add_extent_to_file(fsfile f, extent ex)
 {
     if (f->md) {
-        heap h = f->fs->h;
         tuple extents;
         symbol a = sym(extents);
         if (!(extents = get_tuple(f->md, a))) {
@@ -627,14 +967,17 @@ static fs_status add_extent_to_file(fsfile f, extent ex)
             set(f->md, a, extents);
         }
 
-        // XXX encode this as an immediate bitstring
-        tuple e = allocate_tuple();
+        tuple e = allocate_schema_tuple(&tfs_extent_schema);
+        if (e == INVALID_ADDRESS)
+            return FS_STATUS_NOMEM;
         ex->md = e;
-        set(e, sym(offset), value_from_u64(h, ex->start_block));
-        set(e, sym(length), value_from_u64(h, range_span(ex->node.r)));
-        set(e, sym(allocated), value_from_u64(h, ex->allocated));
+        set(e, sym(offset), allocate_integer(ex->start_block));
+        set(e, sym(length), allocate_integer(range_span(ex->node.r)));
+        set(e, sym(allocated), allocate_integer(ex->allocated));
         if (ex->uninited == INVALID_ADDRESS)
             set(e, sym(uninited), null_value);
+        if (ex->compressed)
+            set(e, sym(lz4), allocate_integer(ex->compressed));
         symbol offs = intern_u64(ex->node.r.start);
         fs_status s = filesystem_write_eav(f->fs, extents, offs, e);
         if (s != FS_STATUS_OK) {
@@ -666,20 +1009,21 @@ static void remove_extent_from_file(fsfile f, extent ex)
     rangemap_remove_node(f->extentmap, &ex->node);
 }
 
-static fs_status add_extents(filesystem fs, range i, rangemap rm)
+static fs_status add_extents(fsfile f, range i, rangemap rm)
 {
+    filesystem fs = f->fs;
     extent ex;
     fs_status fss;
     while (range_span(i) >= MAX_EXTENT_SIZE) {
         range r = {.start = i.start, .end = i.start + MAX_EXTENT_SIZE};
-        fss = create_extent(fs, r, true, &ex);
+        fss = create_extent(fs, f, r, 0, true, &ex);
         if (fss != FS_STATUS_OK)
             return fss;
         assert(rangemap_insert(rm, &ex->node));
         i.start += MAX_EXTENT_SIZE;
     }
     if (range_span(i)) {
-        fss = create_extent(fs, i, true, &ex);
+        fss = create_extent(fs, f, i, 0, true, &ex);
         if (fss != FS_STATUS_OK)
             return fss;
         assert(rangemap_insert(rm, &ex->node));
@@ -687,6 +1031,31 @@ static fs_status add_extents(filesystem fs, range i, rangemap rm)
     return FS_STATUS_OK;
 }
 
+closure_function(1, 1, void, destroy_extent_node,
+                 filesystem, fs,
+                 rmnode, n)
+{
+    destroy_extent(bound(fs), (extent)n);
+}
+
+closure_function(0, 1, void, assert_no_node,
+                 rmnode, n)
+{
+    halt("tfs: temporary rangemap not empty on dealloc\n");
+}
+
+static fs_status add_extents_to_file(fsfile f, rangemap rm)
+{
+    tfs_debug("%s: tuple %p\n", __func__, f->md);
+    rangemap_foreach(rm, node) {
+        rangemap_remove_node(rm, node);
+        fs_status s = add_extent_to_file(f, (extent) node);
+        if (s != FS_STATUS_OK)
+            return s;
+    }
+    return FS_STATUS_OK;
+}
+
 define_closure_function(2, 1, void, uninited_complete,
                         uninited, u, status_handler, complete,
                         status, s)
@@ -816,13 +1185,33 @@ static u64 write_extent(fsfile f, extent ex, sg_list sg, range blocks, merge m)
     return i.end;
 }
 
+/* Number of blocks to allocate for a new extent at blocks.start. This covers the whole run of
+   blocks reserved for writes in flight, so that these end up contiguous regardless of the order in
+   which the writes are issued. For a file growing at its end, the allocation is speculatively
+   extended in proportion to the file size; subsequent appends then extend the extent in place. */
+static u64 fill_gap_alloc_blocks(fsfile f, range blocks, u64 max_blocks)
+{
+    u64 nblocks = range_span(blocks);
+    u64 end = blocks.start;
+    rmnode n = rangemap_lookup(f->delalloc, end);
+    while (n != INVALID_ADDRESS && n->r.start <= end) {
+        end = n->r.end;
+        n = rangemap_next_node(f->delalloc, n);
+    }
+    nblocks = MAX(nblocks, end - blocks.start);
+    if (rangemap_lookup_at_or_next(f->extentmap, blocks.start) == INVALID_ADDRESS)
+        nblocks = MAX(nblocks, blocks.start);
+    return MIN(nblocks, max_blocks);
+}
+
 static fs_status fill_gap(fsfile f, sg_list sg, range blocks, merge m, u64 *edge)
 {
-    blocks = irangel(blocks.start, MIN(MAX_EXTENT_SIZE >> f->fs->blocksize_order,
-                                       range_span(blocks)));
+    u64 max_blocks = MAX_EXTENT_SIZE >> f->fs->blocksize_order;
+    blocks = irangel(blocks.start, MIN(max_blocks, range_span(blocks)));
     tfs_debug("   %s: writing new extent blocks %R\n", __func__, blocks);
     extent ex;
-    fs_status fss = create_extent(f->fs, blocks, false, &ex);
+    fs_status fss = create_extent(f->fs, f, blocks, fill_gap_alloc_blocks(f, blocks, max_blocks),
+                                  false, &ex);
     if (fss != FS_STATUS_OK)
         return fss;
     fss = add_extent_to_file(f, ex);
@@ -840,11 +1229,15 @@ static fs_status update_extent_length(fsfile f, extent ex, u64 new_length)
 {
     if (f->md) {
         assert(ex->md);
-        value v = value_from_u64(f->fs->h, new_length);
+        value v = allocate_integer(new_length);
+        if (v == INVALID_ADDRESS)
+            return FS_STATUS_NOMEM;
         symbol l = sym(length);
         fs_status s = filesystem_write_eav(f->fs, ex->md, l, v);
-        if (s != FS_STATUS_OK)
+        if (s != FS_STATUS_OK) {
+            deallocate_value(v);
             return s;
+        }
         value oldval = get(ex->md, l);
         assert(oldval);
         deallocate_value(oldval);
@@ -860,6 +1253,10 @@ static fs_status update_extent_length(fsfile f, extent ex, u64 new_length)
 
 static fs_status extend(fsfile f, extent ex, sg_list sg, range blocks, merge m, u64 *edge)
 {
+    if (ex->compressed) {
+        *edge = blocks.start;
+        return FS_STATUS_OK;
+    }
     u64 free = ex->allocated - range_span(ex->node.r);
     range r = irangel(ex->node.r.end, free);
     range i = range_intersection(r, blocks);
@@ -967,18 +1364,133 @@ closure_function(2, 1, status, filesystem_check_or_reserve_extent,
     range blocks = range_rshift_pad(q, fs->blocksize_order);
     tfs_debug("%s: file %p range %R blocks %R\n", __func__, f, q, blocks);
 
-    filesystem_lock(fs);
-    status s = extents_range_handler(fs, f, blocks, 0, 0);
-    filesystem_unlock(fs);
-    return s;
+    filesystem_rlock(fs);
+    fsfile_lock(f);
+    u64 count;
+    fs_status fss = fsfile_delalloc_walk(f, blocks, false, &count);
+    if (count > 0) {
+        /* The free space check is not atomic with the reservation, so concurrent reservations
+           against other files may overcommit by a few blocks; this is caught at allocation. */
+        fs_alloc_lock(fs);
+        u64 free = fs_freeblocks(fs);
+        fs_alloc_unlock(fs);
+        if (count > free)
+            fss = FS_STATUS_NOSPACE;
+        else
+            fss = fsfile_delalloc_walk(f, blocks, true, &count);
+    }
+    fsfile_unlock(f);
+    filesystem_runlock(fs);
+    if (fss != FS_STATUS_OK)
+        return timm("result", "unable to reserve storage", "fsstatus", "%d", fss);
+    return STATUS_OK;
 }
 
-closure_function(2, 3, void, filesystem_storage_write,
-                 filesystem, fs, fsfile, f,
-                 sg_list, sg, range, q, status_handler, complete)
+/* Returns a compressed extent that must be replaced with ordinary extents before the blocks can be
+   written; when zeroing (!write), extents entirely within the range are removed instead. */
+static extent fsfile_compressed_extent(fsfile f, range blocks, boolean write)
+{
+    rmnode n = rangemap_lookup_at_or_next(f->extentmap, blocks.start);
+    while (n != INVALID_ADDRESS && n->r.start < blocks.end) {
+        if (((extent)n)->compressed && (write || !range_contains(blocks, n->r)))
+            return (extent)n;
+        n = rangemap_next_node(f->extentmap, n);
+    }
+    return 0;
+}
+
+closure_function(2, 1, void, fsfile_decompress_complete,
+                 zcache_entry, e, sg_list, sg,
+                 status, s)
+{
+    if (!is_ok(s))
+        msg_err("failed to write decompressed extent: %v\n", s);
+    sg_list_release(bound(sg));
+    deallocate_sg_list(bound(sg));
+    zcache_release(bound(e));
+    closure_finish();
+}
+
+/* Replaces a compressed extent with uninited extents, and writes the decompressed data to them;
+   reads from the range are held until the data is on storage. The cache entry is released when the
+   write completes. */
+static fs_status fsfile_decompress_extent(fsfile f, extent ex, zcache_entry e)
+{
+    filesystem fs = f->fs;
+    range r = ex->node.r;
+    fs_status fss = FS_STATUS_NOMEM;
+    rangemap rm = allocate_rangemap(fs->h);
+    if (rm == INVALID_ADDRESS)
+        goto release;
+    sg_list sg = tfs_page_sg(zcache_entry_data(e), range_span(r) << fs->blocksize_order);
+    if (sg == INVALID_ADDRESS)
+        goto dealloc_rm;
+    merge m = allocate_merge(fs->h, closure(fs->h, fsfile_decompress_complete, e, sg));
+    if (m == INVALID_ADDRESS)
+        goto dealloc_sg;
+    fss = add_extents(f, r, rm);
+    if (fss != FS_STATUS_OK) {
+        deallocate_rangemap(rm, stack_closure(destroy_extent_node, fs));
+        apply(apply_merge(m), STATUS_OK);
+        return fss;
+    }
+    remove_extent_from_file(f, ex);
+    destroy_extent(fs, ex);
+    fss = add_extents_to_file(f, rm);
+    deallocate_rangemap(rm, fss == FS_STATUS_OK ? stack_closure(assert_no_node) :
+                        stack_closure(destroy_extent_node, fs));
+    status_handler sh = apply_merge(m);
+    if (fss == FS_STATUS_OK)
+        apply(sh, extents_range_handler(fs, f, r, sg, m));
+    else
+        apply(sh, STATUS_OK);
+    return fss;
+  dealloc_sg:
+    deallocate_sg_list(sg);
+  dealloc_rm:
+    deallocate_rangemap(rm, stack_closure(assert_no_node));
+  release:
+    zcache_release(e);
+    return fss;
+}
+
+static void fsfile_storage_write(filesystem fs, fsfile f, sg_list sg, range q,
+                                 status_handler complete);
+
+closure_function(5, 2, void, fsfile_decompress_loaded,
+                 filesystem, fs, fsfile, f, sg_list, sg, range, q, status_handler, complete,
+                 zcache_entry, e, status, s)
 {
     filesystem fs = bound(fs);
     fsfile f = bound(f);
+    sg_list sg = bound(sg);
+    range q = bound(q);
+    status_handler complete = bound(complete);
+    closure_finish();
+    if (!is_ok(s)) {
+        zcache_release(e);
+        apply(complete, s);
+        return;
+    }
+    filesystem_rlock(fs);
+    fsfile_lock(f);
+    extent ex = zcache_entry_extent(e);
+    fs_status fss = FS_STATUS_OK;
+    if (ex)
+        fss = fsfile_decompress_extent(f, ex, e);
+    else
+        zcache_release(e);  /* already replaced or removed */
+    fsfile_unlock(f);
+    filesystem_runlock(fs);
+    if (fss != FS_STATUS_OK)
+        apply(complete, timm("result", "unable to decompress extent", "fsstatus", "%d", fss));
+    else
+        fsfile_storage_write(fs, f, sg, q, complete);
+}
+
+static void fsfile_storage_write(filesystem fs, fsfile f, sg_list sg, range q,
+                                 status_handler complete)
+{
     assert(range_span(q) > 0);
     assert((q.start & MASK(fs->blocksize_order)) == 0);
     range blocks = range_rshift_pad(q, fs->blocksize_order);
@@ -986,11 +1498,33 @@ closure_function(2, 3, void, filesystem_storage_write,
               f, q, blocks, sg, sg ? sg->count : 0, complete);
     assert(!sg || sg->count >= range_span(blocks) << fs->blocksize_order);
 
+    filesystem_rlock(fs);
+    fsfile_lock(f);
+    extent ex = fsfile_compressed_extent(f, blocks, sg != 0);
+    if (ex) {
+        zcache_entry e = zcache_acquire(fs->zcache, ex);
+        fsfile_unlock(f);
+        filesystem_runlock(fs);
+        zcache_handler h;
+        if (e == INVALID_ADDRESS)
+            goto alloc_fail;
+        h = closure(fs->h, fsfile_decompress_loaded, fs, f, sg, q, complete);
+        if (h == INVALID_ADDRESS) {
+            zcache_release(e);
+            goto alloc_fail;
+        }
+        zcache_wait(e, h);
+        return;
+      alloc_fail:
+        apply(complete, timm("result", "unable to decompress extent",
+                             "fsstatus", "%d", FS_STATUS_NOMEM));
+        return;
+    }
+
     merge m = allocate_merge(fs->h, complete);
     status_handler sh = apply_merge(m);
-
-    filesystem_lock(fs);
     status s = extents_range_handler(fs, f, blocks, sg, m);
+    fsfile_delalloc_release(f, blocks);
     if (s != STATUS_OK)
         goto out;
     if (fsfile_get_length(f) < q.end) {
@@ -1003,10 +1537,18 @@ closure_function(2, 3, void, filesystem_storage_write,
         }
     }
   out:
-    filesystem_unlock(fs);
+    fsfile_unlock(f);
+    filesystem_runlock(fs);
     apply(sh, s);
 }
 
+closure_function(2, 3, void, filesystem_storage_write,
+                 filesystem, fs, fsfile, f,
+                 sg_list, sg, range, q, status_handler, complete)
+{
+    fsfile_storage_write(bound(fs), bound(f), sg, q, complete);
+}
+
 closure_function(3, 1, void, filesystem_write_complete,
                  sg_list, sg, u64, length, io_status_handler, io_complete,
                  status, s)
@@ -1034,6 +1576,140 @@ void filesystem_write_linear(fsfile f, void *src, range q, io_status_handler io_
                                           sg, length, io_complete));
 }
 
+closure_function(5, 1, void, fsfile_write_unit_complete,
+                 heap, h, sg_list, sg, void *, buf, u64, len, status_handler, sh,
+                 status, s)
+{
+    sg_list_release(bound(sg));
+    deallocate_sg_list(bound(sg));
+    if (bound(buf))
+        deallocate(bound(h), bound(buf), bound(len));
+    apply(bound(sh), s);
+    closure_finish();
+}
+
+/* If owned is set, the data buffer (of the padded unit length) is released by this function or
+   once the write completes. */
+static fs_status fsfile_write_unit(fsfile f, range blocks, void *data, boolean owned,
+                                   void *workmem, merge m)
+{
+    filesystem fs = f->fs;
+    u64 length = range_span(blocks) << fs->blocksize_order;
+    void *cdata = allocate(fs->h, length);
+    if (cdata == INVALID_ADDRESS) {
+        if (owned)
+            deallocate(fs->h, data, length);
+        return FS_STATUS_NOMEM;
+    }
+
+    /* store compressed data only if it saves at least one block */
+    u64 clen = lz4_compress(data, length, cdata, length - fs_blocksize(fs), workmem);
+    u64 nblocks = pad(clen, fs_blocksize(fs)) >> fs->blocksize_order;
+    if (clen) {
+        zero(cdata + clen, (nblocks << fs->blocksize_order) - clen);
+        if (owned)
+            deallocate(fs->h, data, length);
+        data = cdata;
+    } else {
+        deallocate(fs->h, cdata, length);
+        if (!owned)
+            cdata = 0;
+        else
+            cdata = data;
+        nblocks = range_span(blocks);
+    }
+    sg_list sg = tfs_page_sg(data, nblocks << fs->blocksize_order);
+    if (sg == INVALID_ADDRESS)
+        goto fail_dealloc;
+    status_handler sh = closure(fs->h, fsfile_write_unit_complete, fs->h, sg, cdata, length,
+                                apply_merge(m));
+    if (sh == INVALID_ADDRESS)
+        goto fail_dealloc_sg;
+    if (!clen) {
+        merge um = allocate_merge(fs->h, sh);
+        status_handler k = apply_merge(um);
+        apply(k, extents_range_handler(fs, f, blocks, sg, um));
+        return FS_STATUS_OK;
+    }
+
+    fs_status fss = FS_STATUS_NOSPACE;
+    if (!filesystem_reserve_log_space(fs, &fs->next_extend_log_offset, 0, 0) ||
+        !filesystem_reserve_log_space(fs, &fs->next_new_log_offset, 0, 0))
+        goto fail;
+    u64 start_block = fsfile_allocate_storage(fs, f, nblocks);
+    if (start_block == INVALID_PHYSICAL)
+        goto fail;
+    range storage_blocks = irangel(start_block, nblocks);
+    extent ex = allocate_extent(fs->h, blocks, storage_blocks);
+    if (ex == INVALID_ADDRESS) {
+        filesystem_free_storage(fs, storage_blocks);
+        fss = FS_STATUS_NOMEM;
+        goto fail;
+    }
+    ex->md = 0;
+    ex->compressed = clen;
+    fss = add_extent_to_file(f, ex);
+    if (fss != FS_STATUS_OK) {
+        destroy_extent(fs, ex);
+        goto fail;
+    }
+    filesystem_storage_op(fs, sg, storage_blocks, true, sh);
+    return FS_STATUS_OK;
+  fail:
+    apply(sh, STATUS_OK);
+    return fss;
+  fail_dealloc_sg:
+    deallocate_sg_list(sg);
+  fail_dealloc:
+    if (cdata)
+        deallocate(fs->h, cdata, length);
+    return FS_STATUS_NOMEM;
+}
+
+/* Writes the contents of a file being created, in units of TFS_COMPRESS_UNIT bytes; units that
+   compress to fewer blocks are stored in compressed extents. The source data must remain valid
+   until the completion is applied. */
+void filesystem_write_compressed(fsfile f, void *src, u64 length, status_handler completion)
+{
+    filesystem fs = f->fs;
+    fs_status fss = FS_STATUS_NOMEM;
+    merge m = allocate_merge(fs->h, completion);
+    if (m == INVALID_ADDRESS) {
+        apply(completion, timm("result", "failed to allocate merge", "fsstatus", "%d", fss));
+        return;
+    }
+    status_handler sh = apply_merge(m);
+    void *workmem = allocate(fs->h, LZ4_WORKMEM_SIZE);
+    if (workmem == INVALID_ADDRESS)
+        goto out;
+    filesystem_lock(fs);
+    fss = FS_STATUS_OK;
+    for (u64 offset = 0; (offset < length) && (fss == FS_STATUS_OK); offset += TFS_COMPRESS_UNIT) {
+        u64 len = MIN(TFS_COMPRESS_UNIT, length - offset);
+        range blocks = range_rshift_pad(irangel(offset, len), fs->blocksize_order);
+        if (len & MASK(fs->blocksize_order)) {
+            /* pad the tail of the file to a block boundary */
+            u64 padded = range_span(blocks) << fs->blocksize_order;
+            void *unit = allocate_zero(fs->h, padded);
+            if (unit == INVALID_ADDRESS) {
+                fss = FS_STATUS_NOMEM;
+                break;
+            }
+            runtime_memcpy(unit, src + offset, len);
+            fss = fsfile_write_unit(f, blocks, unit, true, workmem, m);
+        } else {
+            fss = fsfile_write_unit(f, blocks, src + offset, false, workmem, m);
+        }
+    }
+    if (fss == FS_STATUS_OK)
+        fss = filesystem_truncate_locked(fs, f, length);
+    filesystem_unlock(fs);
+    deallocate(fs->h, workmem, LZ4_WORKMEM_SIZE);
+  out:
+    apply(sh, fss == FS_STATUS_OK ? STATUS_OK :
+          timm("result", "failed to write file", "fsstatus", "%d", fss));
+}
+
 fs_status filesystem_truncate(filesystem fs, fsfile f, u64 len)
 {
     filesystem_lock(fs);
@@ -1052,7 +1728,7 @@ closure_function(3, 1, void, log_flush_completed,
         bound(sync_complete) = true;
         pagecache_sync_volume(bound(fs)->pv, (status_handler)closure_self());
     } else {
-        if (is_ok(s)) {
+        if (is_ok(s) && !bound(fs)->fua) {
             struct storage_req req = {
                 .op = STORAGE_OP_FLUSH,
                 .blocks = irange(0, 0),
@@ -1066,13 +1742,157 @@ closure_function(3, 1, void, log_flush_completed,
     }
 }
 
-void filesystem_flush(filesystem fs, status_handler completion)
+/* Group commit
+
+   Sync requests are not serviced individually. Requests arriving while a
+   commit is in progress are gathered and covered by a single log flush,
+   volume sync and device flush once that commit completes. If the last
+   commit covered more than one request, a new commit is further delayed by a
+   window of up to half the commit latency, so that concurrent syncing
+   threads can join it; the window decays to zero for a lone syncing thread,
+   which thus sees no added latency. */
+
+static void fs_sync_start(filesystem fs)
 {
+    fs_sync_lock(fs);
+    fs->sync_scheduled = false;
+    if (fs->sync_in_progress || buffer_length(fs->sync_waiters) == 0) {
+        fs_sync_unlock(fs);
+        return;
+    }
+    buffer b = fs->sync_batch;
+    fs->sync_batch = fs->sync_waiters;
+    fs->sync_waiters = b;
+    fs->sync_in_progress = true;
+    fs->sync_batch_time = now(CLOCK_ID_MONOTONIC_RAW);
+    fs->sync_stats.batches++;
+    fs_sync_unlock(fs);
+    tfs_debug("%s: fs %p, %ld waiters\n", __func__, fs,
+              buffer_length(fs->sync_batch) / sizeof(struct fs_sync_waiter));
+    status_handler sh = closure(fs->h, log_flush_completed, fs, fs->sync_batch_sh, false);
+    if (sh == INVALID_ADDRESS) {
+        apply(fs->sync_batch_sh,
+              timm("result", "failed to allocate closure", "fsstatus", "%d", FS_STATUS_NOMEM));
+        return;
+    }
     filesystem_lock(fs);
-    log_flush(fs->tl, closure(fs->h, log_flush_completed, fs, completion, false));
+    log_flush(fs->tl, sh);
     filesystem_unlock(fs);
 }
 
+define_closure_function(1, 0, void, fs_sync_batch_start,
+                        filesystem, fs)
+{
+    fs_sync_start(bound(fs));
+}
+
+#ifdef KERNEL
+define_closure_function(1, 2, void, fs_sync_window_expired,
+                        filesystem, fs,
+                        u64, expiry, u64, overruns)
+{
+    if (overruns != timer_disabled)
+        fs_sync_start(bound(fs));
+}
+#endif
+
+/* Called with sync lock held; returns true if the batch must be started by the caller. */
+static boolean fs_sync_schedule(filesystem fs, boolean from_completion)
+{
+    if (fs->sync_in_progress || fs->sync_scheduled)
+        return false;
+#ifdef KERNEL
+    if (fs->sync_window) {
+        fs->sync_scheduled = true;
+        register_timer(kernel_timers, &fs->sync_timer, CLOCK_ID_MONOTONIC_RAW,
+                       fs->sync_window, false, 0, (timer_handler)&fs->sync_window_expired);
+        return false;
+    }
+
+    /* The completion of a commit may run with the filesystem locked, so the next
+       one is started from the runqueue. */
+    if (from_completion && enqueue(runqueue, &fs->sync_batch_start)) {
+        fs->sync_scheduled = true;
+        return false;
+    }
+#endif
+    return true;
+}
+
+define_closure_function(1, 1, void, fs_sync_batch_complete,
+                        filesystem, fs,
+                        status, s)
+{
+    filesystem fs = bound(fs);
+    struct fs_sync_stats *st = &fs->sync_stats;
+    timestamp t = now(CLOCK_ID_MONOTONIC_RAW);
+    fs_sync_lock(fs);
+    u64 n = buffer_length(fs->sync_batch) / sizeof(struct fs_sync_waiter);
+    tfs_debug("%s: fs %p, %ld waiters, status %v\n", __func__, fs, n, s);
+    for (u64 i = 0; i < n; i++) {
+        fs_sync_waiter w = buffer_ref(fs->sync_batch, i * sizeof(struct fs_sync_waiter));
+        timestamp latency = t - w->t;
+        st->latency_total += latency;
+        if (latency > st->latency_max)
+            st->latency_max = latency;
+#ifdef KERNEL
+        async_apply_status_handler(w->sh, s);
+#else
+        apply(w->sh, s);
+#endif
+    }
+    buffer_clear(fs->sync_batch);
+    st->completed += n;
+    st->rate_requests += n;
+    if (t - st->rate_start >= seconds(1)) {
+        st->rate = st->rate_requests * seconds(1) / (t - st->rate_start);
+        st->rate_requests = 0;
+        st->rate_start = t;
+    }
+#ifdef KERNEL
+    timestamp latency = t - fs->sync_batch_time;
+    if (n > 1)
+        fs->sync_window = MIN(latency / 2, microseconds(TFS_SYNC_WINDOW_MAX_US));
+    else
+        fs->sync_window /= 2;
+#endif
+    fs->sync_in_progress = false;
+    boolean start = (buffer_length(fs->sync_waiters) > 0) && fs_sync_schedule(fs, true);
+    fs_sync_unlock(fs);
+    if (start)
+        fs_sync_start(fs);
+}
+
+void filesystem_flush(filesystem fs, status_handler completion)
+{
+    struct fs_sync_waiter w = {
+        .sh = completion,
+        .t = now(CLOCK_ID_MONOTONIC_RAW),
+    };
+    fs_sync_lock(fs);
+    if (!buffer_append(fs->sync_waiters, &w, sizeof(w))) {
+        fs_sync_unlock(fs);
+        apply(completion, timm("result", "failed to queue sync request",
+                               "fsstatus", "%d", FS_STATUS_NOMEM));
+        return;
+    }
+    fs->sync_stats.requests++;
+    boolean start = fs_sync_schedule(fs, false);
+    fs_sync_unlock(fs);
+    if (start)
+        fs_sync_start(fs);
+}
+
+void filesystem_set_fua(filesystem fs, boolean fua)
+{
+    fs->fua = fua;
+}
+
+void filesystem_set_compressed_cache(filesystem fs, u64 size)
+{
+    zcache_set_size(fs->zcache, size);
+}
+
 void filesystem_reserve(filesystem fs)
 {
     refcount_reserve(&fs->refcount);
@@ -1113,31 +1933,6 @@ closure_function(2, 1, void, filesystem_op_complete,
     closure_finish();
 }
 
-closure_function(1, 1, void, destroy_extent_node,
-                 filesystem, fs,
-                 rmnode, n)
-{
-    destroy_extent(bound(fs), (extent)n);
-}
-
-closure_function(0, 1, void, assert_no_node,
-                 rmnode, n)
-{
-    halt("tfs: temporary rangemap not empty on dealloc\n");
-}
-
-static fs_status add_extents_to_file(fsfile f, rangemap rm)
-{
-    tfs_debug("%s: tuple %p\n", __func__, f->md);
-    rangemap_foreach(rm, node) {
-        rangemap_remove_node(rm, node);
-        fs_status s = add_extent_to_file(f, (extent) node);
-        if (s != FS_STATUS_OK)
-            return s;
-    }
-    return FS_STATUS_OK;
-}
-
 /* no longer async, but keep completion to match dealloc... */
 void filesystem_alloc(fsfile f, long offset, long len,
                       boolean keep_size, fs_status_handler completion)
@@ -1159,7 +1954,7 @@ void filesystem_alloc(fsfile f, long offset, long len,
         u64 edge = curr->r.start;
         range i = range_intersection(irange(lastedge, edge), blocks);
         if (range_span(i)) {
-            status = add_extents(fs, i, new_rm);
+            status = add_extents(f, i, new_rm);
             if (status != FS_STATUS_OK)
                 goto done;
         }
@@ -1170,7 +1965,7 @@ void filesystem_alloc(fsfile f, long offset, long len,
     /* check for a gap between the last node and blocks.end */
     range i = range_intersection(irange(lastedge, blocks.end), blocks);
     if (range_span(i)) {
-        status = add_extents(fs, i, new_rm);
+        status = add_extents(f, i, new_rm);
         if (status != FS_STATUS_OK)
             goto done;
     }
@@ -1178,6 +1973,7 @@ void filesystem_alloc(fsfile f, long offset, long len,
     status = add_extents_to_file(f, new_rm);
     if (status != FS_STATUS_OK)
         goto done;
+    fsfile_delalloc_release(f, blocks);
     u64 end = offset + len;
     if (!keep_size && (end > fsfile_get_length(f))) {
         status = filesystem_truncate_locked(fs, f, end);
@@ -1207,8 +2003,8 @@ void filesystem_dealloc(fsfile f, long offset, long len,
 
 static tuple fs_new_entry(filesystem fs)
 {
-    tuple t = allocate_tuple();
-    assert(t);
+    tuple t = allocate_schema_tuple(&tfs_inode_schema);
+    assert(t != INVALID_ADDRESS);
     timestamp tim = now(CLOCK_ID_REALTIME);
     filesystem_set_atime(fs, t, tim);
     filesystem_set_mtime(fs, t, tim);
@@ -1233,6 +2029,24 @@ static void cleanup_directory(tuple n)
         iterate(c, stack_closure(cleanup_directory_each));
 }
 
+static void fs_drop_dir_index(filesystem fs, tuple dir)
+{
+    dir_index di = table_find(fs->dir_indexes, dir);
+    if (di) {
+        table_set(fs->dir_indexes, dir, 0);
+        dir_index_destroy(di);
+    }
+}
+
+static void fs_update_dir_index(filesystem fs, tuple dir, symbol name_sym, tuple child)
+{
+    dir_index di = table_find(fs->dir_indexes, dir);
+
+    /* if the index cannot be updated, it is rebuilt on next access */
+    if (di && !dir_index_set(di, name_sym, child))
+        fs_drop_dir_index(fs, dir);
+}
+
 static fs_status fs_set_dir_entry(filesystem fs, tuple parent, symbol name_sym,
                                   tuple child)
 {
@@ -1244,6 +2058,7 @@ static fs_status fs_set_dir_entry(filesystem fs, tuple parent, symbol name_sym,
     fs_status s = filesystem_write_eav(fs, c, name_sym, child);
     if (s == FS_STATUS_OK) {
         set(c, name_sym, child);
+        fs_update_dir_index(fs, parent, name_sym, child);
         filesystem_update_mtime(fs, parent);
     }
     if (child) {
@@ -1278,6 +2093,7 @@ static void file_unlink(filesystem fs, tuple t)
     if (f) {
         f->md = 0;
     }
+    fs_drop_dir_index(fs, t);
     fs_notify_release(t, false);
 
     /* If a tuple is not present in the filesystem log dictionary, it can (and should) be destroyed
@@ -1309,6 +2125,7 @@ fs_status do_mkentry(filesystem fs, tuple parent, const char *name, tuple entry,
 
     if (s == FS_STATUS_OK) {
         set(c, name_sym, entry);
+        fs_update_dir_index(fs, parent, name_sym, entry);
         table_set(fs->files, entry, INVALID_ADDRESS);
         fs_notify_create(entry, parent, name_sym);
     }
@@ -1335,7 +2152,7 @@ fs_status filesystem_mkentry(filesystem fs, tuple cwd, const char *fp, tuple ent
     /* find the folder we need to mkentry in */
     while ((token = runtime_strtok_r(rest, "/", &rest))) {
         boolean final = *rest == '\0';
-        tuple t = lookup(parent, sym_this(token));
+        tuple t = fs_lookup_child(fs, parent, alloca_wrap_buffer(token, runtime_strlen(token)));
         if (!t) {
             if (!final) {
                 if (recursive) {
@@ -1425,6 +2242,7 @@ fsfile allocate_fsfile(filesystem fs, tuple md);
 static void deallocate_fsfile(filesystem fs, fsfile f, rmnode_handler extent_destructor)
 {
     deallocate_rangemap(f->extentmap, extent_destructor);
+    deallocate_rangemap(f->delalloc, stack_closure(fsfile_delalloc_free, f));
     pagecache_deallocate_node(f->cache_node);
     deallocate(fs->h, f, sizeof(*f));
 }
@@ -1826,6 +2644,10 @@ fsfile allocate_fsfile(filesystem fs, tuple md)
         return INVALID_ADDRESS;
     }
     f->extentmap = allocate_rangemap(fs->h);
+    f->delalloc = allocate_rangemap(fs->h);
+    fsfile_lock_init(f);
+    f->alloc_goal = 0;
+    f->alloc_group = filesystem_current_alloc_group(fs);
     f->fs = fs;
     f->md = md;
     f->length = 0;
@@ -1885,16 +2707,22 @@ boolean filesystem_reserve_log_space(filesystem fs, u64 *next_offset, u64 *offse
 {
     if (size == 0)
         size = filesystem_log_blocks(fs);
+    boolean result = true;
+    fs_alloc_lock(fs);
     if (*next_offset == INVALID_PHYSICAL) {
-        *next_offset = filesystem_allocate_storage(fs, size);
-        if (*next_offset == INVALID_PHYSICAL)
-            return false;
+        *next_offset = fs_storage_alloc(fs, size);
+        if (*next_offset == INVALID_PHYSICAL) {
+            result = false;
+            goto out;
+        }
     }
     if (offset) {
         *offset = *next_offset;
-        *next_offset = filesystem_allocate_storage(fs, size);
+        *next_offset = fs_storage_alloc(fs, size);
     }
-    return true;
+  out:
+    fs_alloc_unlock(fs);
+    return result;
 }
 
 void create_filesystem(heap h,
@@ -1911,7 +2739,12 @@ void create_filesystem(heap h,
     fs->h = h;
     if (!ignore_io_status)
         ignore_io_status = closure(h, ignore_io);
+    if (!tfs_inode_schema.count)
+        tfs_init_schemas();
     fs->files = allocate_table(h, identity_key, pointer_equal);
+    fs->dir_indexes = allocate_table(h, identity_key, pointer_equal);
+    fs->zcache = zcache_new(fs, TFS_COMPRESSED_CACHE_SIZE);
+    assert(fs->zcache != INVALID_ADDRESS);
     fs->zero_page = pagecache_get_zero_page();
     assert(fs->zero_page);
     fs->req_handler = req_handler;
@@ -1925,13 +2758,39 @@ void create_filesystem(heap h,
 #ifndef TFS_READ_ONLY
     fs->storage = create_id_heap(h, h, 0, size >> fs->blocksize_order, 1, false);
     assert(fs->storage != INVALID_ADDRESS);
+    fs_alloc_lock_init(fs);
+    fs->delalloc_blocks = 0;
+    u64 group_blocks = TFS_ALLOC_GROUP_MIN_SIZE >> fs->blocksize_order;
+    fs->alloc_groups = MAX(1, MIN(fs->storage->total / group_blocks, TFS_ALLOC_GROUPS_MAX));
+    fs->alloc_group_blocks = fs->storage->total / fs->alloc_groups;
+    fs->alloc_group_next = allocate(h, fs->alloc_groups * sizeof(u64));
+    assert(fs->alloc_group_next != INVALID_ADDRESS);
+    for (int i = 0; i < fs->alloc_groups; i++)
+        fs->alloc_group_next[i] = i * fs->alloc_group_blocks;
+    zero(&fs->frag_stats, sizeof(fs->frag_stats));
     fs->temp_log = 0;
     init_refcount(&fs->refcount, 1, init_closure(&fs->sync, fs_sync, fs));
     fs->sync_complete = 0;
     filesystem_lock_init(fs);
+    fs->sync_waiters = allocate_buffer(h, 4 * sizeof(struct fs_sync_waiter));
+    assert(fs->sync_waiters != INVALID_ADDRESS);
+    fs->sync_batch = allocate_buffer(h, 4 * sizeof(struct fs_sync_waiter));
+    assert(fs->sync_batch != INVALID_ADDRESS);
+    fs->sync_in_progress = fs->sync_scheduled = false;
+    fs->sync_window = 0;
+    zero(&fs->sync_stats, sizeof(fs->sync_stats));
+    fs->sync_batch_sh = init_closure(&fs->sync_batch_complete, fs_sync_batch_complete, fs);
+    init_closure(&fs->sync_batch_start, fs_sync_batch_start, fs);
+    fs_sync_lock_init(fs);
+#ifdef KERNEL
+    init_timer(&fs->sync_timer);
+    init_closure(&fs->sync_window_expired, fs_sync_window_expired, fs);
+#endif
 #else
     fs->storage = 0;
+    fs->alloc_groups = 1;
 #endif
+    fs->fua = false;
     fs->ro = ro;
     if (label) {
         int label_len = runtime_strlen(label);
@@ -1959,16 +2818,29 @@ closure_function(1, 1, void, dealloc_extent_node,
 void destroy_filesystem(filesystem fs)
 {
     tfs_debug("%s %p\n", __func__, fs);
+#ifdef KERNEL
+    /* a sync window may still be pending if the final flush found nothing to commit */
+    remove_timer(kernel_timers, &fs->sync_timer, 0);
+#endif
     log_destroy(fs->tl);
     table_foreach(fs->files, k, v) {
         fs_notify_release(k, true);
         if (v != INVALID_ADDRESS)
             deallocate_fsfile(fs, v, stack_closure(dealloc_extent_node, fs));
     }
+    table_foreach(fs->dir_indexes, k, v) {
+        (void)k;
+        dir_index_destroy(v);
+    }
+    deallocate_table(fs->dir_indexes);
+    zcache_destroy(fs->zcache);
     if (fs->root)
         destruct_dir_entry(fs->root);
     pagecache_dealloc_volume(fs->pv);
     deallocate_table(fs->files);
+    deallocate_buffer(fs->sync_waiters);
+    deallocate_buffer(fs->sync_batch);
+    deallocate(fs->h, fs->alloc_group_next, fs->alloc_groups * sizeof(u64));
     destroy_id_heap(fs->storage);
     deallocate(fs->h, fs, sizeof(*fs));
 }
@@ -1997,12 +2869,13 @@ u64 fs_totalblocks(filesystem fs)
 
 u64 fs_usedblocks(filesystem fs)
 {
-    return fs->storage->allocated;
+    return fs->storage->allocated + fs->delalloc_blocks;
 }
 
 u64 fs_freeblocks(filesystem fs)
 {
-    return heap_free((heap)fs->storage);
+    u64 free = heap_free((heap)fs->storage);
+    return free > fs->delalloc_blocks ? free - fs->delalloc_blocks : 0;
 }
 
 BSS_RO_AFTER_INIT static struct {
@@ -2019,10 +2892,10 @@ void fs_set_path_helper(filesystem (*get_root_fs)(), inode (*get_mountpoint)(tup
 
 /* Requires that a mount point does not change while at least one of its two filesystems (parent and
  * child) is locked. */
-static tuple lookup_follow(filesystem *fs, tuple t, symbol a, tuple *p)
+static tuple lookup_follow(filesystem *fs, tuple t, buffer a, tuple *p)
 {
     *p = t;
-    t = lookup(t, a);
+    t = fs_lookup_child(*fs, t, a);
     if (!t)
         return t;
     if (fs_path_helper.get_mountpoint) {
@@ -2038,7 +2911,7 @@ static tuple lookup_follow(filesystem *fs, tuple t, symbol a, tuple *p)
                 t = child_fs->root;
                 *fs = child_fs;
             }
-        } else if ((t == *p) && (a == sym_this("..")) &&
+        } else if ((t == *p) && buffer_compare_with_cstring(a, "..") &&
                    (t != filesystem_getroot(fs_path_helper.get_root_fs()))) {
             /* t is the root of its filesystem: look for a mount point for this
              * filesystem, and if found look up the parent of the mount directory.
@@ -2055,7 +2928,7 @@ static tuple lookup_follow(filesystem *fs, tuple t, symbol a, tuple *p)
             *fs = parent_fs;
             if (mp) {
                 *p = mp;
-                t = lookup(mp, a);
+                t = fs_lookup_child(parent_fs, mp, a);
             } else {
                 /* The mount directory in the parent filesystem has disappeared before the
                  * filesystem could be locked. */
@@ -2101,7 +2974,7 @@ int filesystem_resolve_cstring(filesystem *fs, tuple cwd, const char *f, tuple *
     while ((y = *f)) {
         if (y == '/') {
             if (buffer_length(a)) {
-                t = lookup_follow(fs, t, intern(a), &p);
+                t = lookup_follow(fs, t, a, &p);
                 if (!t) {
                     err = FS_STATUS_NOENT;
                     goto done;
@@ -2131,7 +3004,7 @@ int filesystem_resolve_cstring(filesystem *fs, tuple cwd, const char *f, tuple *
     if (buffer_length(a)) {
         if (!children(t))
             return FS_STATUS_NOTDIR;
-        t = lookup_follow(fs, t, intern(a), &p);
+        t = lookup_follow(fs, t, a, &p);
     }
     err = FS_STATUS_NOENT;
 done:
@@ -2201,6 +3074,206 @@ int filesystem_follow_links(filesystem *fs, tuple link, tuple parent,
 
 #ifdef KERNEL
 
+closure_function(2, 0, value, fs_get_syncs,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(fs)->sync_stats.requests);
+}
+
+closure_function(2, 0, value, fs_get_sync_commits,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(fs)->sync_stats.batches);
+}
+
+closure_function(2, 0, value, fs_get_syncs_per_sec,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(fs)->sync_stats.rate);
+}
+
+closure_function(2, 0, value, fs_get_sync_latency_avg_us,
+                 filesystem, fs, value, v)
+{
+    struct fs_sync_stats *st = &bound(fs)->sync_stats;
+    return value_rewrite_u64(bound(v), st->completed ?
+                             usec_from_timestamp(st->latency_total / st->completed) : 0);
+}
+
+closure_function(2, 0, value, fs_get_sync_latency_max_us,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), usec_from_timestamp(bound(fs)->sync_stats.latency_max));
+}
+
+closure_function(1, 1, void, fs_frag_free_range,
+                 struct fs_frag_stats *, st,
+                 range, r)
+{
+    struct fs_frag_stats *st = bound(st);
+    u64 len = range_span(r);
+    st->free_extents++;
+    st->free_extent_max = MAX(st->free_extent_max, len);
+    st->free_extent_hist[MIN(msb(len), FS_FREE_EXTENT_ORDERS - 1)]++;
+}
+
+/* Fragmentation statistics are gathered on demand, by walking all files and
+   the free space bitmap, and are cached for a second. */
+static struct fs_frag_stats *fs_get_frag_stats(filesystem fs)
+{
+    struct fs_frag_stats *st = &fs->frag_stats;
+    timestamp t = now(CLOCK_ID_MONOTONIC_RAW);
+    if (st->updated && t - st->updated < seconds(1))
+        return st;
+    filesystem_lock(fs);
+    zero(st, sizeof(*st));
+    st->updated = t;
+    table_foreach(fs->files, k, v) {
+        (void)k;
+        if (v == INVALID_ADDRESS)
+            continue;
+        u64 extents = 0;
+        rangemap_foreach(((fsfile)v)->extentmap, n)
+            extents++;
+        if (extents) {
+            st->files++;
+            st->extents += extents;
+            st->extents_max = MAX(st->extents_max, extents);
+        }
+    }
+    id_heap_free_range_foreach(fs->storage, stack_closure(fs_frag_free_range, st));
+    filesystem_unlock(fs);
+    return st;
+}
+
+closure_function(2, 0, value, fs_get_extents_per_file,
+                 filesystem, fs, value, v)
+{
+    struct fs_frag_stats *st = fs_get_frag_stats(bound(fs));
+    return value_rewrite_u64(bound(v), st->files ? st->extents / st->files : 0);
+}
+
+closure_function(2, 0, value, fs_get_extents_per_file_max,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), fs_get_frag_stats(bound(fs))->extents_max);
+}
+
+closure_function(2, 0, value, fs_get_free_extents,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), fs_get_frag_stats(bound(fs))->free_extents);
+}
+
+closure_function(2, 0, value, fs_get_free_extent_max,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), fs_get_frag_stats(bound(fs))->free_extent_max);
+}
+
+closure_function(2, 0, value, fs_get_delalloc_blocks,
+                 filesystem, fs, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(fs)->delalloc_blocks);
+}
+
+closure_function(3, 0, value, fs_get_free_extent_hist,
+                 filesystem, fs, int, order, value, v)
+{
+    return value_rewrite_u64(bound(v), fs_get_frag_stats(bound(fs))->free_extent_hist[bound(order)]);
+}
+
+closure_function(2, 0, value, fs_get_compressed_cache_hits,
+                 filesystem, fs, value, v)
+{
+    u64 size;
+    return value_rewrite_u64(bound(v), zcache_get_stats(bound(fs)->zcache, &size)->hits);
+}
+
+closure_function(2, 0, value, fs_get_compressed_cache_misses,
+                 filesystem, fs, value, v)
+{
+    u64 size;
+    return value_rewrite_u64(bound(v), zcache_get_stats(bound(fs)->zcache, &size)->misses);
+}
+
+closure_function(2, 0, value, fs_get_compressed_cache_evictions,
+                 filesystem, fs, value, v)
+{
+    u64 size;
+    return value_rewrite_u64(bound(v), zcache_get_stats(bound(fs)->zcache, &size)->evictions);
+}
+
+closure_function(2, 0, value, fs_get_compressed_cache_size,
+                 filesystem, fs, value, v)
+{
+    u64 size;
+    zcache_get_stats(bound(fs)->zcache, &size);
+    return value_rewrite_u64(bound(v), size);
+}
+
+closure_function(2, 0, value, fs_get_compressed_read_bytes,
+                 filesystem, fs, value, v)
+{
+    u64 size;
+    return value_rewrite_u64(bound(v), zcache_get_stats(bound(fs)->zcache, &size)->read_bytes);
+}
+
+closure_function(2, 0, value, fs_get_decompressed_bytes,
+                 filesystem, fs, value, v)
+{
+    u64 size;
+    return value_rewrite_u64(bound(v),
+                             zcache_get_stats(bound(fs)->zcache, &size)->decompressed_bytes);
+}
+
+#define register_fs_stat(fs, n, t, name)                                \
+    v = value_from_u64(fs->h, 0);                                       \
+    s = sym(name);                                                      \
+    set(t, s, v);                                                       \
+    tuple_notifier_register_get_notify(n, s, closure(fs->h, fs_get_ ##name, fs, v));
+
+value filesystem_management(filesystem fs)
+{
+    value v;
+    symbol s;
+    tuple t = timm("type", "tfs");
+    assert(t != INVALID_ADDRESS);
+    tuple_notifier n = tuple_notifier_wrap(t);
+    assert(n != INVALID_ADDRESS);
+    register_fs_stat(fs, n, t, syncs);
+    register_fs_stat(fs, n, t, sync_commits);
+    register_fs_stat(fs, n, t, syncs_per_sec);
+    register_fs_stat(fs, n, t, sync_latency_avg_us);
+    register_fs_stat(fs, n, t, sync_latency_max_us);
+    register_fs_stat(fs, n, t, extents_per_file);
+    register_fs_stat(fs, n, t, extents_per_file_max);
+    register_fs_stat(fs, n, t, free_extents);
+    register_fs_stat(fs, n, t, free_extent_max);
+    register_fs_stat(fs, n, t, delalloc_blocks);
+    register_fs_stat(fs, n, t, compressed_cache_hits);
+    register_fs_stat(fs, n, t, compressed_cache_misses);
+    register_fs_stat(fs, n, t, compressed_cache_evictions);
+    register_fs_stat(fs, n, t, compressed_cache_size);
+    register_fs_stat(fs, n, t, compressed_read_bytes);
+    register_fs_stat(fs, n, t, decompressed_bytes);
+
+    /* free extent counts keyed by minimum length in blocks */
+    tuple hist = allocate_tuple();
+    assert(hist != INVALID_ADDRESS);
+    tuple_notifier hn = tuple_notifier_wrap(hist);
+    assert(hn != INVALID_ADDRESS);
+    for (int order = 0; order < FS_FREE_EXTENT_ORDERS; order++) {
+        v = value_from_u64(fs->h, 0);
+        s = intern_u64(U64_FROM_BIT(order));
+        set(hist, s, v);
+        tuple_notifier_register_get_notify(hn, s, closure(fs->h, fs_get_free_extent_hist,
+                                                          fs, order, v));
+    }
+    set(t, sym(free_extent_hist), hn);
+    return n;
+}
+
 fs_status filesystem_mk_socket(filesystem *fs, inode cwd, const char *path, void *s, inode *n)
 {
     tuple cwd_t = filesystem_get_meta(*fs, cwd);
@@ -2292,9 +3365,21 @@ fs_status filesystem_clear_socket(filesystem fs, inode n)
     return fss;
 }
 
+/* locks are taken in address order to avoid deadlocks */
+static void filesystem_lock_2(filesystem fs1, filesystem fs2)
+{
+    if (fs1 > fs2) {
+        filesystem tmp = fs1;
+        fs1 = fs2;
+        fs2 = tmp;
+    }
+    filesystem_lock(fs1);
+    filesystem_lock(fs2);
+}
+
 fs_status filesystem_mount(filesystem parent, inode mount_dir, filesystem child)
 {
-    spin_lock_2(&parent->lock, &child->lock);
+    filesystem_lock_2(parent, child);
     tuple mount_dir_t = fs_tuple_from_inode(parent, mount_dir);
     fs_status fss;
     if (!mount_dir_t) {
@@ -2325,7 +3410,7 @@ fs_status filesystem_mount(filesystem parent, inode mount_dir, filesystem child)
 
 void filesystem_unmount(filesystem parent, inode mount_dir, filesystem child, thunk complete)
 {
-    spin_lock_2(&parent->lock, &child->lock);
+    filesystem_lock_2(parent, child);
     tuple mount_dir_t = fs_tuple_from_inode(parent, mount_dir);
     if (mount_dir_t) {
         tuple mount = get_tuple(mount_dir_t, sym(mount));
@@ -2406,7 +3491,7 @@ int file_get_path(filesystem fs, inode ino, char *buf, u64 len)
     int cur_len = 1;
     tuple p;
     do {
-        n = lookup_follow(&fs, n, sym_this(".."), &p);
+        n = lookup_follow(&fs, n, alloca_wrap_buffer("..", 2), &p);
         assert(n);
         if (n == p) {   /* this is the root directory */
             if (cur_len == 1) {
@@ -41,8 +41,14 @@ void filesystem_write_sg(fsfile f, sg_list sg, range q, status_handler completio
 /* deprecate these if we can */
 void filesystem_read_linear(fsfile f, void *dest, range q, io_status_handler completion);
 void filesystem_write_linear(fsfile f, void *src, range q, io_status_handler completion);
+void filesystem_write_compressed(fsfile f, void *src, u64 length, status_handler completion);
 
 void filesystem_flush(filesystem fs, status_handler completion);
+void filesystem_storage_poll(filesystem fs);
+void filesystem_storage_plug(filesystem fs);
+void filesystem_storage_unplug(filesystem fs);
+void filesystem_set_fua(filesystem fs, boolean fua);
+void filesystem_set_compressed_cache(filesystem fs, u64 size);
 
 void filesystem_reserve(filesystem fs);
 void filesystem_release(filesystem fs);
@@ -124,6 +130,12 @@ fs_status filesystem_mk_socket(filesystem *fs, inode cwd, const char *path, void
 fs_status filesystem_get_socket(filesystem *fs, inode cwd, const char *path, tuple *n, void **s);
 fs_status filesystem_clear_socket(filesystem fs, inode n);
 
+/* Directory entries are listed in a stable order; the cookie passed along with each entry can be
+   used to resume the listing after that entry. */
+typedef closure_type(dir_entry_handler, boolean, symbol /* name */, tuple /* entry */,
+                     u64 /* next cookie */);
+fs_status filesystem_iterate_dir(filesystem fs, tuple dir, u64 cookie, dir_entry_handler h);
+
 fs_status filesystem_mount(filesystem parent, inode mount_dir, filesystem child);
 void filesystem_unmount(filesystem parent, inode mount_dir, filesystem child, thunk complete);
 
@@ -199,6 +211,9 @@ int file_get_path(filesystem fs, inode ino, char *buf, u64 len);
 
 #ifdef KERNEL
 
+/* sync statistics */
+value filesystem_management(filesystem fs);
+
 /* Functions called by TFS code to notify filesystem operations */
 void fs_notify_create(tuple t, tuple parent, symbol name);
 void fs_notify_move(tuple t, tuple old_parent, symbol old_name, tuple new_parent, symbol new_name);
@@ -7,19 +7,61 @@
 #include <storage.h>
 #include <tfs.h>
 
-#define TFS_VERSION 0x00000004
+/* Version 5 added extents holding lz4-compressed data, which older versions would read as file
+   contents. Images of older versions, down to TFS_VERSION_MIN, can still be mounted. */
+#define TFS_VERSION     0x00000005
+#define TFS_VERSION_MIN 0x00000004
+
+/* Locking
+
+   The filesystem lock is held exclusively for namespace and metadata
+   operations, log flushes and compaction. File data operations (storage
+   reads and writes and space reservations) hold it shared, along with the
+   lock of the file; file state (extents, delayed allocations and the file
+   metadata tuple) is thus protected by either the exclusive filesystem lock
+   or the shared filesystem lock plus the file lock. The log and the block
+   allocator are serialized by their own locks, which nest inside the above.
+*/
 
 #ifdef KERNEL
 
-#define filesystem_lock_init(fs)    spin_lock_init(&(fs)->lock)
-#define filesystem_lock(fs)         spin_lock(&(fs)->lock)
-#define filesystem_unlock(fs)       spin_unlock(&(fs)->lock)
+#define filesystem_lock_init(fs)    spin_rw_lock_init(&(fs)->lock)
+#define filesystem_lock(fs)         spin_wlock(&(fs)->lock)
+#define filesystem_unlock(fs)       spin_wunlock(&(fs)->lock)
+#define filesystem_rlock(fs)        spin_rlock(&(fs)->lock)
+#define filesystem_runlock(fs)      spin_runlock(&(fs)->lock)
+
+#define fsfile_lock_init(f)         spin_lock_init(&(f)->lock)
+#define fsfile_lock(f)              spin_lock(&(f)->lock)
+#define fsfile_unlock(f)            spin_unlock(&(f)->lock)
+
+#define fs_alloc_lock_init(fs)      spin_lock_init(&(fs)->alloc_lock)
+#define fs_alloc_lock(fs)           spin_lock(&(fs)->alloc_lock)
+#define fs_alloc_unlock(fs)         spin_unlock(&(fs)->alloc_lock)
+
+#define fs_sync_lock_init(fs)       spin_lock_init(&(fs)->sync_lock)
+#define fs_sync_lock(fs)            spin_lock(&(fs)->sync_lock)
+#define fs_sync_unlock(fs)          spin_unlock(&(fs)->sync_lock)
 
 #else
 
 #define filesystem_lock_init(fs)
 #define filesystem_lock(fs)         ((void)fs)
 #define filesystem_unlock(fs)       ((void)fs)
+#define filesystem_rlock(fs)        ((void)fs)
+#define filesystem_runlock(fs)      ((void)fs)
+
+#define fsfile_lock_init(f)
+#define fsfile_lock(f)              ((void)f)
+#define fsfile_unlock(f)            ((void)f)
+
+#define fs_alloc_lock_init(fs)
+#define fs_alloc_lock(fs)           ((void)fs)
+#define fs_alloc_unlock(fs)         ((void)fs)
+
+#define fs_sync_lock_init(fs)
+#define fs_sync_lock(fs)            ((void)fs)
+#define fs_sync_unlock(fs)          ((void)fs)
 
 #endif
 
@@ -30,9 +72,64 @@ declare_closure_struct(1, 0, void, fs_sync,
 declare_closure_struct(1, 1, void, fs_free,
                        struct filesystem *, fs,
                        status, s);
+declare_closure_struct(1, 1, void, fs_sync_batch_complete,
+                       struct filesystem *, fs,
+                       status, s);
+declare_closure_struct(1, 0, void, fs_sync_batch_start,
+                       struct filesystem *, fs);
+#ifdef KERNEL
+declare_closure_struct(1, 2, void, fs_sync_window_expired,
+                       struct filesystem *, fs,
+                       u64, expiry, u64, overruns);
+#endif
+
+/* a caller of filesystem_flush() waiting for a group commit */
+typedef struct fs_sync_waiter {
+    status_handler sh;
+    timestamp t;
+} *fs_sync_waiter;
+
+struct fs_sync_stats {
+    u64 requests;           /* filesystem_flush() calls */
+    u64 batches;            /* log commits, each followed by at most one device flush */
+    u64 completed;
+    u64 latency_total;      /* sum of request latencies */
+    u64 latency_max;
+    u64 rate;               /* requests per second over the last sampling period */
+    u64 rate_requests;      /* requests completed in current sampling period */
+    timestamp rate_start;
+};
+
+/* free extent histogram buckets, by log2 of the length in blocks */
+#define FS_FREE_EXTENT_ORDERS   24
+
+struct fs_frag_stats {
+    u64 files;              /* files with at least one extent */
+    u64 extents;
+    u64 extents_max;        /* most extents in a single file */
+    u64 free_extents;
+    u64 free_extent_max;    /* in blocks */
+    u64 free_extent_hist[FS_FREE_EXTENT_ORDERS];
+    timestamp updated;
+};
+
+struct zcache_stats {
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    u64 read_bytes;         /* compressed data read from storage */
+    u64 decompressed_bytes;
+};
+
+typedef struct zcache *zcache;
 
 typedef struct filesystem {
     id_heap storage;
+    u64 delalloc_blocks;        /* reserved for pending file writes, not yet allocated */
+    u64 alloc_group_blocks;
+    int alloc_groups;
+    u64 *alloc_group_next;      /* next-fit position in each allocation group */
+    struct fs_frag_stats frag_stats;
     u64 size;
     heap h;
     int blocksize_order;
@@ -41,6 +138,8 @@ typedef struct filesystem {
     u8 uuid[UUID_LEN];
     char label[VOLUME_LABEL_MAX_LEN];
     table files; // maps tuple to fsfile
+    table dir_indexes;          /* maps directory tuple to dir_index */
+    zcache zcache;              /* decompressed extent cache */
     closure_type(log, void, tuple);
     heap dma;
     void *zero_page;
@@ -53,8 +152,23 @@ typedef struct filesystem {
     u64 next_new_log_offset;
     tuple root;
 #ifdef KERNEL
-    struct spinlock lock;
+    struct rw_spinlock lock;
+    struct spinlock alloc_lock;
+    struct spinlock sync_lock;
+    struct timer sync_timer;
+    closure_struct(fs_sync_window_expired, sync_window_expired);
 #endif
+    buffer sync_waiters;        /* gathering for the next group commit */
+    buffer sync_batch;          /* covered by the group commit in progress */
+    boolean sync_in_progress;
+    boolean sync_scheduled;     /* batch start pending on window timer or runqueue */
+    boolean fua;                /* write with FUA in place of device cache flushes */
+    timestamp sync_window;      /* adaptive gathering delay */
+    timestamp sync_batch_time;
+    struct fs_sync_stats sync_stats;
+    closure_struct(fs_sync_batch_complete, sync_batch_complete);
+    status_handler sync_batch_sh;
+    closure_struct(fs_sync_batch_start, sync_batch_start);
     struct refcount refcount;
     closure_struct(fs_sync, sync);
     thunk sync_complete;
@@ -67,12 +181,18 @@ declare_closure_struct(1, 1, void, fsf_sync_complete,
 
 typedef struct fsfile {
     rangemap extentmap;
+    rangemap delalloc;          /* blocks reserved for writes in flight (delayed allocation) */
+    u64 alloc_goal;             /* storage block following the last extent allocation */
+    int alloc_group;
     filesystem fs;
     pagecache_node cache_node;
     u64 length;
     tuple md;
     sg_io read;
     sg_io write;
+#ifdef KERNEL
+    struct spinlock lock;
+#endif
     struct refcount refcount;
     closure_struct(fsf_sync_complete, sync_complete);
 } *fsfile;
@@ -110,6 +230,7 @@ typedef struct extent {
     u64 allocated;
     tuple md;                   /* shortcut to extent meta */
     uninited uninited;
+    u64 compressed;             /* length of LZ4-compressed data in bytes, or 0 */
 } *extent;
 
 void ingest_extent(fsfile f, symbol foff, tuple value);
@@ -120,6 +241,29 @@ boolean log_write_eav(log tl, tuple e, symbol a, value v);
 void log_flush(log tl, status_handler completion);
 void log_destroy(log tl);
 void flush(filesystem fs, status_handler);
+typedef struct dir_index *dir_index;
+
+dir_index dir_index_new(heap h, tuple c);
+void dir_index_destroy(dir_index di);
+tuple dir_index_lookup(dir_index di, buffer name, symbol *s);
+boolean dir_index_set(dir_index di, symbol name, tuple t);
+boolean dir_index_iterate(dir_index di, u64 cookie, dir_entry_handler h);
+
+typedef struct zcache_entry *zcache_entry;
+typedef closure_type(zcache_handler, void, zcache_entry, status);
+
+zcache zcache_new(filesystem fs, u64 max_size);
+void zcache_destroy(zcache zc);
+void zcache_set_size(zcache zc, u64 max_size);
+struct zcache_stats *zcache_get_stats(zcache zc, u64 *size);
+zcache_entry zcache_acquire(zcache zc, extent ex);
+void zcache_wait(zcache_entry e, zcache_handler h);
+void zcache_release(zcache_entry e);
+void *zcache_entry_data(zcache_entry e);
+extent zcache_entry_extent(zcache_entry e);
+void zcache_evict(zcache zc, extent ex);
+void zcache_read(zcache zc, extent ex, sg_list sg, range q, status_handler sh);
+
 u64 filesystem_allocate_storage(filesystem fs, u64 nblocks);
 boolean filesystem_reserve_storage(filesystem fs, range storage_blocks);
 boolean filesystem_free_storage(filesystem fs, range storage_blocks);
@@ -138,6 +282,24 @@ boolean file_tuple_is_ancestor(tuple t1, tuple t2, tuple p2);
 
 #define filesystem_log_blocks(fs) (TFS_LOG_DEFAULT_EXTENSION_SIZE >> (fs)->blocksize_order)
 
+/* Builds a list of page-sized buffers over a page-aligned area, so that each buffer is physically
+   contiguous. */
+static inline sg_list tfs_page_sg(void *buf, u64 length)
+{
+    sg_list sg = allocate_sg_list();
+    if (sg == INVALID_ADDRESS)
+        return sg;
+    for (u64 offset = 0; offset < length; offset += PAGESIZE) {
+        u64 len = MIN(PAGESIZE, length - offset);
+        sg_buf sgb = sg_list_tail_add(sg, len);
+        sgb->buf = buf + offset;
+        sgb->size = len;
+        sgb->offset = 0;
+        sgb->refcount = 0;
+    }
+    return sg;
+}
+
 static inline u64 bytes_from_sectors(filesystem fs, u64 sectors)
 {
     return sectors << fs->blocksize_order;
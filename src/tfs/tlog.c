@@ -37,17 +37,25 @@ static const char *tfs_magic = "NVMTFS";
 typedef struct log *log;
 typedef struct log_ext *log_ext;
 
-#define tlog_lock(tl)       filesystem_lock((tl)->fs)
-#define tlog_unlock(tl)     filesystem_unlock((tl)->fs)
-
 #ifdef KERNEL
 
+/* Writers to the log hold the filesystem lock in shared mode, so the log
+   state is serialized by its own lock. Flushing and compaction are done with
+   the filesystem lock held exclusively. */
+#define tlog_lock_init(tl)  spin_lock_init(&(tl)->lock)
+#define tlog_lock(tl)       spin_lock(&(tl)->lock)
+#define tlog_unlock(tl)     spin_unlock(&(tl)->lock)
+
 #define tlog_ext_lock_init(ext)    spin_lock_init(&(ext)->lock)
 #define tlog_ext_lock(ext)         spin_lock(&(ext)->lock)
 #define tlog_ext_unlock(ext)       spin_unlock(&(ext)->lock)
 
 #else
 
+#define tlog_lock_init(tl)
+#define tlog_lock(tl)       ((void)tl)
+#define tlog_unlock(tl)     ((void)tl)
+
 #define tlog_ext_lock_init(ext)
 #define tlog_ext_lock(ext)
 #define tlog_ext_unlock(ext)
@@ -91,9 +99,13 @@ struct log {
     vector encoding_lengths;
     u64 tuple_bytes_remain;
 
+#ifdef KERNEL
+    struct spinlock lock;
+#endif
     struct timer flush_timer;
     vector flush_completions;
     boolean dirty;
+    boolean flush_expedited;
     boolean flushing;
     boolean compacting;
     boolean failed;             /* unrecoverable log failure */
@@ -228,7 +240,9 @@ static log log_new(heap h, filesystem fs)
     if (tl->encoding_lengths == INVALID_ADDRESS)
         goto fail_dealloc_staging;
     tl->tuple_bytes_remain = 0;
+    tlog_lock_init(tl);
     tl->dirty = false;
+    tl->flush_expedited = false;
     tl->flushing = false;
     init_timer(&tl->flush_timer);
     tl->flush_completions = allocate_vector(tl->h, COMPLETION_QUEUE_SIZE);
@@ -485,7 +499,6 @@ closure_function(1, 1, void, log_flush_complete,
 {
     /* would need to move these to runqueue if a flush is ever invoked from a tfs op */
     tlog_lock(bound(tl));
-    bound(tl)->dirty = false;
     run_flush_completions(bound(tl), s);
     bound(tl)->flushing = false;
     tlog_unlock(bound(tl));
@@ -525,7 +538,9 @@ closure_function(2, 1, void, log_switch_complete,
             msg_err("failed to mark to_be_destroyed log at %R as free", ext->r);
     }
 
+    tlog_lock(old_tl);
     run_flush_completions(old_tl, s);
+    tlog_unlock(old_tl);
     filesystem_unlock(fs);
 
     refcount_release(&to_be_destroyed->refcount);
@@ -533,21 +548,27 @@ closure_function(2, 1, void, log_switch_complete,
     closure_finish();
 }
 
+/* called with filesystem lock held exclusively */
 void log_flush(log tl, status_handler completion)
 {
     tlog_debug("%s: log %p, completion %p, dirty %d\n", __func__, tl, completion, tl->dirty);
-    if (!tl->dirty && !tl->compacting) {
+    tlog_lock(tl);
+    if (!tl->dirty && !tl->flushing && !tl->compacting) {
+        tlog_unlock(tl);
         if (completion)
             apply(completion, STATUS_OK);
         return;
     }
     if (completion)
         vector_push(tl->flush_completions, completion);
-    if (tl->flushing || tl->compacting)
+    if (tl->flushing || tl->compacting) {
+        tlog_unlock(tl);
         return;
+    }
 #ifdef KERNEL
     remove_timer(kernel_timers, &tl->flush_timer, 0);
 #endif
+    tl->flush_expedited = false;
     tl->flushing = true;
     merge m = allocate_merge(tl->h, closure(tl->h, log_flush_complete, tl));
     status_handler sh = apply_merge(m);
@@ -557,11 +578,14 @@ void log_flush(log tl, status_handler completion)
     if (!log_write_internal(tl, m))
         tl->failed = true;
 
+    /* entries staged from here on need another flush, rearming the timer */
+    tl->dirty = false;
+
     /* completion merge will close out with the flush; compaction is independent */
     tlog_unlock(tl);    /* to allow flush completion to run synchronously */
     flush_log_extension(tl->current, false, sh);
-    tlog_lock(tl);
 
+    /* no log writers can run concurrently with the exclusive filesystem lock held */
     if (!tl->failed && !tl->compacting && (tl->obsolete_entries >= TFS_LOG_COMPACT_OBSOLETE) &&
         (tl->total_entries <= TFS_LOG_COMPACT_RATIO * tl->obsolete_entries)) {
         tlog_debug("%ld obsolete entries out of %ld, starting log compaction\n",
@@ -604,62 +628,81 @@ closure_function(1, 2, void, log_flush_timer_expired,
                  u64, expiry, u64, overruns)
 {
     if (overruns != timer_disabled) {
-        tlog_lock(bound(tl));
+        filesystem fs = bound(tl)->fs;
+        filesystem_lock(fs);
         log_flush(bound(tl), 0);
-        tlog_unlock(bound(tl));
+        filesystem_unlock(fs);
     }
     closure_finish();
 }
 
-static void log_set_dirty(log tl)
+/* Called with log lock held. A flush needs the filesystem lock held
+   exclusively, which the writer may not have; so, rather than flushing here,
+   a large amount of staged data brings the flush timer forward. */
+static boolean log_set_dirty(log tl)
 {
     if (tl->dirty) {
-        if (buffer_length(tl->tuple_staging) >= bytes_from_sectors(tl->fs,
-                range_span(tl->current->sectors)) / 2)
-            log_flush(tl, 0);
-        return;
+        if (!tl->flush_expedited && buffer_length(tl->tuple_staging) >=
+            bytes_from_sectors(tl->fs, range_span(tl->current->sectors)) / 2) {
+            tl->flush_expedited = true;
+            if (remove_timer(kernel_timers, &tl->flush_timer, 0))
+                register_timer(kernel_timers, &tl->flush_timer, CLOCK_ID_MONOTONIC_RAW, 0, false,
+                               0, closure(tl->h, log_flush_timer_expired, tl));
+        }
+        return false;
     }
     tl->dirty = true;
     register_timer(kernel_timers, &tl->flush_timer, CLOCK_ID_MONOTONIC_RAW,
                    seconds(TFS_LOG_FLUSH_DELAY_SECONDS), false, 0,
                    closure(tl->h, log_flush_timer_expired, tl));
+    return false;
 }
 #else
 /* mkfs: flush on close */
-static void log_set_dirty(log tl)
+static boolean log_set_dirty(log tl)
 {
     tl->dirty = true;
-    if (buffer_length(tl->tuple_staging) >=
-            bytes_from_sectors(tl->fs, range_span(tl->current->sectors))) {
-        log_flush(tl, 0);
-    }
+    return buffer_length(tl->tuple_staging) >=
+        bytes_from_sectors(tl->fs, range_span(tl->current->sectors));
 }
 #endif
 
 boolean log_write_eav(log tl, tuple e, symbol a, value v)
 {
     tlog_debug("log_write_eav: tl %p, e %p, a %b, v %p\n", tl, e, symbol_string(a), v);
+    tlog_lock(tl);
     u64 len = buffer_length(tl->tuple_staging);
-    if (tl->failed || len >= TFS_LOG_MAX_TUPLE_STAGING_BYTES)
+    if (tl->failed || len >= TFS_LOG_MAX_TUPLE_STAGING_BYTES) {
+        tlog_unlock(tl);
         return false;
+    }
     encode_eav(tl->tuple_staging, tl->dictionary, e, a, v, &tl->obsolete_entries);
     tl->total_entries++;
     len = buffer_length(tl->tuple_staging) - len;
     vector_push(tl->encoding_lengths, (void *)len);
-    log_set_dirty(tl);
+    boolean flush = log_set_dirty(tl);
+    tlog_unlock(tl);
+    if (flush)
+        log_flush(tl, 0);
     return !tl->failed;
 }
 
 boolean log_write(log tl, tuple t)
 {
     tlog_debug("log_write: tl %p, t %p\n", tl, t);
+    tlog_lock(tl);
     u64 len = buffer_length(tl->tuple_staging);
-    if (tl->failed || len >= TFS_LOG_MAX_TUPLE_STAGING_BYTES)
+    if (tl->failed || len >= TFS_LOG_MAX_TUPLE_STAGING_BYTES) {
+        tlog_unlock(tl);
         return false;
+    }
     encode_tuple(tl->tuple_staging, tl->dictionary, t, &tl->total_entries);
     len = buffer_length(tl->tuple_staging) - len;
     vector_push(tl->encoding_lengths, (void *)len);
-    log_set_dirty(tl);
+    boolean flush = log_set_dirty(tl);
+    tlog_unlock(tl);
+    if (flush)
+        log_flush(tl, 0);
     return !tl->failed;
 }
 
@@ -688,7 +731,7 @@ static status log_hdr_parse(buffer b, boolean first_ext, u64 *length, u8 *uuid,
         return timm("result", "tfs magic mismatch");
     buffer_consume(b, TFS_MAGIC_BYTES);
     u64 version = pop_varint(b);
-    if (version != TFS_VERSION)
+    if ((version < TFS_VERSION_MIN) || (version > TFS_VERSION))
         return timm("result", "tfs version mismatch (read %ld, build %ld)",
             version, TFS_VERSION);
     *length = pop_varint(b);
@@ -6,6 +6,9 @@
 
 #define AIO_RESFD_INVALID   -1U
 
+/* maximum number of distinct filesystems whose storage is plugged during an io_submit call */
+#define AIO_PLUG_MAX    4
+
 #define aio_lock(aio)   spin_lock(&(aio)->lock)
 #define aio_unlock(aio) spin_unlock(&(aio)->lock)
 
@@ -34,10 +37,35 @@ struct aio {
     unsigned int nr;
     unsigned int ongoing_ops;
     unsigned int copied_evts;
+    struct list polls;
     struct refcount refcount;
     closure_struct(aio_free, free);
 };
 
+declare_closure_struct(2, 2, boolean, aio_poll_notify,
+                       struct aio *, aio, struct aio_poll *, p,
+                       u64, events, void *, arg);
+
+typedef struct aio_poll {
+    struct list l;
+    fdesc f;
+    notify_entry ne;
+    closure_struct(aio_poll_notify, handler);
+    async_1 complete;
+    u64 mask;
+    u64 events;
+} *aio_poll;
+
+declare_closure_struct(1, 0, void, aio_plug_flush,
+                       struct aio_plug *, plug);
+
+struct aio_plug {
+    filesystem fs[AIO_PLUG_MAX];
+    int count;
+    syscall_context sc;
+    closure_struct(aio_plug_flush, flush);
+};
+
 static struct aio *aio_alloc(process p, kernel_heaps kh, unsigned int *id)
 {
     struct aio *aio = allocate(heap_locked(get_kernel_heaps()),
@@ -117,6 +145,7 @@ sysreturn io_setup(unsigned int nr_events, aio_context_t *ctx_idp)
     aio->bq = 0;
     aio->nr = nr_events;
     aio->ongoing_ops = 0;
+    list_init(&aio->polls);
     init_refcount(&aio->refcount, 1, init_closure(&aio->free, aio_free, aio));
 
     ctx->nr = nr_events;
@@ -200,7 +229,145 @@ static unsigned int aio_avail_events(struct aio *aio)
     return avail;
 }
 
-static sysreturn iocb_enqueue(struct aio *aio, struct iocb *iocb, context ctx)
+closure_function(2, 1, void, aio_fsync_complete,
+                 thread, t, io_completion, completion,
+                 status, s)
+{
+    thread_log(bound(t), "%s: status %v", __func__, s);
+    apply(bound(completion), bound(t), is_ok(s) ? 0 : -EIO);
+    closure_finish();
+}
+
+/* Applied (asynchronously) in the context of the io_submit call that added the poll request. */
+closure_function(4, 1, void, aio_poll_complete,
+                 heap, h, aio_poll, p, thread, t, io_completion, completion,
+                 u64, rv)
+{
+    deallocate(bound(h), bound(p), sizeof(struct aio_poll));
+    apply(bound(completion), bound(t), (sysreturn)rv);
+    closure_finish();
+}
+
+define_closure_function(2, 2, boolean, aio_poll_notify,
+                        struct aio *, aio, struct aio_poll *, p,
+                        u64, events, void *, arg)
+{
+    aio_poll p = bound(p);
+    events &= p->mask;
+    if (!events)
+        return false;
+    struct aio *aio = bound(aio);
+    aio_lock(aio);
+    boolean found = list_inserted(&p->l);
+    if (found)
+        list_delete(&p->l);
+    else
+        p->events = events;
+    aio_unlock(aio);
+    if (found)
+        async_apply_1(p->complete, pointer_from_u64(events));
+    return found;
+}
+
+/* A poll request completes (only once) when any of the requested events is notified. */
+static sysreturn aio_poll_add(struct aio *aio, fdesc f, u16 events, io_completion completion)
+{
+    heap h = heap_locked(aio->kh);
+    aio_poll p = allocate(h, sizeof(*p));
+    if (p == INVALID_ADDRESS)
+        return -ENOMEM;
+    p->complete = (async_1)contextual_closure(aio_poll_complete, h, p, current,
+                                                    completion);
+    if (p->complete == INVALID_ADDRESS)
+        goto err_closure;
+    p->l.next = p->l.prev = 0;
+    p->f = f;
+    p->mask = events | EPOLLERR | EPOLLHUP;
+    p->events = 0;
+    p->ne = notify_add(f->ns, p->mask,
+                       init_closure(&p->handler, aio_poll_notify, aio, p));
+    if (p->ne == INVALID_ADDRESS)
+        goto err_notify;
+    aio_lock(aio);
+    u64 notified = p->events;
+    if (!notified)
+        list_push_back(&aio->polls, &p->l);
+    aio_unlock(aio);
+    if (notified) {
+        /* Poll events have been notified already. */
+        notify_remove(f->ns, p->ne, false);
+        async_apply_1(p->complete, pointer_from_u64(notified));
+    } else if (f->events) {
+        /* Check if poll events are already present. */
+        notify_dispatch_for_thread(f->ns, apply(f->events, current), current);
+    }
+    return 0;
+  err_notify:
+    deallocate_closure(p->complete);
+  err_closure:
+    deallocate(h, p, sizeof(*p));
+    return -ENOMEM;
+}
+
+static void aio_cancel_polls(struct aio *aio)
+{
+    struct list polls;
+    list_init(&polls);
+    aio_lock(aio);
+    list_foreach(&aio->polls, l) {
+        list_delete(l);
+        list_push_back(&polls, l);
+    }
+    aio_unlock(aio);
+
+    /* The aio lock cannot be held here, because poll notify handlers are invoked with the notify
+     * set lock held. */
+    list_foreach(&polls, l) {
+        aio_poll p = struct_from_list(l, aio_poll, l);
+        list_delete(l);
+        notify_remove(p->f->ns, p->ne, false);
+        async_apply_1(p->complete, pointer_from_u64(-ECANCELED));
+    }
+}
+
+/* Requests to the same filesystem issued within an io_submit call are submitted to the storage
+ * device as a batch. The plug is global to the device, so it is flushed as soon as the syscall
+ * context suspends (e.g. on a fault on a user buffer, which may need I/O to the same device);
+ * iocbs submitted after resuming start a new batch. */
+static void aio_plug_fs(struct aio_plug *plug, filesystem fs)
+{
+    for (int i = 0; i < plug->count; i++) {
+        if (plug->fs[i] == fs)
+            return;
+    }
+    if (plug->count == AIO_PLUG_MAX)
+        return;
+    filesystem_reserve(fs);
+    filesystem_storage_plug(fs);
+    if (plug->count == 0)
+        plug->sc->plug_flush = (thunk)&plug->flush;
+    plug->fs[plug->count++] = fs;
+}
+
+static void aio_unplug(struct aio_plug *plug)
+{
+    if (plug->sc->plug_flush == (thunk)&plug->flush)
+        plug->sc->plug_flush = 0;
+    for (int i = 0; i < plug->count; i++) {
+        filesystem_storage_unplug(plug->fs[i]);
+        filesystem_release(plug->fs[i]);
+    }
+    plug->count = 0;
+}
+
+define_closure_function(1, 0, void, aio_plug_flush,
+                        struct aio_plug *, plug)
+{
+    aio_unplug(bound(plug));
+}
+
+static sysreturn iocb_enqueue(struct aio *aio, struct iocb *iocb, context ctx,
+                              struct aio_plug *plug)
 {
     if (!validate_user_memory(iocb, sizeof(struct iocb), false)) {
         return -EFAULT;
@@ -208,11 +375,28 @@ static sysreturn iocb_enqueue(struct aio *aio, struct iocb *iocb, context ctx)
     thread_log(current, "%s: fd %d, op %d", __func__, iocb->aio_fildes,
             iocb->aio_lio_opcode);
 
-    if (iocb->aio_reserved1 || iocb->aio_reserved2 || !iocb->aio_buf ||
+    if (iocb->aio_reserved1 || iocb->aio_reserved2 ||
             (iocb->aio_flags & ~AIO_KNOWN_FLAGS)) {
         return -EINVAL;
     }
 
+    switch (iocb->aio_lio_opcode) {
+    case IOCB_CMD_PREAD:
+    case IOCB_CMD_PWRITE:
+        if (!iocb->aio_buf)
+            return -EINVAL;
+        break;
+    case IOCB_CMD_FSYNC:
+    case IOCB_CMD_FDSYNC:
+        if (iocb->aio_buf)
+            return -EINVAL;
+        /* fall through */
+    case IOCB_CMD_POLL:
+        if (iocb->aio_nbytes || iocb->aio_offset)
+            return -EINVAL;
+        break;
+    }
+
     fdesc f = resolve_fd(current->p, iocb->aio_fildes);
     aio_lock(aio);
     if (aio->ongoing_ops >= aio_avail_events(aio) - 1) {
@@ -242,6 +426,8 @@ static sysreturn iocb_enqueue(struct aio *aio, struct iocb *iocb, context ctx)
             rv = -EBADF;
             goto error;
         }
+        if (plug && (f->type == FDESC_TYPE_REGULAR))
+            aio_plug_fs(plug, ((file)f)->fs);
         apply(f->read, (void *) iocb->aio_buf, iocb->aio_nbytes,
                 iocb->aio_offset, current, true, completion);
         break;
@@ -253,9 +439,39 @@ static sysreturn iocb_enqueue(struct aio *aio, struct iocb *iocb, context ctx)
             rv = -EBADF;
             goto error;
         }
+        if (plug && (f->type == FDESC_TYPE_REGULAR))
+            aio_plug_fs(plug, ((file)f)->fs);
         apply(f->write, (void *) iocb->aio_buf, iocb->aio_nbytes,
                 iocb->aio_offset, current, true, completion);
         break;
+    case IOCB_CMD_FSYNC:
+    case IOCB_CMD_FDSYNC:
+        switch (f->type) {
+        case FDESC_TYPE_REGULAR: {
+            status_handler sh = contextual_closure(aio_fsync_complete, current, completion);
+            if (sh == INVALID_ADDRESS) {
+                rv = -ENOMEM;
+                goto error;
+            }
+            if (plug)
+                aio_plug_fs(plug, ((file)f)->fs);
+            filesystem_sync_node(((file)f)->fs, fsfile_get_cachenode(((file)f)->fsf), sh);
+            break;
+        }
+        case FDESC_TYPE_DIRECTORY:
+        case FDESC_TYPE_SYMLINK:
+            apply(completion, current, 0);
+            break;
+        default:
+            rv = -EINVAL;
+            goto error;
+        }
+        break;
+    case IOCB_CMD_POLL:
+        rv = aio_poll_add(aio, f, iocb->aio_buf, completion);
+        if (rv)
+            goto error;
+        break;
     default:
         rv = -EINVAL;
         goto error;
@@ -285,9 +501,13 @@ sysreturn io_submit(aio_context_t ctx_id, long nr, struct iocb **iocbpp)
     cpuinfo ci = current_cpu();
     syscall_context sc = (syscall_context)get_current_context(ci);
     assert(is_syscall_context(&sc->context));
+    struct aio_plug plug;
+    plug.count = 0;
+    plug.sc = sc;
+    init_closure(&plug.flush, aio_plug_flush, &plug);
     int io_ops;
     for (io_ops = 0; io_ops < nr; io_ops++) {
-        sysreturn rv = iocb_enqueue(aio, iocbpp[io_ops], &sc->context);
+        sysreturn rv = iocb_enqueue(aio, iocbpp[io_ops], &sc->context, (nr > 1) ? &plug : 0);
         if (rv) {
             if (io_ops == 0) {
                 io_ops = rv;
@@ -295,6 +515,7 @@ sysreturn io_submit(aio_context_t ctx_id, long nr, struct iocb **iocbpp)
             break;
         }
     }
+    aio_unplug(&plug);
     refcount_release(&aio->refcount);
     orphan_syscall_context(ci, sc);
     return io_ops;
@@ -435,5 +656,6 @@ sysreturn io_destroy(aio_context_t ctx_id)
     process_unlock(p);
     if (!aio)
         return -EINVAL;
+    aio_cancel_polls(aio);
     return io_destroy_internal(aio, current, false);
 }
@@ -25,6 +25,9 @@ sysreturn sysreturn_from_fs_status_value(status s);
  * not to the range to be read ahead. */
 void file_readahead(file f, u64 offset, u64 len);
 
+void file_direct_io(file f, sg_list sg, u64 length, u64 offset_arg, boolean write, thread t,
+                    io_completion completion);
+
 fs_status filesystem_chdir(process p, const char *path);
 
 sysreturn symlink(const char *target, const char *linkpath);
@@ -1,97 +1,124 @@
 #include <unix_internal.h>
 
-struct futex {
-    heap h;
-    blockq bq;
+/* Futex waiters are queued in a global hash table, indexed by process and futex address. Each
+   bucket has its own lock, which is held while the futex word is checked and a waiter is queued,
+   so that a wakeup cannot be missed. A waiting thread blocks on its thread blockq; a waker
+   dequeues the waiter, marks it as woken and wakes the thread. No state is kept for futexes
+   without waiters. */
+
+typedef struct futex_bucket {
     struct spinlock lock;
-};
+    struct list waiters;
+} __attribute__((aligned(DEFAULT_CACHELINE_SIZE))) *futex_bucket;
+
+#define FUTEX_BUCKETS_PER_CPU   256
 
-#define futex_lock(f)   spin_lock(&(f)->lock)
-#define futex_unlock(f) spin_unlock(&(f)->lock)
+static futex_bucket futex_buckets;
+static u64 futex_hash_order;
+static boolean futex_verbose;
 
-static u64 futex_key_function(void *x)
+static futex_bucket futex_get_bucket(process p, int *uaddr)
 {
-    return u64_from_pointer(x);
+    u64 key = (u64_from_pointer(uaddr) >> 2) ^ (u64_from_pointer(p) << 7);
+    return &futex_buckets[(key * 0x9e3779b97f4a7c15ull) >> (64 - futex_hash_order)];
 }
 
-static boolean futex_key_equal(void *a, void *b)
+static boolean futex_match(futex_waiter w, process p, int *uaddr, u32 bitset)
 {
-    return a == b;
+    return (w->p == p) && (w->uaddr == uaddr) && (w->bitset & bitset) && !w->pi;
 }
 
-static struct futex * soft_create_futex(process p, u64 key)
+static void futex_waiter_init(futex_waiter w, int *uaddr, u32 bitset)
 {
-    heap h = heap_locked(get_kernel_heaps());
-    struct futex * f;
-
-    process_lock(p);
-
-    f = table_find(p->futices, pointer_from_u64(key));
-    if (f)
-        goto out;
-
-    f = allocate(h, sizeof(struct futex));
-    if (f == INVALID_ADDRESS) {
-        msg_err("failed to allocate futex\n");
-        goto out;
-    }
-
-    f->h = h;
-    f->bq = allocate_blockq(f->h, "futex");
-    if (f->bq == INVALID_ADDRESS) {
-        msg_err("failed to allocate futex blockq\n");
-        deallocate(f->h, f, sizeof(struct futex));
-        f = INVALID_ADDRESS;
-        goto out;
-    }
+    list_init_member(&w->l);
+    w->p = current->p;
+    w->uaddr = uaddr;
+    w->bitset = bitset;
+    w->woken = false;
+    w->pi = false;
+    w->requeue_pi = 0;
+    w->t = current;
+}
 
-    spin_lock_init(&f->lock);
-    table_set(p->futices, pointer_from_u64(key), f);
-  out:
-    process_unlock(p);
-    return f;
+/* called with bucket lock held */
+static void futex_wake_waiter(futex_waiter w)
+{
+    list_delete(&w->l);
+    w->woken = true;
+    write_barrier();
+    blockq_wake_one(w->t->thread_bq);
 }
 
-static thread futex_wake_one(struct futex * f)
+/* called with bucket lock held */
+static int futex_wake_bucket(futex_bucket b, process p, int *uaddr, int val, u32 bitset)
 {
-    thread t = blockq_wake_one(f->bq);
-    if (t != INVALID_ADDRESS)
-        return t;
-    kern_pause();
-    return t;
+    int nr_woken = 0;
+    list_foreach(&b->waiters, l) {
+        if (nr_woken >= val)
+            break;
+        futex_waiter w = struct_from_list(l, futex_waiter, l);
+        if (futex_match(w, p, uaddr, bitset)) {
+            futex_wake_waiter(w);
+            nr_woken++;
+        }
+    }
+    return nr_woken;
 }
 
 /*
  * Wake up to 'val' waiters
  * Return the number woken
  */
-static int futex_wake_many(struct futex * f, int val)
+static int futex_wake(process p, int *uaddr, int val, u32 bitset)
 {
-    int nr_woken;
-
-    for (nr_woken = 0; nr_woken < val; nr_woken++) {
-        thread w = futex_wake_one(f);
-        if (w == INVALID_ADDRESS)
-            break;
-    }
-
+    futex_bucket b = futex_get_bucket(p, uaddr);
+    spin_lock(&b->lock);
+    int nr_woken = futex_wake_bucket(b, p, uaddr, val, bitset);
+    spin_unlock(&b->lock);
     return nr_woken;
 }
 
-boolean futex_wake_many_by_uaddr(process p, int *uaddr, int val)
+static void futex_lock_buckets(futex_bucket b1, futex_bucket b2)
 {
-    struct futex * f;
+    if (b1 == b2)
+        spin_lock(&b1->lock);
+    else
+        spin_lock_2(&b1->lock, &b2->lock);
+}
 
-    process_lock(p);
-    f = table_find(p->futices, (void *)uaddr);
-    process_unlock(p);
-    if (!f)
-        return false;
+static void futex_unlock_buckets(futex_bucket b1, futex_bucket b2)
+{
+    if (b1 != b2)
+        spin_unlock(&b2->lock);
+    spin_unlock(&b1->lock);
+}
 
-    futex_lock(f);
-    futex_wake_many(f, val);
-    futex_unlock(f);
-    return true;
+/* Removes a waiter from its bucket, unless it has been woken. The bucket is looked up again after
+   locking, since a requeue may have moved the waiter in the meantime. */
+static void futex_dequeue(futex_waiter w)
+{
+    while (1) {
+        int *uaddr = w->uaddr;
+        futex_bucket b = futex_get_bucket(w->p, uaddr);
+        spin_lock(&b->lock);
+        if (w->uaddr == uaddr) {
+            if (list_inserted(&w->l))
+                list_delete(&w->l);
+            spin_unlock(&b->lock);
+            return;
+        }
+        spin_unlock(&b->lock);
+    }
+}
+
+/* Returns the index of the first woken waiter, or -1 if none has been woken. */
+static int futex_woken_index(futex_waiter waiters, int count)
+{
+    read_barrier();
+    for (int i = 0; i < count; i++)
+        if (waiters[i].woken)
+            return i;
+    return -1;
 }
 
 /*
@@ -99,44 +126,324 @@ boolean futex_wake_many_by_uaddr(process p, int *uaddr, int val)
  * to timeout/signal delivery/etc., or by another thread in sys_futex
  *
  * Return:
- *  BLOCKQ_BLOCK_REQUIRED: top half, going to block
+ *  BLOCKQ_BLOCK_REQUIRED: going to block
  *  -ETIMEDOUT: if we timed out
  *  -EINTR: if we're being nullified
- *  0: thread woken up
+ *  0 (or the index of the woken futex for futex_waitv): thread woken up
  */
-closure_function(3, 1, sysreturn, futex_bh,
-                 struct futex *, f, thread, t, timestamp, timeout,
+closure_function(5, 1, sysreturn, futex_bh,
+                 futex_waiter, waiters, int, count, boolean, waitv, thread, t, timestamp, timeout,
                  u64, flags)
 {
     thread t = bound(t);
-    struct futex *f = bound(f);
+    futex_waiter waiters = bound(waiters);
+    int count = bound(count);
     sysreturn rv;
 
-    if (!(flags & BLOCKQ_ACTION_BLOCKED)) {
-        futex_unlock(f);
-        thread_log(t, "%s: struct futex: %p, blocking", __func__, f);
-        return BLOCKQ_BLOCK_REQUIRED;
+    int index = futex_woken_index(waiters, count);
+    if ((index < 0) && !(flags & (BLOCKQ_ACTION_NULLIFY | BLOCKQ_ACTION_TIMEDOUT))) {
+        thread_log(t, "%s: waiters %p, blocking", __func__, waiters);
+        return blockq_block_required(t, flags);
     }
 
-    if (flags & (BLOCKQ_ACTION_NULLIFY | BLOCKQ_ACTION_TIMEDOUT)) {
-        if (flags & BLOCKQ_ACTION_NULLIFY)
-            rv = bound(timeout) ? -EINTR : -ERESTARTSYS;
-        else
-            rv = -ETIMEDOUT;
-    } else {
-        rv = 0; /* no timer expire + not us --> actual wakeup */
-    }
+    for (int i = 0; i < count; i++)
+        futex_dequeue(&waiters[i]);
+
+    /* a wakeup that raced with a timeout or signal takes precedence */
+    index = futex_woken_index(waiters, count);
+    if (index >= 0)
+        rv = bound(waitv) ? index :
+            (waiters->requeue_pi && !waiters->pi) ? -EAGAIN :   /* not requeued */
+            0;
+    else if (flags & BLOCKQ_ACTION_NULLIFY)
+        rv = bound(timeout) ? -EINTR : -ERESTARTSYS;
+    else
+        rv = -ETIMEDOUT;
 
-    thread_log(t, "%s: struct futex: %p, flags 0x%lx, rv %ld", __func__, f, flags, rv);
+    thread_log(t, "%s: waiters %p, flags 0x%lx, rv %ld", __func__, waiters, flags, rv);
+    if (bound(waitv))
+        deallocate(heap_locked(get_kernel_heaps()), waiters, count * sizeof(struct futex_waiter));
     closure_finish();
     return syscall_return(t, rv);
 }
 
-closure_function(1, 1, void, futex_requeue_handler,
-                 struct futex *, dest,
-                 blockq_action, action)
+static sysreturn futex_wait(int *uaddr, int val, u32 bitset, clock_id clkid, timestamp ts,
+                            boolean absolute)
 {
-    closure_member(futex_bh, action, f) = bound(dest);
+    futex_waiter w = &current->futex_w;
+    futex_waiter_init(w, uaddr, bitset);
+    futex_bucket b = futex_get_bucket(current->p, uaddr);
+    spin_lock(&b->lock);
+    if (*uaddr != val) {
+        spin_unlock(&b->lock);
+        return -EAGAIN;
+    }
+    list_push_back(&b->waiters, &w->l);
+    spin_unlock(&b->lock);
+    return blockq_check_timeout(current->thread_bq, current,
+                                contextual_closure(futex_bh, w, 1, false, current, ts),
+                                false, clkid, ts, absolute);
+}
+
+/* Wakes up to nwake waiters on uaddr and moves up to nrequeue of the remaining ones to uaddr2,
+   optionally after checking the value of uaddr. */
+static sysreturn futex_requeue(int *uaddr, int *uaddr2, int nwake, int nrequeue, boolean cmp,
+                               int val3)
+{
+    process p = current->p;
+    futex_bucket b = futex_get_bucket(p, uaddr);
+    futex_bucket b2 = futex_get_bucket(p, uaddr2);
+    sysreturn rv;
+    futex_lock_buckets(b, b2);
+    if (cmp && (*uaddr != val3)) {
+        rv = -EAGAIN;
+        goto out;
+    }
+
+    /* waiters in FUTEX_WAIT_REQUEUE_PI can only be moved by FUTEX_CMP_REQUEUE_PI */
+    u64 affected = 0;
+    list_foreach(&b->waiters, l) {
+        if (affected >= (u64)nwake + nrequeue)
+            break;
+        futex_waiter w = struct_from_list(l, futex_waiter, l);
+        if (!futex_match(w, p, uaddr, FUTEX_BITSET_MATCH_ANY))
+            continue;
+        if (w->requeue_pi) {
+            rv = -EINVAL;
+            goto out;
+        }
+        affected++;
+    }
+    int woken = futex_wake_bucket(b, p, uaddr, nwake, FUTEX_BITSET_MATCH_ANY);
+    int requeued = 0;
+    list_foreach(&b->waiters, l) {
+        if (requeued >= nrequeue)
+            break;
+        futex_waiter w = struct_from_list(l, futex_waiter, l);
+        if (!futex_match(w, p, uaddr, FUTEX_BITSET_MATCH_ANY))
+            continue;
+        list_delete(&w->l);
+        w->uaddr = uaddr2;
+        list_push_back(&b2->waiters, &w->l);
+        requeued++;
+    }
+    if (futex_verbose)
+        thread_log(current, " awoken: %d, re-queued %d", woken, requeued);
+    rv = woken + requeued;
+  out:
+    futex_unlock_buckets(b, b2);
+    return rv;
+}
+
+/* PI futexes
+
+   The word of a PI futex holds the TID of its owner, with FUTEX_WAITERS set while threads may be
+   waiting in the kernel to acquire it. Unlocking a futex with waiters hands it directly to the
+   first waiter, which returns from FUTEX_LOCK_PI as the new owner, so that only one thread is
+   woken per unlock. Threads are not scheduled by priority, so the kernel side of priority
+   inheritance is limited to this ownership protocol. */
+
+/* Returns the first waiter to acquire a PI futex, other than skip. Called with bucket lock held. */
+static futex_waiter futex_pi_waiter(futex_bucket b, process p, int *uaddr, futex_waiter skip)
+{
+    list_foreach(&b->waiters, l) {
+        futex_waiter w = struct_from_list(l, futex_waiter, l);
+        if ((w != skip) && w->pi && (w->p == p) && (w->uaddr == uaddr))
+            return w;
+    }
+    return 0;
+}
+
+/* Takes ownership of a PI futex for thread tid if the futex is not owned; otherwise, if
+   set_waiters is true, sets FUTEX_WAITERS in the futex word. Returns 1 if the futex has been
+   acquired, 0 if it is owned by another thread, or an error. Called with bucket lock held. */
+static sysreturn futex_pi_trylock(futex_bucket b, process p, int *uaddr, int tid,
+                                  boolean set_waiters)
+{
+    u32 *word = (u32 *)uaddr;
+    while (1) {
+        u32 val = *word;
+        u32 owner = val & FUTEX_TID_MASK;
+        if (!owner) {
+            u32 new = tid | (val & FUTEX_OWNER_DIED) |
+                (futex_pi_waiter(b, p, uaddr, 0) ? FUTEX_WAITERS : 0);
+            if (compare_and_swap_32(word, val, new))
+                return 1;
+            continue;
+        }
+        if (owner == tid)
+            return -EDEADLK;
+        if ((val & FUTEX_OWNER_DIED) || (set_waiters && !(val & FUTEX_WAITERS))) {
+            thread t = thread_from_tid(p, owner);
+            if (t == INVALID_ADDRESS) {
+                if (!(val & FUTEX_OWNER_DIED))
+                    return -ESRCH;
+
+                /* The owner of a robust futex died with no waiter to hand it over to: take it
+                   over, keeping the owner died bit so that user space recovers the state. */
+                u32 new = tid | FUTEX_OWNER_DIED |
+                    (futex_pi_waiter(b, p, uaddr, 0) ? FUTEX_WAITERS : 0);
+                if (compare_and_swap_32(word, val, new))
+                    return 1;
+                continue;
+            }
+            thread_release(t);
+        }
+        if (!set_waiters || (val & FUTEX_WAITERS))
+            return 0;
+        if (compare_and_swap_32(word, val, val | FUTEX_WAITERS))
+            return 0;
+    }
+}
+
+/* Hands a PI futex over to its first waiter, or unlocks it if there are no waiters. The bits of
+   the futex word in keep are preserved. Called with bucket lock held. */
+static void futex_pi_handoff(futex_bucket b, process p, int *uaddr, u32 keep)
+{
+    u32 *word = (u32 *)uaddr;
+    futex_waiter w = futex_pi_waiter(b, p, uaddr, 0);
+    u32 new = 0;
+    if (w)
+        new = w->t->tid | (futex_pi_waiter(b, p, uaddr, w) ? FUTEX_WAITERS : 0);
+    u32 val;
+    do {
+        val = *word;
+    } while (!compare_and_swap_32(word, val, new | (val & keep)));
+    if (w)
+        futex_wake_waiter(w);
+}
+
+/* Wakes waiters of a robust futex whose owner died, handing a PI futex over to its first waiter. */
+boolean futex_wake_many_by_uaddr(process p, int *uaddr, int val)
+{
+    futex_bucket b = futex_get_bucket(p, uaddr);
+    spin_lock(&b->lock);
+    int nr_woken = futex_wake_bucket(b, p, uaddr, val, FUTEX_BITSET_MATCH_ANY);
+    if (futex_pi_waiter(b, p, uaddr, 0)) {
+        futex_pi_handoff(b, p, uaddr, FUTEX_OWNER_DIED);
+        nr_woken++;
+    }
+    spin_unlock(&b->lock);
+    return nr_woken > 0;
+}
+
+static sysreturn futex_lock_pi(int *uaddr, boolean trylock, clock_id clkid, timestamp ts)
+{
+    process p = current->p;
+    futex_waiter w = &current->futex_w;
+    futex_waiter_init(w, uaddr, FUTEX_BITSET_MATCH_ANY);
+    w->pi = true;
+    futex_bucket b = futex_get_bucket(p, uaddr);
+    spin_lock(&b->lock);
+    sysreturn rv = futex_pi_trylock(b, p, uaddr, current->tid, !trylock);
+    if ((rv == 0) && !trylock)
+        list_push_back(&b->waiters, &w->l);
+    spin_unlock(&b->lock);
+    if (rv == 1)
+        return 0;
+    if (rv < 0)
+        return rv;
+    if (trylock)
+        return -EAGAIN;
+    return blockq_check_timeout(current->thread_bq, current,
+                                contextual_closure(futex_bh, w, 1, false, current, ts),
+                                false, clkid, ts, true);
+}
+
+static sysreturn futex_unlock_pi(int *uaddr)
+{
+    process p = current->p;
+    futex_bucket b = futex_get_bucket(p, uaddr);
+    sysreturn rv = 0;
+    spin_lock(&b->lock);
+    if ((*(u32 *)uaddr & FUTEX_TID_MASK) != current->tid)
+        rv = -EPERM;
+    else
+        futex_pi_handoff(b, p, uaddr, 0);
+    spin_unlock(&b->lock);
+    return rv;
+}
+
+/* Waits on the non-PI futex uaddr until requeued by FUTEX_CMP_REQUEUE_PI to the PI futex uaddr2,
+   then until uaddr2 is acquired. */
+static sysreturn futex_wait_requeue_pi(int *uaddr, int val, int *uaddr2, clock_id clkid,
+                                       timestamp ts)
+{
+    if (uaddr == uaddr2)
+        return -EINVAL;
+    futex_waiter w = &current->futex_w;
+    futex_waiter_init(w, uaddr, FUTEX_BITSET_MATCH_ANY);
+    w->requeue_pi = uaddr2;
+    futex_bucket b = futex_get_bucket(current->p, uaddr);
+    spin_lock(&b->lock);
+    if (*uaddr != val) {
+        spin_unlock(&b->lock);
+        return -EAGAIN;
+    }
+    list_push_back(&b->waiters, &w->l);
+    spin_unlock(&b->lock);
+    return blockq_check_timeout(current->thread_bq, current,
+                                contextual_closure(futex_bh, w, 1, false, current, ts),
+                                false, clkid, ts, true);
+}
+
+/* Acquires the PI futex uaddr2 on behalf of the first FUTEX_WAIT_REQUEUE_PI waiter on uaddr and
+   wakes it if the futex is not owned, then moves up to nrequeue waiters to uaddr2. */
+static sysreturn futex_cmp_requeue_pi(int *uaddr, int *uaddr2, int nwake, int nrequeue, int val3)
+{
+    if ((nwake != 1) || (nrequeue < 0) || (uaddr == uaddr2))
+        return -EINVAL;
+    process p = current->p;
+    futex_bucket b = futex_get_bucket(p, uaddr);
+    futex_bucket b2 = futex_get_bucket(p, uaddr2);
+    sysreturn rv;
+    futex_lock_buckets(b, b2);
+    if (*uaddr != val3) {
+        rv = -EAGAIN;
+        goto out;
+    }
+    int woken = 0, requeued = 0;
+    list_foreach(&b->waiters, l) {
+        futex_waiter w = struct_from_list(l, futex_waiter, l);
+        if (!futex_match(w, p, uaddr, FUTEX_BITSET_MATCH_ANY))
+            continue;
+        if (w->requeue_pi != uaddr2) {
+            rv = -EINVAL;
+            goto out;
+        }
+        if (woken + requeued == 0) {
+            rv = futex_pi_trylock(b2, p, uaddr2, w->t->tid, true);
+            if (rv < 0)
+                goto out;
+            if (rv == 1) {
+                w->uaddr = uaddr2;
+                w->pi = true;
+                futex_wake_waiter(w);
+                woken++;
+                continue;
+            }
+        }
+        if (requeued >= nrequeue)
+            break;
+        list_delete(&w->l);
+        w->uaddr = uaddr2;
+        w->pi = true;
+        list_push_back(&b2->waiters, &w->l);
+        requeued++;
+    }
+    if (requeued) {
+        /* the futex is owned: either the trylock above set FUTEX_WAITERS, or a waiter acquired it */
+        u32 val;
+        do {
+            val = *(u32 *)uaddr2;
+        } while (!compare_and_swap_32((u32 *)uaddr2, val, val | FUTEX_WAITERS));
+    }
+    if (futex_verbose)
+        thread_log(current, " awoken: %d, re-queued %d", woken, requeued);
+    rv = woken + requeued;
+  out:
+    futex_unlock_buckets(b, b2);
+    return rv;
 }
 
 static timestamp get_timeout_timestamp(int futex_op, u64 val2)
@@ -144,6 +451,9 @@ static timestamp get_timeout_timestamp(int futex_op, u64 val2)
     switch (futex_op) {
     case FUTEX_WAIT:
     case FUTEX_WAIT_BITSET:
+    case FUTEX_LOCK_PI:
+    case FUTEX_LOCK_PI2:
+    case FUTEX_WAIT_REQUEUE_PI:
         return (val2) 
             ? time_from_timespec((struct timespec *)pointer_from_u64(val2)) 
             : 0;
@@ -152,22 +462,15 @@ static timestamp get_timeout_timestamp(int futex_op, u64 val2)
     }
 }
 
-static boolean futex_verbose;
-
 sysreturn futex(int *uaddr, int futex_op, int val,
                 u64 val2, int *uaddr2, int val3)
 {
-    struct futex * f;
     timestamp ts;
     int op;
 
     if (!validate_user_memory(uaddr, sizeof(int), false))
         return set_syscall_error(current, EFAULT);
 
-    f = soft_create_futex(current->p, u64_from_pointer(uaddr));
-    if (f == INVALID_ADDRESS)
-        return set_syscall_error(current, ENOMEM);
-    
     op = futex_op & 127; // chuck the private bit
     ts = get_timeout_timestamp(op, val2);
     clock_id clkid = (futex_op & FUTEX_CLOCK_REALTIME) ? CLOCK_ID_REALTIME :
@@ -178,64 +481,28 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         if (futex_verbose)
             thread_log(current, "futex_wait [%ld %p %d] %d 0x%ld",
                 current->tid, uaddr, *uaddr, val, val2);
-
-        sysreturn rv;
-        futex_lock(f);
-        if (*uaddr != val)
-            rv = -EAGAIN;
-        else
-            rv = blockq_check_timeout(f->bq, current,
-                                      contextual_closure(futex_bh, f, current, ts),
-                                      false, clkid, ts, false);
-        futex_unlock(f);
-        return rv;
+        return futex_wait(uaddr, val, FUTEX_BITSET_MATCH_ANY, clkid, ts, false);
     }
 
     case FUTEX_WAKE: {
         if (futex_verbose)
             thread_log(current, "futex_wake [%ld %p %d] %d",
                 current->tid, uaddr, *uaddr, val);
-        futex_lock(f);
-        int nr_woken = futex_wake_many(f, val);
-        futex_unlock(f);
-        return nr_woken;
+        return futex_wake(current->p, uaddr, val, FUTEX_BITSET_MATCH_ANY);
     }
 
+    case FUTEX_REQUEUE:
     case FUTEX_CMP_REQUEUE: {
-        int woken, requeued;
-
         if (!validate_user_memory(uaddr2, sizeof(int), false))
             return set_syscall_error(current, EFAULT);
 
         if (futex_verbose)
-            thread_log(current, "futex_cmp_requeue [%ld %p %d] val: %d val2: %d uaddr2: %p %d val3: %d",
-                       current->tid, uaddr, *uaddr, val, val2, uaddr2, *uaddr2, val3);
-
-        sysreturn rv;
-        futex_lock(f);
-        if (*uaddr != val3) {
-            rv = -EAGAIN;
-            goto cmp_requeue_done;
-        }
-
-        woken = futex_wake_many(f, val);
-
-        requeued = 0;
-        if (val2 > 0) {
-            struct futex * new = soft_create_futex(current->p, u64_from_pointer(uaddr2));
-            if (new == INVALID_ADDRESS) {
-                rv = -ENOMEM;
-                goto cmp_requeue_done;
-            }
-            requeued = blockq_transfer_waiters(new->bq, f->bq, val2,
-                                               stack_closure(futex_requeue_handler, new));
-            if (futex_verbose)
-                thread_log(current, " awoken: %d, re-queued %d", woken, requeued);
-        }
-        rv = woken + requeued;
-      cmp_requeue_done:
-        futex_unlock(f);
-        return rv;
+            thread_log(current, "futex_%srequeue [%ld %p %d] val: %d val2: %d uaddr2: %p %d val3: %d",
+                       (op == FUTEX_CMP_REQUEUE) ? "cmp_" : "", current->tid, uaddr, *uaddr, val,
+                       val2, uaddr2, *uaddr2, val3);
+        if ((val < 0) || ((int)val2 < 0))
+            return -EINVAL;
+        return futex_requeue(uaddr, uaddr2, val, val2, op == FUTEX_CMP_REQUEUE, val3);
     }
 
     case FUTEX_WAKE_OP: {
@@ -253,10 +520,10 @@ sysreturn futex(int *uaddr, int futex_op, int val,
                 current->tid, uaddr, *uaddr, uaddr2, cmparg, oparg, cmp, op);
         }
 
-        struct futex *f2 = soft_create_futex(current->p, u64_from_pointer(uaddr2));
-        if (f2 == INVALID_ADDRESS)
-            return -ENOMEM;
-        spin_lock_2(&f->lock, &f2->lock);
+        process p = current->p;
+        futex_bucket b = futex_get_bucket(p, uaddr);
+        futex_bucket b2 = futex_get_bucket(p, uaddr2);
+        futex_lock_buckets(b, b2);
         oldval = *(int *) uaddr2;
         
         switch (op) {
@@ -267,7 +534,7 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         case FUTEX_OP_XOR:   *uaddr2 ^= oparg; break;
         }
 
-        wake1 = futex_wake_many(f, val);
+        wake1 = futex_wake_bucket(b, p, uaddr, val, FUTEX_BITSET_MATCH_ANY);
         
         c = 0;
         switch (cmp) {
@@ -281,11 +548,10 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         
         wake2 = 0;
         if (c) {
-            wake2 = futex_wake_many(f2, val2);
+            wake2 = futex_wake_bucket(b2, p, uaddr2, val2, FUTEX_BITSET_MATCH_ANY);
         }
 
-        futex_unlock(f2);
-        futex_unlock(f);
+        futex_unlock_buckets(b, b2);
         return set_syscall_return(current, wake1 + wake2);
     }
 
@@ -293,32 +559,137 @@ sysreturn futex(int *uaddr, int futex_op, int val,
         if (futex_verbose)
             thread_log(current, "futex_wait_bitset [%ld %p %d] %d 0x%ld %d",
                 current->tid, uaddr, *uaddr, val, val2, val3);
+        if (!val3)
+            return -EINVAL;
+        return futex_wait(uaddr, val, val3, clkid, ts, true);
+    }
 
-        sysreturn rv;
-        futex_lock(f);
-        if (*uaddr != val)
-            rv = -EAGAIN;
-        else
-            rv = blockq_check_timeout(f->bq, current,
-                                      contextual_closure(futex_bh, f, current, ts),
-                                      false, clkid, ts, true);
-        futex_unlock(f);
-        return rv;
+    case FUTEX_WAKE_BITSET: {
+        if (futex_verbose)
+            thread_log(current, "futex_wake_bitset [%ld %p %d] %d %d",
+                current->tid, uaddr, *uaddr, val, val3);
+        if (!val3)
+            return -EINVAL;
+        return futex_wake(current->p, uaddr, val, val3);
+    }
+
+    case FUTEX_LOCK_PI:
+    case FUTEX_LOCK_PI2:
+    case FUTEX_TRYLOCK_PI: {
+        if (futex_verbose)
+            thread_log(current, "futex_%slock_pi [%ld %p 0x%x] 0x%lx",
+                (op == FUTEX_TRYLOCK_PI) ? "try" : "", current->tid, uaddr, *uaddr, val2);
+        if (!validate_user_memory(uaddr, sizeof(int), true))
+            return set_syscall_error(current, EFAULT);
+
+        /* FUTEX_LOCK_PI timeouts are measured against CLOCK_REALTIME */
+        if (op == FUTEX_LOCK_PI)
+            clkid = CLOCK_ID_REALTIME;
+        return futex_lock_pi(uaddr, op == FUTEX_TRYLOCK_PI, clkid, ts);
+    }
+
+    case FUTEX_UNLOCK_PI: {
+        if (futex_verbose)
+            thread_log(current, "futex_unlock_pi [%ld %p 0x%x]", current->tid, uaddr, *uaddr);
+        if (!validate_user_memory(uaddr, sizeof(int), true))
+            return set_syscall_error(current, EFAULT);
+        return futex_unlock_pi(uaddr);
+    }
+
+    case FUTEX_WAIT_REQUEUE_PI: {
+        if (!validate_user_memory(uaddr2, sizeof(int), true))
+            return set_syscall_error(current, EFAULT);
+        if (futex_verbose)
+            thread_log(current, "futex_wait_requeue_pi [%ld %p %d] %d 0x%lx uaddr2: %p",
+                current->tid, uaddr, *uaddr, val, val2, uaddr2);
+        return futex_wait_requeue_pi(uaddr, val, uaddr2, clkid, ts);
+    }
+
+    case FUTEX_CMP_REQUEUE_PI: {
+        if (!validate_user_memory(uaddr2, sizeof(int), true))
+            return set_syscall_error(current, EFAULT);
+        if (futex_verbose)
+            thread_log(current, "futex_cmp_requeue_pi [%ld %p %d] val: %d val2: %d uaddr2: %p %d val3: %d",
+                       current->tid, uaddr, *uaddr, val, val2, uaddr2, *uaddr2, val3);
+        return futex_cmp_requeue_pi(uaddr, uaddr2, val, val2, val3);
     }
 
-    case FUTEX_REQUEUE: rprintf("futex_requeue not implemented\n"); break;
-    case FUTEX_WAKE_BITSET: rprintf("futex_wake_bitset not implemented\n"); break;
-    case FUTEX_LOCK_PI: rprintf("futex_lock_pi not implemented\n"); break;
-    case FUTEX_TRYLOCK_PI: rprintf("futex_trylock_pi not implemented\n"); break;
-    case FUTEX_UNLOCK_PI: rprintf("futex_unlock_pi not implemented\n"); break;
-    case FUTEX_CMP_REQUEUE_PI: rprintf("futex_cmp_requeue_pi not implemented\n"); break;
-    case FUTEX_WAIT_REQUEUE_PI: rprintf("futex_wait_requeue_pi not implemented\n"); break;
     default: rprintf("futex op %d not implemented\n", op); break;
     }
 
     return set_syscall_error(current, ENOSYS);
 }
 
+/* Waits on up to FUTEX_WAITV_MAX 32-bit futexes at once, returning the index of a woken futex. If
+   the value of any futex does not match, no waiting takes place. */
+sysreturn futex_waitv(struct futex_waitv *waiters, unsigned int nr_futexes, unsigned int flags,
+                      struct timespec *timeout, clockid_t clockid)
+{
+    if (flags || (nr_futexes == 0) || (nr_futexes > FUTEX_WAITV_MAX))
+        return -EINVAL;
+    if (!validate_user_memory(waiters, nr_futexes * sizeof(struct futex_waitv), false))
+        return -EFAULT;
+    timestamp ts = 0;
+    clock_id clkid = CLOCK_ID_MONOTONIC;
+    if (timeout) {
+        if (!validate_user_memory(timeout, sizeof(struct timespec), false))
+            return -EFAULT;
+        switch (clockid) {
+        case CLOCK_MONOTONIC:
+            break;
+        case CLOCK_REALTIME:
+            clkid = CLOCK_ID_REALTIME;
+            break;
+        default:
+            return -EINVAL;
+        }
+        ts = time_from_timespec(timeout);
+    }
+    for (unsigned int i = 0; i < nr_futexes; i++) {
+        struct futex_waitv *fw = &waiters[i];
+        if (((fw->flags & ~FUTEX_PRIVATE_FLAG) != FUTEX_32) || fw->__reserved ||
+            (fw->uaddr & (sizeof(u32) - 1)))
+            return -EINVAL;
+        if (!validate_user_memory(pointer_from_u64(fw->uaddr), sizeof(u32), false))
+            return -EFAULT;
+    }
+    if (futex_verbose)
+        thread_log(current, "futex_waitv [%ld %p %d]", current->tid, waiters, nr_futexes);
+
+    heap h = heap_locked(get_kernel_heaps());
+    futex_waiter w = allocate(h, nr_futexes * sizeof(struct futex_waiter));
+    if (w == INVALID_ADDRESS)
+        return -ENOMEM;
+    process p = current->p;
+    sysreturn rv = 0;
+    unsigned int queued;
+    for (queued = 0; queued < nr_futexes; queued++) {
+        int *uaddr = pointer_from_u64(waiters[queued].uaddr);
+        futex_waiter_init(&w[queued], uaddr, FUTEX_BITSET_MATCH_ANY);
+        futex_bucket b = futex_get_bucket(p, uaddr);
+        spin_lock(&b->lock);
+        if (*(u32 *)uaddr != (u32)waiters[queued].val) {
+            spin_unlock(&b->lock);
+            rv = -EAGAIN;
+            break;
+        }
+        list_push_back(&b->waiters, &w[queued].l);
+        spin_unlock(&b->lock);
+    }
+    if (rv) {
+        for (unsigned int i = 0; i < queued; i++)
+            futex_dequeue(&w[i]);
+        int index = futex_woken_index(w, queued);
+        if (index >= 0)
+            rv = index;
+        deallocate(h, w, nr_futexes * sizeof(struct futex_waiter));
+        return rv;
+    }
+    return blockq_check_timeout(current->thread_bq, current,
+                                contextual_closure(futex_bh, w, nr_futexes, true, current, ts),
+                                false, clkid, ts, true);
+}
+
 closure_function(0, 1, boolean, futex_trace_notify,
                  value, v)
 {
@@ -330,15 +701,23 @@ void
 init_futices(process p)
 {
     heap h = heap_locked(&p->uh->kh);
-    p->futices = allocate_table(h, futex_key_function, futex_key_equal);
-    if (p->futices == INVALID_ADDRESS)
-        halt("failed to allocate futex table\n");
+    if (!futex_buckets) {
+        u64 nbuckets = U64_FROM_BIT(find_order(MAX(present_processors, 1) *
+                                               FUTEX_BUCKETS_PER_CPU));
+        futex_buckets = allocate(h, nbuckets * sizeof(struct futex_bucket));
+        if (futex_buckets == INVALID_ADDRESS)
+            halt("failed to allocate futex hash table\n");
+        for (u64 i = 0; i < nbuckets; i++) {
+            spin_lock_init(&futex_buckets[i].lock);
+            list_init(&futex_buckets[i].waiters);
+        }
+        futex_hash_order = find_order(nbuckets);
+    }
     register_root_notify(sym(futex_trace), closure(h, futex_trace_notify));
 }
 
 /* robust mutex handling */
 
-#define FUTEX_OWNER_DIED	0x40000000
 #define FUTEX_KEY_ADDR(x, o)    ((int *)((u8 *)(x) + (o)))
 
 typedef struct robust_list {
@@ -1,9 +1,23 @@
+#include <net_system_structs.h>
 #include <unix_internal.h>
+#include <filesystem.h>
+#include <socket.h>
 
+#define IORING_SETUP_IOPOLL     (1 << 0)
+#define IORING_SETUP_SQPOLL     (1 << 1)
+#define IORING_SETUP_SQ_AFF     (1 << 2)
 #define IORING_SETUP_CQSIZE     (1 << 3)
 
 #define IORING_FEAT_SINGLE_MMAP     (1 << 0)
 #define IORING_FEAT_RW_CUR_POS      (1 << 3)
+#define IORING_FEAT_SQPOLL_NONFIXED (1 << 7)
+#define IORING_FEAT_CQE_SKIP        (1 << 11)
+
+#define IORING_SQ_NEED_WAKEUP   (1 << 0)
+
+#define IORING_CQE_F_BUFFER     (1 << 0)
+#define IORING_CQE_F_MORE       (1 << 1)
+#define IORING_CQE_BUFFER_SHIFT 16
 
 #define IORING_OFF_SQ_RING  0ULL
 #define IORING_OFF_CQ_RING  0x8000000ULL
@@ -11,16 +25,37 @@
 
 #define IORING_TIMEOUT_ABS  (1 << 0)
 
+#define IORING_POLL_ADD_MULTI   (1 << 0)
+
+#define IORING_RECV_MULTISHOT   (1 << 1)
+#define IORING_ACCEPT_MULTISHOT (1 << 0)
+
 #define IORING_ENTER_GETEVENTS  (1 << 0)
+#define IORING_ENTER_SQ_WAKEUP  (1 << 1)
 
 #define IO_URING_OP_SUPPORTED   (1 << 0)
 
 #define IOUR_SQ_ENTRIES_MAX 0x40000000UL
 #define IOUR_CQ_ENTRIES_MAX (2 * IOUR_SQ_ENTRIES_MAX)
 #define IOUR_FILES_MAX      0x8000
+#define IOUR_BUF_MAX        (1ull << 30)    /* maximum length of a registered buffer */
 
-#define IOSQE_FIXED_FILE    (1 << 0)
-#define IOSQE_ASYNC         (1 << 4)
+#define IOUR_SQ_THREAD_IDLE_DEFAULT 1000    /* milliseconds */
+
+#define IOUR_PROVIDE_BUFFERS_MAX    0x10000
+#define IOUR_PBUF_RING_ENTRIES_MAX  0x8000
+
+#define IOSQE_FIXED_FILE        (1 << 0)
+#define IOSQE_IO_DRAIN          (1 << 1)
+#define IOSQE_IO_LINK           (1 << 2)
+#define IOSQE_IO_HARDLINK       (1 << 3)
+#define IOSQE_ASYNC             (1 << 4)
+#define IOSQE_BUFFER_SELECT     (1 << 5)
+#define IOSQE_CQE_SKIP_SUCCESS  (1 << 6)
+
+/* SQE flags that require tracking a request until its completion */
+#define IOUR_REQ_FLAGS  (IOSQE_IO_DRAIN | IOSQE_IO_LINK | IOSQE_IO_HARDLINK | IOSQE_BUFFER_SELECT | \
+                         IOSQE_CQE_SKIP_SUCCESS)
 
 //#define IOUR_DEBUG
 #ifdef IOUR_DEBUG
@@ -46,10 +81,12 @@ struct io_uring_sqe {
         u32 sync_range_flags;
         u32 msg_flags;
         u32 timeout_flags;
+        u32 accept_flags;
     };
     u64 user_data;
     union{
         u16 buf_index;
+        u16 buf_group;      /* for IOSQE_BUFFER_SELECT */
         u64 __pad2[3];
     };
 };
@@ -85,6 +122,15 @@ enum iour_enter_opcode {
     IORING_OP_STATX,
     IORING_OP_READ,
     IORING_OP_WRITE,
+    IORING_OP_FADVISE,
+    IORING_OP_MADVISE,
+    IORING_OP_SEND,
+    IORING_OP_RECV,
+    IORING_OP_OPENAT2,
+    IORING_OP_EPOLL_CTL,
+    IORING_OP_SPLICE,
+    IORING_OP_PROVIDE_BUFFERS,
+    IORING_OP_REMOVE_BUFFERS,
     IORING_OP_LAST,
 };
 
@@ -98,6 +144,21 @@ enum iour_register_opcode {
     IORING_REGISTER_FILES_UPDATE,
     IORING_REGISTER_EVENTFD_ASYNC,
     IORING_REGISTER_PROBE,
+    IORING_REGISTER_PERSONALITY,
+    IORING_UNREGISTER_PERSONALITY,
+    IORING_REGISTER_RESTRICTIONS,
+    IORING_REGISTER_ENABLE_RINGS,
+    IORING_REGISTER_FILES2,
+    IORING_REGISTER_FILES_UPDATE2,
+    IORING_REGISTER_BUFFERS2,
+    IORING_REGISTER_BUFFERS_UPDATE,
+    IORING_REGISTER_IOWQ_AFF,
+    IORING_UNREGISTER_IOWQ_AFF,
+    IORING_REGISTER_IOWQ_MAX_WORKERS,
+    IORING_REGISTER_RING_FDS,
+    IORING_UNREGISTER_RING_FDS,
+    IORING_REGISTER_PBUF_RING,
+    IORING_UNREGISTER_PBUF_RING,
 };
 
 struct io_uring_files_update {
@@ -121,6 +182,24 @@ struct io_uring_probe {
     struct io_uring_probe_op ops[0];
 };
 
+struct io_uring_buf {
+    u64 addr;
+    u32 len;
+    u16 bid;
+    u16 resv;
+};
+
+/* The tail of a buffer ring, written by userspace, overlays the resv field of the first entry. */
+#define IOUR_PBUF_RING_TAIL(ring)   (((volatile u16 *)(ring))[7])
+
+struct io_uring_buf_reg {
+    u64 ring_addr;
+    u32 ring_entries;
+    u16 bgid;
+    u16 flags;
+    u64 resv[3];
+};
+
 typedef struct io_rings {
     u32 sq_head, sq_tail;
     u32 sq_mask, sq_entries;
@@ -135,11 +214,33 @@ typedef struct io_rings {
 declare_closure_struct(1, 2, sysreturn, iour_close,
                        struct io_uring *, iour,
                        thread, t, io_completion, completion);
+declare_closure_function(1, 0, void, iour_sqpoll,
+                         struct io_uring *, iour);
+declare_closure_function(1, 0, void, iour_sqpoll_run,
+                         struct io_uring *, iour);
+
+/* Registered buffers: a buffer in anonymous memory has its pages pinned, so that fixed reads and
+ * writes on regular files can transfer data directly between the storage device and the buffer.
+ * The table is referenced by in-flight direct operations, and outlives unregistration until they
+ * complete. */
+typedef struct iour_buf {
+    void *base;
+    u64 len;
+    u64 *phys;      /* physical address of each page, or zero if not pinned */
+} *iour_buf;
+
+typedef struct iour_buftable {
+    heap h;
+    u32 count;
+    word refcount;
+    struct iour_buf bufs[0];
+} *iour_buftable;
 
 typedef struct io_uring {
     struct fdesc f;    /* must be first */
     heap h;
     heap vh;
+    u32 flags;
     u32 sq_mask, sq_entries;
     u32 cq_mask, cq_entries;
     io_rings rings;
@@ -149,8 +250,7 @@ typedef struct io_uring {
     u64 phys;
     io_rings user_rings;
     closure_struct(iour_close, close);
-    struct iovec *bufs;
-    u32 buf_count;
+    iour_buftable bufs;
     fdesc *files;
     u32 file_count;
     blockq bq;
@@ -159,9 +259,39 @@ typedef struct io_uring {
     boolean eventfd_async;
     struct list pollers;
     struct list timers;
+    struct list sock_ops;
     u32 cq_timeouts;
     u64 noncancelable_ops;
 
+    /* Requests being executed; requests waiting for a predecessor in a link chain or queued behind
+     * a drain request (in drain_queue) are not counted until they are issued. */
+    u64 inflight;
+    struct list drain_queue;
+    boolean drain_active;   /* a request submitted with IOSQE_IO_DRAIN is in flight */
+
+    struct list buf_groups;
+
+    /* IOPOLL: filesystems of the files targeted by polled I/O, and number of polled requests in
+     * flight */
+    vector iopoll_fs;
+    u64 iopoll_inflight;
+
+    /* SQPOLL: the submission queue is polled by a kernel task running on behalf of the thread
+     * that created the io_uring instance, which counts as a non-cancelable operation while
+     * scheduled, and goes idle (setting IORING_SQ_NEED_WAKEUP) after finding no work for
+     * sqp_idle. */
+    thread sqp_thread;
+    int sqp_cpu;            /* CPU the poller is bound to, or -1 */
+    timestamp sqp_idle;
+    timestamp sqp_last_active;
+    boolean sqp_scheduled;
+    closure_struct(iour_sqpoll, sqp_poll);
+    closure_struct(iour_sqpoll_run, sqp_run);
+
+    /* Set when close() is called: scheduled SQ poller passes stop, and deferred requests are
+     * canceled instead of being issued. */
+    boolean closing;
+
     /* When true, the io_uring context is being shut down in the background,
      * i.e. no thread is blocked on close() and the context will be deallocated
      * when its last non-cancelable operation is completed. This can happen if
@@ -172,6 +302,51 @@ typedef struct io_uring {
     io_completion shutdown_completion;
 } *io_uring;
 
+declare_closure_struct(1, 0, void, iour_req_issue,
+                       struct iour_req *, req);
+declare_closure_struct(1, 0, void, iour_req_run,
+                       struct iour_req *, req);
+
+/* Request whose SQE flags affect its completion or the execution of other requests. Such a
+ * request holds a copy of its SQE, so that it can be issued after the submission call returns if
+ * it has to wait for a predecessor in a link chain or for a drain request; deferred requests are
+ * issued in a syscall context running on behalf of the submitting thread. */
+typedef struct iour_req {
+    struct list l;              /* in drain_queue */
+    io_uring iour;
+    thread t;
+    struct iour_req *next;      /* next request in the link chain */
+    int refcount;               /* one for the execution, one while the chain is being built */
+    boolean done;
+    boolean failed;             /* breaks the link chain */
+    boolean buf_selected;
+    u16 buf_head;               /* ring position of a selected ring buffer */
+    u16 bid;
+    u32 buf_len;
+    u64 buf_addr;
+    struct io_uring_sqe sqe;
+    closure_struct(iour_req_issue, issue);
+    closure_struct(iour_req_run, run);
+} *iour_req;
+
+struct iour_pbuf {
+    u64 addr;
+    u32 len;
+    u16 bid;
+};
+
+/* Buffers available to requests submitted with IOSQE_BUFFER_SELECT: either handed to the kernel
+ * with IORING_OP_PROVIDE_BUFFERS, or published by userspace in a ring registered with
+ * IORING_REGISTER_PBUF_RING. */
+typedef struct iour_buf_group {
+    struct list l;
+    u16 bgid;
+    struct io_uring_buf *ring;  /* zero for provided buffers */
+    u32 ring_mask;
+    u16 head;
+    buffer bufs;                /* provided buffers (struct iour_pbuf), in FIFO order */
+} *iour_buf_group;
+
 declare_closure_struct(2, 2, boolean, iour_poll_notify,
                        io_uring, iour, struct iour_poll *, p,
                        u64, events, void *, arg);
@@ -179,10 +354,12 @@ declare_closure_struct(2, 2, boolean, iour_poll_notify,
 typedef struct iour_poll {
     struct list l;
     u64 user_data;
+    iour_req req;
     fdesc f;
     notify_entry ne;
     closure_struct(iour_poll_notify, handler);
     u64 events;
+    boolean multishot;
 } *iour_poll;
 
 declare_closure_struct(2, 2, void, iour_timeout,
@@ -193,10 +370,50 @@ typedef struct iour_timer {
     struct list l;
     unsigned int target;
     u64 user_data;
+    iour_req req;       /* zero once completed or discarded */
     struct timer t;
     closure_struct(iour_timeout, handler);
 } *iour_timer;
 
+declare_closure_struct(1, 2, boolean, iour_sock_notify,
+                       struct iour_sock_op *, op,
+                       u64, events, void *, arg);
+declare_closure_struct(1, 0, void, iour_sock_retry,
+                       struct iour_sock_op *, op);
+
+/* Socket operation waiting for the socket to become ready. The op is owned by whoever set the
+ * scheduled flag: the submitter, a notify handler that queued a retry, or the close path
+ * canceling it. */
+typedef struct iour_sock_op {
+    struct list l;
+    io_uring iour;
+    struct sock *s;
+    thread t;
+    u8 opcode;
+    u64 user_data;
+    iour_req req;
+    int flags;
+    boolean multishot;
+    boolean buf_select;     /* for RECV, selects a buffer when the socket becomes readable */
+    u32 buf_len;
+    struct sockaddr *addr;  /* for CONNECT, zero once the connection is in progress */
+    socklen_t *addrlen;
+    socklen_t connect_addrlen;
+    struct msghdr *msg;
+    struct msghdr hdr;      /* for SEND and RECV */
+    struct iovec iov;
+    u64 events;
+    notify_entry ne;
+    closure_struct(iour_sock_notify, notify);
+    closure_struct(iour_sock_retry, retry);
+    boolean scheduled;
+    boolean canceled;
+} *iour_sock_op;
+
+static void iour_sock_op_complete(iour_sock_op op, sysreturn rv);
+static void iour_sqpoll_wake(io_uring iour);
+static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe, iour_req req);
+
 /* Mmapped region layout:
  * - Region 1
  *   - struct io_rings
@@ -221,6 +438,56 @@ typedef struct iour_timer {
 #define iour_lock(iour)     spin_lock(&(iour)->f.lock)
 #define iour_unlock(iour)   spin_unlock(&(iour)->f.lock)
 
+static void iour_buf_group_free(io_uring iour, iour_buf_group g)
+{
+    if (g->bufs)
+        deallocate_buffer(g->bufs);
+    deallocate(iour->h, g, sizeof(*g));
+}
+
+/* Called with the lock held. */
+static void iour_req_release(io_uring iour, iour_req req)
+{
+    if (--req->refcount == 0) {
+        thread_release(req->t);
+        deallocate(iour->h, req, sizeof(*req));
+    }
+}
+
+/* Drops a request that will not complete because the io_uring instance is being closed, along
+ * with the rest of its link chain. Called with the lock held. */
+static void iour_req_discard(io_uring iour, iour_req req)
+{
+    while (req) {
+        iour_req next = req->next;
+        req->next = 0;
+        req->done = req->failed = true;
+        iour_req_release(iour, req);
+        req = next;
+    }
+}
+
+static u64 iour_buf_npages(iour_buf b)
+{
+    u64 start = u64_from_pointer(b->base) & ~PAGEMASK;
+    return (pad(u64_from_pointer(b->base) + b->len, PAGESIZE) - start) >> PAGELOG;
+}
+
+static void iour_buftable_release(iour_buftable bt)
+{
+    if (fetch_and_add(&bt->refcount, -1) != 1)
+        return;
+    for (u32 i = 0; i < bt->count; i++) {
+        iour_buf b = &bt->bufs[i];
+        if (b->phys) {
+            u64 npages = iour_buf_npages(b);
+            unpin_pages(b->phys, npages);
+            deallocate(bt->h, b->phys, npages * sizeof(u64));
+        }
+    }
+    deallocate(bt->h, bt, sizeof(*bt) + bt->count * sizeof(struct iour_buf));
+}
+
 static void iour_release(io_uring iour)
 {
     iour_debug("completion %p", iour->shutdown_completion);
@@ -230,8 +497,18 @@ static void iour_release(io_uring iour)
                 fdesc_put(iour->files[i]);
         deallocate(iour->h, iour->files, sizeof(fdesc) * iour->file_count);
     }
-    if (iour->buf_count)
-        deallocate(iour->h, iour->bufs, sizeof(struct iovec) * iour->buf_count);
+    if (iour->bufs)
+        iour_buftable_release(iour->bufs);
+    if (iour->iopoll_fs) {
+        filesystem fs;
+        vector_foreach(iour->iopoll_fs, fs)
+            filesystem_release(fs);
+        deallocate_vector(iour->iopoll_fs);
+    }
+    if (iour->sqp_thread)
+        thread_release(iour->sqp_thread);
+    list_foreach(&iour->buf_groups, l)
+        iour_buf_group_free(iour, struct_from_list(l, iour_buf_group, l));
     u64 alloc_size = IOUR_ALLOC_SIZE(iour);
     unmap(u64_from_pointer(iour->user_rings), alloc_size);
     release_fdesc(&iour->f);
@@ -286,8 +563,15 @@ define_closure_function(1, 2, sysreturn, iour_close,
     iour_debug("iour %p", iour);
 
     iour_lock(iour);
+    iour->closing = true;
+    list_foreach(&iour->drain_queue, l) {
+        list_delete(l);
+        iour_req_discard(iour, struct_from_list(l, iour_req, l));
+    }
     list_foreach(&iour->timers, l) {
         iour_timer iour_tim = struct_from_list(l, iour_timer, l);
+        iour_req_discard(iour, iour_tim->req);
+        iour_tim->req = 0;
         iour_timer_remove(iour, iour_tim);
     }
 
@@ -300,9 +584,29 @@ define_closure_function(1, 2, sysreturn, iour_close,
         iour_poll poller = struct_from_list(l, iour_poll, l);
         notify_remove(poller->f->ns, poller->ne, false);
         fdesc_put(poller->f);
+        if (poller->req) {
+            iour_lock(iour);
+            iour_req_discard(iour, poller->req);
+            iour_unlock(iour);
+        }
         deallocate(iour->h, poller, sizeof(*poller));
     }
 
+    /* Socket operations being retried are canceled by their owner when the retry completes. */
+    list_init(&deleted_items);
+    iour_lock(iour);
+    list_foreach(&iour->sock_ops, l) {
+        iour_sock_op op = struct_from_list(l, iour_sock_op, l);
+        op->canceled = true;
+        if (compare_and_swap_boolean(&op->scheduled, false, true)) {
+            list_delete(l);
+            list_push_back(&deleted_items, l);
+        }
+    }
+    iour_unlock(iour);
+    list_foreach(&deleted_items, l)
+        iour_sock_op_complete(struct_from_list(l, iour_sock_op, l), -ECANCELED);
+
     iour_lock(iour);
     if (iour->eventfd) {
         fdesc_put(iour->eventfd);
@@ -354,8 +658,12 @@ sysreturn io_uring_setup(unsigned int entries, struct io_uring_params *params)
     iour_debug("entries %d, flags 0x%x, CQ entries %d", entries, params->flags,
                params->cq_entries);
     if ((entries == 0) || (entries > IOUR_SQ_ENTRIES_MAX) ||
-            (params->flags & ~IORING_SETUP_CQSIZE) || params->resv[0] ||
-            params->resv[1] || params->resv[2] || params->resv[3])
+            (params->flags & ~(IORING_SETUP_IOPOLL | IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF |
+                               IORING_SETUP_CQSIZE)) ||
+            params->resv[0] || params->resv[1] || params->resv[2] || params->resv[3])
+        return -EINVAL;
+    if ((params->flags & IORING_SETUP_SQ_AFF) && (!(params->flags & IORING_SETUP_SQPOLL) ||
+                                                  (params->sq_thread_cpu >= total_processors)))
         return -EINVAL;
     params->sq_entries = U64_FROM_BIT(find_order(entries));
     if (params->flags & IORING_SETUP_CQSIZE) {
@@ -374,6 +682,7 @@ sysreturn io_uring_setup(unsigned int entries, struct io_uring_params *params)
         return -ENOMEM;
     }
     iour->h = h;
+    iour->flags = params->flags;
     iour->sq_entries = params->sq_entries;
     iour->sq_mask = iour->sq_entries - 1;
     iour->cq_entries = params->cq_entries;
@@ -401,13 +710,24 @@ sysreturn io_uring_setup(unsigned int entries, struct io_uring_params *params)
                iour->sq_array, iour->cqes, iour->sqes);
 
     iour_rings_init(iour);
-    iour->buf_count = iour->file_count = 0;
+    iour->bufs = 0;
+    iour->file_count = 0;
     iour->bq = 0;
     iour->eventfd = 0;
     list_init(&iour->pollers);
     list_init(&iour->timers);
+    list_init(&iour->sock_ops);
     iour->cq_timeouts = 0;
     iour->noncancelable_ops = 0;
+    iour->iopoll_fs = 0;
+    iour->iopoll_inflight = 0;
+    iour->inflight = 0;
+    list_init(&iour->drain_queue);
+    iour->drain_active = false;
+    list_init(&iour->buf_groups);
+    iour->sqp_thread = 0;
+    iour->sqp_scheduled = false;
+    iour->closing = false;
     iour->shutdown = false;
     iour->shutdown_completion = 0;
     init_fdesc(h, &iour->f, FDESC_TYPE_IORING);
@@ -416,13 +736,33 @@ sysreturn io_uring_setup(unsigned int entries, struct io_uring_params *params)
         ret = -ENOMEM;
         goto err3;
     }
+    if (params->flags & IORING_SETUP_IOPOLL) {
+        iour->iopoll_fs = allocate_vector(h, 1);
+        if (iour->iopoll_fs == INVALID_ADDRESS) {
+            iour->iopoll_fs = 0;
+            apply(iour->f.close, 0, io_completion_ignore);
+            return -ENOMEM;
+        }
+    }
+    if (params->flags & IORING_SETUP_SQPOLL) {
+        iour->sqp_thread = current;
+        thread_reserve(current);
+        iour->sqp_cpu = (params->flags & IORING_SETUP_SQ_AFF) ? params->sq_thread_cpu : -1;
+        iour->sqp_idle = milliseconds(params->sq_thread_idle ? params->sq_thread_idle :
+                                      IOUR_SQ_THREAD_IDLE_DEFAULT);
+        init_closure(&iour->sqp_poll, iour_sqpoll, iour);
+        init_closure(&iour->sqp_run, iour_sqpoll_run, iour);
+    }
     ret = allocate_fd(current->p, iour);
     if (ret == INVALID_PHYSICAL) {
         apply(iour->f.close, 0, io_completion_ignore);
         return -EMFILE;
     }
     iour_debug("fd %d", ret);
-    params->features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS;
+    if (iour->sqp_thread)
+        iour_sqpoll_wake(iour);
+    params->features = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_RW_CUR_POS |
+            IORING_FEAT_SQPOLL_NONFIXED | IORING_FEAT_CQE_SKIP;
     params->sq_off.head = offsetof(io_rings, sq_head);
     params->sq_off.tail = offsetof(io_rings, sq_tail);
     params->sq_off.ring_mask = offsetof(io_rings, sq_mask);
@@ -481,17 +821,17 @@ simple_closure_function(1, 2, void, iour_efd_complete,
     closure_finish();
 }
 
-static void iour_complete_locked(io_uring iour, u64 user_data, s32 res,
-                                 boolean async)
+/* Called with the lock held. */
+static void iour_post_cqe(io_uring iour, u64 user_data, s32 res, u32 cflags, boolean async)
 {
     io_rings rings = iour->rings;
-    iour_debug("user_data %ld, res %d, CQ tail %d", user_data, res,
+    iour_debug("user_data %ld, res %d, flags 0x%x, CQ tail %d", user_data, res, cflags,
                rings->cq_tail);
     if (rings->cq_tail < rings->cq_head + iour->cq_entries) {
         struct io_uring_cqe *cqe = &iour->cqes[rings->cq_tail & iour->cq_mask];
         cqe->user_data = user_data;
         cqe->res = res;
-        cqe->flags = 0;
+        cqe->flags = cflags;
         write_barrier();
         rings->cq_tail++;
     } else {
@@ -509,11 +849,208 @@ static void iour_complete_locked(io_uring iour, u64 user_data, s32 res,
     }
 }
 
-static void iour_complete(io_uring iour, u64 user_data, s32 res,
+/* Called with the lock held. */
+static iour_buf_group iour_buf_group_find(io_uring iour, u16 bgid)
+{
+    list_foreach(&iour->buf_groups, l) {
+        iour_buf_group g = struct_from_list(l, iour_buf_group, l);
+        if (g->bgid == bgid)
+            return g;
+    }
+    return 0;
+}
+
+/* Selects a buffer for a request submitted with IOSQE_BUFFER_SELECT; on input, len is the maximum
+ * length to be used (zero meaning the whole buffer). */
+static boolean iour_buf_select(io_uring iour, iour_req req, void **addr, u32 *len)
+{
+    boolean selected = false;
+    iour_lock(iour);
+    iour_buf_group g = iour_buf_group_find(iour, req->sqe.buf_group);
+    if (g && g->ring) {
+        u16 tail = IOUR_PBUF_RING_TAIL(g->ring);
+        read_barrier();
+        if (g->head != tail) {
+            struct io_uring_buf *b = &g->ring[g->head & g->ring_mask];
+            req->buf_addr = b->addr;
+            req->buf_len = b->len;
+            req->bid = b->bid;
+            req->buf_head = g->head++;
+            selected = true;
+        }
+    } else if (g && (buffer_length(g->bufs) >= sizeof(struct iour_pbuf))) {
+        struct iour_pbuf pb;
+        buffer_read(g->bufs, &pb, sizeof(pb));
+        req->buf_addr = pb.addr;
+        req->buf_len = pb.len;
+        req->bid = pb.bid;
+        selected = true;
+    }
+    req->buf_selected = selected;
+    iour_unlock(iour);
+    if (!selected)
+        return false;
+    iour_debug("buffer %d from group %d", req->bid, req->sqe.buf_group);
+    *addr = pointer_from_u64(req->buf_addr);
+    if ((*len == 0) || (*len > req->buf_len))
+        *len = req->buf_len;
+    return true;
+}
+
+/* Returns a selected buffer to its group. A ring buffer can only be returned if no other buffer
+ * has been taken from the ring in the meantime. Called with the lock held. */
+static void iour_buf_recycle_locked(io_uring iour, iour_req req)
+{
+    req->buf_selected = false;
+    iour_buf_group g = iour_buf_group_find(iour, req->sqe.buf_group);
+    if (!g)
+        return;
+    if (g->ring) {
+        if ((u16)(req->buf_head + 1) == g->head)
+            g->head--;
+    } else {
+        struct iour_pbuf pb = {
+            .addr = req->buf_addr,
+            .len = req->buf_len,
+            .bid = req->bid,
+        };
+        buffer_write(g->bufs, &pb, sizeof(pb));
+    }
+}
+
+static void iour_buf_recycle(io_uring iour, iour_req req)
+{
+    iour_lock(iour);
+    iour_buf_recycle_locked(iour, req);
+    iour_unlock(iour);
+}
+
+/* Called with the lock held. */
+static void iour_req_schedule(io_uring iour, iour_req req)
+{
+    iour_debug("user_data %ld", req->sqe.user_data);
+    iour->inflight++;
+    fetch_and_add(&iour->noncancelable_ops, 1);
+    assert(enqueue_irqsafe(current_cpu()->thread_queue, (thunk)&req->issue));
+}
+
+/* Completes the requests of a link chain that will not be issued. Called with the lock held. */
+static void iour_req_cancel_chain(io_uring iour, iour_req req, boolean async)
+{
+    while (req) {
+        iour_post_cqe(iour, req->sqe.user_data, -ECANCELED, 0, async);
+        iour_req next = req->next;
+        req->next = 0;
+        req->done = req->failed = true;
+        iour_req_release(iour, req);
+        req = next;
+    }
+}
+
+/* Short reads and writes break a link chain like errors do. */
+static boolean iour_req_failed(iour_req req, s32 res)
+{
+    if (res < 0)
+        return true;
+    switch (req->sqe.opcode) {
+    case IORING_OP_READ:
+    case IORING_OP_WRITE:
+    case IORING_OP_READ_FIXED:
+    case IORING_OP_WRITE_FIXED:
+        return !(req->sqe.flags & IOSQE_BUFFER_SELECT) && (res < req->sqe.len);
+    default:
+        return false;
+    }
+}
+
+/* Called with the lock held. */
+static void iour_req_done(io_uring iour, iour_req req, s32 res, boolean async)
+{
+    req->done = true;
+    req->failed = iour_req_failed(req, res);
+    if (req->sqe.flags & IOSQE_IO_DRAIN)
+        iour->drain_active = false;
+    iour_req next = req->next;
+    if (next) {
+        req->next = 0;
+        if (iour->closing || (req->failed && !(req->sqe.flags & IOSQE_IO_HARDLINK)))
+            iour_req_cancel_chain(iour, next, async);
+        else
+            iour_req_schedule(iour, next);
+    }
+    iour_req_release(iour, req);
+}
+
+/* Issues the requests in the drain queue that no longer have to wait. Called with the lock
+ * held. */
+static void iour_drain_service(io_uring iour)
+{
+    list l;
+    while (!iour->drain_active && (l = list_get_next(&iour->drain_queue))) {
+        iour_req req = struct_from_list(l, iour_req, l);
+        if (req->sqe.flags & IOSQE_IO_DRAIN) {
+            if (iour->inflight)
+                break;
+            iour->drain_active = true;
+        }
+        list_delete(l);
+        iour_req_schedule(iour, req);
+    }
+}
+
+/* Posts a completion for a request (unless skipped via IOSQE_CQE_SKIP_SUCCESS); cflags include
+ * IORING_CQE_F_MORE for all but the last completion of a multishot request. Called with the lock
+ * held. */
+static void iour_complete_locked(io_uring iour, iour_req req, u64 user_data, s32 res, u32 cflags,
+                                 boolean async)
+{
+    if (req && req->buf_selected) {
+        if (res < 0)
+            iour_buf_recycle_locked(iour, req);
+        else
+            cflags |= IORING_CQE_F_BUFFER | (req->bid << IORING_CQE_BUFFER_SHIFT);
+        req->buf_selected = false;
+    }
+    if (!req || (res < 0) || !(req->sqe.flags & IOSQE_CQE_SKIP_SUCCESS))
+        iour_post_cqe(iour, user_data, res, cflags, async);
+    if (cflags & IORING_CQE_F_MORE)
+        return;
+    if (req)
+        iour_req_done(iour, req, res, async);
+    iour->inflight--;
+    if (!list_empty(&iour->drain_queue))
+        iour_drain_service(iour);
+}
+
+/* Releases the lock and wakes up the thread waiting for completions, if any. */
+static void iour_unlock_and_wake(io_uring iour)
+{
+    blockq bq = iour->bq;
+    if (bq)
+        blockq_reserve(bq);
+    iour_unlock(iour);
+    if (bq) {
+        blockq_wake_one(bq);
+        blockq_release(bq);
+    }
+}
+
+/* Ends a non-cancelable operation that does not post a completion. */
+static void iour_noncancelable_done(io_uring iour)
+{
+    iour_lock(iour);
+    if ((fetch_and_add(&iour->noncancelable_ops, -1) == 1) && iour->shutdown) {
+        iour_release(iour);
+        return;
+    }
+    iour_unlock_and_wake(iour);
+}
+
+static void iour_complete(io_uring iour, iour_req req, u64 user_data, s32 res, u32 cflags,
                           boolean async, boolean noncancelable)
 {
     iour_lock(iour);
-    iour_complete_locked(iour, user_data, res, async);
+    iour_complete_locked(iour, req, user_data, res, cflags, async);
     if (noncancelable) {
         if ((fetch_and_add(&iour->noncancelable_ops, -1) == 1) &&
                 iour->shutdown) {
@@ -530,7 +1067,8 @@ check_timers:
             list_delete(l);
             list_push_back(&deleted_timers, l);
             iour->cq_timeouts++;
-            iour_complete_locked(iour, iour_tim->user_data, 0, async);
+            iour_complete_locked(iour, iour_tim->req, iour_tim->user_data, 0, 0, async);
+            iour_tim->req = 0;
 
             /* Increment the target of any remaining timers, to compensate the
              * CQ tail increment due to the just completed timeout, then go
@@ -556,48 +1094,46 @@ check_timers:
     }
 }
 
-static void iour_complete_timeout(io_uring iour, u64 user_data)
+static void iour_complete_timeout(io_uring iour, iour_req req, u64 user_data)
 {
     iour_lock(iour);
     iour->cq_timeouts++;
-    iour_complete_locked(iour, user_data, -ETIME, true);
-    blockq bq = iour->bq;
-    if (bq)
-        blockq_reserve(bq);
-    iour_unlock(iour);
-    if (bq) {
-        blockq_wake_one(bq);
-        blockq_release(bq);
-    }
+    iour_complete_locked(iour, req, user_data, -ETIME, 0, true);
+    iour_unlock_and_wake(iour);
 }
 
-closure_function(3, 2, void, iour_rw_complete,
-                 io_uring, iour, fdesc, f, u64, user_data,
+closure_function(4, 2, void, iour_rw_complete,
+                 io_uring, iour, fdesc, f, u64, user_data, iour_req, req,
                  thread, t, sysreturn, rv)
 {
+    io_uring iour = bound(iour);
     fdesc_put(bound(f));
-    iour_complete(bound(iour), bound(user_data), rv, true, true);
+    if (iour->flags & IORING_SETUP_IOPOLL)
+        fetch_and_add(&iour->iopoll_inflight, -1);
+    iour_complete(iour, bound(req), bound(user_data), rv, 0, true, true);
     context_release_refcount(get_current_context(current_cpu()));
     closure_finish();
 }
 
 static void iour_iov(io_uring iour, fdesc f, boolean write, struct iovec *iov,
-                     u32 len, u64 off, u64 user_data)
+                     u32 len, u64 off, u64 user_data, iour_req req)
 {
     io_completion completion = closure(iour->h, iour_rw_complete, iour, f,
-        user_data);
+        user_data, req);
     if (completion == INVALID_ADDRESS) {
         fdesc_put(f);
-        iour_complete(iour, user_data, -ENOMEM, false, false);
+        iour_complete(iour, req, user_data, -ENOMEM, 0, false, false);
     } else {
         context_reserve_refcount(get_current_context(current_cpu()));
         fetch_and_add(&iour->noncancelable_ops, 1);
+        if (iour->flags & IORING_SETUP_IOPOLL)
+            fetch_and_add(&iour->iopoll_inflight, 1);
         iov_op(f, write, iov, len, off, false, completion);
     }
 }
 
 static void iour_rw(io_uring iour, fdesc f, boolean write, void *addr, u32 len,
-                    u64 offset, u64 user_data)
+                    u64 offset, u64 user_data, iour_req req)
 {
     iour_debug("%s at %p, len %d, offset %ld", write ? "write" : "read", addr,
             len, offset);
@@ -610,20 +1146,82 @@ static void iour_rw(io_uring iour, fdesc f, boolean write, void *addr, u32 len,
             (!write && !fdesc_is_readable(f))) {
         err = -EBADF;
     } else {
-        completion = closure(iour->h, iour_rw_complete, iour, f, user_data);
+        completion = closure(iour->h, iour_rw_complete, iour, f, user_data, req);
         if (completion == INVALID_ADDRESS)
             err = -ENOMEM;
     }
     if (err) {
         fdesc_put(f);
-        iour_complete(iour, user_data, err, false, false);
+        iour_complete(iour, req, user_data, err, 0, false, false);
     } else {
         context_reserve_refcount(get_current_context(current_cpu()));
         fetch_and_add(&iour->noncancelable_ops, 1);
+        if (iour->flags & IORING_SETUP_IOPOLL)
+            fetch_and_add(&iour->iopoll_inflight, 1);
         apply(op, addr, len, offset, current, true, completion);
     }
 }
 
+/* A fixed read or write on a regular file bypasses the page cache if the buffer is pinned and
+ * the transfer is aligned to the filesystem block size. */
+static boolean iour_fixed_direct_eligible(fdesc f, iour_buf b, void *buf, u32 len, u64 offset)
+{
+    if ((f->type != FDESC_TYPE_REGULAR) || !b->phys || (len == 0) || (offset == -1ull))
+        return false;
+    u64 mask = fs_blocksize(((file)f)->fs) - 1;
+    return !((u64_from_pointer(buf) | len | offset) & mask);
+}
+
+closure_function(5, 2, void, iour_rw_direct_complete,
+                 io_uring, iour, fdesc, f, iour_buftable, bt, u64, user_data, iour_req, req,
+                 thread, t, sysreturn, rv)
+{
+    io_uring iour = bound(iour);
+    iour_buftable_release(bound(bt));
+    fdesc_put(bound(f));
+    if (iour->flags & IORING_SETUP_IOPOLL)
+        fetch_and_add(&iour->iopoll_inflight, -1);
+    iour_complete(iour, bound(req), bound(user_data), rv, 0, true, true);
+    context_release_refcount(get_current_context(current_cpu()));
+    closure_finish();
+}
+
+static void iour_rw_direct(io_uring iour, fdesc f, boolean write, iour_buftable bt, iour_buf b,
+                           void *buf, u32 len, u64 offset, u64 user_data, iour_req req)
+{
+    iour_debug("%s at %p, len %d, offset %ld", write ? "write" : "read", buf, len, offset);
+    int err = 0;
+    io_completion completion = 0;
+    sg_list sg = 0;
+    if ((write && !fdesc_is_writable(f)) || (!write && !fdesc_is_readable(f))) {
+        err = -EBADF;
+    } else {
+        u64 start = u64_from_pointer(buf);
+        u64 page = (start >> PAGELOG) - (u64_from_pointer(b->base) >> PAGELOG);
+        sg = sg_from_pinned_pages(b->phys + page, start & PAGEMASK, len);
+        if (sg == INVALID_ADDRESS) {
+            err = -ENOMEM;
+        } else {
+            completion = closure(iour->h, iour_rw_direct_complete, iour, f, bt, user_data, req);
+            if (completion == INVALID_ADDRESS) {
+                deallocate_sg_list(sg);
+                err = -ENOMEM;
+            }
+        }
+    }
+    if (err) {
+        iour_buftable_release(bt);
+        fdesc_put(f);
+        iour_complete(iour, req, user_data, err, 0, false, false);
+    } else {
+        context_reserve_refcount(get_current_context(current_cpu()));
+        fetch_and_add(&iour->noncancelable_ops, 1);
+        if (iour->flags & IORING_SETUP_IOPOLL)
+            fetch_and_add(&iour->iopoll_inflight, 1);
+        file_direct_io((file)f, sg, len, offset, write, current, completion);
+    }
+}
+
 define_closure_function(2, 2, boolean, iour_poll_notify,
                         io_uring, iour, iour_poll, p,
                         u64, events, void *, arg)
@@ -636,14 +1234,19 @@ define_closure_function(2, 2, boolean, iour_poll_notify,
     iour_lock(iour);
     boolean found = list_find(&iour->pollers, &p->l);
     if (found) {
-        list_delete(&p->l);
+        if (!p->multishot)
+            list_delete(&p->l);
     } else {
         p->events = events;
     }
     iour_unlock(iour);
-    if (found) {
+    if (found && p->multishot) {
+        /* A concurrent removal waits for this handler to return before posting the final
+         * completion. */
+        iour_complete(iour, p->req, p->user_data, events, IORING_CQE_F_MORE, true, false);
+    } else if (found) {
         iour_debug("user_data %ld, events %ld", p->user_data, events);
-        iour_complete(iour, p->user_data, events, true, false);
+        iour_complete(iour, p->req, p->user_data, events, 0, true, false);
         remove = true;
         fdesc_put(p->f);
         deallocate(iour->h, p, sizeof(*p));
@@ -651,7 +1254,10 @@ define_closure_function(2, 2, boolean, iour_poll_notify,
     return remove;
 }
 
-static void iour_poll_add(io_uring iour, fdesc f, u16 events, u64 user_data)
+/* A multishot poll request posts a completion (flagged with IORING_CQE_F_MORE) for each event
+ * notification, until it is removed. */
+static void iour_poll_add(io_uring iour, fdesc f, u16 events, boolean multishot, u64 user_data,
+                          iour_req req)
 {
     s32 err = 0;
     iour_poll p = allocate(iour->h, sizeof(*p));
@@ -660,38 +1266,46 @@ static void iour_poll_add(io_uring iour, fdesc f, u16 events, u64 user_data)
         goto done;
     }
     p->user_data = user_data;
+    p->req = req;
     p->f = f;
     p->events = 0;
+    p->multishot = multishot;
     p->ne = notify_add(f->ns, events | EPOLLERR | EPOLLHUP,
         init_closure(&p->handler, iour_poll_notify, iour, p));
     if (p->ne == INVALID_ADDRESS) {
         err = -ENOMEM;
         deallocate(iour->h, p, sizeof(*p));
+        goto done;
     }
     iour_lock(iour);
-    if (!p->events)
+    u64 notified = p->events;
+    if (!notified || multishot) {
         list_push_back(&iour->pollers, &p->l);
-    else {
+    } else {
         /* Poll events have been notified already. */
         iour_unlock(iour);
-        iour_complete(iour, p->user_data, p->events, false, false);
+        iour_complete(iour, req, p->user_data, notified, 0, false, false);
         notify_remove(p->f->ns, p->ne, false);
         fdesc_put(p->f);
         deallocate(iour->h, p, sizeof(*p));
         return;
     }
     iour_unlock(iour);
+    if (notified)
+        iour_complete(iour, req, user_data, notified, IORING_CQE_F_MORE, false, false);
 done:
     if (!err) {
         if (f->events)
             /* Check if poll events are already present. */
             notify_dispatch_for_thread(f->ns, apply(f->events, current),
                 current);
-    } else
-        iour_complete(iour, user_data, err, false, false);
+    } else {
+        fdesc_put(f);
+        iour_complete(iour, req, user_data, err, 0, false, false);
+    }
 }
 
-static void iour_poll_remove(io_uring iour, u64 addr, u64 user_data)
+static void iour_poll_remove(io_uring iour, u64 addr, u64 user_data, iour_req req)
 {
     iour_poll p = 0;
     s32 res;
@@ -706,80 +1320,318 @@ static void iour_poll_remove(io_uring iour, u64 addr, u64 user_data)
     }
     iour_unlock(iour);
     if (p) {
-        iour_complete(iour, addr, -ECANCELED, false, false);
-        res = 0;
         notify_remove(p->f->ns, p->ne, false);
+        iour_complete(iour, p->req, addr, -ECANCELED, 0, false, false);
+        res = 0;
         fdesc_put(p->f);
         deallocate(iour->h, p, sizeof(*p));
     } else
         res = -ENOENT;
-    iour_complete(iour, user_data, res, false, false);
+    iour_complete(iour, req, user_data, res, 0, false, false);
 }
 
-define_closure_function(2, 2, void, iour_timeout,
-                        io_uring, iour, iour_timer, t,
-                        u64, expiry, u64, overruns)
+/* Receives into a provided buffer, selected once the socket is readable. */
+static sysreturn iour_sock_recv_buf(iour_sock_op op)
 {
-    if (overruns == timer_disabled)
-        return;
+    struct sock *s = op->s;
+    if (!(apply(s->f.events, op->t) & op->events))
+        return -EAGAIN;
+    void *buf;
+    u32 len = op->buf_len;
+    if (!iour_buf_select(op->iour, op->req, &buf, &len))
+        return -ENOBUFS;
+    if (!validate_user_memory(buf, len, true))
+        return -EFAULT;
+    op->iov.iov_base = buf;
+    op->iov.iov_len = len;
+    sysreturn rv = s->recvmsg_nb(s, op->t, op->msg, op->flags);
+    if ((rv == -EAGAIN) || (rv == 0))
+        iour_buf_recycle(op->iour, op->req);
+    return rv;
+}
 
-    io_uring iour = bound(iour);
-    iour_timer t = bound(t);
-    iour_lock(iour);
-    boolean found = list_find(&iour->timers, &t->l);
-    if (found)
-        list_delete(&t->l);
-    iour_unlock(iour);
-    if (found) {
-        iour_debug("user_data %ld", t->user_data);
-        iour_complete_timeout(iour, t->user_data);
+static sysreturn iour_sock_try(iour_sock_op op)
+{
+    struct sock *s = op->s;
+    if (op->buf_select)
+        return iour_sock_recv_buf(op);
+    switch (op->opcode) {
+    case IORING_OP_ACCEPT:
+        return s->accept_nb(s, op->t, op->addr, op->addrlen, op->flags);
+    case IORING_OP_CONNECT:
+        return s->connect_nb(s, op->t, op->addr, op->connect_addrlen);
+    case IORING_OP_SEND:
+    case IORING_OP_SENDMSG:
+        return s->sendmsg_nb(s, op->t, op->msg, op->flags);
+    default:
+        return s->recvmsg_nb(s, op->t, op->msg, op->flags);
     }
-    deallocate(iour->h, t, sizeof(*t));
-    if ((fetch_and_add(&iour->noncancelable_ops, -1) == 1) && iour->shutdown)
-        iour_release(iour);
 }
 
-static void iour_timeout_add(io_uring iour, struct timespec *ts, u32 flags,
-                             u64 off, u64 user_data)
+/* Returns true if the operation must wait for the socket to become ready. */
+static boolean iour_sock_pending(iour_sock_op op, sysreturn rv)
 {
-    iour_debug("flags 0x%x, off %ld", flags, off);
-    int err = 0;
-    if (flags & ~IORING_TIMEOUT_ABS) {
-        err = -EINVAL;
-        goto done;
-    }
-    iour_timer iour_tim = allocate(iour->h, sizeof(*iour_tim));
-    if (iour_tim == INVALID_ADDRESS) {
-        err = -ENOMEM;
-        goto done;
+    if (op->opcode == IORING_OP_CONNECT) {
+        if (rv != -EINPROGRESS)
+            return false;
+        op->addr = 0;
+        return true;
     }
-    iour_tim->user_data = user_data;
-    init_timer(&iour_tim->t);
-    iour_lock(iour);
+    return (rv == -EAGAIN) && ((op->opcode == IORING_OP_ACCEPT) || !(op->flags & MSG_DONTWAIT));
+}
 
-    /* off == 0 indicates a pure timeout request, i.e. one not linked to
-     * completion of other requests; in this case, the target is set to the last
-     * completion (i.e. a past completion), so that it won't match future
-     * completions (until after UINT_MAX operations, at which point the timeout
-     * will have elapsed already, hopefully). */
-    iour_tim->target = iour->rings->cq_tail + off;
-    iour_debug("target %ld", iour_tim->target);
+/* Executes a socket operation until it has to wait for the socket to become ready (returning
+ * true) or it completes; each iteration of a multishot operation posts a completion. */
+static boolean iour_sock_run(iour_sock_op op, sysreturn *rv, boolean async)
+{
+    while (true) {
+        sysreturn r = iour_sock_try(op);
+        if (iour_sock_pending(op, r))
+            return true;
+        if (!op->multishot || (r < 0) || ((r == 0) && (op->opcode == IORING_OP_RECV))) {
+            *rv = r;
+            return false;
+        }
+        iour_complete(op->iour, op->req, op->user_data, r, IORING_CQE_F_MORE, async, false);
+    }
+}
 
-    /* Timeouts are counted as non-cancelable_operations because the ability to remove a kernel
-     * timer synchronously is not guaranteed in SMP machines. */
-    fetch_and_add(&iour->noncancelable_ops, 1);
+static void iour_sock_op_free(iour_sock_op op)
+{
+    fdesc_put(&op->s->f);
+    thread_release(op->t);
+    deallocate(op->iour->h, op, sizeof(*op));
+}
 
-    list_push_back(&iour->timers, &iour_tim->l);
+/* Called by the owner of an operation that has been waiting for readiness. */
+static void iour_sock_op_complete(iour_sock_op op, sysreturn rv)
+{
+    io_uring iour = op->iour;
+    u64 user_data = op->user_data;
+    iour_req req = op->req;
+    iour_debug("user_data %ld, rv %ld", user_data, rv);
+    notify_remove(op->s->f.ns, op->ne, false);
+    iour_lock(iour);
+    list_delete(&op->l);
+    iour_unlock(iour);
+    iour_sock_op_free(op);
+    iour_complete(iour, req, user_data, rv, 0, true, true);
+}
+
+/* Releases ownership of an operation waiting for readiness, unless the socket became ready (or
+ * the operation was canceled) in the meantime, in which case a retry is scheduled. */
+static void iour_sock_op_wait(iour_sock_op op)
+{
+    op->scheduled = false;
+    memory_barrier();
+    if ((op->canceled || (apply(op->s->f.events, 0) & op->events)) &&
+            compare_and_swap_boolean(&op->scheduled, false, true))
+        assert(enqueue_irqsafe(runqueue, (thunk)&op->retry));
+}
+
+define_closure_function(1, 2, boolean, iour_sock_notify,
+                        iour_sock_op, op,
+                        u64, events, void *, arg)
+{
+    iour_sock_op op = bound(op);
+
+    /* The socket operation cannot be executed here, as it may dispatch notifications to the
+     * socket notify set, whose lock is held while this handler runs. */
+    if (events && (events != NOTIFY_EVENTS_RELEASE) &&
+            compare_and_swap_boolean(&op->scheduled, false, true))
+        assert(enqueue_irqsafe(runqueue, (thunk)&op->retry));
+    return false;
+}
+
+define_closure_function(1, 0, void, iour_sock_retry,
+                        iour_sock_op, op)
+{
+    iour_sock_op op = bound(op);
+    if (op->canceled) {
+        iour_sock_op_complete(op, -ECANCELED);
+        return;
+    }
+    sysreturn rv;
+    if (iour_sock_run(op, &rv, true))
+        iour_sock_op_wait(op);
+    else
+        iour_sock_op_complete(op, rv);
+}
+
+/* Socket operations are attempted immediately; if the socket is not ready, they are retried
+ * from the socket readiness notifications, which are raised by the socket callbacks (e.g. on
+ * lwIP data reception or acknowledgement). */
+static void iour_sock_op_submit(io_uring iour, fdesc f, struct io_uring_sqe *sqe, iour_req req)
+{
+    struct sock *s = (struct sock *)f;
+    u8 opcode = sqe->opcode;
+    s32 res;
+    if (f->type != FDESC_TYPE_SOCKET) {
+        res = -ENOTSOCK;
+        goto error;
+    }
+    boolean supported;
+    switch (opcode) {
+    case IORING_OP_ACCEPT:
+        supported = !!s->accept_nb;
+        break;
+    case IORING_OP_CONNECT:
+        supported = !!s->connect_nb;
+        break;
+    case IORING_OP_SEND:
+    case IORING_OP_SENDMSG:
+        supported = !!s->sendmsg_nb;
+        break;
+    default:
+        supported = !!s->recvmsg_nb;
+    }
+    if (!supported) {
+        res = -EOPNOTSUPP;
+        goto error;
+    }
+    iour_sock_op op = allocate(iour->h, sizeof(*op));
+    if (op == INVALID_ADDRESS) {
+        res = -ENOMEM;
+        goto error;
+    }
+    op->iour = iour;
+    op->s = s;
+    op->t = current;
+    thread_reserve(op->t);
+    op->opcode = opcode;
+    op->user_data = sqe->user_data;
+    op->req = req;
+    op->multishot = false;
+    op->buf_select = false;
+    op->addr = 0;
+    op->addrlen = 0;
+    op->msg = 0;
+    switch (opcode) {
+    case IORING_OP_ACCEPT:
+        op->multishot = !!(sqe->ioprio & IORING_ACCEPT_MULTISHOT);
+        op->flags = sqe->accept_flags;
+        op->addr = pointer_from_u64(sqe->addr);
+        op->addrlen = pointer_from_u64(sqe->off);
+        break;
+    case IORING_OP_CONNECT:
+        op->flags = 0;
+        op->addr = pointer_from_u64(sqe->addr);
+        op->connect_addrlen = sqe->off;
+        break;
+    case IORING_OP_SEND:
+    case IORING_OP_RECV:
+        op->iov.iov_base = pointer_from_u64(sqe->addr);
+        op->iov.iov_len = sqe->len;
+        zero(&op->hdr, sizeof(op->hdr));
+        op->hdr.msg_iov = &op->iov;
+        op->hdr.msg_iovlen = 1;
+        op->msg = &op->hdr;
+        op->flags = sqe->msg_flags;
+        if (opcode == IORING_OP_RECV) {
+            op->multishot = !!(sqe->ioprio & IORING_RECV_MULTISHOT);
+            op->buf_select = !!(sqe->flags & IOSQE_BUFFER_SELECT);
+            op->buf_len = sqe->len;
+        }
+        break;
+    default:
+        op->msg = pointer_from_u64(sqe->addr);
+        op->flags = sqe->msg_flags;
+    }
+    op->events = ((opcode == IORING_OP_ACCEPT) || (opcode == IORING_OP_RECV) ||
+                  (opcode == IORING_OP_RECVMSG)) ? EPOLLIN : EPOLLOUT;
+    op->events |= EPOLLERR | EPOLLHUP;
+    sysreturn rv;
+    if (!iour_sock_run(op, &rv, false)) {
+        iour_sock_op_free(op);
+        iour_complete(iour, req, sqe->user_data, rv, 0, false, false);
+        return;
+    }
+    op->scheduled = true;
+    op->canceled = false;
+    init_closure(&op->retry, iour_sock_retry, op);
+    op->ne = notify_add(f->ns, op->events, init_closure(&op->notify, iour_sock_notify, op));
+    if (op->ne == INVALID_ADDRESS) {
+        iour_sock_op_free(op);
+        res = -ENOMEM;
+        goto complete;
+    }
+    iour_lock(iour);
+    list_push_back(&iour->sock_ops, &op->l);
+    fetch_and_add(&iour->noncancelable_ops, 1);
+    iour_unlock(iour);
+    iour_sock_op_wait(op);
+    return;
+  error:
+    fdesc_put(f);
+  complete:
+    iour_complete(iour, req, sqe->user_data, res, 0, false, false);
+}
+
+define_closure_function(2, 2, void, iour_timeout,
+                        io_uring, iour, iour_timer, t,
+                        u64, expiry, u64, overruns)
+{
+    if (overruns == timer_disabled)
+        return;
+
+    io_uring iour = bound(iour);
+    iour_timer t = bound(t);
+    iour_lock(iour);
+    boolean found = list_find(&iour->timers, &t->l);
+    if (found)
+        list_delete(&t->l);
+    iour_unlock(iour);
+    if (found) {
+        iour_debug("user_data %ld", t->user_data);
+        iour_complete_timeout(iour, t->req, t->user_data);
+    }
+    deallocate(iour->h, t, sizeof(*t));
+    if ((fetch_and_add(&iour->noncancelable_ops, -1) == 1) && iour->shutdown)
+        iour_release(iour);
+}
+
+static void iour_timeout_add(io_uring iour, struct timespec *ts, u32 flags,
+                             u64 off, u64 user_data, iour_req req)
+{
+    iour_debug("flags 0x%x, off %ld", flags, off);
+    int err = 0;
+    if (flags & ~IORING_TIMEOUT_ABS) {
+        err = -EINVAL;
+        goto done;
+    }
+    iour_timer iour_tim = allocate(iour->h, sizeof(*iour_tim));
+    if (iour_tim == INVALID_ADDRESS) {
+        err = -ENOMEM;
+        goto done;
+    }
+    iour_tim->user_data = user_data;
+    iour_tim->req = req;
+    init_timer(&iour_tim->t);
+    iour_lock(iour);
+
+    /* off == 0 indicates a pure timeout request, i.e. one not linked to
+     * completion of other requests; in this case, the target is set to the last
+     * completion (i.e. a past completion), so that it won't match future
+     * completions (until after UINT_MAX operations, at which point the timeout
+     * will have elapsed already, hopefully). */
+    iour_tim->target = iour->rings->cq_tail + off;
+    iour_debug("target %ld", iour_tim->target);
+
+    /* Timeouts are counted as non-cancelable_operations because the ability to remove a kernel
+     * timer synchronously is not guaranteed in SMP machines. */
+    fetch_and_add(&iour->noncancelable_ops, 1);
+
+    list_push_back(&iour->timers, &iour_tim->l);
     register_timer(kernel_timers, &iour_tim->t, CLOCK_ID_MONOTONIC,
         time_from_timespec(ts), flags & IORING_TIMEOUT_ABS, 0,
         init_closure(&iour_tim->handler, iour_timeout, iour, iour_tim));
     iour_unlock(iour);
 done:
     if (err)
-        iour_complete(iour, user_data, err, false, false);
+        iour_complete(iour, req, user_data, err, 0, false, false);
 }
 
-static void iour_timeout_remove(io_uring iour, u64 addr, u64 user_data)
+static void iour_timeout_remove(io_uring iour, u64 addr, u64 user_data, iour_req req)
 {
     iour_timer t = 0;
     s32 res;
@@ -794,19 +1646,20 @@ static void iour_timeout_remove(io_uring iour, u64 addr, u64 user_data)
     }
     iour_unlock(iour);
     if (t) {
+        iour_req treq = t->req;
         iour_timer_remove(iour, t);
-        iour_complete(iour, addr, -ECANCELED, false, false);
+        iour_complete(iour, treq, addr, -ECANCELED, 0, false, false);
         res = 0;
     } else
         res = -ENOENT;
-    iour_complete(iour, user_data, res, false, false);
+    iour_complete(iour, req, user_data, res, 0, false, false);
 }
 
-closure_function(2, 2, void, iour_close_complete,
-                 io_uring, iour, u64, user_data,
+closure_function(3, 2, void, iour_close_complete,
+                 io_uring, iour, u64, user_data, iour_req, req,
                  thread, t, sysreturn, rv)
 {
-    iour_complete(bound(iour), bound(user_data), rv, true, true);
+    iour_complete(bound(iour), bound(req), bound(user_data), rv, 0, true, true);
     closure_finish();
 }
 
@@ -853,17 +1706,149 @@ static int iour_register_files_update(io_uring iour, int *fds,
     return ret;
 }
 
-static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
+/* Polled rings only support I/O on regular files, whose completions are reaped by polling the
+ * storage devices of the filesystems being accessed. */
+static s32 iour_iopoll_check(io_uring iour, u8 opcode, fdesc f)
+{
+    switch (opcode) {
+    case IORING_OP_NOP:
+        return 0;
+    case IORING_OP_READV:
+    case IORING_OP_WRITEV:
+    case IORING_OP_READ_FIXED:
+    case IORING_OP_WRITE_FIXED:
+    case IORING_OP_READ:
+    case IORING_OP_WRITE:
+        break;
+    default:
+        return -EINVAL;
+    }
+    if (f->type != FDESC_TYPE_REGULAR)
+        return -EOPNOTSUPP;
+    filesystem fs = ((file)f)->fs;
+    iour_lock(iour);
+    filesystem e;
+    boolean found = false;
+    vector_foreach(iour->iopoll_fs, e) {
+        if (e == fs) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        /* vector_push() asserts on allocation failure, so grow the vector before taking the
+           filesystem reference */
+        if (!buffer_extend(iour->iopoll_fs, sizeof(void *))) {
+            iour_unlock(iour);
+            return -ENOMEM;
+        }
+        filesystem_reserve(fs);
+        vector_push(iour->iopoll_fs, fs);
+    }
+    iour_unlock(iour);
+    return 0;
+}
+
+/* Returns true if any polled operations are in flight. */
+static boolean iour_iopoll(io_uring iour)
+{
+    if (!iour->iopoll_inflight)
+        return false;
+    iour_lock(iour);
+    filesystem fs;
+    vector_foreach(iour->iopoll_fs, fs)
+        filesystem_storage_poll(fs);
+    iour_unlock(iour);
+    return true;
+}
+
+static s32 iour_provide_buffers(io_uring iour, struct io_uring_sqe *sqe)
+{
+    u32 count = sqe->fd;
+    u64 addr = sqe->addr;
+    u32 len = sqe->len;
+    if ((count == 0) || (count > IOUR_PROVIDE_BUFFERS_MAX) || sqe->rw_flags)
+        return -EINVAL;
+    if (sqe->off + count > IOUR_PROVIDE_BUFFERS_MAX)
+        return -E2BIG;
+    if (!validate_user_memory(pointer_from_u64(addr), (u64)count * len, true))
+        return -EFAULT;
+    s32 res = 0;
+    iour_lock(iour);
+    iour_buf_group g = iour_buf_group_find(iour, sqe->buf_group);
+    if (!g) {
+        g = allocate(iour->h, sizeof(*g));
+        if (g == INVALID_ADDRESS) {
+            res = -ENOMEM;
+            goto out;
+        }
+        g->bufs = allocate_buffer(iour->h, count * sizeof(struct iour_pbuf));
+        if (g->bufs == INVALID_ADDRESS) {
+            deallocate(iour->h, g, sizeof(*g));
+            res = -ENOMEM;
+            goto out;
+        }
+        g->bgid = sqe->buf_group;
+        g->ring = 0;
+        list_push_back(&iour->buf_groups, &g->l);
+    } else if (g->ring) {
+        res = -EINVAL;
+        goto out;
+    }
+    for (u32 i = 0; i < count; i++) {
+        struct iour_pbuf pb = {
+            .addr = addr + i * len,
+            .len = len,
+            .bid = sqe->off + i,
+        };
+        if (!buffer_write(g->bufs, &pb, sizeof(pb))) {
+            if (i == 0)
+                res = -ENOMEM;
+            break;
+        }
+    }
+  out:
+    iour_unlock(iour);
+    return res;
+}
+
+static s32 iour_remove_buffers(io_uring iour, struct io_uring_sqe *sqe)
+{
+    u32 count = sqe->fd;
+    if ((count == 0) || (count > IOUR_PROVIDE_BUFFERS_MAX) || sqe->rw_flags || sqe->addr ||
+            sqe->len || sqe->off)
+        return -EINVAL;
+    s32 res;
+    iour_lock(iour);
+    iour_buf_group g = iour_buf_group_find(iour, sqe->buf_group);
+    if (!g) {
+        res = -ENOENT;
+    } else if (g->ring) {
+        res = -EINVAL;
+    } else {
+        res = MIN(count, buffer_length(g->bufs) / sizeof(struct iour_pbuf));
+        buffer_consume(g->bufs, res * sizeof(struct iour_pbuf));
+    }
+    iour_unlock(iour);
+    return res;
+}
+
+static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe, iour_req req)
 {
     iour_debug("opcode %d, flags 0x%x, user_data %ld", sqe->opcode, sqe->flags,
         sqe->user_data);
     fdesc f = 0;
     s32 res;
-    if (sqe->flags & ~(IOSQE_FIXED_FILE | IOSQE_ASYNC)) {
+    if (sqe->flags & ~(IOSQE_FIXED_FILE | IOSQE_ASYNC | IOUR_REQ_FLAGS)) {
         /* non-supported flags */
         res = -EINVAL;
         goto complete;
     }
+    if ((sqe->flags & IOSQE_BUFFER_SELECT) &&
+            (sqe->opcode != IORING_OP_READ) && (sqe->opcode != IORING_OP_RECV)) {
+        res = -EINVAL;
+        goto complete;
+    }
     switch(sqe->opcode) {
     case IORING_OP_READV:
     case IORING_OP_WRITEV:
@@ -872,6 +1857,12 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
     case IORING_OP_POLL_ADD:
     case IORING_OP_READ:
     case IORING_OP_WRITE:
+    case IORING_OP_ACCEPT:
+    case IORING_OP_CONNECT:
+    case IORING_OP_SEND:
+    case IORING_OP_RECV:
+    case IORING_OP_SENDMSG:
+    case IORING_OP_RECVMSG:
         if (sqe->flags & IOSQE_FIXED_FILE) {
             iour_lock(iour);
             int fd = sqe->fd;
@@ -891,6 +1882,11 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
     default:
         break;
     }
+    if (iour->flags & IORING_SETUP_IOPOLL) {
+        res = iour_iopoll_check(iour, sqe->opcode, f);
+        if (res)
+            goto complete;
+    }
     switch (sqe->opcode) {
     case IORING_OP_NOP:
         res = 0;
@@ -908,7 +1904,7 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
             res = -EFAULT;
             goto complete;
         }
-        iour_iov(iour, f, write, iov, len, sqe->off, sqe->user_data);
+        iour_iov(iour, f, write, iov, len, sqe->off, sqe->user_data, req);
         break;
     }
     case IORING_OP_READ_FIXED:
@@ -916,34 +1912,40 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
         res = 0;
         iour_lock(iour);
         u16 buf_index = sqe->buf_index;
-        if (buf_index >= iour->buf_count) {
-            if (iour->buf_count != 0)
-                res = -EINVAL;
-            else
-                res = -EFAULT;
+        iour_buftable bt = iour->bufs;
+        if (!bt) {
+            res = -EFAULT;
+        } else if (buf_index >= bt->count) {
+            res = -EINVAL;
         } else {
-            struct iovec *iov = &iour->bufs[buf_index];
+            iour_buf b = &bt->bufs[buf_index];
             void *buf = pointer_from_u64(sqe->addr);
             u32 len = sqe->len;
             boolean write = sqe->opcode == IORING_OP_WRITE_FIXED;
-            if ((buf < iov->iov_base) || (u64_from_pointer(buf) + len >
-                    u64_from_pointer(iov->iov_base) + iov->iov_len)) {
+            if ((buf < b->base) || (u64_from_pointer(buf) + len >
+                    u64_from_pointer(b->base) + b->len)) {
                 res = -EFAULT;
+            } else if (iour_fixed_direct_eligible(f, b, buf, len, sqe->off)) {
+                fetch_and_add(&bt->refcount, 1);
+                iour_unlock(iour);
+                iour_rw_direct(iour, f, write, bt, b, buf, len, sqe->off, sqe->user_data, req);
+                return true;
             } else {
                 iour_unlock(iour);
-                iour_rw(iour, f, write, buf, len, sqe->off, sqe->user_data);
+                iour_rw(iour, f, write, buf, len, sqe->off, sqe->user_data, req);
                 return true;
             }
         }
         iour_unlock(iour);
         goto complete;
     case IORING_OP_POLL_ADD:
-        if (sqe->ioprio || sqe->off || sqe->addr || sqe->len ||
+        if (sqe->ioprio || sqe->off || sqe->addr || (sqe->len & ~IORING_POLL_ADD_MULTI) ||
                 sqe->buf_index) {
             res = -EINVAL;
             goto complete;
         }
-        iour_poll_add(iour, f, sqe->poll_events, sqe->user_data);
+        iour_poll_add(iour, f, sqe->poll_events, !!(sqe->len & IORING_POLL_ADD_MULTI),
+                      sqe->user_data, req);
         break;
     case IORING_OP_POLL_REMOVE:
         if (sqe->ioprio || sqe->off || sqe->len || sqe->poll_events ||
@@ -951,7 +1953,7 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
             res = -EINVAL;
             goto complete;
         }
-        iour_poll_remove(iour, sqe->addr, sqe->user_data);
+        iour_poll_remove(iour, sqe->addr, sqe->user_data, req);
         break;
     case IORING_OP_TIMEOUT: {
         struct timespec *ts = (struct timespec *)sqe->addr;
@@ -964,7 +1966,7 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
             goto complete;
         }
         iour_timeout_add(iour, ts, sqe->timeout_flags, sqe->off,
-                         sqe->user_data);
+                         sqe->user_data, req);
         break;
     }
     case IORING_OP_TIMEOUT_REMOVE:
@@ -972,7 +1974,7 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
             res = -EINVAL;
             goto complete;
         }
-        iour_timeout_remove(iour, sqe->addr, sqe->user_data);
+        iour_timeout_remove(iour, sqe->addr, sqe->user_data, req);
         break;
     case IORING_OP_CLOSE:
         if (sqe->ioprio || sqe->addr || sqe->len || sqe->off || sqe->buf_index
@@ -990,18 +1992,19 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
         deallocate_fd(current->p, fd);
         if (fetch_and_add(&f->refcnt, -2) == 2) {
             io_completion completion = closure(iour->h, iour_close_complete,
-                iour, sqe->user_data);
+                iour, sqe->user_data, req);
             if (completion == INVALID_ADDRESS) {
-                iour_complete(iour, sqe->user_data, -ENOMEM, false, false);
+                iour_complete(iour, req, sqe->user_data, -ENOMEM, 0, false, false);
                 completion = io_completion_ignore;
             } else
                 fetch_and_add(&iour->noncancelable_ops, 1);
             apply(f->close, 0, completion);
         } else
-            iour_complete(iour, sqe->user_data, 0, false, false);
+            iour_complete(iour, req, sqe->user_data, 0, 0, false, false);
         return true;
     case IORING_OP_FILES_UPDATE:
-        if (sqe->flags || sqe->ioprio || sqe->rw_flags) {
+        if ((sqe->flags & (IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT)) || sqe->ioprio ||
+                sqe->rw_flags) {
             res = -EINVAL;
             goto complete;
         }
@@ -1010,7 +2013,24 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
         goto complete;
     case IORING_OP_READ:
     case IORING_OP_WRITE:
-        if (sqe->buf_index) {
+        if (sqe->flags & IOSQE_BUFFER_SELECT) {
+            /* the buffer is selected at submission, as file reads do not wait for readiness */
+            void *buf;
+            u32 len = sqe->len;
+            if (sqe->addr) {
+                res = -EINVAL;
+                goto complete;
+            }
+            if (!iour_buf_select(iour, req, &buf, &len)) {
+                res = -ENOBUFS;
+                goto complete;
+            }
+            if (!validate_user_memory(buf, len, true)) {
+                res = -EFAULT;
+                goto complete;
+            }
+            iour_rw(iour, f, false, buf, len, sqe->off, sqe->user_data, req);
+        } else if (sqe->buf_index) {
             res = -EINVAL;
             goto complete;
         } else {
@@ -1022,16 +2042,91 @@ static boolean iour_submit(io_uring iour, struct io_uring_sqe *sqe)
                 res = -EFAULT;
                 goto complete;
             }
-            iour_rw(iour, f, write, buf, len, sqe->off, sqe->user_data);
+            iour_rw(iour, f, write, buf, len, sqe->off, sqe->user_data, req);
+        }
+        break;
+    case IORING_OP_ACCEPT: {
+        struct sockaddr *addr = pointer_from_u64(sqe->addr);
+        socklen_t *addrlen = pointer_from_u64(sqe->off);
+        if ((sqe->ioprio & ~IORING_ACCEPT_MULTISHOT) || sqe->len || sqe->buf_index) {
+            res = -EINVAL;
+            goto complete;
+        }
+        if (addr && (!validate_user_memory(addrlen, sizeof(socklen_t), true) ||
+                     !validate_user_memory(addr, *addrlen, true))) {
+            res = -EFAULT;
+            goto complete;
+        }
+        iour_sock_op_submit(iour, f, sqe, req);
+        break;
+    }
+    case IORING_OP_CONNECT:
+        if (sqe->ioprio || sqe->len || sqe->buf_index || sqe->rw_flags) {
+            res = -EINVAL;
+            goto complete;
+        }
+        if (!validate_user_memory(pointer_from_u64(sqe->addr), sqe->off, false)) {
+            res = -EFAULT;
+            goto complete;
+        }
+        iour_sock_op_submit(iour, f, sqe, req);
+        break;
+    case IORING_OP_SEND:
+        if (sqe->ioprio || sqe->off || sqe->buf_index) {
+            res = -EINVAL;
+            goto complete;
+        }
+        if (!validate_user_memory(pointer_from_u64(sqe->addr), sqe->len, false)) {
+            res = -EFAULT;
+            goto complete;
+        }
+        iour_sock_op_submit(iour, f, sqe, req);
+        break;
+    case IORING_OP_RECV:
+        /* A multishot receive selects a new buffer for each completion. */
+        if ((sqe->ioprio & ~IORING_RECV_MULTISHOT) || sqe->off) {
+            res = -EINVAL;
+            goto complete;
+        }
+        if (sqe->flags & IOSQE_BUFFER_SELECT) {
+            if (sqe->addr) {
+                res = -EINVAL;
+                goto complete;
+            }
+        } else if (sqe->buf_index || (sqe->ioprio & IORING_RECV_MULTISHOT)) {
+            res = -EINVAL;
+            goto complete;
+        } else if (!validate_user_memory(pointer_from_u64(sqe->addr), sqe->len, true)) {
+            res = -EFAULT;
+            goto complete;
+        }
+        iour_sock_op_submit(iour, f, sqe, req);
+        break;
+    case IORING_OP_SENDMSG:
+    case IORING_OP_RECVMSG:
+        if (sqe->ioprio || sqe->off || sqe->buf_index) {
+            res = -EINVAL;
+            goto complete;
+        }
+        if (!validate_msghdr(pointer_from_u64(sqe->addr), sqe->opcode == IORING_OP_RECVMSG)) {
+            res = -EFAULT;
+            goto complete;
         }
+        iour_sock_op_submit(iour, f, sqe, req);
         break;
+    case IORING_OP_PROVIDE_BUFFERS:
+        res = iour_provide_buffers(iour, sqe);
+        goto complete;
+    case IORING_OP_REMOVE_BUFFERS:
+        res = iour_remove_buffers(iour, sqe);
+        goto complete;
     default:
-        iour_complete(iour, sqe->user_data, -EINVAL, false, false);
+        iour_complete(iour, req, sqe->user_data, -EINVAL, 0, false, false);
         return false;
     }
     return true;
 complete:
-    iour_complete(iour, sqe->user_data, res, false, false);
+    iour_complete(iour, req, sqe->user_data, res, 0, false, false);
     if (f)
         fdesc_put(f);
     return true;
@@ -1078,6 +2173,232 @@ out:
     return rv;
 }
 
+/* Runs a function in the syscall context of the current CPU on behalf of a user thread; called
+ * from the runloop. The function must end with check_syscall_context_replace(), as operations it
+ * submits may retain the context. */
+static void iour_apply_for_thread(thread t, thunk run)
+{
+    cpuinfo ci = current_cpu();
+    syscall_context sc = (syscall_context)ci->m.syscall_context;
+    sc->t = t;
+    sc->context.fault_handler = t->context.fault_handler;
+    sc->start_time = 0;
+    sc->call = -1;
+    context_apply(&sc->context, run);
+}
+
+define_closure_function(1, 0, void, iour_req_issue,
+                        iour_req, req)
+{
+    iour_req req = bound(req);
+    iour_apply_for_thread(req->t, (thunk)&req->run);
+}
+
+define_closure_function(1, 0, void, iour_req_run,
+                        iour_req, req)
+{
+    iour_req req = bound(req);
+    io_uring iour = req->iour;
+    if (iour->closing)
+        iour_complete(iour, req, req->sqe.user_data, -ECANCELED, 0, true, false);
+    else
+        iour_submit(iour, &req->sqe, req);
+    iour_noncancelable_done(iour);
+    check_syscall_context_replace(current_cpu(), get_current_context(current_cpu()));
+}
+
+static iour_req iour_req_alloc(io_uring iour, struct io_uring_sqe *sqe)
+{
+    iour_req req = allocate(iour->h, sizeof(*req));
+    if (req == INVALID_ADDRESS)
+        return req;
+    req->iour = iour;
+    req->t = current;
+    thread_reserve(req->t);
+    req->next = 0;
+    req->refcount = 1;
+    req->done = req->failed = req->buf_selected = false;
+    runtime_memcpy(&req->sqe, sqe, sizeof(req->sqe));
+    init_closure(&req->issue, iour_req_issue, req);
+    init_closure(&req->run, iour_req_run, req);
+    return req;
+}
+
+/* Submits an entry that must be tracked until its completion. link points to the last request of
+ * the link chain being submitted, if any; the chain holds a reference to this request. Returns
+ * false if no further entries should be submitted. */
+static boolean iour_submit_req(io_uring iour, struct io_uring_sqe *sqe, iour_req *link)
+{
+    iour_req prev = *link;
+    iour_req req = iour_req_alloc(iour, sqe);
+    *link = 0;
+    iour_lock(iour);
+    if (req == INVALID_ADDRESS) {
+        if (prev)
+            iour_req_release(iour, prev);
+        iour->inflight++;
+        iour_unlock(iour);
+        iour_complete(iour, 0, sqe->user_data, -ENOMEM, 0, false, false);
+        return false;
+    }
+    if (sqe->flags & (IOSQE_IO_LINK | IOSQE_IO_HARDLINK)) {
+        req->refcount++;
+        *link = req;
+    }
+    boolean issue = false;
+    if (prev) {
+        if (!prev->done)
+            prev->next = req;
+        else if (iour->closing || (prev->failed && !(prev->sqe.flags & IOSQE_IO_HARDLINK)))
+            iour_req_cancel_chain(iour, req, false);
+        else
+            issue = true;
+        iour_req_release(iour, prev);
+    } else if ((sqe->flags & IOSQE_IO_DRAIN) || iour->drain_active ||
+               !list_empty(&iour->drain_queue)) {
+        list_push_back(&iour->drain_queue, &req->l);
+        iour_drain_service(iour);
+    } else {
+        issue = true;
+    }
+    if (issue)
+        iour->inflight++;
+    iour_unlock(iour);
+    return issue ? iour_submit(iour, &req->sqe, req) : true;
+}
+
+static unsigned int iour_submit_entries(io_uring iour, unsigned int to_submit)
+{
+    io_rings rings = iour->rings;
+    read_barrier();
+    iour_debug("SQ head %d, SQ tail %d", rings->sq_head, rings->sq_tail);
+    unsigned int submitted;
+    iour_req link = 0;
+    for (submitted = 0; submitted < to_submit;) {
+        iour_lock(iour);
+        if (rings->sq_head >= rings->sq_tail) {
+            iour_unlock(iour);
+            break;
+        }
+        u32 sqe_index = iour->sq_array[rings->sq_head & iour->sq_mask];
+        rings->sq_head++;
+        if (sqe_index >= iour->sq_entries) {
+            iour_debug("sqe dropped: index %d, entries %d", sqe_index,
+                iour->sq_entries);
+            rings->sq_dropped++;
+            iour_unlock(iour);
+            break;
+        }
+        submitted++;
+        struct io_uring_sqe *sqe = &iour->sqes[sqe_index];
+        if (!link && !(sqe->flags & IOUR_REQ_FLAGS) && !iour->drain_active &&
+                list_empty(&iour->drain_queue)) {
+            /* nothing to track beyond posting the completion */
+            iour->inflight++;
+            iour_unlock(iour);
+            if (!iour_submit(iour, sqe, 0))
+                break;
+        } else {
+            iour_unlock(iour);
+            if (!iour_submit_req(iour, sqe, &link))
+                break;
+        }
+    }
+    if (link) {
+        /* a link chain ends with the submission call */
+        iour_lock(iour);
+        iour_req_release(iour, link);
+        iour_unlock(iour);
+    }
+    return submitted;
+}
+
+static void iour_sqpoll_schedule(io_uring iour)
+{
+    cpuinfo ci = current_cpu();
+    cpuinfo target = (iour->sqp_cpu >= 0) ? cpuinfo_from_id(iour->sqp_cpu) : ci;
+    assert(enqueue_irqsafe(target->thread_queue, (thunk)&iour->sqp_poll));
+    if (target != ci)
+        wakeup_cpu(target->id);
+}
+
+static void iour_sqpoll_wake(io_uring iour)
+{
+    iour_lock(iour);
+    boolean wake = !iour->sqp_scheduled && !iour->closing;
+    if (wake) {
+        iour->sqp_scheduled = true;
+        fetch_and_add(&iour->noncancelable_ops, 1);
+        iour->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+        iour->sqp_last_active = now(CLOCK_ID_MONOTONIC_RAW);
+    }
+    iour_unlock(iour);
+    if (wake)
+        iour_sqpoll_schedule(iour);
+}
+
+/* Each pass of the SQ poller is queued like a thread, so that it shares the CPU with user threads
+ * instead of starving them, and runs in a syscall context on behalf of the thread that created
+ * the io_uring instance. */
+define_closure_function(1, 0, void, iour_sqpoll,
+                        io_uring, iour)
+{
+    io_uring iour = bound(iour);
+    cpuinfo ci = current_cpu();
+    if (iour->closing) {
+        iour_debug("SQ poller stopped");
+        iour->sqp_scheduled = false;
+        iour_noncancelable_done(iour);
+        return;
+    }
+    if ((iour->sqp_cpu >= 0) && (ci->id != iour->sqp_cpu)) {
+        /* migrated away from the CPU the poller is bound to */
+        iour_sqpoll_schedule(iour);
+        return;
+    }
+
+    /* The runloop does not enable interrupts while it has work to do: let pending interrupts in
+     * between polling passes. */
+    enable_interrupts();
+    kern_pause();
+    disable_interrupts();
+
+    iour_apply_for_thread(iour->sqp_thread, (thunk)&iour->sqp_run);
+}
+
+define_closure_function(1, 0, void, iour_sqpoll_run,
+                        io_uring, iour)
+{
+    io_uring iour = bound(iour);
+    io_rings rings = iour->rings;
+    boolean busy = iour_submit_entries(iour, iour->sq_entries) != 0;
+    if ((iour->flags & IORING_SETUP_IOPOLL) && iour_iopoll(iour))
+        busy = true;
+    timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
+    if (busy) {
+        iour->sqp_last_active = here;
+    } else if (here - iour->sqp_last_active >= iour->sqp_idle) {
+        iour_lock(iour);
+        if (!iour->closing) {
+            rings->sq_flags |= IORING_SQ_NEED_WAKEUP;
+            memory_barrier();
+            if (rings->sq_tail == rings->sq_head) {
+                iour_debug("SQ poller idle");
+                iour->sqp_scheduled = false;
+                fetch_and_add(&iour->noncancelable_ops, -1);
+                iour_unlock(iour);
+                goto out;
+            }
+            rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+        }
+        iour_unlock(iour);
+    }
+    iour_sqpoll_schedule(iour);
+  out:
+    /* submitted operations may hold references to this context */
+    check_syscall_context_replace(current_cpu(), get_current_context(current_cpu()));
+}
+
 sysreturn io_uring_enter(int fd, unsigned int to_submit,
                          unsigned int min_complete, unsigned int flags,
                          sigset_t *sig)
@@ -1086,7 +2407,7 @@ sysreturn io_uring_enter(int fd, unsigned int to_submit,
         to_submit, min_complete, flags, sig);
     io_uring iour = iour_from_fd(current->p, fd);
     sysreturn rv;
-    if (flags & ~IORING_ENTER_GETEVENTS) {
+    if (flags & ~(IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP)) {
         rv = -EINVAL;
         goto out;
     }
@@ -1102,31 +2423,16 @@ sysreturn io_uring_enter(int fd, unsigned int to_submit,
             goto out;
         }
     }
-    io_rings rings = iour->rings;
-    read_barrier();
-    iour_debug("SQ head %d, SQ tail %d", rings->sq_head, rings->sq_tail);
     unsigned int submitted;
-    for (submitted = 0; submitted < to_submit;) {
-        iour_lock(iour);
-        if (rings->sq_head >= rings->sq_tail) {
-            iour_unlock(iour);
-            break;
-        }
-        u32 sqe_index = iour->sq_array[rings->sq_head & iour->sq_mask];
-        rings->sq_head++;
-        iour_unlock(iour);
-        if (sqe_index < iour->sq_entries) {
-            submitted++;
-            if (!iour_submit(iour, &iour->sqes[sqe_index]))
-                break;
-        } else {
-            iour_debug("sqe dropped: index %d, entries %d", sqe_index,
-                iour->sq_entries);
-            iour_lock(iour);
-            iour->rings->sq_dropped++;
-            iour_unlock(iour);
-            break;
-        }
+    if (iour->flags & IORING_SETUP_SQPOLL) {
+        /* submission queue entries are consumed by the SQ poller */
+        if (flags & IORING_ENTER_SQ_WAKEUP)
+            iour_sqpoll_wake(iour);
+        submitted = to_submit;
+    } else {
+        submitted = iour_submit_entries(iour, to_submit);
+        if ((flags & IORING_ENTER_GETEVENTS) && (iour->flags & IORING_SETUP_IOPOLL))
+            iour_iopoll(iour);
     }
     cpuinfo ci = current_cpu();
     syscall_context sc = (syscall_context)get_current_context(ci);
@@ -1169,21 +2475,49 @@ static sysreturn iour_register_buffers(io_uring iour, struct iovec *bufs,
 {
     if ((count == 0) || (count > IOV_MAX))
         return -EINVAL;
+    if (!validate_user_memory(bufs, sizeof(struct iovec) * count, false))
+        return -EFAULT;
+    for (unsigned int i = 0; i < count; i++) {
+        if (!bufs[i].iov_base || (bufs[i].iov_len == 0) || (bufs[i].iov_len > IOUR_BUF_MAX))
+            return -EINVAL;
+        if (!validate_user_memory(bufs[i].iov_base, bufs[i].iov_len, true))
+            return -EFAULT;
+    }
+    iour_buftable bt = allocate(iour->h, sizeof(*bt) + count * sizeof(struct iour_buf));
+    if (bt == INVALID_ADDRESS)
+        return -ENOMEM;
+    bt->h = iour->h;
+    bt->count = count;
+    bt->refcount = 1;
+    for (unsigned int i = 0; i < count; i++) {
+        iour_buf b = &bt->bufs[i];
+        b->base = bufs[i].iov_base;
+        b->len = bufs[i].iov_len;
+
+        /* Buffers that cannot be pinned (e.g. file mappings) are accessed through the user
+         * mapping. */
+        u64 npages = iour_buf_npages(b);
+        b->phys = allocate(bt->h, npages * sizeof(u64));
+        if (b->phys == INVALID_ADDRESS) {
+            b->phys = 0;
+        } else if (!pin_user_pages(b->base, b->len, VMAP_FLAG_READABLE | VMAP_FLAG_WRITABLE,
+                                   b->phys)) {
+            deallocate(bt->h, b->phys, npages * sizeof(u64));
+            b->phys = 0;
+        }
+    }
     sysreturn ret;
     iour_lock(iour);
-    if (iour->buf_count)
+    if (iour->bufs) {
         ret = -EBUSY;
-    else {
-        iour->bufs = allocate(iour->h, sizeof(struct iovec) * count);
-        if (iour->bufs == INVALID_ADDRESS) {
-            ret = -ENOMEM;
-        } else {
-            runtime_memcpy(iour->bufs, bufs, sizeof(struct iovec) * count);
-            iour->buf_count = count;
-            ret = 0;
-        }
+    } else {
+        iour->bufs = bt;
+        bt = 0;
+        ret = 0;
     }
     iour_unlock(iour);
+    if (bt)
+        iour_buftable_release(bt);
     return ret;
 }
 
@@ -1191,14 +2525,16 @@ static sysreturn iour_unregister_buffers(io_uring iour)
 {
     sysreturn ret;
     iour_lock(iour);
-    if (iour->buf_count == 0)
+    iour_buftable bt = iour->bufs;
+    if (!bt) {
         ret = -ENXIO;
-    else {
-        deallocate(iour->h, iour->bufs, sizeof(struct iovec) * iour->buf_count);
-        iour->buf_count = 0;
+    } else {
+        iour->bufs = 0;
         ret = 0;
     }
     iour_unlock(iour);
+    if (bt)
+        iour_buftable_release(bt);
     return ret;
 }
 
@@ -1296,6 +2632,66 @@ static sysreturn iour_unregister_eventfd(io_uring iour)
     return ret;
 }
 
+static sysreturn iour_register_pbuf_ring(io_uring iour, struct io_uring_buf_reg *reg)
+{
+    u32 entries = reg->ring_entries;
+    if (reg->flags || reg->resv[0] || reg->resv[1] || reg->resv[2] ||
+            (entries == 0) || (entries > IOUR_PBUF_RING_ENTRIES_MAX) || (entries & (entries - 1)) ||
+            !reg->ring_addr || (reg->ring_addr & PAGEMASK))
+        return -EINVAL;
+    struct io_uring_buf *ring = pointer_from_u64(reg->ring_addr);
+    if (!validate_user_memory(ring, entries * sizeof(*ring), false))
+        return -EFAULT;
+    iour_buf_group g = allocate(iour->h, sizeof(*g));
+    if (g == INVALID_ADDRESS)
+        return -ENOMEM;
+    g->bgid = reg->bgid;
+    g->ring = ring;
+    g->ring_mask = entries - 1;
+    g->head = 0;
+    g->bufs = 0;
+    sysreturn ret;
+    iour_lock(iour);
+    if (iour_buf_group_find(iour, reg->bgid)) {
+        ret = -EEXIST;
+    } else {
+        list_push_back(&iour->buf_groups, &g->l);
+        ret = 0;
+    }
+    iour_unlock(iour);
+    if (ret)
+        deallocate(iour->h, g, sizeof(*g));
+    return ret;
+}
+
+static sysreturn iour_unregister_pbuf_ring(io_uring iour, struct io_uring_buf_reg *reg)
+{
+    if (reg->flags || reg->resv[0] || reg->resv[1] || reg->resv[2])
+        return -EINVAL;
+    sysreturn ret;
+    iour_lock(iour);
+    iour_buf_group g = iour_buf_group_find(iour, reg->bgid);
+    if (!g) {
+        ret = -ENOENT;
+    } else if (!g->ring) {
+        ret = -EINVAL;
+    } else {
+        list_delete(&g->l);
+        iour_buf_group_free(iour, g);
+        ret = 0;
+    }
+    iour_unlock(iour);
+    return ret;
+}
+
+static const u8 iour_supported_ops[] = {
+    IORING_OP_NOP, IORING_OP_READV, IORING_OP_WRITEV, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED,
+    IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_SENDMSG, IORING_OP_RECVMSG,
+    IORING_OP_TIMEOUT, IORING_OP_TIMEOUT_REMOVE, IORING_OP_ACCEPT, IORING_OP_CONNECT,
+    IORING_OP_CLOSE, IORING_OP_FILES_UPDATE, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_SEND,
+    IORING_OP_RECV, IORING_OP_PROVIDE_BUFFERS, IORING_OP_REMOVE_BUFFERS,
+};
+
 static sysreturn iour_register_probe(struct io_uring_probe *probe,
                                      unsigned int op_count)
 {
@@ -1307,18 +2703,9 @@ static sysreturn iour_register_probe(struct io_uring_probe *probe,
     for (unsigned int i = 0; i < op_count; i++)
         probe->ops[i].op = i;
     probe->ops_len = op_count;
-    probe->ops[IORING_OP_NOP].flags = probe->ops[IORING_OP_READV].flags =
-            probe->ops[IORING_OP_WRITEV].flags =
-            probe->ops[IORING_OP_READ_FIXED].flags =
-            probe->ops[IORING_OP_WRITE_FIXED].flags =
-            probe->ops[IORING_OP_POLL_ADD].flags =
-            probe->ops[IORING_OP_POLL_REMOVE].flags =
-            probe->ops[IORING_OP_TIMEOUT].flags =
-            probe->ops[IORING_OP_TIMEOUT_REMOVE].flags =
-            probe->ops[IORING_OP_CLOSE].flags =
-            probe->ops[IORING_OP_FILES_UPDATE].flags =
-            probe->ops[IORING_OP_READ].flags =
-            probe->ops[IORING_OP_WRITE].flags = IO_URING_OP_SUPPORTED;
+    for (unsigned int i = 0; i < sizeof(iour_supported_ops); i++)
+        if (iour_supported_ops[i] < op_count)
+            probe->ops[iour_supported_ops[i]].flags = IO_URING_OP_SUPPORTED;
     return 0;
 }
 
@@ -1388,6 +2775,19 @@ sysreturn io_uring_register(int fd, unsigned int opcode, void *arg,
             rv = iour_register_probe(probe, nr_args);
         break;
     }
+    case IORING_REGISTER_PBUF_RING:
+    case IORING_UNREGISTER_PBUF_RING: {
+        struct io_uring_buf_reg *reg = (struct io_uring_buf_reg *)arg;
+        if (!validate_user_memory(reg, sizeof(*reg), false))
+            rv = -EFAULT;
+        else if (nr_args != 1)
+            rv = -EINVAL;
+        else if (opcode == IORING_REGISTER_PBUF_RING)
+            rv = iour_register_pbuf_ring(iour, reg);
+        else
+            rv = iour_unregister_pbuf_ring(iour, reg);
+        break;
+    }
     default:
         rv = -EINVAL;
         break;
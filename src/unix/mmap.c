@@ -29,8 +29,17 @@ static struct {
     closure_struct(pending_fault_print, pf_print);
 
     struct list pf_freelist;
+
+    table pinned_pages;         /* maps physical address to pinned_page */
+    struct spinlock pinned_lock;
 } mmap_info;
 
+/* A page pinned for DMA is not freed when unmapped, but when the last pin is released. */
+typedef struct pinned_page {
+    u64 pins;
+    boolean unmapped;
+} *pinned_page;
+
 define_closure_function(0, 2, int, pending_fault_compare,
                         rbnode, a, rbnode, b)
 {
@@ -838,11 +847,117 @@ static void vmap_return_virtual(process p, vmap k)
         id_heap_set_area(v->h, r.start, range_span(r), false, false);
 }
 
+static void dealloc_phys_range(id_heap physical, range r)
+{
+    if (range_span(r) && !id_heap_set_area(physical, r.start, range_span(r), true, false))
+        msg_err("some of physical range %R not allocated in heap\n", r);
+}
+
 closure_function(1, 1, void, dealloc_phys_page,
                  id_heap, physical, range, r)
 {
-    if (!id_heap_set_area(bound(physical), r.start, range_span(r), true, false))
-        msg_err("some of physical range %R not allocated in heap\n", r);
+    id_heap physical = bound(physical);
+    if (table_elements(mmap_info.pinned_pages) > 0) {
+        spin_lock(&mmap_info.pinned_lock);
+        for (u64 pa = r.start; pa < r.end; pa += PAGESIZE) {
+            pinned_page pp = table_find(mmap_info.pinned_pages, pointer_from_u64(pa));
+            if (pp) {
+                pp->unmapped = true;
+                dealloc_phys_range(physical, irange(r.start, pa));
+                r.start = pa + PAGESIZE;
+            }
+        }
+        spin_unlock(&mmap_info.pinned_lock);
+    }
+    dealloc_phys_range(physical, r);
+}
+
+static void unpin_pages_locked(u64 *phys, u64 npages)
+{
+    for (u64 i = 0; i < npages; i++) {
+        pinned_page pp = table_find(mmap_info.pinned_pages, pointer_from_u64(phys[i]));
+        assert(pp);
+        if (--pp->pins > 0)
+            continue;
+        table_set(mmap_info.pinned_pages, pointer_from_u64(phys[i]), 0);
+        if (pp->unmapped)
+            dealloc_phys_range(mmap_info.physical, irangel(phys[i], PAGESIZE));
+        deallocate(mmap_info.h, pp, sizeof(*pp));
+    }
+}
+
+/* Pins the pages of an anonymous memory range of the current process, storing the physical
+   address of each page in phys. Returns false if any part of the range is not mapped anonymous
+   memory with the required permissions. */
+boolean pin_user_pages(const void *buf, bytes length, u64 required_flags, u64 *phys)
+{
+    if (!fault_in_user_memory(buf, length, required_flags | VMAP_MMAP_TYPE_ANONYMOUS, 0))
+        return false;
+    u64 start = u64_from_pointer(buf) & ~PAGEMASK;
+    u64 npages = (pad(u64_from_pointer(buf) + length, PAGESIZE) - start) >> PAGELOG;
+    spin_lock(&mmap_info.pinned_lock);
+    for (u64 i = 0; i < npages; i++) {
+        u64 pa = physical_from_virtual(pointer_from_u64(start + (i << PAGELOG)));
+        pinned_page pp = INVALID_ADDRESS;
+        if (pa != INVALID_PHYSICAL) {
+            pp = table_find(mmap_info.pinned_pages, pointer_from_u64(pa));
+            if (!pp) {
+                pp = allocate(mmap_info.h, sizeof(*pp));
+                if (pp != INVALID_ADDRESS) {
+                    pp->pins = 0;
+                    pp->unmapped = false;
+                    table_set(mmap_info.pinned_pages, pointer_from_u64(pa), pp);
+                }
+            }
+        }
+        if (pp == INVALID_ADDRESS) {
+            unpin_pages_locked(phys, i);
+            spin_unlock(&mmap_info.pinned_lock);
+            return false;
+        }
+        pp->pins++;
+        phys[i] = pa;
+    }
+    spin_unlock(&mmap_info.pinned_lock);
+    return true;
+}
+
+void unpin_pages(u64 *phys, u64 npages)
+{
+    spin_lock(&mmap_info.pinned_lock);
+    unpin_pages_locked(phys, npages);
+    spin_unlock(&mmap_info.pinned_lock);
+}
+
+/* Returns a scatter-gather list referencing, through the linear mapping, length bytes of pinned
+   pages starting at offset in the first page, with one buffer per physically contiguous run. */
+sg_list sg_from_pinned_pages(u64 *phys, u64 offset, u64 length)
+{
+    sg_list sg = allocate_sg_list();
+    if (sg == INVALID_ADDRESS)
+        return sg;
+    u64 run_start = *phys + offset;
+    u64 run = 0;
+    u64 n = MIN(length, PAGESIZE - offset);
+    while (length > 0) {
+        run += n;
+        length -= n;
+        u64 next = 0;
+        if (length > 0) {
+            next = *++phys;
+            n = MIN(length, PAGESIZE);
+            if (next == run_start + run)
+                continue;
+        }
+        sg_buf sgb = sg_list_tail_add(sg, run);
+        sgb->buf = pointer_from_u64(virt_from_linear_backed_phys(run_start));
+        sgb->size = run;
+        sgb->offset = 0;
+        sgb->refcount = 0;
+        run_start = next;
+        run = 0;
+    }
+    return sg;
 }
 
 static void vmap_unmap_page_range(process p, vmap k)
@@ -1355,6 +1470,9 @@ void mmap_process_init(process p, boolean aslr)
                 init_closure(&mmap_info.pf_compare, pending_fault_compare),
                 init_closure(&mmap_info.pf_print, pending_fault_print));
     list_init(&mmap_info.pf_freelist);
+    mmap_info.pinned_pages = allocate_table(h, identity_key, pointer_equal);
+    assert(mmap_info.pinned_pages != INVALID_ADDRESS);
+    spin_lock_init(&mmap_info.pinned_lock);
 }
 
 void register_mmap_syscalls(struct syscall *map)
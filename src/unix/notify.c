@@ -69,7 +69,7 @@ u64 notify_get_eventmask_union(notify_set s)
     spin_lock(&s->lock);
     list_foreach(&s->entries, l) {
         notify_entry n = struct_from_list(l, notify_entry, l);
-        u |= n->eventmask;
+        u |= n->eventmask & ~NOTIFY_EXCLUSIVE;
     }
     spin_unlock(&s->lock);
     return u;
@@ -77,17 +77,32 @@ u64 notify_get_eventmask_union(notify_set s)
 
 void notify_dispatch_with_arg(notify_set s, u64 events, void *arg)
 {
+    notify_entry exclusive = 0;
     spin_lock(&s->lock);
     list_foreach(&s->entries, l) {
         notify_entry n = struct_from_list(l, notify_entry, l);
         /* no guarantee that a transition is represented here; event
            handler needs to keep track itself if edge trigger is used */
         assert(n->eh);
-        if (apply(n->eh, events & n->eventmask, arg)) {
+        u64 e = events & n->eventmask;
+        if (e && (n->eventmask & NOTIFY_EXCLUSIVE)) {
+            if (exclusive)
+                continue;
+            exclusive = n;
+        }
+        if (apply(n->eh, e, arg)) {
+            if (n == exclusive)
+                exclusive = 0;
             list_delete(l);
             deallocate(s->h, n, sizeof(struct notify_entry));
         }
     }
+
+    /* the next exclusive wakeup goes to another entry */
+    if (exclusive) {
+        list_delete(&exclusive->l);
+        list_push_back(&s->entries, &exclusive->l);
+    }
     spin_unlock(&s->lock);
 }
 
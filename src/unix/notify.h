@@ -12,6 +12,11 @@ typedef closure_type(event_handler, boolean, u64 events, void *arg);
    resources (e.g. epollfd) accordingly. */
 #define NOTIFY_EVENTS_RELEASE (-1ull)
 
+/* An entry with NOTIFY_EXCLUSIVE set in its eventmask takes part in exclusive wakeups: a non-zero
+   set of events is dispatched to only one of the exclusive entries interested in them, chosen in
+   round-robin order. Other entries, and falling edges, are not affected. */
+#define NOTIFY_EXCLUSIVE    (1ull << 63)
+
 notify_set allocate_notify_set(heap h);
 
 void deallocate_notify_set(notify_set s);
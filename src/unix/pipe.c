@@ -7,9 +7,9 @@
 #define pipe_debug(x, ...)
 #endif
 
-#define INITIAL_PIPE_DATA_SIZE  100
 #define PIPE_MIN_CAPACITY       PAGESIZE
 #define DEFAULT_PIPE_MAX_SIZE   (16 * PAGESIZE) /* see pipe(7) */
+#define PIPE_MAX_CAPACITY       (64 * MB)
 #define PIPE_READ               0
 #define PIPE_WRITE              1
 
@@ -24,29 +24,32 @@ struct pipe_file {
     blockq bq;
 };
 
+/* Page allocated by a pipe to hold data written into it; data spliced into a pipe is instead
+ * referenced in the pages where it already resides (e.g. page cache or socket buffers). */
+declare_closure_struct(0, 0, void, pipe_page_free);
+typedef struct pipe_page {
+    struct refcount refcount;
+    closure_struct(pipe_page_free, free);
+    void *data;
+} *pipe_page;
+
 struct pipe {
     struct pipe_file files[2];
     process proc;
     heap h;
     u64 ref_cnt;
     u64 max_size;
-    buffer data;
+    u64 length;         /* amount of data in the pipe */
+    sg_list data;       /* references to the pages holding the data */
+    pipe_page tail;     /* page being filled by writes */
+    u32 tail_used;
+    boolean splice_out; /* data is being spliced out of the pipe */
     struct spinlock lock;
 };
 
 #define pipe_lock(p)    spin_lock(&(p)->lock)
 #define pipe_unlock(p)  spin_unlock(&(p)->lock)
 
-#define BUFFER_DEBUG(BUF,LENGTH) do { \
-    pipe_debug("%s:%d - requested %d -- contents %p start/end %d/%d  -- len %d %d\n", \
-        __func__, __LINE__, \
-        (LENGTH), \
-        (BUF)->contents, \
-        (BUF)->start, \
-        (BUF)->end, \
-        (BUF)->length, buffer_length((BUF))); \
-} while(0)
-
 boolean pipe_init(unix_heaps uh)
 {
     heap h = heap_locked((kernel_heaps)uh);
@@ -57,6 +60,128 @@ boolean pipe_init(unix_heaps uh)
     return (uh->pipe_cache == INVALID_ADDRESS ? false : true);
 }
 
+define_closure_function(0, 0, void, pipe_page_free)
+{
+    pipe_page pp = struct_from_field(closure_self(), pipe_page, free);
+    kernel_heaps kh = get_kernel_heaps();
+    deallocate((heap)heap_linear_backed(kh), pp->data, PAGESIZE);
+    deallocate(heap_locked(kh), pp, sizeof(*pp));
+}
+
+static pipe_page pipe_page_alloc(void)
+{
+    kernel_heaps kh = get_kernel_heaps();
+    pipe_page pp = allocate(heap_locked(kh), sizeof(*pp));
+    if (pp == INVALID_ADDRESS)
+        return pp;
+    pp->data = allocate((heap)heap_linear_backed(kh), PAGESIZE);
+    if (pp->data == INVALID_ADDRESS) {
+        deallocate(heap_locked(kh), pp, sizeof(*pp));
+        return INVALID_ADDRESS;
+    }
+    init_refcount(&pp->refcount, 1, init_closure(&pp->free, pipe_page_free));
+    return pp;
+}
+
+static inline sg_buf pipe_data_last(pipe p)
+{
+    buffer b = p->data->b;
+    if (buffer_length(b) < sizeof(struct sg_buf))
+        return 0;
+    return buffer_end(b) - sizeof(struct sg_buf);
+}
+
+/* The functions below must be called with the pipe lock held. */
+
+/* Copies data into the pipe, filling up the tail page before allocating a new one. */
+static u64 pipe_write_data(pipe p, void *src, u64 length)
+{
+    u64 written = 0;
+    while (written < length) {
+        pipe_page pp = p->tail;
+        if (!pp || (p->tail_used == PAGESIZE)) {
+            pp = pipe_page_alloc();
+            if (pp == INVALID_ADDRESS)
+                break;
+            if (p->tail)
+                refcount_release(&p->tail->refcount);
+            p->tail = pp;
+            p->tail_used = 0;
+        }
+        u32 n = MIN(length - written, PAGESIZE - p->tail_used);
+        runtime_memcpy(pp->data + p->tail_used, src + written, n);
+        sg_buf sgb = pipe_data_last(p);
+        if (sgb && (sgb->refcount == &pp->refcount) && (sgb->size == p->tail_used)) {
+            sgb->size += n;
+        } else {
+            sgb = sg_list_tail_add(p->data, n);
+            sgb->buf = pp->data;
+            sgb->offset = p->tail_used;
+            sgb->size = p->tail_used + n;
+            refcount_reserve(&pp->refcount);
+            sgb->refcount = &pp->refcount;
+        }
+        p->tail_used += n;
+        p->length += n;
+        written += n;
+    }
+    return written;
+}
+
+static u64 pipe_read_data(pipe p, void *dest, u64 length)
+{
+    u64 n = sg_copy_to_buf(dest, p->data, length);
+    p->length -= n;
+    return n;
+}
+
+/* Moves up to length bytes from an sg list into the pipe: buffers that hold a reference to their
+ * pages are added to the pipe without copying, the others are copied to pipe pages. */
+static u64 pipe_put_sg(pipe p, sg_list sg, u64 length)
+{
+    u64 moved = 0;
+    sg_buf sgb;
+    while ((moved < length) && ((sgb = sg_list_head_peek(sg)) != INVALID_ADDRESS)) {
+        u64 n = MIN(length - moved, sg_buf_len(sgb));
+        if (n == 0) {
+            sg_list_head_remove(sg);
+            sg_buf_release(sgb);
+            continue;
+        }
+        if (sgb->refcount) {
+            n = sg_move(p->data, sg, n);
+            p->length += n;
+        } else {
+            n = pipe_write_data(p, sgb->buf + sgb->offset, n);
+            if (n == 0)
+                break;
+            sg_consume(sg, n);
+        }
+        moved += n;
+    }
+    return moved;
+}
+
+/* Adds to an sg list new references to the first length bytes of pipe data, without consuming
+ * them. */
+static u64 pipe_peek_sg(pipe p, sg_list sg, u64 length)
+{
+    u64 n = 0;
+    sg_list_foreach(p->data, psgb) {
+        if (n == length)
+            break;
+        u32 len = MIN(length - n, sg_buf_len(psgb));
+        sg_buf sgb = sg_list_tail_add(sg, len);
+        sgb->buf = psgb->buf;
+        sgb->offset = psgb->offset;
+        sgb->size = psgb->offset + len;
+        refcount_reserve(psgb->refcount);
+        sgb->refcount = psgb->refcount;
+        n += len;
+    }
+    return n;
+}
+
 static inline void pipe_notify_reader(pipe_file pf, int events)
 {
     pipe_file read_pf = &pf->pipe->files[PIPE_READ];
@@ -95,8 +220,12 @@ static void pipe_release(pipe p)
 {
     if (!p->ref_cnt || (fetch_and_add(&p->ref_cnt, -1) == 1)) {
         pipe_debug("%s(%p): deallocating pipe\n", __func__, p);
-        if (p->data != INVALID_ADDRESS)
-            deallocate_buffer(p->data);
+        if (p->data != INVALID_ADDRESS) {
+            sg_list_release(p->data);
+            deallocate_sg_list(p->data);
+        }
+        if (p->tail)
+            refcount_release(&p->tail->refcount);
 
         unix_cache_free(get_unix_heaps(), pipe, p);
     }
@@ -113,7 +242,7 @@ static inline void pipe_dealloc_end(pipe p, pipe_file pf)
         deallocate_closure(pf->f.events);
     }
     if (&p->files[PIPE_WRITE] == pf) {
-        pipe_notify_reader(pf, (buffer_length(p->data) ? EPOLLIN : 0) | EPOLLHUP);
+        pipe_notify_reader(pf, (p->length ? EPOLLIN : 0) | EPOLLHUP);
         pipe_debug("%s(%p): reader notified\n", __func__, p);
         deallocate_closure(pf->f.write);
         deallocate_closure(pf->f.close);
@@ -143,32 +272,28 @@ closure_function(5, 1, sysreturn, pipe_read_bh,
         goto out;
     }
 
-    pipe_lock(pf->pipe);
-    buffer b = pf->pipe->data;
-    rv = MIN(buffer_length(b), bound(length));
+    pipe p = pf->pipe;
+    pipe_lock(p);
+    rv = p->splice_out ? 0 : MIN(p->length, bound(length));
     if (rv == 0) {
-        if (pf->pipe->files[PIPE_WRITE].fd == -1)
+        if (!p->splice_out && (p->files[PIPE_WRITE].fd == -1))
             goto unlock;
         if (pf->f.flags & O_NONBLOCK) {
             rv = -EAGAIN;
             goto unlock;
         }
-        pipe_unlock(pf->pipe);
+        pipe_unlock(p);
         return blockq_block_required(bound(t), flags);
     }
 
-    buffer_read(b, bound(dest), rv);
-
-    // If we have consumed all of the buffer, reset it. This might prevent future writes to allocte new buffer
-    // in buffer_write/buffer_extend. Can improve things until a proper circular buffer is available
-    if (buffer_length(b) == 0) {
-        buffer_clear(b);
-        pipe_unlock(pf->pipe);
+    pipe_read_data(p, bound(dest), rv);
+    if (p->length == 0) {
+        pipe_unlock(p);
         notify_dispatch(pf->f.ns, 0); /* for edge trigger */
         goto notify_writer;
     }
   unlock:
-    pipe_unlock(pf->pipe);
+    pipe_unlock(p);
   notify_writer:
     if (rv > 0)
         pipe_notify_writer(pf, EPOLLOUT);
@@ -205,9 +330,8 @@ closure_function(5, 1, sysreturn, pipe_write_bh,
 
     u64 length = bound(length);
     pipe p = pf->pipe;
-    buffer b = p->data;
     pipe_lock(p);
-    u64 avail = p->max_size - buffer_length(b);
+    u64 avail = p->max_size - MIN(p->length, p->max_size);
 
     if (avail == 0) {
         if (pf->pipe->files[PIPE_READ].fd == -1) {
@@ -222,9 +346,9 @@ closure_function(5, 1, sysreturn, pipe_write_bh,
         return blockq_block_required(bound(t), flags);
     }
 
-    u64 real_length = MIN(length, avail);
-    assert(buffer_write(b, bound(dest), real_length));
-    rv = real_length;
+    rv = pipe_write_data(p, bound(dest), MIN(length, avail));
+    if (rv == 0)
+        rv = -ENOMEM;
   unlock:
     pipe_unlock(p);
     if (avail == length)
@@ -256,7 +380,7 @@ closure_function(1, 1, u32, pipe_read_events,
     pipe_file pf = bound(pf);
     assert(pf->f.read);
     pipe_lock(pf->pipe);
-    u32 events = buffer_length(pf->pipe->data) ? EPOLLIN : 0;
+    u32 events = (pf->pipe->length && !pf->pipe->splice_out) ? EPOLLIN : 0;
     if (pf->pipe->files[PIPE_WRITE].fd == -1)
         events |= EPOLLHUP;
     pipe_unlock(pf->pipe);
@@ -270,7 +394,7 @@ closure_function(1, 1, u32, pipe_write_events,
     pipe_file pf = bound(pf);
     assert(pf->f.write);
     pipe_lock(pf->pipe);
-    u32 events = buffer_length(pf->pipe->data) < pf->pipe->max_size ? EPOLLOUT : 0;
+    u32 events = pf->pipe->length < pf->pipe->max_size ? EPOLLOUT : 0;
     if (pf->pipe->files[PIPE_READ].fd == -1)
         events |= EPOLLHUP;
     pipe_unlock(pf->pipe);
@@ -309,10 +433,14 @@ int do_pipe2(int fds[2], int flags)
 
     pipe->ref_cnt = 0;
     pipe->max_size = DEFAULT_PIPE_MAX_SIZE;
+    pipe->length = 0;
+    pipe->tail = 0;
+    pipe->tail_used = 0;
+    pipe->splice_out = false;
 
-    pipe->data = allocate_buffer(pipe->h, INITIAL_PIPE_DATA_SIZE);
+    pipe->data = allocate_sg_list();
     if (pipe->data == INVALID_ADDRESS) {
-        msg_err("failed to allocate pipe's data buffer\n");
+        msg_err("failed to allocate pipe's data list\n");
         goto err;
     }
     spin_lock_init(&pipe->lock);
@@ -378,21 +506,26 @@ err:
     return -ENOMEM;
 }
 
+/* The capacity is rounded up to a power of two number of pages, as in Linux. */
 int pipe_set_capacity(fdesc f, int capacity)
 {
     pipe_file pf = (pipe_file)f;
     pipe p = pf->pipe;
-    if (capacity < PIPE_MIN_CAPACITY)
-        capacity = PIPE_MIN_CAPACITY;
+    u64 size = MAX((u32)capacity, PIPE_MIN_CAPACITY);
+    if (size > PIPE_MAX_CAPACITY)
+        return -EPERM;
+    size = U64_FROM_BIT(find_order(size));
     int rv;
     pipe_lock(p);
-    if (capacity < buffer_length(p->data)) {
+    if (size < p->length) {
         rv = -EBUSY;
     } else {
-        p->max_size = buffer_set_capacity(p->data, (bytes)capacity);
-        rv = (int)p->max_size;
+        p->max_size = size;
+        rv = (int)size;
     }
     pipe_unlock(p);
+    if (rv > 0)
+        pipe_notify_writer(pf, EPOLLOUT);
     return rv;
 }
 
@@ -401,3 +534,492 @@ int pipe_get_capacity(fdesc f)
     pipe_file pf = (pipe_file)f;
     return (int)pf->pipe->max_size;
 }
+
+/* splice() and tee()
+
+   Data is moved between pipes, and between a pipe and another file, by passing references to the
+   pages that hold it: pages read from a file (or a socket) implementing the sg_read method are
+   added to the pipe without copying, and pipe pages are handed to the sg_write method of the
+   destination file. Files without sg methods are read into (or written from) a single page per
+   call.
+
+   While waiting for the pipe and the other file to become ready, the calling thread is blocked on
+   its thread blockq, which is woken by notify entries registered on both file descriptors. While
+   data is being spliced out of a pipe, other readers of the pipe wait until the transfer
+   completes, so that they cannot consume the same data. */
+
+declare_closure_struct(1, 2, boolean, splice_notify,
+                       struct splice_op *, op,
+                       u64, events, void *, arg);
+declare_closure_struct(1, 2, void, splice_complete,
+                       struct splice_op *, op,
+                       thread, t, sysreturn, rv);
+typedef struct splice_op {
+    thread t;
+    fdesc in, out;
+    pipe pin, pout;     /* set if the respective file descriptor refers to a pipe */
+    s64 *off_in, *off_out;
+    u64 pos_in, pos_out;
+    u64 len;            /* requested length */
+    u64 xfer;           /* length of the transfer being executed */
+    unsigned int flags;
+    boolean tee;
+    notify_entry ne_in, ne_out;
+    sg_list sg;
+    pipe_page pp;
+    closure_struct(splice_notify, notify);
+    closure_struct(splice_complete, complete);
+} *splice_op;
+
+define_closure_function(1, 2, boolean, splice_notify,
+                        struct splice_op *, op,
+                        u64, events, void *, arg)
+{
+    /* The operation cannot be retried here, as the notify set lock is held. */
+    if (events && (events != NOTIFY_EVENTS_RELEASE))
+        blockq_wake_one(bound(op)->t->thread_bq);
+    return false;
+}
+
+static void splice_op_free(splice_op op)
+{
+    if (op->ne_in != INVALID_ADDRESS)
+        notify_remove(op->in->ns, op->ne_in, false);
+    if (op->ne_out != INVALID_ADDRESS)
+        notify_remove(op->out->ns, op->ne_out, false);
+    fdesc_put(op->in);
+    fdesc_put(op->out);
+    deallocate(heap_locked(get_kernel_heaps()), op, sizeof(*op));
+}
+
+static inline sysreturn splice_wait(splice_op op, fdesc f)
+{
+    return ((op->flags & SPLICE_F_NONBLOCK) || (f->flags & O_NONBLOCK)) ?
+        -EAGAIN : BLOCKQ_BLOCK_REQUIRED;
+}
+
+static inline boolean splice_file_ready(splice_op op, fdesc f, u32 events)
+{
+    return !f->events || (apply(f->events, op->t) & (events | EPOLLERR | EPOLLHUP));
+}
+
+static void pipe_lock_both(pipe a, pipe b)
+{
+    if (a < b) {
+        pipe_lock(a);
+        pipe_lock(b);
+    } else {
+        pipe_lock(b);
+        pipe_lock(a);
+    }
+}
+
+/* Returns true if the input pipe has no data that can be spliced, setting *rv accordingly. */
+static boolean splice_pipe_empty(splice_op op, sysreturn *rv)
+{
+    pipe p = op->pin;
+    if (p->length && !p->splice_out)
+        return false;
+    *rv = (!p->splice_out && (p->files[PIPE_WRITE].fd == -1)) ? 0 : splice_wait(op, op->in);
+    return true;
+}
+
+static sysreturn splice_pipes(splice_op op)
+{
+    pipe pin = op->pin, pout = op->pout;
+    sysreturn rv;
+    pipe_lock_both(pin, pout);
+    if (splice_pipe_empty(op, &rv))
+        goto unlock;
+    if (pout->files[PIPE_READ].fd == -1) {
+        rv = -EPIPE;
+        goto unlock;
+    }
+    u64 n = MIN(MIN(op->len, pin->length), pout->max_size - MIN(pout->length, pout->max_size));
+    if (n == 0) {
+        rv = splice_wait(op, op->out);
+        goto unlock;
+    }
+    if (op->tee) {
+        n = pipe_peek_sg(pin, pout->data, n);
+    } else {
+        n = sg_move(pout->data, pin->data, n);
+        pin->length -= n;
+    }
+    pout->length += n;
+    rv = n;
+  unlock:
+    pipe_unlock(pin);
+    pipe_unlock(pout);
+    if (rv > 0) {
+        if (!op->tee)
+            pipe_notify_writer(&pin->files[PIPE_READ], EPOLLOUT);
+        pipe_notify_reader(&pout->files[PIPE_WRITE], EPOLLIN);
+    }
+    return rv;
+}
+
+/* Returns true if data can be read from the input file into the output pipe. */
+static boolean splice_to_pipe_ready(splice_op op, sysreturn *rv)
+{
+    pipe p = op->pout;
+    boolean ready = false;
+    pipe_lock(p);
+    if (p->files[PIPE_READ].fd == -1) {
+        *rv = -EPIPE;
+    } else if (p->length >= p->max_size) {
+        *rv = splice_wait(op, op->out);
+    } else {
+        op->xfer = MIN(op->len, p->max_size - p->length);
+        ready = true;
+    }
+    pipe_unlock(p);
+    if (ready && !splice_file_ready(op, op->in, EPOLLIN | EPOLLRDHUP)) {
+        *rv = splice_wait(op, op->in);
+        ready = false;
+    }
+    return ready;
+}
+
+static sysreturn splice_to_pipe_start(splice_op op, boolean bh)
+{
+    fdesc in = op->in;
+    u64 offset = op->off_in ? op->pos_in : infinity;
+    io_completion completion = (io_completion)&op->complete;
+    if (in->sg_read) {
+        op->sg = allocate_sg_list();
+        if (op->sg == INVALID_ADDRESS) {
+            op->sg = 0;
+            return io_complete(completion, op->t, -ENOMEM);
+        }
+        return apply(in->sg_read, op->sg, op->xfer, offset, op->t, bh, completion);
+    }
+    op->pp = pipe_page_alloc();
+    if (op->pp == INVALID_ADDRESS) {
+        op->pp = 0;
+        return io_complete(completion, op->t, -ENOMEM);
+    }
+    return apply(in->read, op->pp->data, MIN(op->xfer, PAGESIZE), offset, op->t, bh, completion);
+}
+
+static sysreturn splice_to_pipe_complete(splice_op op, sysreturn rv)
+{
+    pipe p = op->pout;
+    if (rv > 0) {
+        pipe_lock(p);
+        if (op->sg) {
+            rv = pipe_put_sg(p, op->sg, rv);
+        } else {
+            /* the reference obtained at allocation is handed to the pipe */
+            sg_buf sgb = sg_list_tail_add(p->data, rv);
+            sgb->buf = op->pp->data;
+            sgb->offset = 0;
+            sgb->size = rv;
+            sgb->refcount = &op->pp->refcount;
+            p->length += rv;
+            op->pp = 0;
+        }
+        pipe_unlock(p);
+        if (rv > 0) {
+            if (op->off_in)
+                *op->off_in += rv;
+            pipe_notify_reader(&p->files[PIPE_WRITE], EPOLLIN);
+        } else {
+            rv = -ENOMEM;
+        }
+    }
+    if (op->sg) {
+        sg_list_release(op->sg);
+        deallocate_sg_list(op->sg);
+    }
+    if (op->pp)
+        refcount_release(&op->pp->refcount);
+    return rv;
+}
+
+/* Returns true if data can be written from the input pipe to the output file; in this case, the
+ * data to be written is referenced in op->sg. */
+static boolean splice_from_pipe_ready(splice_op op, sysreturn *rv)
+{
+    pipe p = op->pin;
+    if (!splice_file_ready(op, op->out, EPOLLOUT)) {
+        *rv = splice_wait(op, op->out);
+        return false;
+    }
+    sg_list sg = allocate_sg_list();
+    if (sg == INVALID_ADDRESS) {
+        *rv = -ENOMEM;
+        return false;
+    }
+    pipe_lock(p);
+    if (splice_pipe_empty(op, rv)) {
+        pipe_unlock(p);
+        deallocate_sg_list(sg);
+        return false;
+    }
+    op->xfer = pipe_peek_sg(p, sg, MIN(op->len, p->length));
+    p->splice_out = true;
+    pipe_unlock(p);
+    op->sg = sg;
+    return true;
+}
+
+static sysreturn splice_from_pipe_start(splice_op op, boolean bh)
+{
+    fdesc out = op->out;
+    u64 offset = op->off_out ? op->pos_out : infinity;
+    io_completion completion = (io_completion)&op->complete;
+    if (out->sg_write)
+        return apply(out->sg_write, op->sg, op->xfer, offset, op->t, bh, completion);
+    sg_buf sgb = sg_list_head_peek(op->sg);
+    return apply(out->write, sgb->buf + sgb->offset, MIN(op->xfer, sg_buf_len(sgb)), offset,
+                 op->t, bh, completion);
+}
+
+static sysreturn splice_from_pipe_complete(splice_op op, sysreturn rv)
+{
+    pipe p = op->pin;
+    sg_list_release(op->sg);
+    deallocate_sg_list(op->sg);
+    pipe_lock(p);
+    if (rv > 0) {
+        sg_consume(p->data, rv);
+        p->length -= rv;
+    }
+    p->splice_out = false;
+    boolean data = p->length != 0;
+    pipe_unlock(p);
+    if (rv > 0) {
+        if (op->off_out)
+            *op->off_out += rv;
+        pipe_notify_writer(&p->files[PIPE_READ], EPOLLOUT);
+    }
+    if (data)
+        pipe_notify_reader(&p->files[PIPE_READ], EPOLLIN);
+    return rv;
+}
+
+define_closure_function(1, 2, void, splice_complete,
+                        struct splice_op *, op,
+                        thread, t, sysreturn, rv)
+{
+    splice_op op = bound(op);
+    thread_log(t, "%s: rv %ld", __func__, rv);
+    rv = op->pin ? splice_from_pipe_complete(op, rv) : splice_to_pipe_complete(op, rv);
+    splice_op_free(op);
+    syscall_return(t, rv);
+}
+
+closure_function(1, 1, sysreturn, splice_bh,
+                 splice_op, op,
+                 u64, flags)
+{
+    splice_op op = bound(op);
+    thread t = op->t;
+    sysreturn rv;
+
+    if (flags & BLOCKQ_ACTION_NULLIFY) {
+        rv = -ERESTARTSYS;
+        goto out;
+    }
+    if (op->pin && op->pout) {
+        rv = splice_pipes(op);
+    } else if (op->pout ? splice_to_pipe_ready(op, &rv) : splice_from_pipe_ready(op, &rv)) {
+        /* the I/O completion finishes the syscall, and when not in a bottom half the I/O
+         * method returns after completion */
+        closure_finish();
+        boolean bh = (flags & BLOCKQ_ACTION_BLOCKED) != 0;
+        rv = op->pout ? splice_to_pipe_start(op, bh) : splice_from_pipe_start(op, bh);
+        return bh ? rv : get_syscall_return(t);
+    }
+    if (rv == BLOCKQ_BLOCK_REQUIRED)
+        return blockq_block_required(t, flags);
+  out:
+    closure_finish();
+    splice_op_free(op);
+    return syscall_return(t, rv);
+}
+
+static sysreturn splice_internal(int fd_in, s64 *off_in, int fd_out, s64 *off_out, u64 len,
+                                 unsigned int flags, boolean tee)
+{
+    thread_log(current, "%s: in %d, out %d, len %ld, flags 0x%x, tee %d",
+               __func__, fd_in, fd_out, len, flags, tee);
+    if (flags & ~SPLICE_F_ALL)
+        return -EINVAL;
+    if ((off_in && !validate_user_memory(off_in, sizeof(*off_in), true)) ||
+        (off_out && !validate_user_memory(off_out, sizeof(*off_out), true)))
+        return -EFAULT;
+    fdesc in = resolve_fd(current->p, fd_in);
+    fdesc out = fdesc_get(current->p, fd_out);
+    if (!out) {
+        fdesc_put(in);
+        return -EBADF;
+    }
+    sysreturn rv;
+    if (!fdesc_is_readable(in) || !fdesc_is_writable(out)) {
+        rv = -EBADF;
+        goto out;
+    }
+    pipe pin = (in->type == FDESC_TYPE_PIPE) ? ((pipe_file)in)->pipe : 0;
+    pipe pout = (out->type == FDESC_TYPE_PIPE) ? ((pipe_file)out)->pipe : 0;
+    if ((tee ? (!pin || !pout) : (!pin && !pout)) || (pin == pout) ||
+        (!pin && !in->sg_read && !in->read) || (!pout && !out->sg_write && !out->write)) {
+        rv = -EINVAL;
+        goto out;
+    }
+    if ((off_in && (pin || (in->type != FDESC_TYPE_REGULAR))) ||
+        (off_out && (pout || (out->type != FDESC_TYPE_REGULAR)))) {
+        rv = -ESPIPE;
+        goto out;
+    }
+    if ((off_in && (*off_in < 0)) || (off_out && (*off_out < 0))) {
+        rv = -EINVAL;
+        goto out;
+    }
+    if (len == 0) {
+        rv = 0;
+        goto out;
+    }
+
+    splice_op op = allocate(heap_locked(get_kernel_heaps()), sizeof(*op));
+    if (op == INVALID_ADDRESS) {
+        rv = -ENOMEM;
+        goto out;
+    }
+    op->t = current;
+    op->in = in;
+    op->out = out;
+    op->pin = pin;
+    op->pout = pout;
+    op->off_in = off_in;
+    op->off_out = off_out;
+    op->pos_in = off_in ? *off_in : 0;
+    op->pos_out = off_out ? *off_out : 0;
+    op->len = len;
+    op->flags = flags;
+    op->tee = tee;
+    op->sg = 0;
+    op->pp = 0;
+    init_closure(&op->complete, splice_complete, op);
+    event_handler eh = (event_handler)init_closure(&op->notify, splice_notify, op);
+    op->ne_in = notify_add(in->ns, EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP, eh);
+    op->ne_out = notify_add(out->ns, EPOLLOUT | EPOLLERR | EPOLLHUP, eh);
+    if ((op->ne_in == INVALID_ADDRESS) || (op->ne_out == INVALID_ADDRESS)) {
+        splice_op_free(op);
+        return -ENOMEM;
+    }
+    blockq_action ba = contextual_closure(splice_bh, op);
+    if (ba == INVALID_ADDRESS) {
+        splice_op_free(op);
+        return -ENOMEM;
+    }
+    return blockq_check(current->thread_bq, current, ba, false);
+  out:
+    fdesc_put(in);
+    fdesc_put(out);
+    return rv;
+}
+
+sysreturn splice(int fd_in, s64 *off_in, int fd_out, s64 *off_out, u64 len, unsigned int flags)
+{
+    return splice_internal(fd_in, off_in, fd_out, off_out, len, flags, false);
+}
+
+sysreturn tee(int fd_in, int fd_out, u64 len, unsigned int flags)
+{
+    return splice_internal(fd_in, 0, fd_out, 0, len, flags, true);
+}
+
+/* The user memory is copied to (or from) the pipe, instead of being mapped into it. */
+closure_function(5, 1, sysreturn, vmsplice_bh,
+                 pipe_file, pf, thread, t, struct iovec *, iov, int, iovcnt, unsigned int, flags,
+                 u64, bq_flags)
+{
+    pipe_file pf = bound(pf);
+    pipe p = pf->pipe;
+    boolean write = (pf == &p->files[PIPE_WRITE]);
+    struct iovec *iov = bound(iov);
+    sysreturn rv = 0;
+
+    if (bq_flags & BLOCKQ_ACTION_NULLIFY) {
+        rv = -ERESTARTSYS;
+        goto out;
+    }
+    pipe_lock(p);
+    if (write) {
+        if (p->files[PIPE_READ].fd == -1) {
+            rv = -EPIPE;
+            goto unlock;
+        }
+        for (int i = 0; (i < bound(iovcnt)) && (p->length < p->max_size); i++) {
+            u64 len = MIN(iov[i].iov_len, p->max_size - p->length);
+            u64 n = pipe_write_data(p, iov[i].iov_base, len);
+            rv += n;
+            if (n < len)
+                break;
+        }
+        if ((rv == 0) && (p->length < p->max_size))
+            rv = -ENOMEM;
+    } else {
+        if (!p->splice_out) {
+            for (int i = 0; (i < bound(iovcnt)) && p->length; i++)
+                rv += pipe_read_data(p, iov[i].iov_base, iov[i].iov_len);
+        }
+        if ((rv == 0) && !p->splice_out && (p->files[PIPE_WRITE].fd == -1))
+            goto unlock;
+    }
+    if (rv == 0) {
+        if ((bound(flags) & SPLICE_F_NONBLOCK) || (pf->f.flags & O_NONBLOCK)) {
+            rv = -EAGAIN;
+            goto unlock;
+        }
+        pipe_unlock(p);
+        return blockq_block_required(bound(t), bq_flags);
+    }
+  unlock:
+    pipe_unlock(p);
+    if (rv > 0) {
+        if (write)
+            pipe_notify_reader(pf, EPOLLIN);
+        else
+            pipe_notify_writer(pf, EPOLLOUT);
+    }
+  out:
+    fdesc_put(&pf->f);
+    closure_finish();
+    return syscall_return(bound(t), rv);
+}
+
+sysreturn vmsplice(int fd, struct iovec *iov, u64 nr_segs, unsigned int flags)
+{
+    if (flags & ~SPLICE_F_ALL)
+        return -EINVAL;
+    if (nr_segs > IOV_MAX)
+        return -EINVAL;
+    fdesc f = resolve_fd(current->p, fd);
+    sysreturn rv;
+    if (f->type != FDESC_TYPE_PIPE) {
+        rv = -EBADF;
+        goto out;
+    }
+    pipe_file pf = (pipe_file)f;
+    boolean write = (pf == &pf->pipe->files[PIPE_WRITE]);
+    if (!validate_iovec(iov, nr_segs, !write)) {
+        rv = -EFAULT;
+        goto out;
+    }
+    if (iov_total_len(iov, nr_segs) == 0) {
+        rv = 0;
+        goto out;
+    }
+    blockq_action ba = contextual_closure(vmsplice_bh, pf, current, iov, nr_segs, flags);
+    if (ba == INVALID_ADDRESS) {
+        rv = -ENOMEM;
+        goto out;
+    }
+    return blockq_check(pf->bq, current, ba, false);
+  out:
+    fdesc_put(f);
+    return rv;
+}
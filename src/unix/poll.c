@@ -25,8 +25,21 @@ typedef struct epollfd {
     boolean registered;
     boolean zombie; /* freed or masked by oneshot */
     notify_entry notify_handle;
+
+    /* epoll ready list state, protected by e->ready_lock */
+    struct list ready_l;    /* in e->ready_list, unless detached by epoll_collect() */
+    u32 revents;            /* events posted since last collected */
+    boolean ready;          /* in (or detached from) the ready list, holding a reference */
 } *epollfd;
 
+/* Events posted for a registered fd that are directed at a specific thread */
+typedef struct epoll_directed {
+    struct list l;          /* in e->directed_list */
+    epollfd efd;            /* holds a reference */
+    int tid;
+    u32 revents;
+} *epoll_directed;
+
 typedef struct epoll_blocked *epoll_blocked;
 
 declare_closure_struct(1, 0, void, epoll_blocked_free,
@@ -46,8 +59,12 @@ struct epoll_blocked {
     struct refcount refcount;
     struct spinlock lock;   /* protects the data in the union */
     closure_struct(epoll_blocked_free, free);
+    boolean woken;          /* wakeup posted since last collection; protected by e->blocked_lock */
     union {
-        buffer user_events;
+        struct {
+            struct epoll_event *user_events;
+            int maxevents;
+        };
         struct {
             buffer poll_fds;
             u64 poll_retcount;
@@ -79,6 +96,14 @@ struct epoll {
     vector events;              /* epollfds indexed by fd */
     int nfds;
     bitmap fds;                 /* fds being watched / epollfd registered */
+
+    /* For epoll instances, registered fds with events to report are queued on the ready list when
+       they are notified, so that epoll_wait only visits ready fds. Level-triggered fds stay on the
+       list for as long as they have events to report. Thread-directed events are queued on the
+       directed list instead, and are only collected by the thread they are directed at. */
+    struct spinlock ready_lock;
+    struct list ready_list;
+    struct list directed_list;
 };
 
 define_closure_function(1, 0, void, epoll_free,
@@ -104,6 +129,9 @@ static epoll epoll_alloc_internal(int epoll_type)
     init_refcount(&e->refcount, 1, init_closure(&e->free, epoll_free, e));
     spin_lock_init(&e->blocked_lock);
     spin_lock_init(&e->fds_lock);
+    spin_lock_init(&e->ready_lock);
+    list_init(&e->ready_list);
+    list_init(&e->directed_list);
     e->h = epoll_heap;
     e->events = allocate_vector(e->h, 8);
     if (e->events == INVALID_ADDRESS)
@@ -138,6 +166,9 @@ static void reset_epollfd(epollfd efd, u32 eventmask, u64 data)
     efd->lastevents = 0;
     efd->zombie = false;
     efd->data = data;
+    spin_lock(&efd->e->ready_lock);
+    efd->revents = 0;
+    spin_unlock(&efd->e->ready_lock);
 }
 
 static epollfd alloc_epollfd(epoll e, int fd, u32 eventmask, u64 data)
@@ -148,6 +179,8 @@ static epollfd alloc_epollfd(epoll e, int fd, u32 eventmask, u64 data)
         return efd;
     efd->fd = fd;
     efd->e = e;
+    list_init_member(&efd->ready_l);
+    efd->ready = false;
     reset_epollfd(efd, eventmask, data);
     init_refcount(&efd->refcount, 1, init_closure(&efd->free, epollfd_free, efd));
     spin_lock_init(&efd->lock);
@@ -183,13 +216,37 @@ static void release_epollfd(epollfd efd)
     spin_unlock(&efd->lock);
     if (efd->registered)
         notify_remove(efd->f->ns, efd->notify_handle, true); /* eh calls unregister */
+
+    /* an epollfd detached from the ready list is dropped by the collector */
+    spin_lock(&e->ready_lock);
+    boolean queued = list_inserted(&efd->ready_l);
+    if (queued) {
+        list_delete(&efd->ready_l);
+        efd->ready = false;
+    }
+    struct list directed;
+    list_init(&directed);
+    list_foreach(&e->directed_list, l) {
+        epoll_directed d = struct_from_list(l, epoll_directed, l);
+        if (d->efd == efd) {
+            list_delete(l);
+            list_push_back(&directed, l);
+        }
+    }
+    spin_unlock(&e->ready_lock);
+    if (queued)
+        refcount_release(&efd->refcount); /* ready list */
+    list_foreach(&directed, l) {
+        list_delete(l);
+        deallocate(epoll_heap, struct_from_list(l, epoll_directed, l), sizeof(struct epoll_directed));
+        refcount_release(&efd->refcount); /* directed list */
+    }
     refcount_release(&efd->refcount); /* alloc */
 }
 
 static inline void poll_notify(epollfd efd, epoll_blocked w, u64 events);
-static inline void epoll_wait_notify(epollfd efd, epoll_blocked w, u64 report);
 static inline void select_notify(epollfd efd, epoll_blocked w, u64 report);
-static inline u32 report_from_notify_events(epollfd efd, u64 notify_events);
+static void epollfd_post(epollfd efd, u32 events, thread t);
 
 closure_function(1, 2, boolean, wait_notify,
                  epollfd, efd,
@@ -213,12 +270,16 @@ closure_function(1, 2, boolean, wait_notify,
         return false;
     }
 
+    u32 events = (u32)notify_events;
+    if (efd->e->epoll_type == EPOLL_TYPE_EPOLL) {
+        epollfd_post(efd, events, t);
+        spin_unlock(&efd->lock);
+        return false;
+    }
+
     spin_lock(&efd->e->blocked_lock);
     list l = list_get_next(&efd->e->blocked_head);
     epoll_blocked w = l ? struct_from_list(l, epoll_blocked, blocked_list) : 0;
-    u32 events = (u32)notify_events;
-    if (efd->e->epoll_type == EPOLL_TYPE_EPOLL)
-        events = report_from_notify_events(efd, events);
     epoll_debug("efd->fd %d, events 0x%x, blocked %p, zombie %d\n",
                 efd->fd, events, w, efd->zombie);
 
@@ -233,9 +294,6 @@ closure_function(1, 2, boolean, wait_notify,
     case EPOLL_TYPE_POLL:
         poll_notify(efd, w, events);
         break;
-    case EPOLL_TYPE_EPOLL:
-        epoll_wait_notify(efd, w, events);
-        break;
     case EPOLL_TYPE_SELECT:
         select_notify(efd, w, events);
         break;
@@ -265,7 +323,10 @@ static boolean register_epollfd(epollfd efd)
     refcount_reserve(&efd->refcount); /* registration */
     event_handler eh = closure(efd->e->h, wait_notify, efd);
     epoll_debug("fd %d, eventmask 0x%x, handler %p\n", efd->fd, efd->eventmask, eh);
-    efd->notify_handle = notify_add(f->ns, efd->eventmask | (EPOLLERR | EPOLLHUP), eh);
+    u64 eventmask = efd->eventmask | (EPOLLERR | EPOLLHUP);
+    if (efd->eventmask & EPOLLEXCLUSIVE)
+        eventmask |= NOTIFY_EXCLUSIVE;
+    efd->notify_handle = notify_add(f->ns, eventmask, eh);
     assert(efd->notify_handle != INVALID_ADDRESS);
     fdesc_put(f);   /* if the file descriptor is deallocated, we will be notified via f->ns */
     return true;
@@ -324,8 +385,6 @@ sysreturn epoll_create(int flags)
     return rv;
 }
 
-#define user_event_count(__w) (buffer_length(__w->user_events)/sizeof(struct epoll_event))
-
 define_closure_function(1, 0, void, epoll_blocked_free,
                         epoll_blocked, w)
 {
@@ -368,50 +427,229 @@ static inline u32 report_from_notify_events(epollfd efd, u64 notify_events)
     return edge_detect ? ~efd->lastevents & events : events;
 }
 
-static inline void epoll_wait_notify(epollfd efd, epoll_blocked w, u64 report)
+/* Wakes a waiter of the epoll (only a waiter on thread t, if specified) that has not been woken
+   since it last collected events. */
+static void epoll_wake_waiter(epoll e, thread t, epoll_blocked self)
 {
+    spin_lock(&e->blocked_lock);
+    list_foreach(&e->blocked_head, l) {
+        epoll_blocked w = struct_from_list(l, epoll_blocked, blocked_list);
+        if (w == self || w->woken || (t && t != w->t))
+            continue;
+        w->woken = true;
+        blockq_wake_one(w->t->thread_bq);
+        break;
+    }
+    spin_unlock(&e->blocked_lock);
+}
+
+/* Queues the epollfd on the ready list if events need to be reported, and wakes a waiter.
+   Events directed at a specific thread (e.g. signalfd readiness for a signal pending on that
+   thread) are kept off the shared ready list, so that they cannot be consumed by another thread.
+   Called with efd->lock held. */
+static void epollfd_post(epollfd efd, u32 events, thread t)
+{
+    u32 report = report_from_notify_events(efd, events);
+    epoll_debug("efd->fd %d, events 0x%x, report 0x%x, tid %d\n", efd->fd, events, report,
+                t ? t->tid : 0);
     if (report == 0)
         return;
 
-    spin_lock(&w->lock);
-    if (!w->user_events || (w->user_events->length - w->user_events->end) <= 0) {
-        spin_unlock(&w->lock);
-        /* XXX here we should advance to the next blocked head, probably */
-        epoll_debug("   user_events null or full\n");
-        return;
+    /* now that these events will be reported, update last */
+    efd->lastevents |= report;
+    epoll e = efd->e;
+    spin_lock(&e->ready_lock);
+    if (t) {
+        list_foreach(&e->directed_list, l) {
+            epoll_directed d = struct_from_list(l, epoll_directed, l);
+            if (d->efd == efd && d->tid == t->tid) {
+                d->revents |= report;
+                goto wake;
+            }
+        }
+        epoll_directed d = allocate(epoll_heap, sizeof(*d));
+        if (d != INVALID_ADDRESS) {
+            d->efd = efd;
+            d->tid = t->tid;
+            d->revents = report;
+            list_push_back(&e->directed_list, &d->l);
+            refcount_reserve(&efd->refcount); /* directed list */
+            goto wake;
+        }
+        /* fall back to the shared ready list */
+    }
+    efd->revents |= report;
+    if (!efd->ready) {
+        efd->ready = true;
+        list_push_back(&e->ready_list, &efd->ready_l);
+        refcount_reserve(&efd->refcount); /* ready list */
     }
+  wake:
+    spin_unlock(&e->ready_lock);
+    epoll_wake_waiter(e, t, 0);
+}
+
+/* Evaluates the events to report for an epollfd on behalf of thread t. Level-triggered events
+   are checked against the thread, and edge-triggered ones are taken from the posted events. */
+static u32 epollfd_collect_events(epollfd efd, thread t, u32 revents, u64 *data, boolean *level)
+{
+    u32 report = 0;
+    *level = false;
+    spin_lock(&efd->lock);
+    if (!efd->zombie && efd->registered) {
+        u32 eventmask = efd->eventmask | (EPOLLERR | EPOLLHUP);
+        if (efd->eventmask & EPOLLET) {
+            report = revents & eventmask;
+        } else {
+            report = apply(efd->f->events, t) & eventmask;
+            *level = true;
+        }
+        *data = efd->data;
+        if (report && (efd->eventmask & EPOLLONESHOT)) {
+            efd->zombie = true;
+            *level = false;
+        }
+    }
+    spin_unlock(&efd->lock);
+    return report;
+}
+
+static void epoll_report(thread t, struct epoll_event *ev, u32 report, u64 data)
+{
     context ctx = get_current_context(current_cpu());
     if (is_kernel_context(ctx)) {
         /* Borrow the thread's fault handler prior to touching user memory. */
-        use_fault_handler(w->t->context.fault_handler);
-    }
-    struct epoll_event *e, *end;
-    e = buffer_ref(w->user_events, 0);
-    end = buffer_ref(w->user_events, w->user_events->end);
-    while (e < end) {
-        if (e->data == efd->data) {
-            /* Use the union of reported events so that edge triggers aren't missed. */
-            e->events |= report;
-            goto reported;
-        }
-        e++;
+        use_fault_handler(t->context.fault_handler);
     }
-    e->data = efd->data;
-    e->events = report;
-    w->user_events->end += sizeof(struct epoll_event);
-  reported:
-    epoll_debug("   epoll_event %p, data 0x%lx, events 0x%x\n", e, e->data, e->events);
+    ev->events = report;
+    ev->data = data;
     if (is_kernel_context(ctx))
         clear_fault_handler();
-    spin_unlock(&w->lock);
-    
-    /* XXX check this */
-    if (efd->eventmask & EPOLLONESHOT)
-        efd->zombie = true;
+}
 
-    /* now that we've reported these events, update last */
-    efd->lastevents |= report;
-    blockq_wake_one(w->t->thread_bq);
+/* Puts back an epollfd detached from the ready list after its events have been collected. */
+static void epollfd_requeue(epoll e, epollfd efd, u32 report, boolean level, list requeue)
+{
+    boolean drop = false;
+    spin_lock(&e->ready_lock);
+    if (efd->zombie)
+        drop = true;
+    else if (report && level)
+        list_push_back(requeue, &efd->ready_l);
+    else if (efd->revents)
+        list_push_back(&e->ready_list, &efd->ready_l);  /* posted while detached */
+    else
+        drop = true;
+    if (drop)
+        efd->ready = false;
+    spin_unlock(&e->ready_lock);
+    if (drop)
+        refcount_release(&efd->refcount); /* ready list */
+}
+
+/* Reports events of ready epollfds into the user buffer, visiting only the events directed at
+   thread t and the ready list. Each epollfd is detached from the list while its events are
+   evaluated, so that the epollfd lock is not taken under the ready list lock. Level-triggered
+   epollfds that still have events are requeued, and edge-triggered and one-shot epollfds are
+   dropped until notified again. */
+static int epoll_collect(epoll e, thread t, epoll_blocked self, struct epoll_event *user_events,
+                         int maxevents)
+{
+    struct list requeue, directed_requeue;
+    int count = 0;
+    list_init(&requeue);
+    list_init(&directed_requeue);
+    while (count < maxevents) {
+        spin_lock(&e->ready_lock);
+        epoll_directed d = 0;
+        list_foreach(&e->directed_list, l) {
+            epoll_directed i = struct_from_list(l, epoll_directed, l);
+            if (i->tid == t->tid) {
+                d = i;
+                break;
+            }
+        }
+        if (!d) {
+            spin_unlock(&e->ready_lock);
+            break;
+        }
+        list_delete(&d->l);
+        epollfd efd = d->efd;
+        u32 revents = d->revents;
+        d->revents = 0;
+
+        /* also take any shared events, so that the fd is reported only once */
+        boolean shared = list_inserted(&efd->ready_l);
+        if (shared) {
+            list_delete(&efd->ready_l);
+            revents |= efd->revents;
+            efd->revents = 0;
+        }
+        spin_unlock(&e->ready_lock);
+
+        u64 data = 0;
+        boolean level;
+        u32 report = epollfd_collect_events(efd, t, revents, &data, &level);
+        if (report) {
+            epoll_report(t, &user_events[count++], report, data);
+            epoll_debug("   fd %d, data 0x%lx, events 0x%x (directed)\n", efd->fd, data, report);
+        }
+        if (shared)
+            epollfd_requeue(e, efd, report, level, &requeue);
+        if (report && level) {
+            list_push_back(&directed_requeue, &d->l);
+        } else {
+            deallocate(epoll_heap, d, sizeof(*d));
+            refcount_release(&efd->refcount); /* directed list */
+        }
+    }
+
+    while (count < maxevents) {
+        spin_lock(&e->ready_lock);
+        list l = list_get_next(&e->ready_list);
+        if (!l) {
+            spin_unlock(&e->ready_lock);
+            break;
+        }
+        list_delete(l);
+        epollfd efd = struct_from_list(l, epollfd, ready_l);
+        u32 revents = efd->revents;
+        efd->revents = 0;
+        spin_unlock(&e->ready_lock);
+
+        u64 data = 0;
+        boolean level;
+        u32 report = epollfd_collect_events(efd, t, revents, &data, &level);
+        if (report) {
+            epoll_report(t, &user_events[count++], report, data);
+            epoll_debug("   fd %d, data 0x%lx, events 0x%x\n", efd->fd, data, report);
+        }
+        epollfd_requeue(e, efd, report, level, &requeue);
+    }
+
+    spin_lock(&e->ready_lock);
+    list_foreach(&requeue, l) {
+        list_delete(l);
+        list_push_back(&e->ready_list, l);
+    }
+    list_foreach(&directed_requeue, l) {
+        if (struct_from_list(l, epoll_directed, l)->efd->zombie)
+            continue;
+        list_delete(l);
+        list_push_back(&e->directed_list, l);
+    }
+    boolean more = !list_empty(&e->ready_list);
+    spin_unlock(&e->ready_lock);
+    list_foreach(&directed_requeue, l) {
+        epoll_directed d = struct_from_list(l, epoll_directed, l);
+        epollfd efd = d->efd;
+        list_delete(l);
+        deallocate(epoll_heap, d, sizeof(*d));
+        refcount_release(&efd->refcount); /* directed list */
+    }
+    if (more)
+        epoll_wake_waiter(e, 0, self);
+    return count;
 }
 
 static epoll_blocked alloc_epoll_blocked(epoll e)
@@ -446,9 +684,6 @@ static void check_fdesc(epollfd efd, epoll_blocked w)
     case EPOLL_TYPE_POLL:
         poll_notify(efd, w, events);
         break;
-    case EPOLL_TYPE_EPOLL:
-        epoll_wait_notify(efd, w, report_from_notify_events(efd, events));
-        break;
     case EPOLL_TYPE_SELECT:
         select_notify(efd, w, events);
         break;
@@ -467,9 +702,14 @@ closure_function(3, 1, sysreturn, epoll_wait_bh,
     sysreturn rv;
     thread t = bound(t);
     epoll_blocked w = bound(w);
+    epoll e = w->e;
     timestamp timeout = bound(timeout);
-    spin_lock(&w->lock);
-    int eventcount = user_event_count(w);
+
+    /* clear before collecting, so that events posted from here on wake this waiter again */
+    spin_lock(&e->blocked_lock);
+    w->woken = false;
+    spin_unlock(&e->blocked_lock);
+    int eventcount = epoll_collect(e, t, w, w->user_events, w->maxevents);
 
     epoll_debug("w %p on tid %d, timeout %ld, flags 0x%lx, event count %d\n",
                 w, t->tid, timeout, flags, eventcount);
@@ -483,15 +723,11 @@ closure_function(3, 1, sysreturn, epoll_wait_bh,
         rv = (timeout == infinity) ? -ERESTARTSYS : -EINTR;
         goto out_wakeup;
     }
-    spin_unlock(&w->lock);
 
     epoll_debug("  continue blocking\n");
     return blockq_block_required(bound(t), flags);
   out_wakeup:
-    unwrap_buffer(w->e->h, w->user_events);
-    w->user_events = 0;
-    spin_unlock(&w->lock);
-    fdesc_put(&w->e->f);
+    fdesc_put(&e->f);
     epoll_debug("   pre refcnt %ld, returning %ld\n", w->refcount.c, rv);
     epoll_blocked_release(w, flags);
     closure_finish();
@@ -502,19 +738,32 @@ closure_function(3, 1, sysreturn, epoll_wait_bh,
    - notify all waiters on a match (default)
    - notify on a match only once until condition is reset (EPOLLET)
    - notify once before removing the registration, handled upstream (EPOLLONESHOT)
-   - notify only one matching waiter, even across multiple epoll instances (EPOLLEXCLUSIVE)
-     - XXX Not implemented; will require tracking reported events on a per fd - not per
-           registration - basis.
+   - notify only one matching waiter, even across multiple epoll instances (EPOLLEXCLUSIVE);
+     events are dispatched to the exclusive registrations of an fd in round-robin order.
+   Each event posted to an epoll instance wakes a single thread waiting on it.
 */
 sysreturn epoll_wait(int epfd,
                      struct epoll_event *events,
                      int maxevents,
                      int timeout)
 {
+    if (maxevents <= 0)
+        return -EINVAL;
     if (!validate_user_memory(events, sizeof(struct epoll_event) * maxevents, true))
         return -EFAULT;
 
     epoll e = resolve_fd(current->p, epfd);
+    if (e->f.type != FDESC_TYPE_EPOLL) {
+        fdesc_put(&e->f);
+        return -EINVAL;
+    }
+
+    /* only allocate a waiter if there is nothing to report yet */
+    int eventcount = epoll_collect(e, current, 0, events, maxevents);
+    if (eventcount || !timeout) {
+        fdesc_put(&e->f);
+        return eventcount;
+    }
     epoll_blocked w = alloc_epoll_blocked(e);
     if (w == INVALID_ADDRESS) {
         fdesc_put(&e->f);
@@ -522,28 +771,8 @@ sysreturn epoll_wait(int epfd,
     }
 
     epoll_debug("tid %d, epoll fd %d, new blocked %p, timeout %d\n", current->tid, epfd, w, timeout);
-    spin_lock(&w->lock);
-    w->user_events = wrap_buffer(e->h, events, maxevents * sizeof(struct epoll_event));
-    w->user_events->end = 0;
-    spin_unlock(&w->lock);
-
-    spin_lock(&e->fds_lock);
-    bitmap_foreach_set(e->fds, fd) {
-        epollfd efd = vector_get(e->events, fd);
-        assert(efd);
-        assert(efd->fd == fd);
-
-        if (efd->zombie)
-            continue;
-
-        /* event transitions may in some cases need to be polled for
-           (e.g. due to change in lwIP internal state), so request a check */
-        spin_lock(&efd->lock);
-        if (efd->registered)
-            check_fdesc(efd, w);
-        spin_unlock(&efd->lock);
-    }
-    spin_unlock(&e->fds_lock);
+    w->user_events = events;
+    w->maxevents = maxevents;
 
     timestamp ts = (timeout > 0) ? milliseconds(timeout) : 0;
     return blockq_check_timeout(w->t->thread_bq, current,
@@ -561,20 +790,15 @@ static epollfd epollfd_from_fd(epoll e, int fd)
     return efd;
 }
 
+/* Posts the current events of a newly registered epollfd. Called with efd->lock held. */
 static void epollfd_update(epollfd efd)
 {
-    /* It may seem excessive to perform a check for all
-       waiters. However, thanks to thread-specific fd events (thanks
-       in turn to signalfd), we could have independent events for
-       multiple threads that require waking - even on the same fd. */
+    if (efd->zombie || !efd->registered)
+        return;
 
-    spin_lock(&efd->e->blocked_lock);
-    list_foreach(&efd->e->blocked_head, l) {
-        epoll_blocked w = struct_from_list(l, epoll_blocked, blocked_list);
-        epoll_debug("   posting check for blocked waiter (tid %d)\n", w->t->tid);
-        check_fdesc(efd, w);
-    }
-    spin_unlock(&efd->e->blocked_lock);
+    /* signalfd events depend on the signals pending on the calling thread */
+    fdesc f = efd->f;
+    epollfd_post(efd, apply(f->events, current), (f->type == FDESC_TYPE_SIGNALFD) ? current : 0);
 }
 
 static sysreturn epoll_add_fd(epoll e, int fd, u32 events, u64 data)
@@ -619,6 +843,11 @@ static sysreturn remove_fd(epoll e, int fd)
     return 0;
 }
 
+/* events that may be requested together with EPOLLEXCLUSIVE */
+#define EPOLLEXCLUSIVE_OK_BITS  (EPOLLIN | EPOLLOUT | EPOLLRDNORM | EPOLLRDBAND | EPOLLWRNORM |    \
+                                 EPOLLWRBAND | EPOLLERR | EPOLLHUP | EPOLLWAKEUP | EPOLLET |         \
+                                 EPOLLEXCLUSIVE)
+
 sysreturn epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
 {
     epoll_debug("epoll fd %d, op %d, fd %d\n", epfd, op, fd);
@@ -628,16 +857,18 @@ sysreturn epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
         return set_syscall_error(current, EFAULT);
     }
 
-    /* EPOLLEXCLUSIVE not yet implemented */
-    if (event && (event->events & EPOLLEXCLUSIVE)) {
-        msg_err("add: EPOLLEXCLUSIVE not supported\n");
-        return set_syscall_error(current, EINVAL);
-    }
+    /* EPOLLEXCLUSIVE may only be set when adding an fd, together with a restricted set of events */
+    if ((op != EPOLL_CTL_DEL) && (event->events & EPOLLEXCLUSIVE) &&
+        ((op != EPOLL_CTL_ADD) || (event->events & ~EPOLLEXCLUSIVE_OK_BITS)))
+        return -EINVAL;
 
     sysreturn rv;
     fdesc f = resolve_fd(current->p, fd);
     if ((f->type == FDESC_TYPE_REGULAR) || (f->type == FDESC_TYPE_DIRECTORY))
         rv = -EPERM;
+    else if ((op == EPOLL_CTL_ADD) && (event->events & EPOLLEXCLUSIVE) &&
+             (f->type == FDESC_TYPE_EPOLL))
+        rv = -EINVAL;
     else
         rv = 0;
     fdesc_put(f);
@@ -646,6 +877,10 @@ sysreturn epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
 
     /* XXX verify that fd is not an epoll instance*/
     epoll e = resolve_fd(current->p, epfd);
+    if (e->f.type != FDESC_TYPE_EPOLL) {
+        fdesc_put(&e->f);
+        return -EINVAL;
+    }
     spin_lock(&e->fds_lock);
     switch(op) {
     case EPOLL_CTL_ADD:
@@ -654,12 +889,18 @@ sysreturn epoll_ctl(int epfd, int op, int fd, struct epoll_event *event)
     case EPOLL_CTL_DEL:
         rv = remove_fd(e, fd);
         break;
-    case EPOLL_CTL_MOD:
+    case EPOLL_CTL_MOD: {
         epoll_debug("   modifying %d, events 0x%x, data 0x%lx\n", fd, event->events, event->data);
+        epollfd efd = epollfd_from_fd(e, fd);
+        if ((efd != INVALID_ADDRESS) && (efd->eventmask & EPOLLEXCLUSIVE)) {
+            rv = -EINVAL;
+            break;
+        }
         rv = remove_fd(e, fd);
         if (rv == 0)
             rv = epoll_add_fd(e, fd, event->events, event->data);
         break;
+    }
     default:
         msg_err("unknown op %d\n", op);
         rv = -EINVAL;
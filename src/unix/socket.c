@@ -164,14 +164,11 @@ static inline void unixsock_notify_writer(unixsock s)
     fdesc_notify_events(&s->sock.f);
 }
 
-closure_function(8, 1, sysreturn, unixsock_read_bh,
-                 unixsock, s, thread, t, void *, dest, sg_list, sg, u64, length, io_completion, completion, struct sockaddr_un *, from_addr, socklen_t *, from_length,
-                 u64, flags)
+/* Returns -EAGAIN if no data is available. */
+static sysreturn unixsock_read_internal(unixsock s, void *dest, sg_list sg, u64 length,
+                                        struct sockaddr_un *from_addr, socklen_t *from_length,
+                                        u64 flags)
 {
-    unixsock s = bound(s);
-    void *dest = bound(dest);
-    u64 length = bound(length);
-
     sharedbuf shb;
     sysreturn rv;
 
@@ -187,12 +184,9 @@ closure_function(8, 1, sysreturn, unixsock_read_bh,
         if (disconnected) {
             rv = 0;
             goto out;
-        } else if (s->sock.f.flags & SOCK_NONBLOCK) {
-            rv = -EAGAIN;
-            goto out;
         }
-        unixsock_unlock(s);
-        return blockq_block_required(bound(t), flags);
+        rv = -EAGAIN;
+        goto out;
     }
     rv = 0;
     do {
@@ -202,7 +196,7 @@ closure_function(8, 1, sysreturn, unixsock_read_bh,
             buffer_read(b, dest, xfer);
             dest = (u8 *)dest + xfer;
         } else if (xfer > 0) {
-            sg_buf sgb = sg_list_tail_add(bound(sg), xfer);
+            sg_buf sgb = sg_list_tail_add(sg, xfer);
             if (!sgb)
                 break;
             sharedbuf_reserve(shb);
@@ -219,8 +213,6 @@ closure_function(8, 1, sysreturn, unixsock_read_bh,
             assert(dequeue(s->data) == shb);
             if (s->sock.type == SOCK_DGRAM) {
                 s->sock.rx_len -= buffer_length(b);
-                struct sockaddr_un *from_addr = bound(from_addr);
-                socklen_t *from_length = bound(from_length);
                 if (from_addr && from_length) {
                     runtime_memcpy(from_addr, &shb->from_addr, MIN(*from_length, sizeof(shb->from_addr)));
                     *from_length = __builtin_offsetof(struct sockaddr_un, sun_path) + runtime_strlen(from_addr->sun_path) + 1;
@@ -238,6 +230,18 @@ out:
     unixsock_unlock(s);
     if (read_done)
         unixsock_notify_writer(s);
+    return rv;
+}
+
+closure_function(8, 1, sysreturn, unixsock_read_bh,
+                 unixsock, s, thread, t, void *, dest, sg_list, sg, u64, length, io_completion, completion, struct sockaddr_un *, from_addr, socklen_t *, from_length,
+                 u64, flags)
+{
+    unixsock s = bound(s);
+    sysreturn rv = unixsock_read_internal(s, bound(dest), bound(sg), bound(length),
+                                          bound(from_addr), bound(from_length), flags);
+    if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK))
+        return blockq_block_required(bound(t), flags);
     apply(bound(completion), bound(t), rv);
     closure_finish();
     return rv;
@@ -321,19 +325,13 @@ static int lookup_socket(unixsock *s, char *path)
     return sysreturn_from_fs_status(fss);
 }
 
-closure_function(7, 1, sysreturn, unixsock_write_bh,
-                 unixsock, s, thread, t, void *, src, sg_list, sg, u64, length, io_completion, completion, unixsock, dest,
-                 u64, flags)
+/* Returns -EAGAIN if the destination socket has no space available. */
+static sysreturn unixsock_write_internal(unixsock s, void *src, sg_list sg, u64 length,
+                                         unixsock dest, u64 flags)
 {
-    unixsock s = bound(s);
-    void *src = bound(src);
-    u64 length = bound(length);
-    unixsock dest;
     boolean full = false;
-
     sysreturn rv;
 
-    dest = bound(dest);
     unixsock_lock(dest);
     if ((flags & BLOCKQ_ACTION_NULLIFY) && dest->data) {
         rv = -ERESTARTSYS;
@@ -344,11 +342,7 @@ closure_function(7, 1, sysreturn, unixsock_write_bh,
         goto out;
     }
 
-    rv = unixsock_write_to(src, bound(sg), length, dest, s);
-    if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK)) {
-        unixsock_unlock(dest);
-        return blockq_block_required(bound(t), flags);
-    }
+    rv = unixsock_write_to(src, sg, length, dest, s);
     full = (dest->sock.rx_len >= so_rcvbuf) || queue_full(dest->data);
 out:
     unixsock_unlock(dest);
@@ -356,6 +350,18 @@ out:
         unixsock_notify_reader(dest);
     if (full)   /* no more space available to write */
         fdesc_notify_events(&s->sock.f);
+    return rv;
+}
+
+closure_function(7, 1, sysreturn, unixsock_write_bh,
+                 unixsock, s, thread, t, void *, src, sg_list, sg, u64, length, io_completion, completion, unixsock, dest,
+                 u64, flags)
+{
+    unixsock s = bound(s);
+    unixsock dest = bound(dest);
+    sysreturn rv = unixsock_write_internal(s, bound(src), bound(sg), bound(length), dest, flags);
+    if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK))
+        return blockq_block_required(bound(t), flags);
     apply(bound(completion), bound(t), rv);
     refcount_release(&dest->refcount);
     closure_finish();
@@ -402,21 +408,15 @@ closure_function(1, 6, sysreturn, unixsock_sg_read,
     return blockq_check(s->sock.rxbq, t, ba, bh);
 }
 
-closure_function(1, 6, sysreturn, unixsock_sg_write,
-                 unixsock, s,
-                 sg_list, sg, u64, length, u64, offset, thread, t, boolean, bh, io_completion, completion)
+/* Consumes the reference to dest. */
+static sysreturn unixsock_sg_write_to(unixsock s, sg_list sg, u64 length, thread t, boolean bh,
+                                      io_completion completion, unixsock dest)
 {
-    unixsock s = bound(s);
     sysreturn rv = unixsock_write_check(s, length);
-    if (rv <= 0)
+    if (rv <= 0) {
+        refcount_release(&dest->refcount);
         return io_complete(completion, t, rv);
-    unixsock_lock(bound(s));
-    unixsock dest = bound(s)->peer;
-    if (dest)
-        refcount_reserve(&dest->refcount);
-    unixsock_unlock(bound(s));
-    if (!dest)
-        return io_complete(completion, t, -ENOTCONN);
+    }
     blockq_action ba = contextual_closure(unixsock_write_bh, s, t, 0, sg, length,
                                           completion, dest);
     if (ba == INVALID_ADDRESS) {
@@ -426,6 +426,21 @@ closure_function(1, 6, sysreturn, unixsock_sg_write,
     return blockq_check(dest->sock.txbq, t, ba, bh);
 }
 
+closure_function(1, 6, sysreturn, unixsock_sg_write,
+                 unixsock, s,
+                 sg_list, sg, u64, length, u64, offset, thread, t, boolean, bh, io_completion, completion)
+{
+    unixsock s = bound(s);
+    unixsock_lock(s);
+    unixsock dest = s->peer;
+    if (dest)
+        refcount_reserve(&dest->refcount);
+    unixsock_unlock(s);
+    if (!dest)
+        return io_complete(completion, t, -ENOTCONN);
+    return unixsock_sg_write_to(s, sg, length, t, bh, completion, dest);
+}
+
 closure_function(1, 1, u32, unixsock_events,
                  unixsock, s,
                  thread, t /* ignore */)
@@ -575,13 +590,9 @@ static sysreturn unixsock_listen(struct sock *sock, int backlog)
     return ret;
 }
 
-closure_function(3, 1, sysreturn, connect_bh,
-                 unixsock, s, thread, t, unixsock, listener,
-                 u64, bqflags)
+/* Returns -EAGAIN if the connection queue of the listening socket is full. */
+static sysreturn unixsock_connect_internal(unixsock s, unixsock listener, u64 bqflags)
 {
-    unixsock s = bound(s);
-    thread t = bound(t);
-    unixsock listener = bound(listener);
     sysreturn rv;
 
     unixsock_lock(s);
@@ -598,12 +609,8 @@ closure_function(3, 1, sysreturn, connect_bh,
         goto out;
     }
     if (queue_full(listener->conn_q)) {
-        if (s->sock.f.flags & SOCK_NONBLOCK) {
-            rv = -EAGAIN;
-            goto out;
-        }
-        unixsock_unlock(s);
-        return blockq_block_required(bound(t), bqflags);
+        rv = -EAGAIN;
+        goto out;
     }
     unixsock peer = unixsock_alloc(s->sock.h, s->sock.type, 0);
     if (!peer) {
@@ -617,12 +624,43 @@ closure_function(3, 1, sysreturn, connect_bh,
     rv = 0;
 out:
     unixsock_unlock(s);
+    return rv;
+}
+
+closure_function(3, 1, sysreturn, connect_bh,
+                 unixsock, s, thread, t, unixsock, listener,
+                 u64, bqflags)
+{
+    unixsock s = bound(s);
+    thread t = bound(t);
+    sysreturn rv = unixsock_connect_internal(s, bound(listener), bqflags);
+    if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK))
+        return blockq_block_required(t, bqflags);
     socket_release(&s->sock);
     syscall_return(t, rv);
     closure_finish();
     return rv;
 }
 
+static sysreturn unixsock_connect_dgram(unixsock s, unixsock listener)
+{
+    sysreturn rv = 0;
+    if (listener->sock.type != s->sock.type)
+        return -EPROTOTYPE;
+    unixsock_lock(s);
+    if (s->notify_handle != INVALID_ADDRESS)
+        notify_remove(s->peer->sock.f.ns, s->notify_handle, false);
+    unixsock_disconnect(s);
+    s->notify_handle = notify_add(listener->sock.f.ns, EPOLLOUT | EPOLLERR | EPOLLHUP,
+        init_closure(&s->event_handler, unixsock_event_handler, s));
+    if (s->notify_handle == INVALID_ADDRESS)
+        rv = -ENOMEM;
+    else
+        unixsock_conn_internal(s, listener);
+    unixsock_unlock(s);
+    return rv;
+}
+
 static sysreturn unixsock_connect(struct sock *sock, struct sockaddr *addr,
         socklen_t addrlen)
 {
@@ -644,21 +682,7 @@ static sysreturn unixsock_connect(struct sock *sock, struct sockaddr *addr,
         return blockq_check(listener->sock.txbq, current, ba, false);
     }
     default:
-        if (listener->sock.type == s->sock.type) {
-            unixsock_lock(s);
-            if (s->notify_handle != INVALID_ADDRESS)
-                notify_remove(s->peer->sock.f.ns, s->notify_handle, false);
-            unixsock_disconnect(s);
-            s->notify_handle = notify_add(listener->sock.f.ns, EPOLLOUT | EPOLLERR | EPOLLHUP,
-                init_closure(&s->event_handler, unixsock_event_handler, s));
-            if (s->notify_handle == INVALID_ADDRESS)
-                rv = -ENOMEM;
-            else
-                unixsock_conn_internal(s, listener);
-            unixsock_unlock(s);
-        } else {
-            rv = -EPROTOTYPE;
-        }
+        rv = unixsock_connect_dgram(s, listener);
     }
 out:
     if (listener)
@@ -667,37 +691,43 @@ out:
     return rv;
 }
 
-closure_function(5, 1, sysreturn, accept_bh,
-                 unixsock, s, thread, t, struct sockaddr *, addr, socklen_t *, addrlen, int, flags,
-                 u64, bqflags)
+static sysreturn unixsock_connect_nb(struct sock *sock, thread t, struct sockaddr *addr,
+                                    socklen_t addrlen)
 {
-    unixsock s = bound(s);
-    thread t = bound(t);
-    struct sockaddr *addr = bound(addr);
+    unixsock s = (unixsock) sock;
     sysreturn rv;
 
-    if (bqflags & BLOCKQ_ACTION_NULLIFY) {
-        rv = -ERESTARTSYS;
-        goto out;
-    }
+    /* connections are never left in progress */
+    if (!addr)
+        return unixsock_is_connected(s) ? 0 : -ENOTCONN;
+    struct sockaddr_un *unixaddr = (struct sockaddr_un *) addr;
+    unixsock listener;
+    rv = lookup_socket(&listener, unixaddr->sun_path);
+    if (rv != 0)
+        return rv;
+    if (s->sock.type == SOCK_STREAM)
+        rv = unixsock_connect_internal(s, listener, 0);
+    else
+        rv = unixsock_connect_dgram(s, listener);
+    refcount_release(&listener->refcount);
+    return rv;
+}
+
+/* Returns -EAGAIN if no connection is pending. */
+static sysreturn unixsock_accept_internal(unixsock s, struct sockaddr *addr, socklen_t *addrlen,
+                                          int flags)
+{
     unixsock_lock(s);
     unixsock child = dequeue(s->conn_q);
     boolean empty = queue_empty(s->conn_q);
     unixsock_unlock(s);
-    if (child == INVALID_ADDRESS) {
-        if (s->sock.f.flags & SOCK_NONBLOCK) {
-            rv = -EAGAIN;
-            goto out;
-        }
-        return blockq_block_required(t, bqflags);
-    }
+    if (child == INVALID_ADDRESS)
+        return -EAGAIN;
     if (empty) {
         fdesc_notify_events(&s->sock.f);
     }
-    child->sock.f.flags |= bound(flags);
-    rv = child->sock.fd;
+    child->sock.f.flags |= flags;
     if (addr) {
-        socklen_t *addrlen = bound(addrlen);
         socklen_t actual_len = sizeof(child->peer->local_addr.sun_family);
         if (child->peer->local_addr.sun_path[0]) {  /* pathname socket */
             actual_len += runtime_strlen(child->peer->local_addr.sun_path) + 1;
@@ -707,6 +737,24 @@ closure_function(5, 1, sysreturn, accept_bh,
         *addrlen = actual_len;
     }
     unixsock_notify_writer(s);
+    return child->sock.fd;
+}
+
+closure_function(5, 1, sysreturn, accept_bh,
+                 unixsock, s, thread, t, struct sockaddr *, addr, socklen_t *, addrlen, int, flags,
+                 u64, bqflags)
+{
+    unixsock s = bound(s);
+    thread t = bound(t);
+    sysreturn rv;
+
+    if (bqflags & BLOCKQ_ACTION_NULLIFY) {
+        rv = -ERESTARTSYS;
+        goto out;
+    }
+    rv = unixsock_accept_internal(s, bound(addr), bound(addrlen), bound(flags));
+    if ((rv == -EAGAIN) && !(s->sock.f.flags & SOCK_NONBLOCK))
+        return blockq_block_required(t, bqflags);
 out:
     socket_release(&s->sock);
     syscall_return(t, rv);
@@ -735,6 +783,17 @@ out:
     return rv;
 }
 
+static sysreturn unixsock_accept_nb(struct sock *sock, thread t, struct sockaddr *addr,
+                                   socklen_t *addrlen, int flags)
+{
+    unixsock s = (unixsock) sock;
+    if (s->sock.type != SOCK_STREAM)
+        return -EOPNOTSUPP;
+    if (!s->conn_q || (flags & ~(SOCK_NONBLOCK|SOCK_CLOEXEC)))
+        return -EINVAL;
+    return unixsock_accept_internal(s, addr, addrlen, flags);
+}
+
 static sysreturn unixsock_getsockname(struct sock *sock, struct sockaddr *addr, socklen_t *addrlen)
 {
     unixsock s = (unixsock)sock;
@@ -769,54 +828,45 @@ static sysreturn unixsock_setsockopt(struct sock *sock, int level,
     return rv;
 }
 
-sysreturn unixsock_sendto(struct sock *sock, void *buf, u64 len, int flags,
-        struct sockaddr *dest_addr, socklen_t addrlen)
+/* Looks up the destination of a datagram, or the peer if no address is given; on success, a
+   reference to the destination is held. */
+static sysreturn unixsock_get_dest(unixsock s, struct sockaddr *dest_addr, socklen_t addrlen,
+                                   unixsock *dest)
 {
-    unixsock s = (unixsock) sock;
-    unixsock dest;
-    sysreturn rv;
     if (dest_addr || addrlen) {
-        if (sock->type == SOCK_STREAM) {
-            if (s->peer)
-                rv = -EISCONN;
-            else
-                rv = -EOPNOTSUPP;
-            goto out;
-        }
-        if (!(dest_addr && addrlen)) {
-            rv = -EFAULT;
-            goto out;
-        }
-        if (addrlen < sizeof(struct sockaddr_un)) {
-            rv = -EINVAL;
-            goto out;
-        }
+        if (s->sock.type == SOCK_STREAM)
+            return s->peer ? -EISCONN : -EOPNOTSUPP;
+        if (!(dest_addr && addrlen))
+            return -EFAULT;
+        if (addrlen < sizeof(struct sockaddr_un))
+            return -EINVAL;
         struct sockaddr_un daddr;
         runtime_memcpy(&daddr, dest_addr, sizeof(daddr));
-        if (daddr.sun_family != AF_UNIX) {
-            rv = -EINVAL;
-            goto out;
-        }
+        if (daddr.sun_family != AF_UNIX)
+            return -EINVAL;
         daddr.sun_path[sizeof(daddr.sun_path)-1] = 0;
-        rv = lookup_socket(&dest, daddr.sun_path);
-        if (rv != 0)
-            goto out;
-    } else {
-        unixsock_lock(s);
-        dest = s->peer;
-        if (dest)
-            refcount_reserve(&dest->refcount);
-        unixsock_unlock(s);
-    }
-    if (!dest) {
-        rv = -ENOTCONN;
-        goto out;
+        return lookup_socket(dest, daddr.sun_path);
+    }
+    unixsock_lock(s);
+    *dest = s->peer;
+    if (*dest)
+        refcount_reserve(&(*dest)->refcount);
+    unixsock_unlock(s);
+    return *dest ? 0 : -ENOTCONN;
+}
+
+sysreturn unixsock_sendto(struct sock *sock, void *buf, u64 len, int flags,
+        struct sockaddr *dest_addr, socklen_t addrlen)
+{
+    unixsock s = (unixsock) sock;
+    unixsock dest;
+    sysreturn rv = unixsock_get_dest(s, dest_addr, addrlen, &dest);
+    if (rv != 0) {
+        socket_release(sock);
+        return rv;
     }
     return unixsock_write_with_addr(s, buf, len, 0, current, false,
         (io_completion)&sock->f.io_complete, dest);
-out:
-    socket_release(sock);
-    return rv;
 }
 
 sysreturn unixsock_recvfrom(struct sock *sock, void *buf, u64 len, int flags,
@@ -854,10 +904,18 @@ sysreturn unixsock_sendmsg(struct sock *sock, const struct msghdr *msg,
     }
     if (!iov_to_sg(sg, msg->msg_iov, msg->msg_iovlen))
         goto err_dealloc_sg;
+    unixsock dest;
+    rv = unixsock_get_dest((unixsock)sock, msg->msg_name, msg->msg_namelen, &dest);
+    if (rv != 0) {
+        deallocate_sg_list(sg);
+        goto out;
+    }
     io_completion complete = closure(sock->h, sendmsg_complete, sock, sg);
-    if (complete == INVALID_ADDRESS)
+    if (complete == INVALID_ADDRESS) {
+        refcount_release(&dest->refcount);
         goto err_dealloc_sg;
-    return apply(sock->f.sg_write, sg, sg->count, 0, current, false, complete);
+    }
+    return unixsock_sg_write_to((unixsock)sock, sg, sg->count, current, false, complete, dest);
   err_dealloc_sg:
     deallocate_sg_list(sg);
     rv = -ENOMEM;
@@ -905,6 +963,52 @@ sysreturn unixsock_recvmsg(struct sock *sock, struct msghdr *msg, int flags)
     return rv;
 }
 
+static sysreturn unixsock_sendmsg_nb(struct sock *sock, thread t, const struct msghdr *msg,
+                                    int flags)
+{
+    unixsock s = (unixsock) sock;
+    u64 length = iov_total_len(msg->msg_iov, msg->msg_iovlen);
+    sysreturn rv = unixsock_write_check(s, length);
+    if (rv <= 0)
+        return rv;
+    unixsock dest;
+    rv = unixsock_get_dest(s, msg->msg_name, msg->msg_namelen, &dest);
+    if (rv != 0)
+        return rv;
+    sg_list sg = allocate_sg_list();
+    if (sg == INVALID_ADDRESS) {
+        rv = -ENOMEM;
+        goto out;
+    }
+    if (iov_to_sg(sg, msg->msg_iov, msg->msg_iovlen))
+        rv = unixsock_write_internal(s, 0, sg, length, dest, 0);
+    else
+        rv = -ENOMEM;
+    deallocate_sg_list(sg);
+  out:
+    refcount_release(&dest->refcount);
+    return rv;
+}
+
+static sysreturn unixsock_recvmsg_nb(struct sock *sock, thread t, struct msghdr *msg, int flags)
+{
+    unixsock s = (unixsock) sock;
+    u64 length = iov_total_len(msg->msg_iov, msg->msg_iovlen);
+    if ((s->sock.type == SOCK_STREAM) && (length == 0))
+        return 0;
+    sg_list sg = allocate_sg_list();
+    if (sg == INVALID_ADDRESS)
+        return -ENOMEM;
+    sysreturn rv = unixsock_read_internal(s, 0, sg, length, 0, 0, 0);
+    if (rv > 0)
+        sg_to_iov(sg, msg->msg_iov, msg->msg_iovlen);
+    deallocate_sg_list(sg);
+
+    /* Non-connected sockets are not supported, so source address is not set. */
+    msg->msg_namelen = 0;
+    return rv;
+}
+
 static unixsock unixsock_alloc(heap h, int type, u32 flags)
 {
     unixsock s = allocate(h, sizeof(*s));
@@ -938,6 +1042,10 @@ static unixsock unixsock_alloc(heap h, int type, u32 flags)
     s->sock.recvfrom = unixsock_recvfrom;
     s->sock.sendmsg = unixsock_sendmsg;
     s->sock.recvmsg = unixsock_recvmsg;
+    s->sock.accept_nb = unixsock_accept_nb;
+    s->sock.connect_nb = unixsock_connect_nb;
+    s->sock.sendmsg_nb = unixsock_sendmsg_nb;
+    s->sock.recvmsg_nb = unixsock_recvmsg_nb;
     s->fs_entry = 0;
     s->local_addr.sun_family = AF_UNIX;
     s->local_addr.sun_path[0] = '\0';
@@ -79,6 +79,20 @@ struct sock {
             int flags);
     sysreturn (*recvmsg)(struct sock *sock, struct msghdr *msg, int flags);
     sysreturn (*shutdown)(struct sock *sock, int how);
+
+    /* Non-blocking operations for asynchronous interfaces (io_uring): these never block or
+     * release the socket, and ignore the SOCK_NONBLOCK flag. The accept, send and receive
+     * operations return -EAGAIN if they cannot make progress until the socket becomes readable
+     * (accept_nb, recvmsg_nb) or writable (sendmsg_nb). connect_nb returns -EINPROGRESS if the
+     * connection cannot be completed immediately; once the socket becomes writable, calling it
+     * again with a null address returns the outcome of the connection attempt (or -EINPROGRESS
+     * if still pending). */
+    sysreturn (*accept_nb)(struct sock *sock, thread t, struct sockaddr *addr,
+            socklen_t *addrlen, int flags);
+    sysreturn (*connect_nb)(struct sock *sock, thread t, struct sockaddr *addr,
+            socklen_t addrlen);
+    sysreturn (*sendmsg_nb)(struct sock *sock, thread t, const struct msghdr *msg, int flags);
+    sysreturn (*recvmsg_nb)(struct sock *sock, thread t, struct msghdr *msg, int flags);
 };
 
 #define socket_release(s) fdesc_put(&(s)->f)
@@ -491,6 +491,56 @@ static void begin_file_read(thread t, file f)
     }
 }
 
+/* O_DIRECT transfers must be aligned to the filesystem block size. */
+static boolean file_direct_aligned(file f, void *buf, u64 length, u64 offset)
+{
+    u64 mask = fs_blocksize(f->fs) - 1;
+    return !((u64_from_pointer(buf) | length | offset) & mask);
+}
+
+closure_function(3, 2, void, file_direct_unpin,
+                 u64 *, phys, u64, npages, io_completion, completion,
+                 thread, t, sysreturn, rv)
+{
+    unpin_pages(bound(phys), bound(npages));
+    deallocate(heap_locked(get_kernel_heaps()), bound(phys), bound(npages) * sizeof(u64));
+    apply(bound(completion), t, rv);
+    closure_finish();
+}
+
+/* Issues an O_DIRECT transfer between storage and the pages of a user buffer. Returns false if the
+   buffer cannot be pinned (e.g. it is in a file mapping), in which case the transfer is to be done
+   through the page cache. */
+static boolean file_direct_rw(file f, void *buf, u64 length, u64 offset_arg, boolean write,
+                              thread t, io_completion completion)
+{
+    if (length == 0)
+        return false;
+    heap h = heap_locked(get_kernel_heaps());
+    u64 start = u64_from_pointer(buf);
+    u64 npages = (pad(start + length, PAGESIZE) - (start & ~PAGEMASK)) >> PAGELOG;
+    u64 *phys = allocate(h, npages * sizeof(u64));
+    if (phys == INVALID_ADDRESS)
+        return false;
+    if (!pin_user_pages(buf, length, write ? VMAP_FLAG_READABLE : VMAP_FLAG_WRITABLE, phys))
+        goto dealloc_phys;
+    sg_list sg = sg_from_pinned_pages(phys, start & PAGEMASK, length);
+    if (sg == INVALID_ADDRESS)
+        goto unpin;
+    io_completion c = closure(h, file_direct_unpin, phys, npages, completion);
+    if (c == INVALID_ADDRESS) {
+        deallocate_sg_list(sg);
+        goto unpin;
+    }
+    file_direct_io(f, sg, length, offset_arg, write, t, c);
+    return true;
+  unpin:
+    unpin_pages(phys, npages);
+  dealloc_phys:
+    deallocate(h, phys, npages * sizeof(u64));
+    return false;
+}
+
 closure_function(7, 1, void, file_read_complete,
                  thread, t, sg_list, sg, void *, dest, u64, limit, file, f, boolean, is_file_offset, io_completion, completion,
                  status, s)
@@ -524,6 +574,12 @@ closure_function(2, 6, sysreturn, file_read,
                __func__, f, dest, offset, is_file_offset ? "file" : "specified",
                length, f->length);
 
+    if (f->f.flags & O_DIRECT) {
+        if (!file_direct_aligned(f, dest, length, offset))
+            return io_complete(completion, t, -EINVAL);
+        if (file_direct_rw(f, dest, length, offset_arg, false, t, completion))
+            return bh ? SYSRETURN_CONTINUE_BLOCKING : thread_maybe_sleep_uninterruptible(t);
+    }
     if (offset >= f->length) {
         return io_complete(completion, t, 0);
     }
@@ -635,6 +691,12 @@ closure_function(2, 6, sysreturn, file_write,
                __func__, f, src, offset, is_file_offset ? "file" : "specified",
                length, f->length);
 
+    if (f->f.flags & O_DIRECT) {
+        if (!file_direct_aligned(f, src, length, offset))
+            return io_complete(completion, t, -EINVAL);
+        if (file_direct_rw(f, src, length, offset_arg, true, t, completion))
+            return bh ? SYSRETURN_CONTINUE_BLOCKING : thread_maybe_sleep_uninterruptible(t);
+    }
     sg_list sg = allocate_sg_list();
     if (sg == INVALID_ADDRESS) {
         thread_log(t, "   unable to allocate sg list");
@@ -693,6 +755,65 @@ closure_function(2, 6, sysreturn, file_sg_write,
     return io_complete(completion, t, rv);
 }
 
+closure_function(7, 1, void, file_direct_io_complete,
+                 thread, t, file, f, sg_list, sg, u64, length, boolean, write, boolean, is_file_offset,
+                 io_completion, completion,
+                 status, s)
+{
+    thread_log(bound(t), "%s: f %p, status %v", __func__, bound(f), s);
+    file f = bound(f);
+    u64 length = bound(length);
+    sysreturn rv;
+    sg_list_release(bound(sg));
+    deallocate_sg_list(bound(sg));
+    if (is_ok(s)) {
+        if (bound(write))
+            f->length = fsfile_get_length(f->fsf);
+        if (bound(is_file_offset))
+            f->offset += length;
+        rv = length;
+    } else {
+        rv = sysreturn_from_fs_status_value(s);
+    }
+    apply(bound(completion), bound(t), rv);
+    closure_finish();
+}
+
+/* Transfers data between a regular file and the buffers of sg, which must be suitable for DMA,
+   bypassing the page cache. The offset and length must be aligned to the filesystem block size,
+   and sg is deallocated on completion. */
+void file_direct_io(file f, sg_list sg, u64 length, u64 offset_arg, boolean write, thread t,
+                    io_completion completion)
+{
+    boolean is_file_offset = offset_arg == infinity;
+    u64 offset = is_file_offset ? f->offset : offset_arg;
+    thread_log(t, "%s: f %p, sg %p, offset %ld, length %ld, %s", __func__, f, sg, offset, length,
+               write ? "write" : "read");
+    range q = irangel(offset, length);
+    if (write) {
+        begin_file_write(t, f, length);
+    } else {
+        if (offset >= f->length)
+            length = 0;
+        else
+            length = MIN(length, f->length - offset);
+        q.end = q.start + pad(length, fs_blocksize(f->fs));
+        begin_file_read(t, f);
+    }
+    status_handler sh = contextual_closure(file_direct_io_complete, t, f, sg, length, write,
+                                           is_file_offset, completion);
+    if (sh == INVALID_ADDRESS) {
+        deallocate_sg_list(sg);
+        apply(completion, t, -ENOMEM);
+        return;
+    }
+    pagecache_node pn = fsfile_get_cachenode(f->fsf);
+    if (write)
+        pagecache_node_direct_write(pn, sg, q, sh);
+    else
+        pagecache_node_direct_read(pn, sg, q, sh);
+}
+
 closure_function(2, 2, sysreturn, file_close,
                  file, f, fsfile, fsf,
                  thread, t, io_completion, completion)
@@ -1059,62 +1180,55 @@ sysreturn getrandom(void *buf, u64 buflen, unsigned int flags)
     return random_buffer(b);
 }
 
-static int try_write_dirent(void *dirp, boolean dirent64, char *p,
-        int *read_sofar, int *written_sofar, u64 *f_offset,
-        unsigned int *count, tuple n)
+static int try_write_dirent(void *dirp, boolean dirent64, char *p, u64 next,
+        int *written_sofar, unsigned int *count, tuple n)
 {
     int len = runtime_strlen(p);
-    *read_sofar += len;
-    if (*read_sofar > *f_offset) {
-        int reclen = (dirent64 ? sizeof(struct linux_dirent64) : sizeof(struct linux_dirent)) +
-                     len + 3;
-        // include this element in the getdents output
-        if (reclen > *count) {
-            // can't include, there's no space
-            *read_sofar -= len;
-            return -1;
-        } else {
-            // include the entry in the buffer
-            runtime_memset((u8*)dirp, 0, reclen);
-            if (dirent64) {
-                struct linux_dirent64 *dp = dirp;
-                dp->d_ino = u64_from_pointer(n);
-                dp->d_reclen = reclen;
-                runtime_memcpy(dp->d_name, p, len + 1);
-                dp->d_off = dp->d_reclen;   // XXX: in the future, pad this.
-                dp->d_name[len + 2] = 0;    /* some zero padding */
-            } else {
-                struct linux_dirent *dp = dirp;
-                dp->d_ino = u64_from_pointer(n);
-                dp->d_reclen = reclen;
-                runtime_memcpy(dp->d_name, p, len + 1);
-                dp->d_off = dp->d_reclen;   // XXX: in the future, pad this.
-                dp->d_name[len + 2] = 0;    /* some zero padding */
-            }
-            ((char *)dirp)[reclen - 1] = dt_from_tuple(n);
-
-            // advance dirp
-            *written_sofar += reclen;
-            *count -= reclen;
-            return reclen;
-        }
+    int reclen = (dirent64 ? sizeof(struct linux_dirent64) : sizeof(struct linux_dirent)) +
+                 len + 3;
+    // include this element in the getdents output
+    if (reclen > *count) {
+        // can't include, there's no space
+        return -1;
+    }
+    // include the entry in the buffer
+    runtime_memset((u8*)dirp, 0, reclen);
+    if (dirent64) {
+        struct linux_dirent64 *dp = dirp;
+        dp->d_ino = u64_from_pointer(n);
+        dp->d_reclen = reclen;
+        runtime_memcpy(dp->d_name, p, len + 1);
+        dp->d_off = next;
+        dp->d_name[len + 2] = 0;    /* some zero padding */
+    } else {
+        struct linux_dirent *dp = dirp;
+        dp->d_ino = u64_from_pointer(n);
+        dp->d_reclen = reclen;
+        runtime_memcpy(dp->d_name, p, len + 1);
+        dp->d_off = next;
+        dp->d_name[len + 2] = 0;    /* some zero padding */
     }
-    return 0;
+    ((char *)dirp)[reclen - 1] = dt_from_tuple(n);
+
+    // advance dirp
+    *written_sofar += reclen;
+    *count -= reclen;
+    return reclen;
 }
 
-closure_function(7, 2, boolean, getdents_each,
-                 file, f, void **, dirp, boolean, dirent64, int *, read_sofar, int *, written_sofar, unsigned int *, count, int *, r,
-                 value, k, value, v)
+closure_function(6, 3, boolean, getdents_each,
+                 file, f, void **, dirp, boolean, dirent64, int *, written_sofar, unsigned int *, count, int *, r,
+                 symbol, k, tuple, v, u64, next)
 {
-    assert(is_symbol(k));
     buffer tmpbuf = little_stack_buffer(NAME_MAX + 1);
     char *p = cstring(symbol_string(k), tmpbuf);
-    *bound(r) = try_write_dirent(*bound(dirp), bound(dirent64), p,
-                                 bound(read_sofar), bound(written_sofar), &bound(f)->offset, bound(count),
-                                 v);
+    *bound(r) = try_write_dirent(*bound(dirp), bound(dirent64), p, next,
+                                 bound(written_sofar), bound(count), v);
     if (*bound(r) < 0)
         return false;
 
+    /* the file offset is the cookie of the next directory entry */
+    bound(f)->offset = next;
     *bound(dirp) = *bound(dirp) + *bound(r);
     return true;
 }
@@ -1129,22 +1243,22 @@ static sysreturn getdents_internal(int fd, void *dirp, unsigned int count, boole
         goto out;
     }
     md = filesystem_get_meta(f->fs, f->n);
-    tuple c;
-    if (!md || !(c = children(md))) {
+    if (!md || !children(md)) {
         rv = -ENOTDIR;
         goto out;
     }
 
     int r = 0;
-    int read_sofar = 0, written_sofar = 0;
-    binding_handler h = stack_closure(getdents_each, f, &dirp, dirent64,
-                                      &read_sofar, &written_sofar, &count, &r);
-    symbol parent_sym = sym_this("..");
-    if (apply(h, sym_this("."), md) && apply(h, parent_sym, get_tuple(md, parent_sym)))
-        iterate(c, h);
+    int written_sofar = 0;
+    dir_entry_handler h = stack_closure(getdents_each, f, &dirp, dirent64,
+                                        &written_sofar, &count, &r);
+    fs_status fss = filesystem_iterate_dir(f->fs, md, f->offset, h);
+    if (fss != FS_STATUS_OK) {
+        rv = sysreturn_from_fs_status(fss);
+        goto out;
+    }
     fs_notify_event(md, IN_ACCESS);
     filesystem_update_atime(f->fs, md);
-    f->offset = read_sofar;
     if (r < 0 && written_sofar == 0)
         rv = -EINVAL;
     else
@@ -2285,6 +2399,9 @@ void register_file_syscalls(struct syscall *map)
     register_syscall(map, mkdirat, mkdirat, SYSCALL_F_SET_FILE|SYSCALL_F_SET_DESC);
     register_syscall(map, getrandom, getrandom, 0);
     register_syscall(map, pipe2, pipe2, SYSCALL_F_SET_DESC);
+    register_syscall(map, splice, splice, SYSCALL_F_SET_DESC);
+    register_syscall(map, tee, tee, SYSCALL_F_SET_DESC);
+    register_syscall(map, vmsplice, vmsplice, SYSCALL_F_SET_DESC);
     register_syscall(map, socketpair, socketpair, SYSCALL_F_SET_NET);
     register_syscall(map, eventfd2, eventfd2, SYSCALL_F_SET_DESC);
     register_syscall(map, chdir, chdir, SYSCALL_F_SET_FILE);
@@ -2339,6 +2456,63 @@ void count_syscall(thread t, sysreturn rv)
 
 static boolean debugsyscalls;
 
+/* Contextual closures created by a syscall (the bottom halves of blocking syscalls and the
+   completions of file I/O) are allocated from the transient heap of its syscall context. Since a
+   syscall context serves one syscall at a time and is recycled on the CPU it was allocated for,
+   closures freed in the context are kept for the following syscalls, which can then block and
+   complete without allocating from the locked heap. The lock is only contended when a closure is
+   freed on another CPU. */
+static u64 syscall_closure_cache_alloc(heap h, bytes size)
+{
+    syscall_closure_cache cc = (syscall_closure_cache)h;
+    u64 irqflags = spin_lock_irq(&cc->lock);
+    for (int i = 0; i < SYSCALL_CLOSURE_CACHE_SLOTS; i++) {
+        void *p = cc->slots[i].p;
+        if (p && (cc->slots[i].size == size)) {
+            cc->slots[i].p = 0;
+            spin_unlock_irq(&cc->lock, irqflags);
+            return u64_from_pointer(p);
+        }
+    }
+    spin_unlock_irq(&cc->lock, irqflags);
+    return allocate_u64(cc->parent, size);
+}
+
+static void syscall_closure_cache_dealloc(heap h, u64 a, bytes size)
+{
+    syscall_closure_cache cc = (syscall_closure_cache)h;
+    u64 irqflags = spin_lock_irq(&cc->lock);
+    for (int i = 0; i < SYSCALL_CLOSURE_CACHE_SLOTS; i++) {
+        if (!cc->slots[i].p) {
+            cc->slots[i].p = pointer_from_u64(a);
+            cc->slots[i].size = size;
+            spin_unlock_irq(&cc->lock, irqflags);
+            return;
+        }
+    }
+    spin_unlock_irq(&cc->lock, irqflags);
+    deallocate_u64(cc->parent, a, size);
+}
+
+static void syscall_closure_cache_init(syscall_closure_cache cc, heap parent)
+{
+    zero(cc, sizeof(*cc));
+    cc->h.alloc = syscall_closure_cache_alloc;
+    cc->h.dealloc = syscall_closure_cache_dealloc;
+    cc->parent = parent;
+    spin_lock_init(&cc->lock);
+}
+
+static void syscall_closure_cache_flush(syscall_closure_cache cc)
+{
+    for (int i = 0; i < SYSCALL_CLOSURE_CACHE_SLOTS; i++) {
+        if (cc->slots[i].p) {
+            deallocate(cc->parent, cc->slots[i].p, cc->slots[i].size);
+            cc->slots[i].p = 0;
+        }
+    }
+}
+
 define_closure_function(3, 0, void, free_syscall_context,
                         syscall_context, sc, cpuinfo, orig_ci, boolean, queued)
 {
@@ -2356,8 +2530,10 @@ define_closure_function(3, 0, void, free_syscall_context,
     }
 
     bound(queued) = false;
-    if (!enqueue(bound(orig_ci)->free_syscall_contexts, sc))
+    if (!enqueue(bound(orig_ci)->free_syscall_contexts, sc)) {
+        syscall_closure_cache_flush(&sc->closure_cache);
         deallocate((heap)heap_linear_backed(get_kernel_heaps()), sc, SYSCALL_CONTEXT_SIZE);
+    }
 }
 
 static void syscall_context_pause(context ctx)
@@ -2385,12 +2561,20 @@ static void syscall_context_schedule_return(context ctx)
     syscall_context sc = (syscall_context)ctx;
     thread t = sc->t;
     assert(t);
-    assert(t->syscall == sc); // XXX bringup
+    assert((sc->call < 0) || (t->syscall == sc)); // XXX bringup
     assert(enqueue_irqsafe(runqueue, &sc->syscall_return));
 }
 
 static void syscall_context_pre_suspend(context ctx)
 {
+    /* Storage requests held back by a plug must not wait for this context to resume, since it may
+       be waiting on the same device (e.g. for a page fault on a user buffer). */
+    syscall_context sc = (syscall_context)ctx;
+    thunk plug_flush = sc->plug_flush;
+    if (plug_flush) {
+        sc->plug_flush = 0;
+        apply(plug_flush);
+    }
     check_syscall_context_replace(current_cpu(), ctx);
 }
 
@@ -2421,8 +2605,10 @@ syscall_context allocate_syscall_context(cpuinfo ci)
     c->schedule_return = syscall_context_schedule_return;
     c->pre_suspend = syscall_context_pre_suspend;
     init_closure(&sc->syscall_return, syscall_context_return, sc);
+    sc->plug_flush = 0;
     c->fault_handler = 0;
-    sc->context.transient_heap = heap_locked(get_kernel_heaps());
+    syscall_closure_cache_init(&sc->closure_cache, heap_locked(get_kernel_heaps()));
+    sc->context.transient_heap = &sc->closure_cache.h;
     void *stack_top = ((void *)sc) + SYSCALL_CONTEXT_SIZE - STACK_ALIGNMENT;
     frame_set_stack_top(c->frame, stack_top);
     return sc;
@@ -59,6 +59,7 @@ typedef struct iovec {
 #define EMLINK          31              /* Too many links */
 #define EPIPE           32              /* Broken pipe */
 #define ERANGE          34              /* Math result not representable */
+#define EDEADLK         35              /* Resource deadlock would occur */
 #define ENAMETOOLONG    36              /* File name too long */
 
 #define ENOSYS          38              /* Invalid system call number */
@@ -111,6 +112,13 @@ typedef struct iovec {
 #define F_SETPIPE_SZ    (F_LINUX_SPECIFIC_BASE + 7)
 #define F_GETPIPE_SZ    (F_LINUX_SPECIFIC_BASE + 8)
 
+/* Flags for splice, tee and vmsplice */
+#define SPLICE_F_MOVE       0x1
+#define SPLICE_F_NONBLOCK   0x2
+#define SPLICE_F_MORE       0x4
+#define SPLICE_F_GIFT       0x8
+#define SPLICE_F_ALL        (SPLICE_F_MOVE | SPLICE_F_NONBLOCK | SPLICE_F_MORE | SPLICE_F_GIFT)
+
 /* Values for 'mode' argument of access/faccessat syscalls */
 #define F_OK    0x0
 #define X_OK    0x1
@@ -240,9 +248,29 @@ struct utimbuf {
 #define FUTEX_WAKE_BITSET	10
 #define FUTEX_WAIT_REQUEUE_PI	11
 #define FUTEX_CMP_REQUEUE_PI	12
+#define FUTEX_LOCK_PI2		13
 
+#define FUTEX_PRIVATE_FLAG      128
 #define FUTEX_CLOCK_REALTIME    (1 << 8)
 
+#define FUTEX_BITSET_MATCH_ANY  0xffffffff
+
+/* PI and robust futex word */
+#define FUTEX_WAITERS           0x80000000
+#define FUTEX_OWNER_DIED        0x40000000
+#define FUTEX_TID_MASK          0x3fffffff
+
+/* futex_waitv */
+#define FUTEX_32                2
+#define FUTEX_WAITV_MAX         128
+
+struct futex_waitv {
+    u64 val;
+    u64 uaddr;
+    u32 flags;
+    u32 __reserved;
+};
+
 #define  FUTEX_OP_SET        0  /* uaddr2 = oparg; */
 #define  FUTEX_OP_ADD        1  /* uaddr2 += oparg; */
 #define  FUTEX_OP_OR         2  /* uaddr2 |= oparg; */
@@ -681,6 +709,9 @@ typedef u32 gid_t;
 enum {
     IOCB_CMD_PREAD = 0,
     IOCB_CMD_PWRITE = 1,
+    IOCB_CMD_FSYNC = 2,
+    IOCB_CMD_FDSYNC = 3,
+    IOCB_CMD_POLL = 5,
 };
 
 #define IOCB_FLAG_RESFD (1 << 0)
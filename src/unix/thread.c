@@ -102,6 +102,7 @@ sysreturn clone(unsigned long flags, void *child_stack, int *ptid, unsigned long
 void register_thread_syscalls(struct syscall *map)
 {
     register_syscall(map, futex, futex, 0);
+    register_syscall(map, futex_waitv, futex_waitv, 0);
     register_syscall(map, set_robust_list, set_robust_list, 0);
     register_syscall(map, get_robust_list, get_robust_list, 0);
     register_syscall(map, clone, clone, SYSCALL_F_SET_PROC);
@@ -68,11 +68,26 @@ declare_closure_struct(3, 0, void, free_syscall_context,
 declare_closure_struct(1, 0, void, syscall_context_return,
                        struct syscall_context *, sc);
 
+#define SYSCALL_CLOSURE_CACHE_SLOTS 4
+
+/* transient heap of a syscall context, see syscall.c */
+typedef struct syscall_closure_cache {
+    struct heap h;
+    heap parent;
+    struct spinlock lock;
+    struct {
+        bytes size;
+        void *p;
+    } slots[SYSCALL_CLOSURE_CACHE_SLOTS];
+} *syscall_closure_cache;
+
 typedef struct syscall_context {
     struct context context;
     thread t;                   /* corresponding thread */
     timestamp start_time;
     int call;                   /* syscall number */
+    thunk plug_flush;           /* submits storage requests held back by the syscall */
+    struct syscall_closure_cache closure_cache;
     closure_struct(syscall_context_return, syscall_return);
     closure_struct(free_syscall_context, free);
 } *syscall_context;
@@ -267,6 +282,18 @@ declare_closure_struct(2, 2, void, blockq_thread_timeout,
                        blockq, bq, struct thread *, t,
                        u64, expiry, u64, overruns);
 
+/* waiter queued in a bucket of the futex hash table */
+typedef struct futex_waiter {
+    struct list l;          /* not inserted once woken or dequeued */
+    process p;
+    int *uaddr;
+    u32 bitset;
+    boolean woken;
+    boolean pi;             /* waiting to acquire a PI futex */
+    int *requeue_pi;        /* PI futex to be requeued to (FUTEX_WAIT_REQUEUE_PI) */
+    struct thread *t;
+} *futex_waiter;
+
 typedef struct thread {
     struct context context;
 
@@ -296,6 +323,9 @@ typedef struct thread {
     /* set by set_robust_list syscall */
     void *robust_list;
 
+    /* waiter for single-futex waits */
+    struct futex_waiter futex_w;
+
     /* blockq data */
     boolean bq_timer_pending;
     struct timer bq_timer;       /* timer for this item */
@@ -479,7 +509,6 @@ typedef struct process {
     filesystem        cwd_fs;
     tuple             process_root;
     inode             cwd;
-    table             futices;
     fault_handler     handler;
     rbtree            threads;
     struct spinlock   threads_lock;
@@ -668,6 +697,10 @@ boolean validate_user_memory_permissions(process p, const void *buf, bytes lengt
 boolean fault_in_user_memory(const void *buf, bytes length,
                              u64 required_flags, u64 disallowed_flags);
 
+boolean pin_user_pages(const void *buf, bytes length, u64 required_flags, u64 *phys);
+void unpin_pages(u64 *phys, u64 npages);
+sg_list sg_from_pinned_pages(u64 *phys, u64 offset, u64 length);
+
 void mmap_process_init(process p, boolean aslr);
 
 /* This "validation" is just a simple limit check right now, but this
@@ -942,6 +975,8 @@ void init_threads(process p);
 void init_futices(process p);
 
 sysreturn futex(int *uaddr, int futex_op, int val, u64 val2, int *uaddr2, int val3);
+sysreturn futex_waitv(struct futex_waitv *waiters, unsigned int nr_futexes, unsigned int flags,
+                      struct timespec *timeout, clockid_t clockid);
 sysreturn get_robust_list(int pid, void *head, u64 *len);
 sysreturn set_robust_list(void *head, u64 len);
 void wake_robust_list(process p, void *head);
@@ -969,6 +1004,9 @@ sysreturn io_uring_register(int fd, unsigned int opcode, void *arg,
 int do_pipe2(int fds[2], int flags);
 int pipe_set_capacity(fdesc f, int capacity);
 int pipe_get_capacity(fdesc f);
+sysreturn splice(int fd_in, s64 *off_in, int fd_out, s64 *off_out, u64 len, unsigned int flags);
+sysreturn tee(int fd_in, int fd_out, u64 len, unsigned int flags);
+sysreturn vmsplice(int fd, struct iovec *iov, u64 nr_segs, unsigned int flags);
 
 sysreturn socketpair(int domain, int type, int protocol, int sv[2]);
 
@@ -180,7 +180,8 @@ heap init_process_runtime()
     platform_monotonic_now = closure(h, unix_now);
     init_random();
     init_runtime(h, h);
-    init_tuples(allocate_tagged_region(h, tag_table_tuple));
+    init_tuples(allocate_tagged_region(h, tag_table_tuple), allocate_tagged_region(h, tag_schema_tuple),
+                allocate_tagged_region(h, tag_integer));
     init_symbols(allocate_tagged_region(h, tag_symbol), h);
     init_sg(h);
     init_extra_prints();
@@ -120,6 +120,9 @@ physical virtqueue_desc_paddr(struct virtqueue *vq);
 physical virtqueue_avail_paddr(struct virtqueue *vq);
 physical virtqueue_used_paddr(struct virtqueue *vq);
 u16 virtqueue_entries(virtqueue vq);
+void virtqueue_poll(virtqueue vq);
+void virtqueue_plug(virtqueue vq);
+void virtqueue_unplug(virtqueue vq);
 
 typedef struct vqmsg *vqmsg;
 
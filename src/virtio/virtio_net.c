@@ -66,23 +66,52 @@ typedef struct vnet {
     struct virtqueue *ctl;
     u64 empty_phys;
     void *empty; // just a mac..fix, from pre-heap days
+    struct list tx_free;    /* protected by lwip lock */
 } *vnet;
 
+declare_closure_struct(0, 1, void, input,
+                       u64, len);
+
 typedef struct xpbuf
 {
     struct pbuf_custom p;
     vnet vn;
+    closure_struct(input, input);
 } *xpbuf;
 
+declare_closure_struct(0, 1, void, tx_complete,
+                       u64, len);
+
+/* Transmit completions are recycled, so that no memory is allocated when sending a packet. */
+typedef struct vnet_tx {
+    struct list l;
+    vnet vn;
+    struct pbuf *p;
+    closure_struct(tx_complete, complete);
+} *vnet_tx;
 
-closure_function(1, 1, void, tx_complete,
-                 struct pbuf *, p,
-                 u64, len)
+define_closure_function(0, 1, void, tx_complete,
+                        u64, len)
 {
+    vnet_tx tx = struct_from_field(closure_self(), vnet_tx, complete);
     lwip_lock();
-    pbuf_free(bound(p));
+    pbuf_free(tx->p);
+    list_push_back(&tx->vn->tx_free, &tx->l);
     lwip_unlock();
-    closure_finish();
+}
+
+/* Called with lwip lock held. */
+static vnet_tx vnet_get_tx(vnet vn)
+{
+    list l = list_get_next(&vn->tx_free);
+    if (l) {
+        list_delete(l);
+        return struct_from_list(l, vnet_tx, l);
+    }
+    vnet_tx tx = allocate(vn->dev->general, sizeof(*tx));
+    if (tx != INVALID_ADDRESS)
+        tx->vn = vn;
+    return tx;
 }
 
 
@@ -90,6 +119,11 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
     vnet vn = netif->state;
 
+    vnet_tx tx = vnet_get_tx(vn);
+    if (tx == INVALID_ADDRESS) {
+        LINK_STATS_INC(link.memerr);
+        return ERR_MEM;
+    }
     vqmsg m = allocate_vqmsg(vn->txq);
     assert(m != INVALID_ADDRESS);
     vqmsg_push(vn->txq, m, vn->empty_phys, vn->net_header_len, false);
@@ -99,7 +133,8 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
     for (struct pbuf * q = p; q != NULL; q = q->next)
         vqmsg_push(vn->txq, m, physical_from_virtual(q->payload), q->len, false);
 
-    vqmsg_commit(vn->txq, m, closure(vn->dev->general, tx_complete, p));
+    tx->p = p;
+    vqmsg_commit(vn->txq, m, (vqfinish)init_closure(&tx->complete, tx_complete));
     
     MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
     if (((u8_t *)p->payload)[0] & 1) {
@@ -124,61 +159,12 @@ static void receive_buffer_release(struct pbuf *p)
 
 static void post_receive(vnet vn);
 
-static u16 vnet_csum(u8 *buf, u64 len)
-{
-    u64 sum = 0;
-    while (len >= sizeof(u64)) {
-        u64 s = *(u64 *)buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-        buf += sizeof(u64);
-        len -= sizeof(u64);
-    }
-    if (len >= sizeof(u32)) {
-        u32 s = *(u32 *)buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-        buf += sizeof(u32);
-        len -= sizeof(u32);
-    }
-    if (len >= sizeof(u16)) {
-        u16 s = *(u16 *)buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-        buf += sizeof(u16);
-        len -= sizeof(u16);
-    }
-    if (len) {
-        u8 s = *buf;
-        sum += s;
-        if (sum < s)
-            sum++;
-    }
-
-    /* Fold down to 16 bits */
-    u32 s1 = sum;
-    u32 s2 = sum >> 32;
-    s1 += s2;
-    if (s1 < s2)
-        s1++;
-    u16 s3 = s1;
-    u16 s4 = s1 >> 16;
-    s3 += s4;
-    if (s3 < s4)
-        s3++;
-    return ~s3;
-}
-
-closure_function(1, 1, void, input,
-                 xpbuf, x,
-                 u64, len)
+define_closure_function(0, 1, void, input,
+                        u64, len)
 {
     virtio_net_debug("%s: len %ld\n", __func__, len);
 
-    xpbuf x = bound(x);
+    xpbuf x = struct_from_field(closure_self(), xpbuf, input);
     vnet vn= x->vn;
     // under what conditions does a virtio queue give us zero?
     if (x != NULL) {
@@ -190,7 +176,7 @@ closure_function(1, 1, void, input,
         x->p.pbuf.payload += vn->net_header_len;
         if (hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) {
             if (hdr->csum_start + hdr->csum_offset <= len - sizeof(u16)) {
-                u16 csum = vnet_csum(x->p.pbuf.payload + hdr->csum_start,
+                u16 csum = ~ip_checksum(x->p.pbuf.payload + hdr->csum_start,
                     len - hdr->csum_start);
                 *(u16 *)(x->p.pbuf.payload + hdr->csum_start +
                         hdr->csum_offset) = csum;
@@ -211,7 +197,6 @@ closure_function(1, 1, void, input,
     // we need to get a signal from the device side that there was
     // an underrun here to open up the window
     post_receive(vn);
-    closure_finish();
 }
 
 
@@ -238,7 +223,7 @@ static void post_receive(vnet vn)
         vqmsg_push(vn->rxq, m, phys, vn->net_header_len, true);
         vqmsg_push(vn->rxq, m, phys + vn->net_header_len, vn->rxbuflen - vn->net_header_len, true);
     }
-    vqmsg_commit(vn->rxq, m, closure(vn->dev->general, input, x));
+    vqmsg_commit(vn->rxq, m, (vqfinish)init_closure(&x->input, input));
 }
 
 static err_t virtioif_init(struct netif *netif)
@@ -298,6 +283,7 @@ static void virtio_net_attach(vtdev dev)
     /* rx = 0, tx = 1, ctl = 2 by 
        page 53 of http://docs.oasis-open.org/virtio/virtio/v1.0/cs01/virtio-v1.0-cs01.pdf */
     vn->dev = dev;
+    list_init(&vn->tx_free);
     virtio_alloc_virtqueue(dev, "virtio net tx", 1, &vn->txq);
     virtio_alloc_virtqueue(dev, "virtio net rx", 0, &vn->rxq);
     // just need vn->net_header_len contig bytes really
@@ -331,10 +331,11 @@ static void virtio_scsi_io_commit(virtio_scsi s, virtqueue vq, vqmsg msg, boolea
     vqmsg_commit(vq, msg, f);
 }
 
-static void virtio_scsi_io_sg(virtio_scsi_disk d, boolean write, sg_list sg, range blocks,
-                              status_handler sh)
+static void virtio_scsi_io_sg(virtio_scsi_disk d, boolean write, boolean fua, sg_list sg,
+                              range blocks, status_handler sh)
 {
-    virtio_scsi_debug("%s: %c blocks %R, sh %F\n", __func__, write ? 'w' : 'r', blocks, sh);
+    virtio_scsi_debug("%s: %c%s blocks %R, sh %F\n", __func__, write ? 'w' : 'r',
+                      fua ? " (fua)" : "", blocks, sh);
     virtio_scsi s = d->scsi;
     virtio_scsi_request r = 0;
     u64 r_phys;
@@ -351,6 +352,8 @@ static void virtio_scsi_io_sg(virtio_scsi_disk d, boolean write, sg_list sg, ran
                                           write ? SCSI_CMD_WRITE_16 : SCSI_CMD_READ_16, &r_phys);
             cdb = (struct scsi_cdb_readwrite_16 *)r->req.cdb;
             cdb->addr = htobe64(blocks.start);
+            if (fua)
+                cdb->byte2 = SRW16_FUA;
             msg = allocate_vqmsg(vq);
             assert(msg != INVALID_ADDRESS);
             vqmsg_push(vq, msg, r_phys + offsetof(virtio_scsi_request, req), sizeof(r->req), false);
@@ -414,14 +417,26 @@ define_closure_function(0, 1, void, virtio_scsi_req_handler,
     virtio_scsi_disk d = struct_from_field(closure_self(), virtio_scsi_disk, req_handler);
     switch (req->op) {
     case STORAGE_OP_READSG:
-        virtio_scsi_io_sg(d, false, req->data, req->blocks, req->completion);
+        virtio_scsi_io_sg(d, false, false, req->data, req->blocks, req->completion);
         break;
     case STORAGE_OP_WRITESG:
-        virtio_scsi_io_sg(d, true, req->data, req->blocks, req->completion);
+        virtio_scsi_io_sg(d, true, false, req->data, req->blocks, req->completion);
+        break;
+    case STORAGE_OP_WRITESG_FUA:
+        virtio_scsi_io_sg(d, true, true, req->data, req->blocks, req->completion);
         break;
     case STORAGE_OP_FLUSH:
         virtio_scsi_flush(d, req->completion);
         break;
+    case STORAGE_OP_POLL:
+        virtqueue_poll(d->scsi->requestq);
+        break;
+    case STORAGE_OP_PLUG:
+        virtqueue_plug(d->scsi->requestq);
+        break;
+    case STORAGE_OP_UNPLUG:
+        virtqueue_unplug(d->scsi->requestq);
+        break;
     case STORAGE_OP_READ:
         virtio_scsi_io(d, SCSI_CMD_READ_16, req->data, req->blocks, req->completion);
         break;
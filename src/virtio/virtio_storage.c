@@ -94,6 +94,8 @@ struct virtio_blk_config {
 
 declare_closure_struct(0, 1, void, virtio_storage_req_handler,
                        storage_req, req);
+declare_closure_struct(0, 1, void, storage_fua_flushed,
+                       status, s);
 
 typedef struct storage {
     vtdev v;
@@ -102,35 +104,98 @@ typedef struct storage {
     u64 capacity;
     u64 block_size;
     u32 seg_max;
+    struct spinlock reqs_lock;
+    struct list free_reqs;
+    struct spinlock fua_lock;
+    boolean fua_flush_pending;
+    vector fua_waiting;         /* completed FUA writes waiting for the next flush */
+    vector fua_flushing;        /* completed FUA writes covered by the flush in progress */
+    closure_struct(storage_fua_flushed, fua_flushed);
 } *storage;
 
-static virtio_blk_req allocate_virtio_blk_req(storage st, u32 type, u64 sector, u64 *phys)
+declare_closure_struct(0, 1, void, virtio_blk_complete,
+                       u64, len);
+
+/* Requests are recycled via a per-device free list, so that no memory is allocated (and no
+ * closure is created) when submitting an I/O request. */
+typedef struct virtio_blk_request {
+    struct virtio_blk_req req;  /* accessed by the device */
+    u64 phys;
+    storage st;
+    status_handler sh;
+    struct list l;
+    closure_struct(virtio_blk_complete, complete);
+} *virtio_blk_request;
+
+#define VIRTIO_BLK_REQUEST_SIZE pad(sizeof(struct virtio_blk_request), 64)
+
+static boolean virtio_blk_request_refill(storage st)
+{
+    backed_heap contiguous = st->v->contiguous;
+    bytes size = contiguous->h.pagesize;
+    u64 phys;
+    void *reqs = alloc_map(contiguous, size, &phys);
+    if (reqs == INVALID_ADDRESS)
+        return false;
+    u64 irqflags = spin_lock_irq(&st->reqs_lock);
+    for (bytes offset = 0; offset + VIRTIO_BLK_REQUEST_SIZE <= size;
+         offset += VIRTIO_BLK_REQUEST_SIZE) {
+        virtio_blk_request r = reqs + offset;
+        r->phys = phys + offset;
+        r->st = st;
+        list_push_back(&st->free_reqs, &r->l);
+    }
+    spin_unlock_irq(&st->reqs_lock, irqflags);
+    return true;
+}
+
+static virtio_blk_request allocate_virtio_blk_req(storage st, u32 type, u64 sector)
 {
-    virtio_blk_req req = alloc_map(st->v->contiguous, sizeof(struct virtio_blk_req), phys);
-    assert(req != INVALID_ADDRESS);
-    req->type = type;
-    req->reserved = 0;
-    req->sector = sector;
-    req->status = 0;
-    return req;
+    list l;
+    while (true) {
+        u64 irqflags = spin_lock_irq(&st->reqs_lock);
+        l = list_get_next(&st->free_reqs);
+        if (l)
+            list_delete(l);
+        spin_unlock_irq(&st->reqs_lock, irqflags);
+        if (l)
+            break;
+        boolean refilled = virtio_blk_request_refill(st);
+        assert(refilled);
+    }
+    virtio_blk_request r = struct_from_list(l, virtio_blk_request, l);
+    r->req.type = type;
+    r->req.reserved = 0;
+    r->req.sector = sector;
+    r->req.status = 0;
+    return r;
 }
 
-static void deallocate_virtio_blk_req(storage st, virtio_blk_req req, u64 phys)
+static void deallocate_virtio_blk_req(storage st, virtio_blk_request r)
 {
-    dealloc_unmap(st->v->contiguous, req, phys,
-                  pad(sizeof(struct virtio_blk_req), st->v->contiguous->h.pagesize));
+    u64 irqflags = spin_lock_irq(&st->reqs_lock);
+    list_push_back(&st->free_reqs, &r->l);
+    spin_unlock_irq(&st->reqs_lock, irqflags);
 }
 
-closure_function(4, 1, void, complete,
-                 storage, s, status_handler, f, virtio_blk_req, req, u64, phys,
-                 u64, len)
+define_closure_function(0, 1, void, virtio_blk_complete,
+                        u64, len)
 {
+    virtio_blk_request r = struct_from_field(closure_self(), virtio_blk_request, complete);
     status st = 0;
     // 1 is io error, 2 is unsupported operation
-    if (bound(req)->status) st = timm("result", "%d", bound(req)->status);
-    apply(bound(f), st);
-    deallocate_virtio_blk_req(bound(s), bound(req), bound(phys));
-    closure_finish();
+    if (r->req.status) st = timm("result", "%d", r->req.status);
+    status_handler sh = r->sh;
+    deallocate_virtio_blk_req(r->st, r);
+    apply(sh, st);
+}
+
+static void virtio_blk_request_commit(storage st, virtqueue vq, vqmsg m, virtio_blk_request r,
+                                      status_handler sh)
+{
+    vqmsg_push(vq, m, r->phys + VIRTIO_BLK_REQ_HEADER_SIZE, VIRTIO_BLK_REQ_STATUS_SIZE, true);
+    r->sh = sh;
+    vqmsg_commit(vq, m, (vqfinish)init_closure(&r->complete, virtio_blk_complete));
 }
 
 static inline void storage_rw_internal(storage st, boolean write, void * buf,
@@ -146,39 +211,25 @@ static inline void storage_rw_internal(storage st, boolean write, void * buf,
         goto out_inval;
     }
 
-    u64 req_phys;
-    virtio_blk_req req = allocate_virtio_blk_req(st, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
-                                                 start_sector, &req_phys);
+    virtio_blk_request req = allocate_virtio_blk_req(st, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
+                                                     start_sector);
     virtqueue vq = st->command;
     vqmsg m = allocate_vqmsg(vq);
     assert(m != INVALID_ADDRESS);
-    vqmsg_push(vq, m, req_phys, VIRTIO_BLK_REQ_HEADER_SIZE, false);
+    vqmsg_push(vq, m, req->phys, VIRTIO_BLK_REQ_HEADER_SIZE, false);
     vqmsg_push(vq, m, physical_from_virtual(buf), nsectors * st->block_size, !write);
-    u64 statusp = req_phys + VIRTIO_BLK_REQ_HEADER_SIZE;
-    vqmsg_push(vq, m, statusp, VIRTIO_BLK_REQ_STATUS_SIZE, true);
-    vqfinish c = closure(st->v->general, complete, st, sh, req, req_phys);
-    vqmsg_commit(vq, m, c);
+    virtio_blk_request_commit(st, vq, m, req, sh);
     return;
   out_inval:
     msg_err("%s", err);               /* yes, bark */
     apply(sh, timm("result", "%s", err));
 }
 
-static void virtio_storage_io_commit(storage st, virtqueue vq, vqmsg msg, virtio_blk_req req,
-                                     u64 req_phys, status_handler completion)
-{
-    vqmsg_push(vq, msg, req_phys + VIRTIO_BLK_REQ_HEADER_SIZE, VIRTIO_BLK_REQ_STATUS_SIZE, true);
-    vqfinish c = closure(st->v->general, complete, st, completion, req, req_phys);
-    assert(c != INVALID_ADDRESS);
-    vqmsg_commit(vq, msg, c);
-}
-
 static void virtio_storage_io_sg(storage st, boolean write, sg_list sg, range blocks,
                                  status_handler sh)
 {
     virtio_blk_debug("SG %c, blocks %R, sh %F\n", write ? 'w' : 'r', blocks, sh);
-    virtio_blk_req req = 0;
-    u64 req_phys;
+    virtio_blk_request req = 0;
     heap h = st->v->general;
     virtqueue vq = st->command;
     vqmsg msg;
@@ -187,10 +238,10 @@ static void virtio_storage_io_sg(storage st, boolean write, sg_list sg, range bl
     while (range_span(blocks)) {
         if (!req) {
             req = allocate_virtio_blk_req(st, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN,
-                                          blocks.start, &req_phys);
+                                          blocks.start);
             msg = allocate_vqmsg(vq);
             assert(msg != INVALID_ADDRESS);
-            vqmsg_push(vq, msg, req_phys, VIRTIO_BLK_REQ_HEADER_SIZE, false);
+            vqmsg_push(vq, msg, req->phys, VIRTIO_BLK_REQ_HEADER_SIZE, false);
             desc_count = 0;
         }
         sg_buf sgb = sg_list_head_peek(sg);
@@ -205,12 +256,12 @@ static void virtio_storage_io_sg(storage st, boolean write, sg_list sg, range bl
                 m = allocate_merge(h, sh);
                 sh = apply_merge(m);
             }
-            virtio_storage_io_commit(st, vq, msg, req, req_phys, m ? apply_merge(m) : sh);
+            virtio_blk_request_commit(st, vq, msg, req, m ? apply_merge(m) : sh);
             req = 0;
         }
     }
     if (req) {
-        virtio_storage_io_commit(st, vq, msg, req, req_phys, m ? apply_merge(m) : sh);
+        virtio_blk_request_commit(st, vq, msg, req, m ? apply_merge(m) : sh);
     }
     if (m)
         apply(sh, STATUS_OK);
@@ -219,16 +270,72 @@ static void virtio_storage_io_sg(storage st, boolean write, sg_list sg, range bl
 static void storage_flush(storage st, status_handler s)
 {
     virtio_blk_debug("%s: handler %p (%F)\n", __func__, s, s);
-    u64 req_phys;
-    virtio_blk_req req = allocate_virtio_blk_req(st, VIRTIO_BLK_T_FLUSH, 0, &req_phys);
+    virtio_blk_request req = allocate_virtio_blk_req(st, VIRTIO_BLK_T_FLUSH, 0);
     virtqueue vq = st->command;
     vqmsg m = allocate_vqmsg(vq);
     assert(m != INVALID_ADDRESS);
-    vqmsg_push(vq, m, req_phys, VIRTIO_BLK_REQ_HEADER_SIZE, false);
-    vqmsg_push(vq, m, req_phys + VIRTIO_BLK_REQ_HEADER_SIZE, VIRTIO_BLK_REQ_STATUS_SIZE, true);
-    vqfinish c = closure(st->v->general, complete, st, s, req, req_phys);
-    assert(c != INVALID_ADDRESS);
-    vqmsg_commit(vq, m, c);
+    vqmsg_push(vq, m, req->phys, VIRTIO_BLK_REQ_HEADER_SIZE, false);
+    virtio_blk_request_commit(st, vq, m, req, s);
+}
+
+/* virtio-blk has no FUA, so a FUA write completes only after a cache flush issued after the write
+   has completed. Writes completing while a flush is in progress share the next flush, so that a
+   burst of FUA writes costs at most two flushes rather than one each. */
+static void storage_fua_flush_start(storage st)
+{
+    vector v = st->fua_flushing;
+    st->fua_flushing = st->fua_waiting;
+    st->fua_waiting = v;
+}
+
+define_closure_function(0, 1, void, storage_fua_flushed,
+                        status, s)
+{
+    storage st = struct_from_field(closure_self(), storage, fua_flushed);
+    status_handler sh;
+
+    /* the flushing vector is not modified while a flush is pending */
+    while ((sh = vector_pop(st->fua_flushing)))
+        apply(sh, s);
+    u64 irqflags = spin_lock_irq(&st->fua_lock);
+    boolean flush = vector_length(st->fua_waiting) > 0;
+    if (flush)
+        storage_fua_flush_start(st);
+    else
+        st->fua_flush_pending = false;
+    spin_unlock_irq(&st->fua_lock, irqflags);
+    if (flush)
+        storage_flush(st, (status_handler)&st->fua_flushed);
+}
+
+closure_function(2, 1, void, storage_fua_write_complete,
+                 storage, st, status_handler, sh,
+                 status, s)
+{
+    storage st = bound(st);
+    status_handler sh = bound(sh);
+    closure_finish();
+    if (!is_ok(s)) {
+        apply(sh, s);
+        return;
+    }
+    u64 irqflags = spin_lock_irq(&st->fua_lock);
+    /* vector_push() asserts on allocation failure; grow first so that the
+       write can be failed back to its caller instead */
+    if (!buffer_extend(st->fua_waiting, sizeof(void *))) {
+        spin_unlock_irq(&st->fua_lock, irqflags);
+        apply(sh, timm("result", "failed to queue FUA write for flush"));
+        return;
+    }
+    vector_push(st->fua_waiting, sh);
+    boolean flush = !st->fua_flush_pending;
+    if (flush) {
+        st->fua_flush_pending = true;
+        storage_fua_flush_start(st);
+    }
+    spin_unlock_irq(&st->fua_lock, irqflags);
+    if (flush)
+        storage_flush(st, (status_handler)&st->fua_flushed);
 }
 
 define_closure_function(0, 1, void, virtio_storage_req_handler,
@@ -242,12 +349,34 @@ define_closure_function(0, 1, void, virtio_storage_req_handler,
     case STORAGE_OP_WRITESG:
         virtio_storage_io_sg(st, true, req->data, req->blocks, req->completion);
         break;
+    case STORAGE_OP_WRITESG_FUA:
+        if (st->v->features & VIRTIO_BLK_F_FLUSH) {
+            status_handler sh = closure(st->v->general, storage_fua_write_complete, st,
+                                        req->completion);
+            if (sh == INVALID_ADDRESS) {
+                apply(req->completion, timm("result", "failed to allocate completion"));
+                break;
+            }
+            virtio_storage_io_sg(st, true, req->data, req->blocks, sh);
+        } else {
+            virtio_storage_io_sg(st, true, req->data, req->blocks, req->completion);
+        }
+        break;
     case STORAGE_OP_FLUSH:
         if (st->v->features & VIRTIO_BLK_F_FLUSH)
             storage_flush(st, req->completion);
         else
             apply(req->completion, STATUS_OK);
         break;
+    case STORAGE_OP_POLL:
+        virtqueue_poll(st->command);
+        break;
+    case STORAGE_OP_PLUG:
+        virtqueue_plug(st->command);
+        break;
+    case STORAGE_OP_UNPLUG:
+        virtqueue_unplug(st->command);
+        break;
     case STORAGE_OP_READ:
         storage_rw_internal(st, false, req->data, req->blocks, req->completion);
         break;
@@ -262,6 +391,15 @@ static void virtio_blk_attach(heap general, storage_attach a, vtdev v)
     storage s = allocate(general, sizeof(struct storage));
     assert(s != INVALID_ADDRESS);
     s->v = v;
+    spin_lock_init(&s->reqs_lock);
+    list_init(&s->free_reqs);
+    spin_lock_init(&s->fua_lock);
+    s->fua_flush_pending = false;
+    s->fua_waiting = allocate_vector(general, 8);
+    assert(s->fua_waiting != INVALID_ADDRESS);
+    s->fua_flushing = allocate_vector(general, 8);
+    assert(s->fua_flushing != INVALID_ADDRESS);
+    init_closure(&s->fua_flushed, storage_fua_flushed);
 
     s->block_size = (v->features & VIRTIO_BLK_F_BLK_SIZE) ?
             vtdev_cfg_read_4(v, VIRTIO_BLK_R_BLOCK_SIZE) : SECTOR_SIZE;
@@ -100,6 +100,7 @@ typedef struct virtqueue {
     u64 free_cnt;               /* atomic */
     u16 desc_idx;               /* head of descriptor free list */
     u16 last_used_idx;          /* irq only */
+    u32 plugged;                /* messages are held in msg_queue while nonzero */
     struct list msg_queue;
     struct list free_msgs;
     struct spinlock lock;
@@ -163,16 +164,11 @@ void vqmsg_commit(virtqueue vq, vqmsg m, vqfinish completion)
     spin_unlock_irq(&vq->lock, irqflags);
 }
 
-closure_function(1, 0, void, vq_interrupt,
-                 virtqueue, vq)
+/* Called with the lock held. */
+static void virtqueue_service(virtqueue vq)
 {
-    // ensure we see up-to-date used->idx (updated by host)
-    memory_barrier();
-    virtqueue vq = bound(vq);
     virtqueue_debug_verbose("%s: ENTRY: vq %s: entries %d, last_used_idx %d, used->idx %d, desc_idx %d\n",
         __func__, vq->name, vq->entries, vq->last_used_idx, vq->used->idx, vq->desc_idx);
-    
-    spin_lock(&vq->lock);
     while (vq->last_used_idx != vq->used->idx) {
         volatile struct vring_used_elem *uep = vq->used->ring + (vq->last_used_idx & (vq->entries - 1));
         virtqueue_debug_verbose("%s: vq %s: last_used_idx %d, id %d, len %d\n",
@@ -205,9 +201,46 @@ closure_function(1, 0, void, vq_interrupt,
     virtqueue_fill(vq);
     virtqueue_debug("%s: EXIT: vq %s: last_used_idx %d, desc_idx %d\n",
                     __func__, vq->name, vq->last_used_idx, vq->desc_idx);
+}
+
+closure_function(1, 0, void, vq_interrupt,
+                 virtqueue, vq)
+{
+    // ensure we see up-to-date used->idx (updated by host)
+    memory_barrier();
+    virtqueue vq = bound(vq);
+    spin_lock(&vq->lock);
+    virtqueue_service(vq);
     spin_unlock(&vq->lock);
 }
 
+/* While a virtqueue is plugged, committed messages are queued without being made available to
+   the device, so that a batch of messages can be submitted with a single notification. */
+void virtqueue_plug(virtqueue vq)
+{
+    u64 irqflags = spin_lock_irq(&vq->lock);
+    vq->plugged++;
+    spin_unlock_irq(&vq->lock, irqflags);
+}
+
+void virtqueue_unplug(virtqueue vq)
+{
+    u64 irqflags = spin_lock_irq(&vq->lock);
+    assert(vq->plugged > 0);
+    if (--vq->plugged == 0)
+        virtqueue_fill(vq);
+    spin_unlock_irq(&vq->lock, irqflags);
+}
+
+/* Processes used buffers without waiting for the queue interrupt. */
+void virtqueue_poll(virtqueue vq)
+{
+    memory_barrier();
+    u64 irqflags = spin_lock_irq(&vq->lock);
+    virtqueue_service(vq);
+    spin_unlock_irq(&vq->lock, irqflags);
+}
+
 status virtqueue_alloc(vtdev dev,
                        const char *name,
                        u16 queue_index,
@@ -234,6 +267,7 @@ status virtqueue_alloc(vtdev dev,
     vq->notify_offset = notify_offset;
     vq->entries = size;
     vq->free_cnt = size;
+    vq->plugged = 0;
     list_init(&vq->msg_queue);
     list_init(&vq->free_msgs);
     spin_lock_init(&vq->lock);
@@ -296,6 +330,8 @@ static void virtqueue_fill(virtqueue vq)
     virtqueue_debug("%s: ENTRY: vq %s: entries %d, desc_idx %d, avail->idx %d, avail->flags 0x%x\n",
         __func__, vq->name, vq->entries, vq->desc_idx, vq->avail->idx, vq->avail->flags);
 
+    if (vq->plugged)
+        return;
     list n = list_get_next(&vq->msg_queue);
     u16 added = 0;
     while (n && n != &vq->msg_queue) {
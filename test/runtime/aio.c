@@ -3,11 +3,13 @@
 #define __USE_GNU
 #include <fcntl.h>
 #include <linux/aio_abi.h>
+#include <poll.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
@@ -43,6 +45,13 @@ static void iocb_setup_pwrite(struct iocb *iocb, int fd, void *buf,
     iocb->aio_offset = offset;
 }
 
+static void iocb_setup_cmd(struct iocb *iocb, int fd, int cmd)
+{
+    memset(iocb, 0, sizeof(*iocb));
+    iocb->aio_fildes = fd;
+    iocb->aio_lio_opcode = cmd;
+}
+
 static void aio_test_readwrite(void)
 {
     int fd;
@@ -220,6 +229,149 @@ static void aio_test_multiple()
     test_assert(close(fd) == 0);
 }
 
+static void aio_test_fsync(void)
+{
+    int fd;
+    int pipefd[2];
+    aio_context_t ioc = 0;
+    uint8_t write_buf[BUF_SIZE];
+    struct iocb iocbs[3];
+    struct iocb *iocb_ptrs[3];
+    struct io_event evts[3];
+
+    fd = open("file_fsync", O_RDWR | O_CREAT, S_IRWXU);
+    test_assert(fd > 0);
+    test_assert(syscall(SYS_io_setup, 3, &ioc) == 0);
+
+    iocb_setup_cmd(&iocbs[0], fd, IOCB_CMD_FSYNC);
+    iocbs[0].aio_buf = (__u64) write_buf;
+    iocb_ptrs[0] = &iocbs[0];
+    test_assert(syscall(SYS_io_submit, ioc, 1, iocb_ptrs) == -1);
+    test_assert(errno == EINVAL);
+
+    test_assert(pipe(pipefd) == 0);
+    iocb_setup_cmd(&iocbs[0], pipefd[1], IOCB_CMD_FSYNC);
+    test_assert(syscall(SYS_io_submit, ioc, 1, iocb_ptrs) == -1);
+    test_assert(errno == EINVAL);
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    /* A write followed by data and full syncs in the same submission. */
+    memset(write_buf, 0xa5, BUF_SIZE);
+    iocb_setup_pwrite(&iocbs[0], fd, write_buf, BUF_SIZE, 0);
+    iocb_setup_cmd(&iocbs[1], fd, IOCB_CMD_FDSYNC);
+    iocb_setup_cmd(&iocbs[2], fd, IOCB_CMD_FSYNC);
+    for (int i = 0; i < 3; i++) {
+        iocbs[i].aio_data = i;
+        iocb_ptrs[i] = &iocbs[i];
+    }
+    test_assert(syscall(SYS_io_submit, ioc, 3, iocb_ptrs) == 3);
+    test_assert(syscall(SYS_io_getevents, ioc, 3, 3, evts, NULL) == 3);
+    for (int i = 0; i < 3; i++) {
+        if (evts[i].data == 0)
+            test_assert(evts[i].res == BUF_SIZE);
+        else
+            test_assert(evts[i].res == 0);
+    }
+
+    test_assert(syscall(SYS_io_destroy, ioc) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(unlink("file_fsync") == 0);
+}
+
+static void aio_test_poll(void)
+{
+    int pipefd[2];
+    aio_context_t ioc = 0;
+    struct iocb iocbs[2];
+    struct iocb *iocb_ptrs[2] = {&iocbs[0], &iocbs[1]};
+    struct io_event evt;
+    struct timespec ts;
+    char c;
+
+    test_assert(pipe(pipefd) == 0);
+    test_assert(syscall(SYS_io_setup, 2, &ioc) == 0);
+
+    iocb_setup_cmd(&iocbs[0], pipefd[0], IOCB_CMD_POLL);
+    iocbs[0].aio_buf = POLLIN;
+    iocbs[0].aio_nbytes = 1;
+    test_assert(syscall(SYS_io_submit, ioc, 1, iocb_ptrs) == -1);
+    test_assert(errno == EINVAL);
+
+    /* The poll request completes only when the pipe becomes readable. */
+    iocbs[0].aio_nbytes = 0;
+    test_assert(syscall(SYS_io_submit, ioc, 1, iocb_ptrs) == 1);
+    ts.tv_sec = 0;
+    ts.tv_nsec = 1000000;
+    test_assert(syscall(SYS_io_getevents, ioc, 1, 1, &evt, &ts) == 0);
+    test_assert(write(pipefd[1], "x", 1) == 1);
+    test_assert(syscall(SYS_io_getevents, ioc, 1, 1, &evt, NULL) == 1);
+    test_assert((evt.obj == (__u64) &iocbs[0]) && (evt.res & POLLIN));
+
+    /* Events which are already present complete the request immediately. */
+    iocb_setup_cmd(&iocbs[1], pipefd[1], IOCB_CMD_POLL);
+    iocbs[1].aio_buf = POLLOUT;
+    test_assert(syscall(SYS_io_submit, ioc, 1, &iocb_ptrs[1]) == 1);
+    test_assert(syscall(SYS_io_getevents, ioc, 1, 1, &evt, NULL) == 1);
+    test_assert((evt.obj == (__u64) &iocbs[1]) && (evt.res & POLLOUT));
+
+    /* Destroying the context cancels pending poll requests. */
+    test_assert(read(pipefd[0], &c, 1) == 1);
+    test_assert(syscall(SYS_io_submit, ioc, 1, iocb_ptrs) == 1);
+    test_assert(syscall(SYS_io_destroy, ioc) == 0);
+
+    close(pipefd[0]);
+    close(pipefd[1]);
+}
+
+/* Submits a batch of iocbs whose user buffers are not resident: writes from a file mapping that
+ * has not been faulted in (which requires reads from the same disk while the batch is being
+ * submitted), and reads into untouched anonymous memory. */
+static void aio_test_nonresident(void)
+{
+    const int count = 4;
+    const size_t len = count * 4096;
+    aio_context_t ioc = 0;
+    struct iocb iocbs[count];
+    struct iocb *iocb_ptrs[count];
+    struct io_event evts[count];
+    int src, fd;
+
+    src = open("mapfile", O_RDONLY);
+    test_assert(src >= 0);
+    uint8_t *wbuf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, src, 0);
+    test_assert(wbuf != MAP_FAILED);
+    uint8_t *rbuf = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    test_assert(rbuf != MAP_FAILED);
+    fd = open("file_nonres", O_RDWR | O_CREAT, S_IRWXU);
+    test_assert(fd > 0);
+    test_assert(syscall(SYS_io_setup, count, &ioc) == 0);
+
+    for (int i = 0; i < count; i++) {
+        iocb_ptrs[i] = &iocbs[i];
+        iocb_setup_pwrite(&iocbs[i], fd, wbuf + i * 4096, 4096, i * 4096);
+    }
+    test_assert(syscall(SYS_io_submit, ioc, count, iocb_ptrs) == count);
+    test_assert(syscall(SYS_io_getevents, ioc, count, count, evts, NULL) == count);
+    for (int i = 0; i < count; i++)
+        test_assert(evts[i].res == 4096);
+
+    for (int i = 0; i < count; i++)
+        iocb_setup_pread(&iocbs[i], fd, rbuf + i * 4096, 4096, i * 4096);
+    test_assert(syscall(SYS_io_submit, ioc, count, iocb_ptrs) == count);
+    test_assert(syscall(SYS_io_getevents, ioc, count, count, evts, NULL) == count);
+    for (int i = 0; i < count; i++)
+        test_assert(evts[i].res == 4096);
+    test_assert(memcmp(rbuf, wbuf, len) == 0);
+
+    test_assert(syscall(SYS_io_destroy, ioc) == 0);
+    test_assert(munmap(rbuf, len) == 0);
+    test_assert(munmap(wbuf, len) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(close(src) == 0);
+    test_assert(unlink("file_nonres") == 0);
+}
+
 int main(int argc, char **argv)
 {
     aio_context_t ioc = 0;
@@ -235,6 +387,9 @@ int main(int argc, char **argv)
     aio_test_readwrite();
     aio_test_eventfd();
     aio_test_multiple();
+    aio_test_fsync();
+    aio_test_poll();
+    aio_test_nonresident();
     printf("AIO test OK\n");
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,197 @@
+/* Linux AIO queue depth benchmark: random block-sized reads (or writes) of a file are kept in
+ * flight via io_submit() at a given queue depth, resubmitting completed requests in batches, so
+ * that IOPS and per-request latency can be measured as a function of the queue depth. Without -q,
+ * queue depths from 1 to 256 are measured in turn. With -d, the file is opened with O_DIRECT.
+ * Usage: aio_bench [-q queue depth] [-b block size] [-s file size in MB] [-n requests] [-w] [-d]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/aio_abi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define AIO_BENCH_MAX_DEPTH 256
+#define AIO_BENCH_FILE      "aio_bench_file"
+
+static int block_size = 4096;
+static long file_blocks;
+static long nrequests = 20000;
+static int write_mode;
+static int direct;
+
+static uint64_t rand_state = 0x9e3779b97f4a7c15ul;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static uint64_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
+    return rand_state;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void iocb_setup(struct iocb *iocb, int fd, void *buf, int slot)
+{
+    memset(iocb, 0, sizeof(*iocb));
+    iocb->aio_fildes = fd;
+    iocb->aio_lio_opcode = write_mode ? IOCB_CMD_PWRITE : IOCB_CMD_PREAD;
+    iocb->aio_buf = (__u64)buf;
+    iocb->aio_nbytes = block_size;
+    iocb->aio_offset = (long long)(rand_next() % file_blocks) * block_size;
+    iocb->aio_data = slot;
+}
+
+static void run_depth(int fd, int depth, uint8_t *bufs)
+{
+    aio_context_t ioc = 0;
+    struct iocb iocbs[AIO_BENCH_MAX_DEPTH];
+    struct iocb *iocb_ptrs[AIO_BENCH_MAX_DEPTH];
+    struct io_event evts[AIO_BENCH_MAX_DEPTH];
+    uint64_t submit_ts[AIO_BENCH_MAX_DEPTH];
+    uint64_t *latencies = malloc(nrequests * sizeof(*latencies));
+    long submitted = 0, completed = 0;
+    int n;
+
+    test_assert(latencies != NULL);
+    test_assert(syscall(SYS_io_setup, depth, &ioc) == 0);
+    uint64_t start = now_ns();
+    for (n = 0; (n < depth) && (submitted + n < nrequests); n++) {
+        iocb_setup(&iocbs[n], fd, bufs + (long)n * block_size, n);
+        iocb_ptrs[n] = &iocbs[n];
+        submit_ts[n] = start;
+    }
+    test_assert(syscall(SYS_io_submit, ioc, n, iocb_ptrs) == n);
+    submitted += n;
+    while (completed < nrequests) {
+        int nevts = syscall(SYS_io_getevents, ioc, 1, depth, evts, NULL);
+        test_assert(nevts > 0);
+        uint64_t ts = now_ns();
+        n = 0;
+        for (int i = 0; i < nevts; i++) {
+            int slot = evts[i].data;
+
+            test_assert(evts[i].res == block_size);
+            latencies[completed++] = ts - submit_ts[slot];
+            if (submitted + n < nrequests) {
+                iocb_setup(&iocbs[slot], fd, bufs + (long)slot * block_size, slot);
+                iocb_ptrs[n++] = &iocbs[slot];
+                submit_ts[slot] = ts;
+            }
+        }
+        if (n) {
+            test_assert(syscall(SYS_io_submit, ioc, n, iocb_ptrs) == n);
+            submitted += n;
+        }
+    }
+    uint64_t ns = now_ns() - start;
+    test_assert(syscall(SYS_io_destroy, ioc) == 0);
+
+    uint64_t total = 0;
+    for (long i = 0; i < nrequests; i++)
+        total += latencies[i];
+    qsort(latencies, nrequests, sizeof(*latencies), cmp_u64);
+    printf("depth %3d: %lu IOPS, latency avg %lu us, p50 %lu us, p99 %lu us, max %lu us\n",
+           depth, nrequests * 1000000000ul / ns, total / nrequests / 1000,
+           latencies[nrequests / 2] / 1000, latencies[nrequests * 99 / 100] / 1000,
+           latencies[nrequests - 1] / 1000);
+    free(latencies);
+}
+
+int main(int argc, char *argv[])
+{
+    int depth = 0;
+    long file_mb = 32;
+    uint8_t *bufs;
+    int fd, opt;
+
+    setbuf(stdout, NULL);
+    while ((opt = getopt(argc, argv, "q:b:s:n:wd")) != -1) {
+        switch (opt) {
+        case 'q':
+            depth = atoi(optarg);
+            break;
+        case 'b':
+            block_size = atoi(optarg);
+            break;
+        case 's':
+            file_mb = atol(optarg);
+            break;
+        case 'n':
+            nrequests = atol(optarg);
+            break;
+        case 'w':
+            write_mode = 1;
+            break;
+        case 'd':
+            direct = 1;
+            break;
+        default:
+            printf("Usage: %s [-q queue depth] [-b block size] [-s file size in MB] "
+                   "[-n requests] [-w] [-d]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    test_assert((depth >= 0) && (depth <= AIO_BENCH_MAX_DEPTH));
+    test_assert((block_size >= 512) && !(block_size & (block_size - 1)));
+    test_assert((file_mb > 0) && (nrequests > 0));
+    file_blocks = (file_mb << 20) / block_size;
+    test_assert(file_blocks > 0);
+    printf("%s%s of %d-byte blocks, %ld MB file, %ld requests per queue depth\n",
+           write_mode ? "random writes" : "random reads", direct ? " (O_DIRECT)" : "",
+           block_size, file_mb, nrequests);
+
+    test_assert(posix_memalign((void **)&bufs, 4096, (long)AIO_BENCH_MAX_DEPTH * block_size) == 0);
+    memset(bufs, 0x5a, (long)AIO_BENCH_MAX_DEPTH * block_size);
+    fd = open(AIO_BENCH_FILE, O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+    test_assert(fd >= 0);
+    for (long i = 0; i < file_blocks; i += AIO_BENCH_MAX_DEPTH) {
+        long n = file_blocks - i < AIO_BENCH_MAX_DEPTH ? file_blocks - i : AIO_BENCH_MAX_DEPTH;
+        test_assert(pwrite(fd, bufs, n * block_size, i * block_size) == n * block_size);
+    }
+    test_assert(fsync(fd) == 0);
+    if (direct) {
+        close(fd);
+        fd = open(AIO_BENCH_FILE, O_RDWR | O_DIRECT);
+        test_assert(fd >= 0);
+    }
+
+    if (depth) {
+        run_depth(fd, depth, bufs);
+    } else {
+        for (depth = 1; depth <= AIO_BENCH_MAX_DEPTH; depth *= 2)
+            run_depth(fd, depth, bufs);
+    }
+
+    test_assert(close(fd) == 0);
+    test_assert(unlink(AIO_BENCH_FILE) == 0);
+    free(bufs);
+    printf("aio_bench test passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+/* Compressed file test: files stored in the image both compressed and uncompressed are read and
+ * compared, reporting the read throughput and stored size of each; then a compressed file is
+ * overwritten in the middle, which converts the affected extent to uncompressed storage.
+ * Usage: compress compressed-file raw-file [compressed-file raw-file ...]
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define READ_SIZE   (64 * 1024)
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+/* Reads a whole file in READ_SIZE chunks, printing the throughput. */
+static char *read_file(const char *path, size_t *len)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    test_assert(fd >= 0);
+    test_assert(fstat(fd, &st) == 0);
+    char *buf = malloc(st.st_size + 1);
+    test_assert(buf);
+    uint64_t start = now_ns();
+    size_t total = 0;
+    ssize_t n;
+    while ((n = read(fd, buf + total, READ_SIZE)) > 0)
+        total += n;
+    uint64_t ns = now_ns() - start;
+    test_assert(n == 0);
+    test_assert(total == st.st_size);
+    close(fd);
+    printf("%s: %zu bytes, %lu bytes stored, read in %lu us (%lu MB/s)\n", path, total,
+           st.st_blocks * 512, ns / 1000, ns ? total * 1000ul / ns : 0);
+    *len = total;
+    return buf;
+}
+
+static void overwrite_test(const char *path, const char *raw, size_t len)
+{
+    char patch[100];
+    off_t offset = len / 2;
+    size_t plen = len - offset < sizeof(patch) ? len - offset : sizeof(patch);
+    int fd = open(path, O_RDWR);
+
+    test_assert(fd >= 0);
+    memset(patch, 0xa5, sizeof(patch));
+    test_assert(pwrite(fd, patch, plen, offset) == plen);
+    test_assert(fsync(fd) == 0);
+    close(fd);
+
+    size_t n;
+    char *data = read_file(path, &n);
+    test_assert(n == len);
+    test_assert(!memcmp(data, raw, offset));
+    test_assert(!memcmp(data + offset, patch, plen));
+    test_assert(!memcmp(data + offset + plen, raw + offset + plen, len - offset - plen));
+    free(data);
+}
+
+int main(int argc, char *argv[])
+{
+    if ((argc < 3) || !(argc & 1)) {
+        printf("Usage: %s compressed-file raw-file [compressed-file raw-file ...]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 1; i < argc; i += 2) {
+        size_t clen, rlen;
+        char *raw = read_file(argv[i + 1], &rlen);
+        char *data = read_file(argv[i], &clen);
+        test_assert(clen == rlen);
+        test_assert(!memcmp(data, raw, rlen));
+        free(data);
+
+        /* cached read */
+        data = read_file(argv[i], &clen);
+        test_assert(!memcmp(data, raw, rlen));
+        free(data);
+        if (i == 1)
+            overwrite_test(argv[i], raw, rlen);
+        free(raw);
+    }
+    printf("compress test passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/* Directory benchmark: creates, looks up, lists and unlinks a large number of files in a single
+ * directory, reporting the rate of each operation.
+ * Usage: dir_bench [-n number of files]
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define DIR_BENCH_DIR   "dir_bench"
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+static int nfiles = 100000;
+static unsigned char *seen;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void print_rate(const char *op, int count, uint64_t ns)
+{
+    printf("%s: %d ops in %lu us, %lu ops/s\n", op, count, ns / 1000,
+           ns ? count * 1000000000ul / ns : 0);
+}
+
+static void file_name(char *buf, int i)
+{
+    sprintf(buf, DIR_BENCH_DIR "/file%08d", i);
+}
+
+/* Lists the directory with a small buffer, so that the listing is resumed from the offset of the
+ * last entry many times; if unlink_odd is set, odd-numbered files are removed while the listing is
+ * in progress. Returns the number of entries seen. */
+static int list_dir(int unlink_odd)
+{
+    char buf[512];
+    char name[64];
+    int fd = open(DIR_BENCH_DIR, O_RDONLY | O_DIRECTORY);
+    int batch[sizeof(buf) / sizeof(struct linux_dirent64)];
+    int nbatch = 0;
+    int count = 0;
+    int nread;
+
+    test_assert(fd >= 0);
+    memset(seen, 0, nfiles);
+    while ((nread = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+        for (int pos = 0; pos < nread; ) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + pos);
+            pos += d->d_reclen;
+            if (d->d_name[0] == '.')
+                continue;
+            int i;
+            test_assert(sscanf(d->d_name, "file%d", &i) == 1);
+            test_assert(i >= 0 && i < nfiles);
+            test_assert(!seen[i]);  /* no entry may be listed twice */
+            seen[i] = 1;
+            count++;
+            if (unlink_odd && (i + 1 < nfiles) && ((i + 1) & 1))
+                batch[nbatch++] = i + 1;
+        }
+
+        /* remove entries that have not been listed yet */
+        for (int j = 0; j < nbatch; j++) {
+            if (seen[batch[j]])
+                continue;
+            file_name(name, batch[j]);
+            test_assert(unlink(name) == 0);
+            seen[batch[j]] = 2;
+        }
+        nbatch = 0;
+    }
+    test_assert(nread == 0);
+    close(fd);
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    char name[64];
+    struct stat st;
+    uint64_t start;
+    int opt, fd, count;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+        case 'n':
+            nfiles = atoi(optarg);
+            break;
+        default:
+            printf("Usage: %s [-n number of files]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    test_assert(nfiles > 1);
+    seen = malloc(nfiles);
+    test_assert(seen);
+    test_assert(mkdir(DIR_BENCH_DIR, 0755) == 0);
+    printf("%d files\n", nfiles);
+
+    start = now_ns();
+    for (int i = 0; i < nfiles; i++) {
+        file_name(name, i);
+        fd = open(name, O_CREAT | O_EXCL | O_WRONLY, 0644);
+        test_assert(fd >= 0);
+        close(fd);
+    }
+    print_rate("create", nfiles, now_ns() - start);
+
+    start = now_ns();
+    for (int i = 0; i < nfiles; i++) {
+        file_name(name, (i * 7919) % nfiles);
+        test_assert(stat(name, &st) == 0);
+    }
+    print_rate("lookup", nfiles, now_ns() - start);
+
+    start = now_ns();
+    for (int i = 0; i < nfiles; i++) {
+        sprintf(name, DIR_BENCH_DIR "/missing%08d", i);
+        test_assert(stat(name, &st) == -1 && errno == ENOENT);
+    }
+    print_rate("negative lookup", nfiles, now_ns() - start);
+
+    start = now_ns();
+    count = list_dir(0);
+    print_rate("list", count, now_ns() - start);
+    test_assert(count == nfiles);
+
+    /* entries removed during the listing must not disturb it: each remaining entry is listed
+     * exactly once */
+    count = list_dir(1);
+    for (int i = 0; i < nfiles; i++)
+        test_assert(seen[i] == 1 || (seen[i] == 2 && (i & 1)));
+
+    start = now_ns();
+    for (int i = 0; i < nfiles; i++) {
+        if (seen[i] != 1)
+            continue;
+        file_name(name, i);
+        test_assert(unlink(name) == 0);
+    }
+    print_rate("unlink", count, now_ns() - start);
+    test_assert(rmdir(DIR_BENCH_DIR) == 0);
+    free(seen);
+    printf("dir_bench test passed\n");
+    return EXIT_SUCCESS;
+}
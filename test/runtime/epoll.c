@@ -1,4 +1,6 @@
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
@@ -6,6 +8,8 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
 #include <errno.h>
 
 #define test_assert(expr) do { \
@@ -227,12 +231,151 @@ void test_eventfd_et()
     close(efd);
 }
 
+static void test_oneshot()
+{
+    int efd, evfd;
+    struct epoll_event events;
+    uint64_t w = 1;
+
+    efd = epoll_create1(0);
+    test_assert(efd >= 0);
+    evfd = eventfd(0, EFD_NONBLOCK);
+    test_assert(evfd >= 0);
+    events.data.fd = evfd;
+    events.events = EPOLLIN | EPOLLONESHOT;
+    test_assert(epoll_ctl(efd, EPOLL_CTL_ADD, evfd, &events) == 0);
+    test_assert(epoll_wait(efd, &events, 1, 0) == 0);
+    test_assert(write(evfd, &w, sizeof(w)) == sizeof(w));
+    test_assert(epoll_wait(efd, &events, 1, 100) == 1);
+    test_assert((events.data.fd == evfd) && (events.events == EPOLLIN));
+
+    /* disabled after the first event, until re-armed */
+    test_assert(epoll_wait(efd, &events, 1, 0) == 0);
+    test_assert(write(evfd, &w, sizeof(w)) == sizeof(w));
+    test_assert(epoll_wait(efd, &events, 1, 0) == 0);
+    events.data.fd = evfd;
+    events.events = EPOLLIN | EPOLLONESHOT;
+    test_assert(epoll_ctl(efd, EPOLL_CTL_MOD, evfd, &events) == 0);
+    test_assert(epoll_wait(efd, &events, 1, 100) == 1);
+    test_assert((events.data.fd == evfd) && (events.events == EPOLLIN));
+    test_assert(epoll_wait(efd, &events, 1, 0) == 0);
+
+    close(evfd);
+    close(efd);
+}
+
+struct exclusive_waiter {
+    int efd;
+    int ret;
+};
+
+static void *exclusive_wait(void *arg)
+{
+    struct exclusive_waiter *w = arg;
+    struct epoll_event event;
+
+    w->ret = epoll_wait(w->efd, &event, 1, 500);
+    return NULL;
+}
+
+/* With EPOLLEXCLUSIVE, an event wakes only one of the threads waiting on different epoll instances
+ * for the same file descriptor. */
+static void test_exclusive()
+{
+    const int waiter_count = 2;
+    struct exclusive_waiter waiters[waiter_count];
+    pthread_t threads[waiter_count];
+    struct epoll_event event;
+    int evfd;
+    uint64_t w = 1;
+    int woken = 0;
+
+    evfd = eventfd(0, EFD_NONBLOCK);
+    test_assert(evfd >= 0);
+    for (int i = 0; i < waiter_count; i++) {
+        waiters[i].efd = epoll_create1(0);
+        test_assert(waiters[i].efd >= 0);
+        event.data.fd = evfd;
+        event.events = EPOLLIN | EPOLLEXCLUSIVE | EPOLLONESHOT;
+        test_assert((epoll_ctl(waiters[i].efd, EPOLL_CTL_ADD, evfd, &event) == -1) &&
+                    (errno == EINVAL));
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        test_assert(epoll_ctl(waiters[i].efd, EPOLL_CTL_ADD, evfd, &event) == 0);
+        test_assert((epoll_ctl(waiters[i].efd, EPOLL_CTL_MOD, evfd, &event) == -1) &&
+                    (errno == EINVAL));
+    }
+    test_assert((epoll_ctl(waiters[0].efd, EPOLL_CTL_ADD, waiters[1].efd, &event) == -1) &&
+                (errno == EINVAL));
+
+    for (int i = 0; i < waiter_count; i++)
+        test_assert(pthread_create(&threads[i], NULL, exclusive_wait, &waiters[i]) == 0);
+    usleep(100 * 1000);
+    test_assert(write(evfd, &w, sizeof(w)) == sizeof(w));
+    for (int i = 0; i < waiter_count; i++) {
+        test_assert(pthread_join(threads[i], NULL) == 0);
+        test_assert((waiters[i].ret == 0) || (waiters[i].ret == 1));
+        woken += waiters[i].ret;
+        close(waiters[i].efd);
+    }
+    test_assert(woken == 1);
+    close(evfd);
+}
+
+static void *signalfd_other_wait(void *arg)
+{
+    struct epoll_event event;
+
+    return (void *)(long)epoll_wait(*(int *)arg, &event, 1, 0);
+}
+
+/* A signal pending on a thread is reported by a signalfd only to that thread, and must not be
+ * consumed by epoll_wait calls from other threads. */
+static void test_signalfd_thread()
+{
+    sigset_t mask;
+    struct epoll_event event;
+    struct signalfd_siginfo si;
+    pthread_t thread;
+    void *retval;
+    int efd, sfd;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    test_assert(pthread_sigmask(SIG_BLOCK, &mask, NULL) == 0);
+    sfd = signalfd(-1, &mask, SFD_NONBLOCK);
+    test_assert(sfd >= 0);
+    efd = epoll_create1(0);
+    test_assert(efd >= 0);
+    event.data.fd = sfd;
+    event.events = EPOLLIN;
+    test_assert(epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &event) == 0);
+    test_assert(epoll_wait(efd, &event, 1, 0) == 0);
+    test_assert(pthread_kill(pthread_self(), SIGUSR1) == 0);
+
+    test_assert(pthread_create(&thread, NULL, signalfd_other_wait, &efd) == 0);
+    test_assert(pthread_join(thread, &retval) == 0);
+    test_assert(retval == 0);
+
+    test_assert(epoll_wait(efd, &event, 1, 100) == 1);
+    test_assert((event.data.fd == sfd) && (event.events == EPOLLIN));
+    test_assert(read(sfd, &si, sizeof(si)) == sizeof(si));
+    test_assert(si.ssi_signo == SIGUSR1);
+    test_assert(epoll_wait(efd, &event, 1, 0) == 0);
+
+    close(efd);
+    close(sfd);
+    test_assert(pthread_sigmask(SIG_UNBLOCK, &mask, NULL) == 0);
+}
+
 int main(int argc, char **argv)
 {
     test_ctl();
     test_wait();
     test_edgetrigger();
     test_eventfd_et();
+    test_oneshot();
+    test_exclusive();
+    test_signalfd_thread();
 
     printf("test passed\n");
     return EXIT_SUCCESS;
@@ -0,0 +1,177 @@
+/* epoll scalability benchmark: a large number of pipes is registered for input with epoll, a small
+ * subset of them carries tokens which worker threads receive via epoll_wait() and send back into
+ * the same pipe, so that the cost of event delivery can be measured as a function of the number
+ * of registered (mostly idle) file descriptors and of the number of threads waiting for events.
+ * With -x, each thread has its own epoll instance, where all pipes are registered with
+ * EPOLLEXCLUSIVE; otherwise, all threads share a single epoll instance.
+ * Usage: epoll_bench [-n pipes] [-a active pipes] [-t threads] [-i events] [-e] [-x]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define EPOLL_BENCH_MAX_THREADS 64
+#define EPOLL_BENCH_MAX_EVENTS  64
+
+static int npipes = 4096;
+static int nactive = 64;
+static int nthreads = 4;
+static uint64_t nevents = 1000000;
+static int edge;
+static int exclusive;
+
+static int (*pipes)[2];
+static int epfds[EPOLL_BENCH_MAX_THREADS];
+static uint64_t received;
+static uint64_t spurious;
+static volatile int done;
+static pthread_barrier_t barrier;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void *worker(void *arg)
+{
+    int epfd = epfds[exclusive ? (long)arg : 0];
+    struct epoll_event events[EPOLL_BENCH_MAX_EVENTS];
+    char token;
+
+    pthread_barrier_wait(&barrier);
+    while (!done) {
+        int n = epoll_wait(epfd, events, EPOLL_BENCH_MAX_EVENTS, 100);
+        test_assert(n >= 0);
+        for (int i = 0; i < n; i++) {
+            int *p = pipes[events[i].data.u32];
+
+            /* with level-triggered events, another thread may have consumed the token already */
+            if (read(p[0], &token, 1) != 1) {
+                test_assert(errno == EAGAIN);
+                __atomic_add_fetch(&spurious, 1, __ATOMIC_RELAXED);
+                continue;
+            }
+            if (__atomic_add_fetch(&received, 1, __ATOMIC_RELAXED) >= nevents)
+                done = 1;
+            else
+                test_assert(write(p[1], &token, 1) == 1);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[EPOLL_BENCH_MAX_THREADS];
+    struct epoll_event ev;
+    struct rlimit rl;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:a:t:i:ex")) != -1) {
+        switch (opt) {
+        case 'n':
+            npipes = atoi(optarg);
+            break;
+        case 'a':
+            nactive = atoi(optarg);
+            break;
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'i':
+            nevents = strtoull(optarg, NULL, 0);
+            break;
+        case 'e':
+            edge = 1;
+            break;
+        case 'x':
+            exclusive = 1;
+            break;
+        default:
+            printf("Usage: %s [-n pipes] [-a active pipes] [-t threads] [-i events] [-e] [-x]\n",
+                   argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    test_assert((npipes > 0) && (nactive > 0) && (nactive <= npipes));
+    test_assert((nthreads > 0) && (nthreads <= EPOLL_BENCH_MAX_THREADS));
+    printf("%d pipes, %d active, %d threads, %s%s\n", npipes, nactive, nthreads,
+           edge ? "edge-triggered" : "level-triggered",
+           exclusive ? ", per-thread epoll instances with EPOLLEXCLUSIVE" : "");
+
+    /* two descriptors per pipe, plus the epoll instances */
+    test_assert(getrlimit(RLIMIT_NOFILE, &rl) == 0);
+    if (rl.rlim_cur < 2 * npipes + nthreads + 16) {
+        rl.rlim_cur = 2 * npipes + nthreads + 16;
+        if (rl.rlim_max < rl.rlim_cur)
+            rl.rlim_max = rl.rlim_cur;
+        test_assert(setrlimit(RLIMIT_NOFILE, &rl) == 0);
+    }
+
+    pipes = malloc(npipes * sizeof(*pipes));
+    test_assert(pipes != NULL);
+    for (int i = 0; i < (exclusive ? nthreads : 1); i++) {
+        epfds[i] = epoll_create1(0);
+        test_assert(epfds[i] >= 0);
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < npipes; i++) {
+        test_assert(pipe2(pipes[i], O_NONBLOCK) == 0);
+        ev.events = EPOLLIN | (edge ? EPOLLET : 0) | (exclusive ? EPOLLEXCLUSIVE : 0);
+        ev.data.u32 = i;
+        for (int j = 0; j < (exclusive ? nthreads : 1); j++)
+            test_assert(epoll_ctl(epfds[j], EPOLL_CTL_ADD, pipes[i][0], &ev) == 0);
+    }
+    uint64_t ns = now_ns() - start;
+    printf("registration: %lu us, %lu ns per pipe\n", ns / 1000, ns / npipes);
+
+    /* idle wait: no registered descriptor is ready */
+    start = now_ns();
+    for (int i = 0; i < 1000; i++)
+        test_assert(epoll_wait(epfds[0], &ev, 1, 0) == 0);
+    ns = now_ns() - start;
+    printf("idle epoll_wait: %lu ns per call\n", ns / 1000);
+
+    test_assert(pthread_barrier_init(&barrier, NULL, nthreads + 1) == 0);
+    for (long i = 0; i < nthreads; i++)
+        test_assert(pthread_create(&threads[i], NULL, worker, (void *)i) == 0);
+    pthread_barrier_wait(&barrier);
+    start = now_ns();
+    for (int i = 0; i < nactive; i++)
+        test_assert(write(pipes[(uint64_t)i * npipes / nactive][1], "t", 1) == 1);
+    for (int i = 0; i < nthreads; i++)
+        test_assert(pthread_join(threads[i], NULL) == 0);
+    ns = now_ns() - start;
+    test_assert(received >= nevents);
+    printf("%lu events in %lu us, %lu events/s, %lu spurious\n", received, ns / 1000,
+           received * 1000000000ul / ns, spurious);
+
+    for (int i = 0; i < npipes; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
+    for (int i = 0; i < (exclusive ? nthreads : 1); i++)
+        close(epfds[i]);
+    free(pipes);
+    printf("epoll_bench test passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+/* Filesystem throughput benchmark: a number of threads write, sync and read back separate files
+ * concurrently, so that the scalability of the file I/O path can be measured.
+ * Usage: fs_bench [-t threads] [-s file size in KB] [-b block size in KB]
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define FS_BENCH_MAX_THREADS    64
+
+static int nthreads = 4;
+static size_t file_size = 16 * 1024 * 1024;
+static size_t block_size = 64 * 1024;
+static pthread_barrier_t barrier;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void fill_block(uint8_t *buf, int id, size_t block)
+{
+    uint64_t *p = (uint64_t *)buf;
+
+    for (size_t i = 0; i < block_size / sizeof(uint64_t); i++)
+        p[i] = ((uint64_t)id << 48) | (block << 16) | i;
+}
+
+static void *fs_bench_thread(void *arg)
+{
+    int id = (intptr_t)arg;
+    char name[32];
+    uint8_t *buf, *expected;
+    size_t nblocks = file_size / block_size;
+    int fd;
+
+    buf = malloc(block_size);
+    expected = malloc(block_size);
+    test_assert(buf && expected);
+    snprintf(name, sizeof(name), "fs_bench_%d", id);
+    fd = open(name, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    test_assert(fd >= 0);
+
+    pthread_barrier_wait(&barrier);
+    for (size_t b = 0; b < nblocks; b++) {
+        fill_block(buf, id, b);
+        test_assert(pwrite(fd, buf, block_size, b * block_size) == (ssize_t)block_size);
+    }
+    test_assert(fsync(fd) == 0);
+
+    pthread_barrier_wait(&barrier);
+    for (size_t b = 0; b < nblocks; b++) {
+        test_assert(pread(fd, buf, block_size, b * block_size) == (ssize_t)block_size);
+        fill_block(expected, id, b);
+        test_assert(!memcmp(buf, expected, block_size));
+    }
+
+    pthread_barrier_wait(&barrier);
+    close(fd);
+    test_assert(unlink(name) == 0);
+    free(expected);
+    free(buf);
+    return NULL;
+}
+
+static void print_rate(const char *op, uint64_t ns)
+{
+    uint64_t bytes = (uint64_t)nthreads * file_size;
+
+    printf("%s: %lu KB in %lu us, %lu MB/s\n", op, bytes / 1024, ns / 1000,
+           ns ? bytes * 1000000000ul / ns / (1024 * 1024) : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[FS_BENCH_MAX_THREADS];
+    uint64_t start, write_done, read_done;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:s:b:")) != -1) {
+        switch (opt) {
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 's':
+            file_size = strtoul(optarg, NULL, 0) * 1024;
+            break;
+        case 'b':
+            block_size = strtoul(optarg, NULL, 0) * 1024;
+            break;
+        default:
+            printf("Usage: %s [-t threads] [-s file size in KB] [-b block size in KB]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    test_assert(nthreads > 0 && nthreads <= FS_BENCH_MAX_THREADS);
+    test_assert(block_size > 0 && (block_size % sizeof(uint64_t)) == 0);
+    test_assert(file_size >= block_size && (file_size % block_size) == 0);
+    printf("%d threads, file size %lu KB, block size %lu KB\n", nthreads, file_size / 1024,
+           block_size / 1024);
+
+    test_assert(pthread_barrier_init(&barrier, NULL, nthreads + 1) == 0);
+    for (int i = 0; i < nthreads; i++)
+        test_assert(pthread_create(&threads[i], NULL, fs_bench_thread, (void *)(intptr_t)i) == 0);
+    pthread_barrier_wait(&barrier);
+    start = now_ns();
+    pthread_barrier_wait(&barrier);
+    write_done = now_ns();
+    pthread_barrier_wait(&barrier);
+    read_done = now_ns();
+    for (int i = 0; i < nthreads; i++)
+        test_assert(pthread_join(threads[i], NULL) == 0);
+    pthread_barrier_destroy(&barrier);
+
+    print_rate("write", write_done - start);
+    print_rate("read", read_done - write_done);
+    printf("fs_bench test passed\n");
+    return EXIT_SUCCESS;
+}
@@ -8,6 +8,7 @@
 #include <limits.h>
 #include <time.h>
 #include <errno.h>
+#include <stdint.h>
 
 #define EXIT_FAILURE 1
 #define EXIT_SUCCESS 0
@@ -27,6 +28,23 @@ int cmp_requeue_test_futex_1 = FUTEX_INITIALIZER;
 int cmp_requeue_test_futex_2 = FUTEX_INITIALIZER;
 int wake_op_test_futex_1 = FUTEX_INITIALIZER;
 int wake_op_test_futex_2 = FUTEX_INITIALIZER;
+int wake_bitset_test_futex = FUTEX_INITIALIZER;
+int waitv_test_futex_1 = FUTEX_INITIALIZER;
+int waitv_test_futex_2 = FUTEX_INITIALIZER;
+int pi_test_futex = 0;
+int requeue_pi_test_futex = FUTEX_INITIALIZER;
+
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449
+#endif
+#define FUTEX_32    2
+
+struct futex_waitv_test {
+    uint64_t val;
+    uint64_t uaddr;
+    uint32_t flags;
+    uint32_t __reserved;
+};
 
 /* Helper Thread Function Declarations */
 static void *futex_wake_test_thread(void *arg);
@@ -334,6 +352,192 @@ static void *futex_wake_op_test_thread(void *arg)
 } 
 
 /* Method to run all tests */
+static void *futex_wake_bitset_test_thread(void *arg)
+{
+    int bitset = (long)arg;
+    struct timespec timeout;
+
+    clock_gettime(CLOCK_MONOTONIC, &timeout);
+    timeout.tv_sec += 2;
+    return (void *)(long)syscall(SYS_futex, &wake_bitset_test_futex, FUTEX_WAIT_BITSET,
+                                 FUTEX_INITIALIZER, &timeout, NULL, bitset);
+}
+
+/* FUTEX_WAKE_BITSET test: only the waiters whose bitset intersects
+the wake bitset are woken */
+static boolean futex_wake_bitset_test()
+{
+    pthread_t threads[2];
+    void *retval;
+    boolean passed = true;
+
+    for (long i = 0; i < 2; i++) {
+        if (pthread_create(&threads[i], NULL, futex_wake_bitset_test_thread, (void *)(1l << i))) {
+            printf("Unable to create thread.\n");
+            return false;
+        }
+    }
+    usleep(200000);
+    if (syscall(SYS_futex, &wake_bitset_test_futex, FUTEX_WAKE_BITSET, INT_MAX, 0, NULL, 2) != 1)
+        passed = false;
+    for (int i = 0; i < 2; i++) {
+        if (pthread_join(threads[i], &retval) != 0)
+            return false;
+        /* the first thread times out, the second is woken */
+        if ((long)retval != ((i == 0) ? -1 : 0))
+            passed = false;
+    }
+    if (syscall(SYS_futex, &wake_bitset_test_futex, FUTEX_WAKE_BITSET, 1, 0, NULL, 0) != -1 ||
+        errno != EINVAL)
+        passed = false;
+    printf("wake_bitset test: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
+static void *futex_waitv_test_thread(void *arg)
+{
+    usleep(200000);
+    waitv_test_futex_2 = 1;
+    syscall(SYS_futex, &waitv_test_futex_2, FUTEX_WAKE, 1, 0, NULL, 0);
+    return NULL;
+}
+
+/* futex_waitv tests: value mismatch, timeout, and wakeup of the second futex */
+static boolean futex_waitv_test()
+{
+    struct futex_waitv_test waiters[2] = {
+        { .val = FUTEX_INITIALIZER, .uaddr = (uintptr_t)&waitv_test_futex_1, .flags = FUTEX_32 },
+        { .val = FUTEX_INITIALIZER, .uaddr = (uintptr_t)&waitv_test_futex_2, .flags = FUTEX_32 },
+    };
+    struct timespec timeout;
+    pthread_t thread;
+    boolean passed = true;
+    int ret;
+
+    waiters[1].val = 20;
+    ret = syscall(SYS_futex_waitv, waiters, 2, 0, NULL, CLOCK_MONOTONIC);
+    if ((ret != -1) || (errno != EAGAIN))
+        passed = false;
+    waiters[1].val = FUTEX_INITIALIZER;
+    waiters[0].flags = 0;
+    ret = syscall(SYS_futex_waitv, waiters, 2, 0, NULL, CLOCK_MONOTONIC);
+    if ((ret != -1) || (errno != EINVAL))
+        passed = false;
+    waiters[0].flags = FUTEX_32;
+
+    clock_gettime(CLOCK_MONOTONIC, &timeout);
+    timeout.tv_nsec += 100000000;
+    if (timeout.tv_nsec >= 1000000000) {
+        timeout.tv_sec++;
+        timeout.tv_nsec -= 1000000000;
+    }
+    ret = syscall(SYS_futex_waitv, waiters, 2, 0, &timeout, CLOCK_MONOTONIC);
+    if ((ret != -1) || (errno != ETIMEDOUT))
+        passed = false;
+
+    if (pthread_create(&thread, NULL, futex_waitv_test_thread, NULL)) {
+        printf("Unable to create thread.\n");
+        return false;
+    }
+    ret = syscall(SYS_futex_waitv, waiters, 2, 0, NULL, CLOCK_MONOTONIC);
+    if (ret != 1)
+        passed = false;
+    if (pthread_join(thread, NULL) != 0)
+        return false;
+    printf("waitv test: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
+static void *futex_pi_test_thread(void *arg)
+{
+    int tid = syscall(SYS_gettid);
+
+    /* blocks until the lock is handed over by the main thread */
+    if (syscall(SYS_futex, &pi_test_futex, FUTEX_LOCK_PI, 0, NULL, NULL, 0) != 0)
+        return (void *)1;
+    if ((pi_test_futex & FUTEX_TID_MASK) != tid)
+        return (void *)2;
+    if (syscall(SYS_futex, &pi_test_futex, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0) != 0)
+        return (void *)3;
+    return NULL;
+}
+
+/* PI futex test: ownership, error cases and handoff of the lock to a waiter */
+static boolean futex_pi_test()
+{
+    int tid = syscall(SYS_gettid);
+    pthread_t thread;
+    void *retval;
+    boolean passed = true;
+
+    if ((syscall(SYS_futex, &pi_test_futex, FUTEX_LOCK_PI, 0, NULL, NULL, 0) != 0) ||
+        (pi_test_futex != tid))
+        passed = false;
+    if ((syscall(SYS_futex, &pi_test_futex, FUTEX_TRYLOCK_PI, 0, NULL, NULL, 0) != -1) ||
+        (errno != EDEADLK))
+        passed = false;
+    if (pthread_create(&thread, NULL, futex_pi_test_thread, NULL)) {
+        printf("Unable to create thread.\n");
+        return false;
+    }
+    usleep(200000);
+    if (pi_test_futex != (tid | FUTEX_WAITERS))
+        passed = false;
+    if (syscall(SYS_futex, &pi_test_futex, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0) != 0)
+        passed = false;
+    if ((pthread_join(thread, &retval) != 0) || retval)
+        passed = false;
+    if (pi_test_futex != 0)
+        passed = false;
+    if ((syscall(SYS_futex, &pi_test_futex, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0) != -1) ||
+        (errno != EPERM))
+        passed = false;
+    printf("pi test: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
+static void *futex_requeue_pi_test_thread(void *arg)
+{
+    int tid = syscall(SYS_gettid);
+
+    if (syscall(SYS_futex, &requeue_pi_test_futex, FUTEX_WAIT_REQUEUE_PI, FUTEX_INITIALIZER, NULL,
+                &pi_test_futex, 0) != 0)
+        return (void *)1;
+    if ((pi_test_futex & FUTEX_TID_MASK) != tid)
+        return (void *)2;
+    if (syscall(SYS_futex, &pi_test_futex, FUTEX_UNLOCK_PI, 0, NULL, NULL, 0) != 0)
+        return (void *)3;
+    return NULL;
+}
+
+/* FUTEX_CMP_REQUEUE_PI test: the PI futex is acquired on behalf of the waiter */
+static boolean futex_requeue_pi_test()
+{
+    pthread_t thread;
+    void *retval;
+    boolean passed = true;
+
+    if (pthread_create(&thread, NULL, futex_requeue_pi_test_thread, NULL)) {
+        printf("Unable to create thread.\n");
+        return false;
+    }
+    usleep(200000);
+
+    /* a FUTEX_WAIT_REQUEUE_PI waiter cannot be requeued by a non-PI requeue */
+    if ((syscall(SYS_futex, &requeue_pi_test_futex, FUTEX_CMP_REQUEUE, 0, 1, &pi_test_futex,
+                 FUTEX_INITIALIZER) != -1) || (errno != EINVAL))
+        passed = false;
+    if (syscall(SYS_futex, &requeue_pi_test_futex, FUTEX_CMP_REQUEUE_PI, 1, 0, &pi_test_futex,
+                FUTEX_INITIALIZER) != 1)
+        passed = false;
+    if ((pthread_join(thread, &retval) != 0) || retval)
+        passed = false;
+    if (pi_test_futex != 0)
+        passed = false;
+    printf("requeue_pi test: %s\n", passed ? "passed" : "failed");
+    return passed;
+}
+
 boolean basic_test() 
 {
     int num_failed = 0;
@@ -389,6 +593,20 @@ boolean basic_test()
 
     /* Wake_Op Tests: pass in true to wake up threads 
     waiting on uaddr2 or false otherwise */
+    printf("---FUTEX_WAKE_BITSET TESTS--- \n");
+    if (!futex_wake_bitset_test())
+        num_failed++;
+
+    printf("---FUTEX_WAITV TESTS--- \n");
+    if (!futex_waitv_test())
+        num_failed++;
+
+    printf("---FUTEX PI TESTS--- \n");
+    if (!futex_pi_test())
+        num_failed++;
+    if (!futex_requeue_pi_test())
+        num_failed++;
+
     printf("---FUTEX_WAKE_OP TESTS--- \n");
     if (!futex_wake_op_test(true)) {
         num_failed++;
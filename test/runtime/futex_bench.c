@@ -0,0 +1,137 @@
+/* Contended mutex benchmark: threads repeatedly acquire and release futex-based mutexes, so that
+ * the scalability of futex waits and wakeups can be measured. With more than one mutex, threads
+ * are spread over the mutexes, each mutex being shared by a group of threads.
+ * Usage: futex_bench [-t threads] [-m mutexes] [-i iterations per thread] [-w work per iteration]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define FUTEX_BENCH_MAX_THREADS 64
+
+/* mutex states: 0 unlocked, 1 locked, 2 locked with (possible) waiters */
+struct bench_mutex {
+    int state;
+    uint64_t count;
+} __attribute__((aligned(64)));
+
+static int nthreads = 4;
+static int nmutexes = 1;
+static long iterations = 100000;
+static int work = 100;
+static struct bench_mutex mutexes[FUTEX_BENCH_MAX_THREADS];
+static uint64_t futex_waits, futex_wakes;
+static pthread_barrier_t barrier;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void mutex_lock(struct bench_mutex *m, uint64_t *waits)
+{
+    int c = 0;
+
+    if (__atomic_compare_exchange_n(&m->state, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        return;
+    if (c != 2)
+        c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+        int rv = syscall(SYS_futex, &m->state, FUTEX_WAIT_PRIVATE, 2, NULL, NULL, 0);
+        test_assert((rv == 0) || (errno == EAGAIN) || (errno == EINTR));
+        (*waits)++;
+        c = __atomic_exchange_n(&m->state, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+static void mutex_unlock(struct bench_mutex *m, uint64_t *wakes)
+{
+    if (__atomic_exchange_n(&m->state, 0, __ATOMIC_RELEASE) == 2) {
+        test_assert(syscall(SYS_futex, &m->state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0) >= 0);
+        (*wakes)++;
+    }
+}
+
+static void *worker(void *arg)
+{
+    struct bench_mutex *m = &mutexes[(long)arg % nmutexes];
+    uint64_t waits = 0, wakes = 0;
+
+    pthread_barrier_wait(&barrier);
+    for (long i = 0; i < iterations; i++) {
+        mutex_lock(m, &waits);
+        for (volatile int j = 0; j < work; j++);
+        m->count++;
+        mutex_unlock(m, &wakes);
+    }
+    __atomic_add_fetch(&futex_waits, waits, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&futex_wakes, wakes, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[FUTEX_BENCH_MAX_THREADS];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:m:i:w:")) != -1) {
+        switch (opt) {
+        case 't':
+            nthreads = atoi(optarg);
+            break;
+        case 'm':
+            nmutexes = atoi(optarg);
+            break;
+        case 'i':
+            iterations = atol(optarg);
+            break;
+        case 'w':
+            work = atoi(optarg);
+            break;
+        default:
+            printf("Usage: %s [-t threads] [-m mutexes] [-i iterations per thread] "
+                   "[-w work per iteration]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    test_assert((nthreads > 0) && (nthreads <= FUTEX_BENCH_MAX_THREADS));
+    test_assert((nmutexes > 0) && (nmutexes <= nthreads));
+    test_assert(iterations > 0);
+    printf("%d threads, %d mutexes, %ld iterations per thread, work %d\n", nthreads, nmutexes,
+           iterations, work);
+
+    test_assert(pthread_barrier_init(&barrier, NULL, nthreads + 1) == 0);
+    for (long i = 0; i < nthreads; i++)
+        test_assert(pthread_create(&threads[i], NULL, worker, (void *)i) == 0);
+    pthread_barrier_wait(&barrier);
+    uint64_t start = now_ns();
+    for (int i = 0; i < nthreads; i++)
+        test_assert(pthread_join(threads[i], NULL) == 0);
+    uint64_t ns = now_ns() - start;
+
+    uint64_t total = 0;
+    for (int i = 0; i < nmutexes; i++)
+        total += mutexes[i].count;
+    test_assert(total == (uint64_t)nthreads * iterations);
+    printf("%lu lock/unlock pairs in %lu us, %lu per second, %lu futex waits, %lu futex wakes\n",
+           total, ns / 1000, total * 1000000000ul / ns, futex_waits, futex_wakes);
+    printf("futex_bench test passed\n");
+    return EXIT_SUCCESS;
+}
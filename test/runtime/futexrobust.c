@@ -6,7 +6,7 @@
 #include <stdint.h>
 #include <errno.h>
 
-pthread_mutex_t mut, mut2;
+pthread_mutex_t mut, mut2, mut_pi;
 uint32_t val;
 
 #define INCS 1000
@@ -75,6 +75,13 @@ worker2(void *v)
     return NULL;
 }
 
+void *
+worker_pi(void *v)
+{
+    acquire_mutex(&mut_pi);
+    return NULL;    /* exit with the mutex held */
+}
+
 int
 main(int argc, char **argv)
 {
@@ -111,5 +118,18 @@ main(int argc, char **argv)
         pthread_join(threads[0], NULL);
         pthread_join(threads[1], NULL);
     }
+
+    printf("\n*** test: exit with PI mutex held and no waiters ***\n");
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&mut_pi, &attr);
+    pthread_create(&threads[0], NULL, worker_pi, NULL);
+    pthread_join(threads[0], NULL);
+    int err = pthread_mutex_lock(&mut_pi);
+    if (err != EOWNERDEAD) {
+        printf("PI mutex lock after owner exit returned %d, expected EOWNERDEAD\n", err);
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_consistent(&mut_pi);
+    pthread_mutex_unlock(&mut_pi);
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
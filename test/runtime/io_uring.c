@@ -9,6 +9,7 @@
 #include <string.h>
 #include <sys/eventfd.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/uio.h>
 #include <time.h>
@@ -26,6 +27,9 @@
 #define SYS_io_uring_register   427
 #endif
 
+#define IORING_SETUP_IOPOLL     (1 << 0)
+#define IORING_SETUP_SQPOLL     (1 << 1)
+#define IORING_SETUP_SQ_AFF     (1 << 2)
 #define IORING_SETUP_CQSIZE     (1 << 3)
 
 #define IO_URING_OP_SUPPORTED   (1 << 0)
@@ -90,7 +94,10 @@ struct io_uring_sqe {
     uint32_t user_data;
     union {
         struct {
-            uint16_t buf_index;
+            union {
+                uint16_t buf_index;
+                uint16_t buf_group;
+            };
             uint16_t personality;
         };
         uint64_t __pad2[3];
@@ -149,15 +156,54 @@ enum {
     IORING_OP_STATX,
     IORING_OP_READ,
     IORING_OP_WRITE,
+    IORING_OP_FADVISE,
+    IORING_OP_MADVISE,
+    IORING_OP_SEND,
+    IORING_OP_RECV,
+    IORING_OP_OPENAT2,
+    IORING_OP_EPOLL_CTL,
+    IORING_OP_SPLICE,
+    IORING_OP_PROVIDE_BUFFERS,
+    IORING_OP_REMOVE_BUFFERS,
+};
+
+struct io_uring_buf {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t bid;
+    uint16_t resv;
+};
+
+struct io_uring_buf_reg {
+    uint64_t ring_addr;
+    uint32_t ring_entries;
+    uint16_t bgid;
+    uint16_t flags;
+    uint64_t resv[3];
 };
 
 #define IORING_FEAT_SINGLE_MMAP (1 << 0)
 
-#define IOSQE_FIXED_FILE    (1 << 0)
+#define IOSQE_FIXED_FILE        (1 << 0)
+#define IOSQE_IO_DRAIN          (1 << 1)
+#define IOSQE_IO_LINK           (1 << 2)
+#define IOSQE_IO_HARDLINK       (1 << 3)
+#define IOSQE_BUFFER_SELECT     (1 << 5)
+#define IOSQE_CQE_SKIP_SUCCESS  (1 << 6)
+
+#define IORING_CQE_F_BUFFER     (1 << 0)
+#define IORING_CQE_F_MORE       (1 << 1)
+#define IORING_CQE_BUFFER_SHIFT 16
+
+#define IORING_POLL_ADD_MULTI   (1 << 0)
+#define IORING_RECV_MULTISHOT   (1 << 1)
 
 #define IORING_TIMEOUT_ABS  (1 << 0)
 
 #define IORING_ENTER_GETEVENTS  (1 << 0)
+#define IORING_ENTER_SQ_WAKEUP  (1 << 1)
+
+#define IORING_SQ_NEED_WAKEUP   (1 << 0)
 
 #define IORING_REGISTER_BUFFERS         0
 #define IORING_UNREGISTER_BUFFERS       1
@@ -168,6 +214,8 @@ enum {
 #define IORING_REGISTER_FILES_UPDATE    6
 #define IORING_REGISTER_EVENTFD_ASYNC   7
 #define IORING_REGISTER_PROBE           8
+#define IORING_REGISTER_PBUF_RING       22
+#define IORING_UNREGISTER_PBUF_RING     23
 
 #define BUF_SIZE        8192
 
@@ -394,6 +442,69 @@ static void iour_setup_write(struct iour *iour, int fd, uint8_t *buf,
         user_data);
 }
 
+/* Sets the flags of the last queued submission entry. */
+static void iour_set_sqe_flags(struct iour *iour, uint8_t flags)
+{
+    struct io_uring_sqe *sqe =
+            &iour->sqes[iour->sq_array[(*iour->sq_tail - 1) & iour->sq_mask]];
+
+    sqe->flags = flags;
+}
+
+static void iour_setup_provide_buffers(struct iour *iour, uint8_t *addr,
+                                       uint32_t len, int nbufs, uint16_t bgid,
+                                       uint16_t bid, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = iour_get_sqe(iour);
+
+    test_assert(sqe);
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = nbufs;
+    sqe->addr = (uint64_t)addr;
+    sqe->len = len;
+    sqe->off = bid;
+    sqe->buf_group = bgid;
+    sqe->user_data = user_data;
+    write_barrier();
+    (*iour->sq_tail)++;
+}
+
+static void iour_setup_remove_buffers(struct iour *iour, int nbufs,
+                                      uint16_t bgid, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = iour_get_sqe(iour);
+
+    test_assert(sqe);
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_REMOVE_BUFFERS;
+    sqe->fd = nbufs;
+    sqe->buf_group = bgid;
+    sqe->user_data = user_data;
+    write_barrier();
+    (*iour->sq_tail)++;
+}
+
+/* Sets up a read or receive operation with a buffer selected from a group. */
+static void iour_setup_buf_select(struct iour *iour, uint8_t opcode, int fd,
+                                  uint32_t len, uint16_t bgid, uint16_t ioprio,
+                                  uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = iour_get_sqe(iour);
+
+    test_assert(sqe);
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->ioprio = ioprio;
+    sqe->fd = fd;
+    sqe->len = len;
+    sqe->buf_group = bgid;
+    sqe->user_data = user_data;
+    write_barrier();
+    (*iour->sq_tail)++;
+}
+
 static int iour_submit(struct iour *iour, unsigned int count,
                        unsigned int min_complete)
 {
@@ -911,6 +1022,141 @@ static void iour_test_rw_fixed(void)
     test_assert(close(fd) == 0);
 }
 
+/* Fixed reads and writes of whole blocks with a registered buffer in anonymous memory transfer
+ * data directly between the buffer and storage; check that they are coherent with buffered I/O. */
+static void iour_test_rw_fixed_direct(void)
+{
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t buf_size = 4 * page_size;
+    const size_t file_size = 2 * page_size;
+    int fd;
+    struct iour iour;
+    uint8_t *buf, *tmp;
+    struct iovec iov;
+    struct io_uring_cqe *cqe;
+
+    fd = open("file_rw_fixed_direct", O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+    test_assert(fd > 0);
+    buf = mmap(NULL, buf_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    test_assert(buf != MAP_FAILED);
+    tmp = malloc(buf_size);
+    test_assert(tmp);
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    test_assert(iour_init(&iour, 1) == 0);
+    iov.iov_base = buf;
+    iov.iov_len = buf_size;
+    test_assert(syscall(SYS_io_uring_register, iour.fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+    for (int i = 0; i < file_size; i++)
+        buf[i] = i;
+    iour_setup_rw_fixed(&iour, fd, 0, true, buf, file_size, 0, 0);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == file_size));
+    test_assert(pread(fd, tmp, buf_size, 0) == file_size);
+    test_assert(!memcmp(tmp, buf, file_size));
+
+    /* direct write over cached data */
+    for (int i = 0; i < file_size; i++)
+        buf[i] = ~i;
+    iour_setup_rw_fixed(&iour, fd, 0, true, buf, file_size, 0, 0);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == file_size));
+    test_assert(pread(fd, tmp, file_size, 0) == file_size);
+    test_assert(!memcmp(tmp, buf, file_size));
+
+    /* direct read after a buffered write, clamped to the file size */
+    memset(tmp, 0x5a, 100);
+    test_assert(pwrite(fd, tmp, 100, page_size + 1) == 100);
+    memset(buf, 0, buf_size);
+    iour_setup_rw_fixed(&iour, fd, 0, false, buf, buf_size, 0, 0);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == file_size));
+    for (int i = 0; i < file_size; i++)
+        test_assert(buf[i] == (((i > page_size) && (i <= page_size + 100)) ? 0x5a :
+                               (uint8_t)~i));
+    iour_setup_rw_fixed(&iour, fd, 0, false, buf, page_size, file_size, 0);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == 0));
+
+    /* unaligned transfers go through the page cache */
+    iour_setup_rw_fixed(&iour, fd, 0, false, buf + 1, 100, page_size + 1, 0);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == 100));
+    for (int i = 1; i <= 100; i++)
+        test_assert(buf[i] == 0x5a);
+
+    /* unmapping a registered buffer does not affect the registration */
+    test_assert(munmap(buf, buf_size) == 0);
+    test_assert(syscall(SYS_io_uring_register, iour.fd, IORING_UNREGISTER_BUFFERS, NULL, 0) == 0);
+
+    test_assert(iour_exit(&iour) == 0);
+    free(tmp);
+    test_assert(close(fd) == 0);
+}
+
+/* Many concurrent direct transfers keep more block requests in flight than fit in the storage
+ * driver request pool, so that the pool is refilled and its requests are recycled. */
+static void iour_test_rw_fixed_direct_batch(void)
+{
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const int req_count = 256;
+    const size_t file_size = req_count * page_size;
+    int fd;
+    struct iour iour;
+    uint8_t *buf, *read_buf;
+    struct iovec iov;
+    struct io_uring_cqe *cqe;
+
+    fd = open("file_rw_fixed_direct_batch", O_RDWR | O_CREAT | O_TRUNC, S_IRWXU);
+    test_assert(fd > 0);
+    test_assert(ftruncate(fd, file_size) == 0);
+    buf = mmap(NULL, 2 * file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    test_assert(buf != MAP_FAILED);
+    read_buf = buf + file_size;
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    test_assert(iour_init(&iour, req_count) == 0);
+    iov.iov_base = buf;
+    iov.iov_len = 2 * file_size;
+    test_assert(syscall(SYS_io_uring_register, iour.fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < req_count; i++) {
+            memset(buf + i * page_size, i + round, page_size);
+            iour_setup_rw_fixed(&iour, fd, 0, true, buf + i * page_size, page_size,
+                                i * page_size, i);
+        }
+        test_assert(iour_submit(&iour, req_count, req_count) == req_count);
+        for (int i = 0; i < req_count; i++) {
+            cqe = iour_get_cqe(&iour);
+            test_assert(cqe && (cqe->res == page_size));
+            test_assert(cqe->user_data < req_count);
+        }
+        memset(read_buf, 0, file_size);
+        for (int i = 0; i < req_count; i++)
+            iour_setup_rw_fixed(&iour, fd, 0, false, read_buf + i * page_size, page_size,
+                                i * page_size, i);
+        test_assert(iour_submit(&iour, req_count, req_count) == req_count);
+        for (int i = 0; i < req_count; i++) {
+            cqe = iour_get_cqe(&iour);
+            test_assert(cqe && (cqe->res == page_size));
+        }
+        for (int i = 0; i < file_size; i++)
+            test_assert(read_buf[i] == (uint8_t)(i / page_size + round));
+    }
+
+    test_assert(syscall(SYS_io_uring_register, iour.fd, IORING_UNREGISTER_BUFFERS, NULL, 0) == 0);
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(munmap(buf, 2 * file_size) == 0);
+    test_assert(close(fd) == 0);
+}
+
 static void iour_test_poll(void)
 {
     struct iour iour;
@@ -1202,6 +1448,387 @@ static void iour_test_register_files(void)
     test_assert(iour_exit(&iour) == 0);
 }
 
+/* Waits for a completion without entering the kernel. */
+static struct io_uring_cqe *iour_wait_cqe(struct iour *iour)
+{
+    struct io_uring_cqe *cqe;
+
+    for (int i = 0; i < 10000; i++) {
+        cqe = iour_get_cqe(iour);
+        if (cqe)
+            return cqe;
+        usleep(1000);
+    }
+    return NULL;
+}
+
+static void iour_test_sqpoll(void)
+{
+    struct iour iour;
+    struct io_uring_params params;
+    uint8_t read_buf[BUF_SIZE], write_buf[BUF_SIZE];
+    uint32_t *sq_flags;
+    struct io_uring_cqe *cqe;
+    int fd;
+
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SQ_AFF;
+    test_assert(syscall(SYS_io_uring_setup, 1, &params) == -1);
+    test_assert(errno == EINVAL);
+    params.flags = IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF;
+    params.sq_thread_cpu = -1;
+    test_assert(syscall(SYS_io_uring_setup, 1, &params) == -1);
+    test_assert(errno == EINVAL);
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    iour.params.flags = IORING_SETUP_SQPOLL | IORING_SETUP_SQ_AFF;
+    iour.params.sq_thread_cpu = 0;
+    iour.params.sq_thread_idle = 10;
+    test_assert(iour_init(&iour, 2) == 0);
+    sq_flags = (uint32_t *)(iour.rings + iour.params.sq_off.flags);
+
+    /* Submission queue entries are consumed without calling io_uring_enter. */
+    fd = open("file_sqpoll", O_RDWR | O_CREAT, S_IRWXU);
+    test_assert(fd > 0);
+    for (int i = 0; i < BUF_SIZE; i++)
+        write_buf[i] = i & 0xFF;
+    iour_setup_write(&iour, fd, write_buf, BUF_SIZE, 0, 1);
+    cqe = iour_wait_cqe(&iour);
+    test_assert(cqe && (cqe->res == BUF_SIZE) && (cqe->user_data == 1));
+    iour_setup_read(&iour, fd, read_buf, BUF_SIZE, 0, 2);
+    cqe = iour_wait_cqe(&iour);
+    test_assert(cqe && (cqe->res == BUF_SIZE) && (cqe->user_data == 2));
+    for (int i = 0; i < BUF_SIZE; i++)
+        test_assert(read_buf[i] == (i & 0xFF));
+
+    /* Once idle, the poller must be woken up to process new entries. */
+    for (int i = 0; !(*(volatile uint32_t *)sq_flags & IORING_SQ_NEED_WAKEUP); i++) {
+        test_assert(i < 1000);
+        usleep(1000);
+    }
+    iour_setup_nop(&iour, 3);
+    test_assert(syscall(SYS_io_uring_enter, iour.fd, 1, 1,
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_SQ_WAKEUP, NULL) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == 0) && (cqe->user_data == 3));
+
+    /* Close with an operation possibly still pending. */
+    iour_setup_read(&iour, fd, read_buf, BUF_SIZE, 0, 4);
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(unlink("file_sqpoll") == 0);
+}
+
+static void iour_test_iopoll(void)
+{
+    struct iour iour;
+    uint8_t read_buf[BUF_SIZE], write_buf[BUF_SIZE];
+    struct io_uring_cqe *cqe;
+    int fd, pipe_fds[2];
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    iour.params.flags = IORING_SETUP_IOPOLL;
+    test_assert(iour_init(&iour, 1) == 0);
+
+    fd = open("file_iopoll", O_RDWR | O_CREAT, S_IRWXU);
+    test_assert(fd > 0);
+    for (int i = 0; i < BUF_SIZE; i++)
+        write_buf[i] = ~i & 0xFF;
+    iour_setup_write(&iour, fd, write_buf, BUF_SIZE, 0, 1);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == BUF_SIZE) && (cqe->user_data == 1));
+    iour_setup_read(&iour, fd, read_buf, BUF_SIZE, 0, 2);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == BUF_SIZE) && (cqe->user_data == 2));
+    for (int i = 0; i < BUF_SIZE; i++)
+        test_assert(read_buf[i] == (~i & 0xFF));
+
+    /* Polled rings only support I/O on regular files. */
+    iour_setup_poll_add(&iour, fd, POLLIN, 3);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == -EINVAL) && (cqe->user_data == 3));
+    test_assert(pipe(pipe_fds) == 0);
+    iour_setup_read(&iour, pipe_fds[0], read_buf, BUF_SIZE, 0, 4);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->res == -EOPNOTSUPP) && (cqe->user_data == 4));
+    test_assert(close(pipe_fds[0]) == 0);
+    test_assert(close(pipe_fds[1]) == 0);
+
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(unlink("file_iopoll") == 0);
+}
+
+static void iour_test_link(void)
+{
+    struct iour iour;
+    uint8_t read_buf[BUF_SIZE], write_buf[BUF_SIZE];
+    struct io_uring_cqe *cqe;
+    int fd;
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    test_assert(iour_init(&iour, 4) == 0);
+    fd = open("file_link", O_RDWR | O_CREAT, S_IRWXU);
+    test_assert(fd > 0);
+
+    /* Each operation in a chain starts after the previous one completes. */
+    for (int i = 0; i < BUF_SIZE; i++)
+        write_buf[i] = (i >> 3) & 0xFF;
+    iour_setup_write(&iour, fd, write_buf, BUF_SIZE, 0, 1);
+    iour_set_sqe_flags(&iour, IOSQE_IO_LINK);
+    iour_setup_read(&iour, fd, read_buf, BUF_SIZE, 0, 2);
+    iour_set_sqe_flags(&iour, IOSQE_IO_LINK);
+    iour_setup_nop(&iour, 3);
+    test_assert(iour_submit(&iour, 3, 3) == 3);
+    for (int i = 1; i <= 3; i++) {
+        cqe = iour_get_cqe(&iour);
+        test_assert(cqe && (cqe->user_data == i));
+        test_assert(cqe->res == ((i < 3) ? BUF_SIZE : 0));
+    }
+    for (int i = 0; i < BUF_SIZE; i++)
+        test_assert(read_buf[i] == ((i >> 3) & 0xFF));
+
+    /* A failed operation cancels the rest of the chain. */
+    iour_setup_write(&iour, -1, write_buf, BUF_SIZE, 0, 4);
+    iour_set_sqe_flags(&iour, IOSQE_IO_LINK);
+    iour_setup_nop(&iour, 5);
+    iour_set_sqe_flags(&iour, IOSQE_IO_LINK);
+    iour_setup_nop(&iour, 6);
+    test_assert(iour_submit(&iour, 3, 3) == 3);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 4) && (cqe->res == -EBADF));
+    for (int i = 5; i <= 6; i++) {
+        cqe = iour_get_cqe(&iour);
+        test_assert(cqe && (cqe->user_data == i) && (cqe->res == -ECANCELED));
+    }
+
+    /* A short read breaks a chain. */
+    iour_setup_read(&iour, fd, read_buf, BUF_SIZE, BUF_SIZE / 2, 7);
+    iour_set_sqe_flags(&iour, IOSQE_IO_LINK);
+    iour_setup_nop(&iour, 8);
+    test_assert(iour_submit(&iour, 2, 2) == 2);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 7) && (cqe->res == BUF_SIZE / 2));
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 8) && (cqe->res == -ECANCELED));
+
+    /* Hard links are not broken by failures. */
+    iour_setup_write(&iour, -1, write_buf, BUF_SIZE, 0, 9);
+    iour_set_sqe_flags(&iour, IOSQE_IO_HARDLINK);
+    iour_setup_nop(&iour, 10);
+    test_assert(iour_submit(&iour, 2, 2) == 2);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 9) && (cqe->res == -EBADF));
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 10) && (cqe->res == 0));
+
+    /* Successful operations may be completed without posting an entry. */
+    iour_setup_nop(&iour, 11);
+    iour_set_sqe_flags(&iour, IOSQE_CQE_SKIP_SUCCESS);
+    iour_setup_write(&iour, -1, write_buf, BUF_SIZE, 0, 12);
+    iour_set_sqe_flags(&iour, IOSQE_CQE_SKIP_SUCCESS);
+    iour_setup_nop(&iour, 13);
+    test_assert(iour_submit(&iour, 3, 2) == 3);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 12) && (cqe->res == -EBADF));
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 13) && (cqe->res == 0));
+    test_assert(iour_get_cqe(&iour) == NULL);
+
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(unlink("file_link") == 0);
+}
+
+static void iour_test_drain(void)
+{
+    struct iour iour;
+    int pipe_fds[2];
+    uint8_t pipe_buf[8];
+    struct io_uring_cqe *cqe;
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    test_assert(iour_init(&iour, 4) == 0);
+    test_assert(pipe(pipe_fds) == 0);
+
+    /* A drained operation waits for all previously submitted operations,
+     * and subsequent operations wait for the drained operation. */
+    iour_setup_poll_add(&iour, pipe_fds[0], POLLIN, 1);
+    iour_setup_nop(&iour, 2);
+    iour_set_sqe_flags(&iour, IOSQE_IO_DRAIN);
+    iour_setup_nop(&iour, 3);
+    test_assert(iour_submit(&iour, 3, 0) == 3);
+    usleep(1000);
+    test_assert(iour_get_cqe(&iour) == NULL);
+    test_assert(write(pipe_fds[1], pipe_buf, sizeof(pipe_buf)) ==
+            sizeof(pipe_buf));
+    for (int i = 1; i <= 3; i++) {
+        cqe = iour_wait_cqe(&iour);
+        test_assert(cqe && (cqe->user_data == i));
+        test_assert(cqe->res == ((i == 1) ? POLLIN : 0));
+    }
+
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(close(pipe_fds[0]) == 0);
+    test_assert(close(pipe_fds[1]) == 0);
+}
+
+static void iour_test_provide_buffers(void)
+{
+    struct iour iour;
+    uint8_t bufs[4][64], write_buf[64];
+    struct io_uring_cqe *cqe;
+    int fd, bid;
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    test_assert(iour_init(&iour, 2) == 0);
+    fd = open("file_pbuf", O_RDWR | O_CREAT, S_IRWXU);
+    test_assert(fd > 0);
+    for (int i = 0; i < sizeof(write_buf); i++)
+        write_buf[i] = i;
+    test_assert(write(fd, write_buf, sizeof(write_buf)) == sizeof(write_buf));
+
+    iour_setup_provide_buffers(&iour, bufs[0], sizeof(bufs[0]), 2, 7, 1, 1);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 1) && (cqe->res == 0));
+
+    /* Each read consumes a buffer from the group. */
+    for (int i = 0; i < 2; i++) {
+        iour_setup_buf_select(&iour, IORING_OP_READ, fd, sizeof(bufs[0]), 7, 0,
+            2 + i);
+        test_assert(iour_submit(&iour, 1, 1) == 1);
+        cqe = iour_get_cqe(&iour);
+        test_assert(cqe && (cqe->user_data == 2 + i));
+        test_assert(cqe->res == sizeof(bufs[0]));
+        test_assert(cqe->flags & IORING_CQE_F_BUFFER);
+        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        test_assert((bid == 1) || (bid == 2));
+        test_assert(memcmp(bufs[bid - 1], write_buf, sizeof(write_buf)) == 0);
+        memset(bufs[bid - 1], 0, sizeof(bufs[0]));
+    }
+    iour_setup_buf_select(&iour, IORING_OP_READ, fd, sizeof(bufs[0]), 7, 0, 4);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 4) && (cqe->res == -ENOBUFS));
+
+    iour_setup_provide_buffers(&iour, bufs[0], sizeof(bufs[0]), 4, 7, 0, 5);
+    iour_setup_remove_buffers(&iour, 8, 7, 6);
+    test_assert(iour_submit(&iour, 2, 2) == 2);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 5) && (cqe->res == 0));
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 6) && (cqe->res == 4));
+    iour_setup_remove_buffers(&iour, 1, 8, 7);
+    test_assert(iour_submit(&iour, 1, 1) == 1);
+    cqe = iour_get_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 7) && (cqe->res == -ENOENT));
+
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(close(fd) == 0);
+    test_assert(unlink("file_pbuf") == 0);
+}
+
+static void iour_test_multishot(void)
+{
+    struct iour iour;
+    struct io_uring_buf_reg reg;
+    struct io_uring_buf *ring;
+    uint16_t *ring_tail;
+    uint8_t bufs[4][32];
+    const char *msgs[] = {"first", "second message"};
+    int pipe_fds[2], sv[2];
+    uint8_t pipe_buf[8];
+    struct io_uring_cqe *cqe;
+    int ret, bid;
+
+    memset(&iour.params, 0, sizeof(iour.params));
+    test_assert(iour_init(&iour, 4) == 0);
+
+    /* A multishot poll posts a completion for each event until removed. */
+    test_assert(pipe(pipe_fds) == 0);
+    iour_setup_poll_add(&iour, pipe_fds[0], POLLIN, 1);
+    iour.sqes[iour.sq_array[(*iour.sq_tail - 1) & iour.sq_mask]].len =
+            IORING_POLL_ADD_MULTI;
+    test_assert(iour_submit(&iour, 1, 0) == 1);
+    for (int i = 0; i < 2; i++) {
+        test_assert(write(pipe_fds[1], pipe_buf, sizeof(pipe_buf)) ==
+                sizeof(pipe_buf));
+        cqe = iour_wait_cqe(&iour);
+        test_assert(cqe && (cqe->user_data == 1) && (cqe->res == POLLIN));
+        test_assert(cqe->flags & IORING_CQE_F_MORE);
+        test_assert(read(pipe_fds[0], pipe_buf, sizeof(pipe_buf)) ==
+                sizeof(pipe_buf));
+    }
+    iour_setup_poll_remove(&iour, 1, 2);
+    test_assert(iour_submit(&iour, 1, 2) == 1);
+    for (int i = 0; i < 2; i++) {
+        cqe = iour_get_cqe(&iour);
+        test_assert(cqe && !(cqe->flags & IORING_CQE_F_MORE));
+        test_assert(cqe->res == ((cqe->user_data == 1) ? -ECANCELED : 0));
+    }
+    test_assert(close(pipe_fds[0]) == 0);
+    test_assert(close(pipe_fds[1]) == 0);
+
+    /* A multishot receive picks a buffer from a registered ring for each
+     * message. */
+    ring = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+        -1, 0);
+    test_assert(ring != MAP_FAILED);
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)ring;
+    reg.ring_entries = 3;
+    reg.bgid = 3;
+    ret = syscall(SYS_io_uring_register, iour.fd, IORING_REGISTER_PBUF_RING,
+        &reg, 1);
+    test_assert((ret == -1) && (errno == EINVAL));
+    reg.ring_entries = 4;
+    test_assert(syscall(SYS_io_uring_register, iour.fd,
+                        IORING_REGISTER_PBUF_RING, &reg, 1) == 0);
+    ring_tail = &ring[0].resv;
+    for (int i = 0; i < 4; i++) {
+        ring[i].addr = (uint64_t)bufs[i];
+        ring[i].len = sizeof(bufs[i]);
+        ring[i].bid = i;
+    }
+    write_barrier();
+    *ring_tail = 4;
+
+    test_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+    iour_setup_buf_select(&iour, IORING_OP_RECV, sv[0], 0, 3,
+        IORING_RECV_MULTISHOT, 3);
+    test_assert(iour_submit(&iour, 1, 0) == 1);
+    for (int i = 0; i < 2; i++) {
+        int len = strlen(msgs[i]);
+
+        test_assert(write(sv[1], msgs[i], len) == len);
+        cqe = iour_wait_cqe(&iour);
+        test_assert(cqe && (cqe->user_data == 3) && (cqe->res == len));
+        test_assert(cqe->flags & IORING_CQE_F_MORE);
+        test_assert(cqe->flags & IORING_CQE_F_BUFFER);
+        bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        test_assert(bid == i);
+        test_assert(memcmp(bufs[bid], msgs[i], len) == 0);
+    }
+    test_assert(close(sv[1]) == 0);
+    cqe = iour_wait_cqe(&iour);
+    test_assert(cqe && (cqe->user_data == 3) && (cqe->res == 0));
+    test_assert(!(cqe->flags & IORING_CQE_F_MORE));
+
+    test_assert(syscall(SYS_io_uring_register, iour.fd,
+                        IORING_UNREGISTER_PBUF_RING, &reg, 1) == 0);
+    ret = syscall(SYS_io_uring_register, iour.fd, IORING_UNREGISTER_PBUF_RING,
+        &reg, 1);
+    test_assert((ret == -1) && (errno == ENOENT));
+    test_assert(close(sv[0]) == 0);
+    test_assert(iour_exit(&iour) == 0);
+    test_assert(munmap(ring, 4096) == 0);
+}
+
 int main(int argc, char **argv)
 {
     setbuf(stdout, NULL);
@@ -1212,11 +1839,19 @@ int main(int argc, char **argv)
     iour_test_multiple();
     iour_test_iovec();
     iour_test_rw_fixed();
+    iour_test_rw_fixed_direct();
+    iour_test_rw_fixed_direct_batch();
     iour_test_poll();
     iour_test_timeout();
     iour_test_close();
     iour_test_sig();
     iour_test_register_files();
+    iour_test_sqpoll();
+    iour_test_iopoll();
+    iour_test_link();
+    iour_test_drain();
+    iour_test_provide_buffers();
+    iour_test_multishot();
     printf("IO uring test OK\n");
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,501 @@
+/* io_uring echo benchmark: an echo server driven entirely by an io_uring instance (accept, receive
+ * and send operations) serves a number of client threads over loopback TCP connections; each
+ * client sends fixed-size requests and waits for them to be echoed back, and the request rate and
+ * round-trip latency are reported. Before the benchmark, the socket operations of io_uring are
+ * validated with a client using connect, sendmsg and recvmsg operations.
+ * Usage: io_uring_echo [-c number of connections] [-n requests per connection] [-s request size]
+ */
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef SYS_io_uring_setup
+#define SYS_io_uring_setup      425
+#endif
+#ifndef SYS_io_uring_enter
+#define SYS_io_uring_enter      426
+#endif
+#ifndef SYS_io_uring_register
+#define SYS_io_uring_register   427
+#endif
+
+#define IORING_OFF_SQ_RING  0ULL
+#define IORING_OFF_SQES     0x10000000ULL
+
+#define IORING_ENTER_GETEVENTS  (1 << 0)
+#define IORING_REGISTER_PROBE   8
+#define IO_URING_OP_SUPPORTED   (1 << 0)
+
+#define IORING_OP_SENDMSG   9
+#define IORING_OP_RECVMSG   10
+#define IORING_OP_ACCEPT    13
+#define IORING_OP_CONNECT   16
+#define IORING_OP_SEND      26
+#define IORING_OP_RECV      27
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        printf("Error: %s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+#define write_barrier() __atomic_thread_fence(__ATOMIC_RELEASE)
+#define read_barrier()  __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+struct io_sqring_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t flags;
+    uint32_t dropped;
+    uint32_t array;
+    uint32_t resv[3];
+};
+
+struct io_cqring_offsets {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t ring_mask;
+    uint32_t ring_entries;
+    uint32_t overflow;
+    uint32_t cqes;
+    uint32_t resv[4];
+};
+
+struct io_uring_params {
+    uint32_t sq_entries;
+    uint32_t cq_entries;
+    uint32_t flags;
+    uint32_t sq_thread_cpu;
+    uint32_t sq_thread_idle;
+    uint32_t features;
+    uint32_t resv[4];
+    struct io_sqring_offsets sq_off;
+    struct io_cqring_offsets cq_off;
+};
+
+struct io_uring_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t ioprio;
+    int32_t fd;
+    uint64_t off;
+    uint64_t addr;
+    uint32_t len;
+    union {
+        uint32_t msg_flags;
+        uint32_t accept_flags;
+    };
+    uint64_t user_data;
+    uint64_t __pad2[3];
+};
+
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+};
+
+struct io_uring_probe_op {
+    uint8_t op;
+    uint8_t resv;
+    uint16_t flags;
+    uint32_t resv2;
+};
+
+struct io_uring_probe {
+    uint8_t last_op;
+    uint8_t ops_len;
+    uint16_t resv;
+    uint32_t resv2[3];
+    struct io_uring_probe_op ops[0];
+};
+
+struct iour {
+    int fd;
+    struct io_uring_sqe *sqes;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t *sq_array;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned int to_submit;
+};
+
+/* per-connection state of the echo server */
+struct echo_conn {
+    int fd;
+    int len;        /* length of the request being echoed */
+    int sent;
+    char *buf;
+};
+
+enum {
+    ECHO_ACCEPT,
+    ECHO_RECV,
+    ECHO_SEND,
+};
+
+static int nconns = 8;
+static int nrequests = 10000;
+static int req_size = 64;
+static struct sockaddr_in server_addr;
+static uint64_t *latencies;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void iour_init(struct iour *iour, unsigned int entries)
+{
+    struct io_uring_params params;
+    uint8_t *rings;
+
+    memset(&params, 0, sizeof(params));
+    iour->fd = syscall(SYS_io_uring_setup, entries, &params);
+    test_assert(iour->fd >= 0);
+    size_t sqring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cqring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    rings = mmap(0, sqring_size > cqring_size ? sqring_size : cqring_size,
+                 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, iour->fd, IORING_OFF_SQ_RING);
+    test_assert(rings != MAP_FAILED);
+    iour->sq_tail = (uint32_t *)(rings + params.sq_off.tail);
+    iour->sq_mask = *(uint32_t *)(rings + params.sq_off.ring_mask);
+    iour->sq_array = (uint32_t *)(rings + params.sq_off.array);
+    iour->cq_head = (uint32_t *)(rings + params.cq_off.head);
+    iour->cq_tail = (uint32_t *)(rings + params.cq_off.tail);
+    iour->cq_mask = *(uint32_t *)(rings + params.cq_off.ring_mask);
+    iour->cqes = (struct io_uring_cqe *)(rings + params.cq_off.cqes);
+    iour->sqes = mmap(0, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, iour->fd, IORING_OFF_SQES);
+    test_assert(iour->sqes != MAP_FAILED);
+    for (int i = 0; i < params.sq_entries; i++)
+        iour->sq_array[i] = i;
+    iour->to_submit = 0;
+}
+
+static void iour_queue(struct iour *iour, uint8_t opcode, int fd, void *addr, uint32_t len,
+                       uint64_t off, uint32_t flags, uint64_t user_data)
+{
+    struct io_uring_sqe *sqe = &iour->sqes[*iour->sq_tail & iour->sq_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->msg_flags = flags;
+    sqe->user_data = user_data;
+    write_barrier();
+    (*iour->sq_tail)++;
+    iour->to_submit++;
+}
+
+/* Submits the queued SQEs and waits for at least one completion. */
+static struct io_uring_cqe *iour_wait(struct iour *iour)
+{
+    for (;;) {
+        read_barrier();
+        if (*iour->cq_tail != *iour->cq_head)
+            return &iour->cqes[*iour->cq_head & iour->cq_mask];
+        int ret = syscall(SYS_io_uring_enter, iour->fd, iour->to_submit, 1,
+                          IORING_ENTER_GETEVENTS, NULL);
+        test_assert(ret == iour->to_submit);
+        iour->to_submit = 0;
+    }
+}
+
+static void iour_seen(struct iour *iour)
+{
+    write_barrier();
+    (*iour->cq_head)++;
+}
+
+static void probe_test(struct iour *iour)
+{
+    const int ops[] = { IORING_OP_SENDMSG, IORING_OP_RECVMSG, IORING_OP_ACCEPT,
+                        IORING_OP_CONNECT, IORING_OP_SEND, IORING_OP_RECV };
+    const int probe_ops = IORING_OP_RECV + 1;
+    struct io_uring_probe *probe = calloc(1, sizeof(*probe) +
+                                          probe_ops * sizeof(struct io_uring_probe_op));
+
+    test_assert(probe);
+    test_assert(syscall(SYS_io_uring_register, iour->fd, IORING_REGISTER_PROBE, probe,
+                        probe_ops) == 0);
+    test_assert(probe->last_op >= IORING_OP_RECV);
+    test_assert(probe->ops_len == probe_ops);
+    for (int i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+        test_assert(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+}
+
+static int echo_listen(void)
+{
+    socklen_t addrlen = sizeof(server_addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    test_assert(fd >= 0);
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    test_assert(bind(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == 0);
+    test_assert(listen(fd, nconns + 1) == 0);
+    test_assert(getsockname(fd, (struct sockaddr *)&server_addr, &addrlen) == 0);
+    return fd;
+}
+
+/* Echo server: serves the given number of connections until they are closed by the peer. */
+static void *echo_server(void *arg)
+{
+    int listen_fd = (long)arg;
+    int nclients = nconns + 1;  /* benchmark clients plus the validation client */
+    struct echo_conn *conns = calloc(nclients, sizeof(*conns));
+    struct iour iour;
+    int accepted = 0, closed = 0;
+
+    test_assert(conns);
+    iour_init(&iour, 2 * nclients);
+    iour_queue(&iour, IORING_OP_ACCEPT, listen_fd, NULL, 0, 0, 0, ECHO_ACCEPT);
+    while (closed < nclients) {
+        struct io_uring_cqe *cqe = iour_wait(&iour);
+        uint64_t user_data = cqe->user_data;
+        int op = user_data & 0xff;
+        struct echo_conn *c = &conns[user_data >> 8];
+        int res = cqe->res;
+
+        iour_seen(&iour);
+        switch (op) {
+        case ECHO_ACCEPT:
+            test_assert(res >= 0);
+            c = &conns[accepted];
+            c->fd = res;
+            c->buf = malloc(req_size);
+            test_assert(c->buf);
+            iour_queue(&iour, IORING_OP_RECV, c->fd, c->buf, req_size, 0, 0,
+                       (accepted << 8) | ECHO_RECV);
+            if (++accepted < nclients)
+                iour_queue(&iour, IORING_OP_ACCEPT, listen_fd, NULL, 0, 0, 0, ECHO_ACCEPT);
+            break;
+        case ECHO_RECV:
+            test_assert(res >= 0);
+            if (res == 0) {
+                close(c->fd);
+                free(c->buf);
+                closed++;
+                break;
+            }
+            c->len = res;
+            c->sent = 0;
+            iour_queue(&iour, IORING_OP_SEND, c->fd, c->buf, c->len, 0, 0,
+                       (user_data & ~0xfful) | ECHO_SEND);
+            break;
+        case ECHO_SEND:
+            test_assert(res > 0);
+            c->sent += res;
+            if (c->sent < c->len)
+                iour_queue(&iour, IORING_OP_SEND, c->fd, c->buf + c->sent, c->len - c->sent, 0,
+                           0, user_data);
+            else
+                iour_queue(&iour, IORING_OP_RECV, c->fd, c->buf, req_size, 0, 0,
+                           (user_data & ~0xfful) | ECHO_RECV);
+            break;
+        }
+    }
+    close(iour.fd);
+    free(conns);
+    return NULL;
+}
+
+/* Connects to the server and exchanges a message with sendmsg and recvmsg operations, each using
+ * two iovecs. */
+static void validation_client(void)
+{
+    struct iour iour;
+    struct io_uring_cqe *cqe;
+    char out[2][32], in[2][32];
+    struct iovec out_iov[2] = { { out[0], sizeof(out[0]) }, { out[1], sizeof(out[1]) } };
+    struct msghdr msg;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int received = 0;
+
+    test_assert(fd >= 0);
+    iour_init(&iour, 4);
+    probe_test(&iour);
+
+    /* operations on a non-socket file descriptor */
+    iour_queue(&iour, IORING_OP_RECV, iour.fd, in[0], sizeof(in[0]), 0, 0, 0);
+    cqe = iour_wait(&iour);
+    test_assert(cqe->res == -ENOTSOCK);
+    iour_seen(&iour);
+
+    /* receive on a non-connected socket */
+    iour_queue(&iour, IORING_OP_RECV, fd, in[0], sizeof(in[0]), 0, 0, 0);
+    cqe = iour_wait(&iour);
+    test_assert(cqe->res == -ENOTCONN);
+    iour_seen(&iour);
+
+    iour_queue(&iour, IORING_OP_CONNECT, fd, &server_addr, 0, sizeof(server_addr), 0, 1);
+    cqe = iour_wait(&iour);
+    test_assert((cqe->user_data == 1) && (cqe->res == 0));
+    iour_seen(&iour);
+
+    memset(out[0], 'a', sizeof(out[0]));
+    memset(out[1], 'b', sizeof(out[1]));
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = out_iov;
+    msg.msg_iovlen = 2;
+    iour_queue(&iour, IORING_OP_SENDMSG, fd, &msg, 1, 0, 0, 2);
+    cqe = iour_wait(&iour);
+    test_assert((cqe->user_data == 2) && (cqe->res == sizeof(out)));
+    iour_seen(&iour);
+
+    /* the echoed data may be split across multiple receive operations */
+    memset(in, 0, sizeof(in));
+    while (received < sizeof(in)) {
+        int first = received < sizeof(in[0]);
+        struct iovec iov[2];
+
+        iov[0].iov_base = first ? in[0] + received : in[1] + received - sizeof(in[0]);
+        iov[0].iov_len = first ? sizeof(in[0]) - received : sizeof(in) - received;
+        iov[1].iov_base = in[1];
+        iov[1].iov_len = sizeof(in[1]);
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = first ? 2 : 1;
+        iour_queue(&iour, IORING_OP_RECVMSG, fd, &msg, 1, 0, 0, 3);
+        cqe = iour_wait(&iour);
+        test_assert((cqe->user_data == 3) && (cqe->res > 0));
+        received += cqe->res;
+        iour_seen(&iour);
+    }
+    test_assert(!memcmp(in, out, sizeof(out)));
+
+    /* a receive that cannot complete immediately fails with MSG_DONTWAIT */
+    iour_queue(&iour, IORING_OP_RECV, fd, in[0], sizeof(in[0]), 0, MSG_DONTWAIT, 4);
+    cqe = iour_wait(&iour);
+    test_assert((cqe->user_data == 4) && (cqe->res == -EAGAIN));
+    iour_seen(&iour);
+
+    /* a pending receive is canceled when the io_uring instance is closed */
+    iour_queue(&iour, IORING_OP_RECV, fd, in[0], sizeof(in[0]), 0, 0, 5);
+    test_assert(syscall(SYS_io_uring_enter, iour.fd, 1, 0, 0, NULL) == 1);
+    test_assert(close(iour.fd) == 0);
+    test_assert(shutdown(fd, SHUT_RDWR) == 0);
+    close(fd);
+    printf("io_uring socket operations validated\n");
+}
+
+static void *bench_client(void *arg)
+{
+    long index = (long)arg;
+    uint64_t *lat = latencies + index * nrequests;
+    char *out = malloc(req_size), *in = malloc(req_size);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+
+    test_assert(out && in && (fd >= 0));
+    test_assert(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == 0);
+    test_assert(connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == 0);
+    for (int i = 0; i < nrequests; i++) {
+        uint64_t start = now_ns();
+
+        memset(out, i, req_size);
+        test_assert(send(fd, out, req_size, 0) == req_size);
+        for (int received = 0; received < req_size; ) {
+            ssize_t ret = recv(fd, in + received, req_size - received, 0);
+            test_assert(ret > 0);
+            received += ret;
+        }
+        lat[i] = now_ns() - start;
+        test_assert(!memcmp(in, out, req_size));
+    }
+    close(fd);
+    free(out);
+    free(in);
+    return NULL;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t server, *clients;
+    uint64_t start, elapsed;
+    int opt, listen_fd;
+    long total;
+
+    while ((opt = getopt(argc, argv, "c:n:s:")) != -1) {
+        switch (opt) {
+        case 'c':
+            nconns = atoi(optarg);
+            break;
+        case 'n':
+            nrequests = atoi(optarg);
+            break;
+        case 's':
+            req_size = atoi(optarg);
+            break;
+        default:
+            printf("Usage: %s [-c number of connections] [-n requests per connection] "
+                   "[-s request size]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    test_assert((nconns > 0) && (nrequests > 0) && (req_size > 0));
+    setbuf(stdout, NULL);
+    total = (long)nconns * nrequests;
+    latencies = malloc(total * sizeof(*latencies));
+    clients = malloc(nconns * sizeof(*clients));
+    test_assert(latencies && clients);
+
+    listen_fd = echo_listen();
+    test_assert(pthread_create(&server, NULL, echo_server, (void *)(long)listen_fd) == 0);
+    validation_client();
+
+    printf("%d connections, %d requests of %d bytes per connection\n", nconns, nrequests,
+           req_size);
+    start = now_ns();
+    for (long i = 0; i < nconns; i++)
+        test_assert(pthread_create(&clients[i], NULL, bench_client, (void *)i) == 0);
+    for (int i = 0; i < nconns; i++)
+        test_assert(pthread_join(clients[i], NULL) == 0);
+    elapsed = now_ns() - start;
+    test_assert(pthread_join(server, NULL) == 0);
+    close(listen_fd);
+
+    qsort(latencies, total, sizeof(*latencies), compare_u64);
+    printf("%ld requests in %lu us, %lu requests/s\n", total, elapsed / 1000,
+           elapsed ? total * 1000000000ul / elapsed : 0);
+    printf("latency: p50 %lu us, p99 %lu us, max %lu us\n", latencies[total / 2] / 1000,
+           latencies[total * 99 / 100] / 1000, latencies[total - 1] / 1000);
+    free(latencies);
+    free(clients);
+    printf("io_uring_echo test passed\n");
+    return EXIT_SUCCESS;
+}
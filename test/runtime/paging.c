@@ -3,6 +3,9 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
 #include <sys/mman.h>
 
 static long pagesize;
@@ -80,15 +83,68 @@ static void test_exec_stack(void)
     test_exec(p);
 }
 
+/* page fault benchmark: each thread repeatedly maps an anonymous area, touches each of its pages
+   and unmaps it, so that page allocation and release from all CPUs can be measured */
+static int fault_iterations = 64;
+static size_t fault_area_size = 16 * 1024 * 1024;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+static void *fault_thread(void *arg)
+{
+    for (int i = 0; i < fault_iterations; i++) {
+        char *p = mmap(NULL, fault_area_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            printf("mmap fail: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        for (size_t offset = 0; offset < fault_area_size; offset += pagesize)
+            p[offset] = 1;
+        if (munmap(p, fault_area_size) < 0) {
+            printf("munmap fail: %s\n", strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    return NULL;
+}
+
+static void fault_bench(int nthreads)
+{
+    pthread_t threads[nthreads];
+    printf("page fault benchmark: %d threads, %d iterations of %zu KB\n", nthreads,
+           fault_iterations, fault_area_size / 1024);
+    uint64_t start = now_ns();
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&threads[i], NULL, fault_thread, NULL)) {
+            printf("pthread_create fail\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t ns = now_ns() - start;
+    uint64_t faults = (uint64_t)nthreads * fault_iterations * (fault_area_size / pagesize);
+    printf("%lu faults in %lu ms: %lu faults/s, %lu ns per fault per thread\n", faults,
+           ns / 1000000, faults * 1000000000ul / ns, ns * nthreads / faults);
+}
+
 static void usage(char * progname)
 {
     printf("usage:\n  %s { write-exec | write-ro | exec-mmap | exec-heap | exec-stack }\n", progname);
+    printf("  %s fault-bench [threads [MB per area [iterations]]]\n", progname);
     printf("\n    protection fault tests (these should cause a page fault / protection violation):\n");
     printf(" \twrite-exec: write to executable page\n");
     printf(" \twrite-ro: write to read-only page\n");
     printf(" \texec-mmap: exec in no-exec mmaped page\n");
     printf(" \texec-heap: exec in heap\n");
     printf(" \texec-stack: exec in stack\n");
+    printf("\n    fault-bench: measure the page fault rate of threads faulting in anonymous memory\n");
     exit(EXIT_FAILURE);
 }
 
@@ -96,7 +152,16 @@ int main(int argc, char * argv[])
 {
     setbuf(stdout, NULL);
     pagesize = sysconf(_SC_PAGESIZE);
-    if (argc == 2) {
+    if ((argc >= 2) && (argc <= 5) && !strcmp(argv[1], "fault-bench")) {
+        int nthreads = (argc > 2) ? atoi(argv[2]) : 4;
+        if (argc > 3)
+            fault_area_size = (size_t)atoi(argv[3]) * 1024 * 1024;
+        if (argc > 4)
+            fault_iterations = atoi(argv[4]);
+        if ((nthreads <= 0) || (fault_area_size == 0) || (fault_iterations <= 0))
+            usage(argv[0]);
+        fault_bench(nthreads);
+    } else if (argc == 2) {
         if (!strcmp(argv[1], "write-exec"))
             test_write_to_exec();
         else if(!strcmp(argv[1], "write-ro"))
@@ -8,6 +8,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <runtime.h>
 
@@ -172,6 +174,250 @@ void blocking_test(heap h, int * fds)
     printf("blocking test passed\n");
 }
 
+#define SPLICE_TEST_LEN (3 * PAGESIZE + 123)
+
+static char splice_srcbuf[SPLICE_TEST_LEN];
+static char splice_dstbuf[SPLICE_TEST_LEN];
+
+static void splice_check(const char *desc, ssize_t nbytes, ssize_t expected)
+{
+    if (nbytes != expected) {
+        printf("%s: returned %ld (errno %d), expected %ld\n", desc, nbytes, errno, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void splice_check_data(const char *desc, const char *data, int len)
+{
+    if (memcmp(data, splice_srcbuf, len)) {
+        printf("%s: data mismatch\n", desc);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* file -> pipe -> file, pipe -> socket -> pipe */
+void splice_test(void)
+{
+    const char *src_name = "splice_src";
+    const char *dst_name = "splice_dst";
+    int fds[2], sv[2];
+    loff_t off;
+    ssize_t nbytes;
+
+    for (int i = 0; i < SPLICE_TEST_LEN; i++)
+        splice_srcbuf[i] = (char)random_u64();
+    int src = open(src_name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (src < 0)
+        handle_error("splice test open source");
+    if (write(src, splice_srcbuf, SPLICE_TEST_LEN) != SPLICE_TEST_LEN)
+        handle_error("splice test write source");
+    int dst = open(dst_name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (dst < 0)
+        handle_error("splice test open destination");
+    if (__pipe(fds) < 0)
+        handle_error("splice test pipe");
+    if (fcntl(fds[0], F_SETPIPE_SZ, SPLICE_TEST_LEN) < SPLICE_TEST_LEN)
+        handle_error("splice test F_SETPIPE_SZ");
+
+    /* invalid arguments */
+    off = 0;
+    splice_check("splice with pipe offset", splice(fds[0], &off, dst, NULL, 1, 0), -1);
+    if (errno != ESPIPE)
+        handle_error("splice with pipe offset: unexpected errno");
+    splice_check("splice between files", splice(src, NULL, dst, NULL, 1, 0), -1);
+    if (errno != EINVAL)
+        handle_error("splice between files: unexpected errno");
+    splice_check("splice with invalid flags", splice(fds[0], NULL, dst, NULL, 1, 0x80), -1);
+    if (errno != EINVAL)
+        handle_error("splice with invalid flags: unexpected errno");
+    splice_check("splice from empty pipe", splice(fds[0], NULL, dst, NULL, 1, SPLICE_F_NONBLOCK),
+                 -1);
+    if (errno != EAGAIN)
+        handle_error("splice from empty pipe: unexpected errno");
+
+    /* file to pipe with explicit offset: the file offset is left unchanged */
+    off = 0;
+    nbytes = splice(src, &off, fds[1], NULL, SPLICE_TEST_LEN, 0);
+    splice_check("splice from file", nbytes, SPLICE_TEST_LEN);
+    splice_check("splice from file offset", off, SPLICE_TEST_LEN);
+    splice_check("source file offset", lseek(src, 0, SEEK_CUR), SPLICE_TEST_LEN);
+
+    /* pipe to file, in two steps */
+    nbytes = splice(fds[0], NULL, dst, NULL, PAGESIZE + 1, 0);
+    splice_check("splice to file", nbytes, PAGESIZE + 1);
+    do {
+        nbytes = splice(fds[0], NULL, dst, NULL, SPLICE_TEST_LEN, SPLICE_F_NONBLOCK);
+        if (nbytes <= 0)
+            handle_error("splice to file");
+    } while (lseek(dst, 0, SEEK_CUR) < SPLICE_TEST_LEN);
+    splice_check("destination file offset", lseek(dst, 0, SEEK_CUR), SPLICE_TEST_LEN);
+    if (pread(dst, splice_dstbuf, SPLICE_TEST_LEN, 0) != SPLICE_TEST_LEN)
+        handle_error("splice test read destination");
+    splice_check_data("file to pipe to file", splice_dstbuf, SPLICE_TEST_LEN);
+
+    /* pipe to socket and back to pipe, using the file offset of the source */
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+        handle_error("splice test socketpair");
+    if (lseek(src, 0, SEEK_SET) != 0)
+        handle_error("splice test lseek");
+    nbytes = splice(src, NULL, fds[1], NULL, PAGESIZE, 0);
+    splice_check("splice from file (file offset)", nbytes, PAGESIZE);
+    splice_check("source file offset", lseek(src, 0, SEEK_CUR), PAGESIZE);
+    int nwritten = 0;
+    while (nwritten < PAGESIZE) {
+        nbytes = splice(fds[0], NULL, sv[0], NULL, PAGESIZE - nwritten, 0);
+        if (nbytes <= 0)
+            handle_error("splice to socket");
+        nwritten += nbytes;
+    }
+    int nread = 0;
+    while (nread < PAGESIZE) {
+        nbytes = splice(sv[1], NULL, fds[1], NULL, PAGESIZE - nread, 0);
+        if (nbytes <= 0)
+            handle_error("splice from socket");
+        nread += nbytes;
+    }
+    if (read(fds[0], splice_dstbuf, PAGESIZE) != PAGESIZE)
+        handle_error("splice test read pipe");
+    splice_check_data("pipe to socket to pipe", splice_dstbuf, PAGESIZE);
+
+    /* end of file, and closed write end of the pipe */
+    off = SPLICE_TEST_LEN;
+    splice_check("splice at end of file", splice(src, &off, fds[1], NULL, 1, 0), 0);
+    close(fds[1]);
+    splice_check("splice from closed pipe", splice(fds[0], NULL, dst, NULL, 1, 0), 0);
+
+    close(sv[0]);
+    close(sv[1]);
+    close(fds[0]);
+    close(src);
+    close(dst);
+    unlink(src_name);
+    unlink(dst_name);
+    printf("splice test passed\n");
+}
+
+void tee_test(void)
+{
+    int in[2], out[2], out2[2];
+    ssize_t nbytes;
+
+    if ((__pipe(in) < 0) || (__pipe(out) < 0) || (__pipe(out2) < 0))
+        handle_error("tee test pipe");
+    if (write(in[1], splice_srcbuf, PAGESIZE + 1) != PAGESIZE + 1)
+        handle_error("tee test write");
+    splice_check("tee to the same pipe", tee(in[0], in[1], 1, 0), -1);
+    if (errno != EINVAL)
+        handle_error("tee to the same pipe: unexpected errno");
+
+    /* tee duplicates data without consuming it, splice moves it */
+    nbytes = tee(in[0], out[1], PAGESIZE + 1, 0);
+    splice_check("tee", nbytes, PAGESIZE + 1);
+    nbytes = splice(in[0], NULL, out2[1], NULL, PAGESIZE + 1, 0);
+    splice_check("splice between pipes", nbytes, PAGESIZE + 1);
+    splice_check("tee from empty pipe", tee(in[0], out[1], 1, SPLICE_F_NONBLOCK), -1);
+    if (errno != EAGAIN)
+        handle_error("tee from empty pipe: unexpected errno");
+    if (read(out[0], splice_dstbuf, PAGESIZE + 1) != PAGESIZE + 1)
+        handle_error("tee test read");
+    splice_check_data("tee", splice_dstbuf, PAGESIZE + 1);
+    if (read(out2[0], splice_dstbuf, PAGESIZE + 1) != PAGESIZE + 1)
+        handle_error("tee test read");
+    splice_check_data("splice between pipes", splice_dstbuf, PAGESIZE + 1);
+
+    for (int i = 0; i < 2; i++) {
+        close(in[i]);
+        close(out[i]);
+        close(out2[i]);
+    }
+    printf("tee test passed\n");
+}
+
+void vmsplice_test(void)
+{
+    int fds[2];
+    struct iovec iov[2];
+    ssize_t nbytes;
+
+    if (__pipe(fds) < 0)
+        handle_error("vmsplice test pipe");
+    iov[0].iov_base = splice_srcbuf;
+    iov[0].iov_len = 10;
+    iov[1].iov_base = splice_srcbuf + 10;
+    iov[1].iov_len = PAGESIZE;
+    nbytes = vmsplice(fds[1], iov, 2, 0);
+    splice_check("vmsplice to pipe", nbytes, PAGESIZE + 10);
+    iov[0].iov_base = splice_dstbuf;
+    iov[0].iov_len = PAGESIZE;
+    iov[1].iov_base = splice_dstbuf + PAGESIZE;
+    iov[1].iov_len = PAGESIZE;
+    nbytes = vmsplice(fds[0], iov, 2, 0);
+    splice_check("vmsplice from pipe", nbytes, PAGESIZE + 10);
+    splice_check_data("vmsplice", splice_dstbuf, PAGESIZE + 10);
+    splice_check("vmsplice from empty pipe", vmsplice(fds[0], iov, 1, SPLICE_F_NONBLOCK), -1);
+    if (errno != EAGAIN)
+        handle_error("vmsplice from empty pipe: unexpected errno");
+    close(fds[0]);
+    close(fds[1]);
+    printf("vmsplice test passed\n");
+}
+
+/* large pipes, with capacity rounded up to a power of two number of pages */
+void capacity_test(void)
+{
+    const int large_size = 1024 * 1024;
+    int fds[2];
+    int nwritten;
+    ssize_t nbytes;
+
+    if (pipe2(fds, O_NONBLOCK) < 0)
+        handle_error("capacity test pipe");
+    splice_check("F_SETPIPE_SZ (rounding)", fcntl(fds[1], F_SETPIPE_SZ, 5 * PAGESIZE),
+                 8 * PAGESIZE);
+    splice_check("F_SETPIPE_SZ (large)", fcntl(fds[1], F_SETPIPE_SZ, large_size - 1), large_size);
+    splice_check("F_GETPIPE_SZ", fcntl(fds[0], F_GETPIPE_SZ), large_size);
+    char *buf = malloc(large_size);
+    if (!buf)
+        handle_error("capacity test malloc");
+    for (int i = 0; i < large_size; i++)
+        buf[i] = (char)i;
+    nwritten = 0;
+    do {
+        nbytes = write(fds[1], buf + nwritten, large_size - nwritten);
+        if (nbytes <= 0)
+            handle_error("capacity test write");
+        nwritten += nbytes;
+    } while (nwritten < large_size);
+    splice_check("write to full pipe", write(fds[1], buf, 1), -1);
+    if (errno != EAGAIN)
+        handle_error("write to full pipe: unexpected errno");
+    splice_check("F_SETPIPE_SZ (busy)", fcntl(fds[1], F_SETPIPE_SZ, PAGESIZE), -1);
+    if (errno != EBUSY)
+        handle_error("F_SETPIPE_SZ (busy): unexpected errno");
+    for (int i = 0; i < large_size; i += nbytes) {
+        char c;
+        nbytes = read(fds[0], &c, 1);
+        if ((nbytes != 1) || (c != (char)i)) {
+            printf("capacity test: read mismatch at offset %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+        nbytes = read(fds[0], buf, PAGESIZE - 1);
+        if (nbytes <= 0)
+            handle_error("capacity test read");
+        for (int j = 0; j < nbytes; j++) {
+            if (buf[j] != (char)(i + 1 + j)) {
+                printf("capacity test: read mismatch at offset %d\n", i + 1 + j);
+                exit(EXIT_FAILURE);
+            }
+        }
+        nbytes++;
+    }
+    free(buf);
+    close(fds[0]);
+    close(fds[1]);
+    printf("capacity test passed\n");
+}
+
 int main(int argc, char **argv)
 {
     int fds[2] = {0,0};
@@ -191,6 +437,11 @@ int main(int argc, char **argv)
 
     blocking_test(h, fds);
 
+    splice_test();
+    tee_test();
+    vmsplice_test();
+    capacity_test();
+
     close(fds[1]);
     pfd.fd = fds[0];
     pfd.events = POLLIN | POLLOUT;
@@ -10,6 +10,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -285,6 +286,116 @@ void append_write_test()
     exit(EXIT_FAILURE);
 }
 
+#define DIRECT_BLOCK_SIZE   512
+
+/* O_DIRECT transfers must be aligned, and are coherent with buffered I/O and shared mappings. */
+void direct_write_test(void)
+{
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t file_size = 2 * page_size;
+    ssize_t rv;
+    unsigned char *buf, *tmp, *map;
+    int fd = open("direct", O_CREAT | O_TRUNC | O_RDWR | O_DIRECT, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        perror("open");
+        exit(EXIT_FAILURE);
+    }
+    buf = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    tmp = malloc(file_size);
+    if ((buf == MAP_FAILED) || !tmp) {
+        printf("direct write test: failed to allocate buffers\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((write(fd, buf + 1, DIRECT_BLOCK_SIZE) != -1) || (errno != EINVAL) ||
+        (pwrite(fd, buf, DIRECT_BLOCK_SIZE, 1) != -1) || (errno != EINVAL) ||
+        (read(fd, buf, DIRECT_BLOCK_SIZE - 1) != -1) || (errno != EINVAL)) {
+        printf("direct write test: misaligned transfer not rejected\n");
+        goto out_fail;
+    }
+
+    for (int i = 0; i < file_size; i++)
+        buf[i] = i;
+    _WRITE(buf, file_size);
+    if ((pread(fd, buf, DIRECT_BLOCK_SIZE, file_size) != 0) ||
+        (lseek(fd, 0, SEEK_CUR) != file_size)) {
+        printf("direct write test: unexpected read at end of file\n");
+        goto out_fail;
+    }
+
+    /* buffered access */
+    if (fcntl(fd, F_SETFL, 0) < 0) {
+        perror("fcntl");
+        goto out_fail;
+    }
+    rv = pread(fd, tmp, file_size, 0);
+    if (rv != file_size || memcmp(tmp, buf, file_size)) {
+        printf("direct write test: buffered read mismatch\n");
+        goto out_fail;
+    }
+    memset(tmp, 0xa5, 100);
+    if (pwrite(fd, tmp, 100, page_size + 1) != 100) {
+        perror("pwrite");
+        goto out_fail;
+    }
+    map = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        goto out_fail;
+    }
+    map[0] = 0x5a;
+    if (fcntl(fd, F_SETFL, O_DIRECT) < 0) {
+        perror("fcntl");
+        goto out_fail;
+    }
+    rv = pread(fd, buf, file_size, 0);
+    if (rv != file_size) {
+        perror("pread");
+        goto out_fail;
+    }
+    for (int i = 0; i < file_size; i++) {
+        unsigned char expected = (i == 0) ? 0x5a :
+                                 ((i > page_size) && (i <= page_size + 100)) ? 0xa5 : i;
+        if (buf[i] != expected) {
+            printf("direct write test: direct read mismatch at offset %d\n", i);
+            goto out_fail;
+        }
+    }
+
+    /* direct write of a partial page, seen through the shared mapping */
+    memset(buf, 0x3c, DIRECT_BLOCK_SIZE);
+    if (pwrite(fd, buf, DIRECT_BLOCK_SIZE, DIRECT_BLOCK_SIZE) != DIRECT_BLOCK_SIZE) {
+        perror("pwrite");
+        goto out_fail;
+    }
+    for (int i = 0; i < page_size; i++) {
+        unsigned char expected = (i == 0) ? 0x5a : ((i >= DIRECT_BLOCK_SIZE) &&
+                                                    (i < 2 * DIRECT_BLOCK_SIZE)) ? 0x3c : i;
+        if (map[i] != expected) {
+            printf("direct write test: mapping mismatch at offset %d\n", i);
+            goto out_fail;
+        }
+    }
+    munmap(map, file_size);
+
+    /* a read past the end of a file with a partial last block is truncated */
+    if (ftruncate(fd, file_size - 1) < 0) {
+        perror("ftruncate");
+        goto out_fail;
+    }
+    if (pread(fd, buf, file_size, 0) != file_size - 1) {
+        printf("direct write test: unexpected read length at end of file\n");
+        goto out_fail;
+    }
+    close(fd);
+    munmap(buf, file_size);
+    free(tmp);
+    return;
+  out_fail:
+    close(fd);
+    exit(EXIT_FAILURE);
+}
+
 void truncate_test(const char *prog)
 {
     unsigned char tmp[BUFLEN];
@@ -854,6 +965,7 @@ int main(int argc, char **argv)
         basic_write_test();
         scatter_write_test(1 << 18, 64, 1 << 12);
         append_write_test();
+        direct_write_test();
         truncate_test(argv[0]);
         write_exec_test(argv[0]);
         fs_stress_test();
@@ -0,0 +1,147 @@
+#include <runtime.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define BUF_SIZE        (64 * KB)
+#define FUZZ_ITERATIONS 10000
+
+#define BENCH_BYTES     (1ull << 30)
+
+#define test_assert(expr)   do { \
+    if (!(expr)) { \
+        msg_err("%s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        exit(EXIT_FAILURE); \
+    } \
+} while (0)
+
+/* RFC 1071 reference, one 16-bit word at a time */
+static u16 ref_checksum(const u8 *p, bytes len)
+{
+    u32 sum = 0;
+    for (; len > 1; len -= 2, p += 2) {
+        sum += p[0] | (p[1] << 8);
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    if (len)
+        sum += p[0];
+    sum = (sum & 0xffff) + (sum >> 16);
+    return sum;
+}
+
+static void check(u8 *src, u8 *dst, bytes len)
+{
+    u16 expected = ref_checksum(src, len);
+    test_assert(ip_checksum(src, len) == expected);
+    dst[len] = ~src[len];
+    test_assert(ip_checksum_copy(dst, src, len) == expected);
+    test_assert(runtime_memcmp(dst, src, len) == 0);
+    test_assert(dst[len] == (u8)~src[len]);
+}
+
+static void fill_random(u8 *p, bytes len)
+{
+    u64 r = random_u64();
+    for (bytes i = 0; i < len; i++) {
+        p[i] = r >> ((i & 7) * 8);
+        r = r * 6364136223846793005ull + 1442695040888963407ull;
+    }
+}
+
+static void test_checksum(u8 *src, u8 *dst)
+{
+    /* all lengths and alignments of short buffers */
+    fill_random(src, BUF_SIZE);
+    for (int off = 0; off < 8; off++)
+        for (bytes len = 0; len <= 256; len++)
+            check(src + off, dst + (off ^ 5), len);
+
+    /* sums that exercise the end-around carries */
+    runtime_memset(src, 0xff, BUF_SIZE);
+    check(src, dst, BUF_SIZE - 1);
+    check(src + 3, dst, BUF_SIZE - 8);
+    runtime_memset(src, 0, BUF_SIZE);
+    check(src + 1, dst, BUF_SIZE - 1);
+    for (int i = 0; i < BUF_SIZE; i += 2) {
+        src[i] = 0x01;
+        src[i + 1] = 0x00;
+    }
+    src[0] = 0xfe;
+    src[1] = 0xff;
+    check(src, dst, BUF_SIZE);
+
+    for (int i = 0; i < FUZZ_ITERATIONS; i++) {
+        bytes off = random_u64() % 64;
+        bytes len = random_u64() % (random_u64() & 1 ? 2048 : BUF_SIZE - 128);
+        fill_random(src + off, len + 1);
+        check(src + off, dst + (random_u64() % 64), len);
+    }
+}
+
+static void bench(const char *name, u16 (*op)(u8 *, u8 *, bytes), u8 *dst, u8 *src)
+{
+    printf("%s:", name);
+    for (bytes size = 64; size <= BUF_SIZE; size *= 4) {
+        u64 iterations = BENCH_BYTES / size / 4;
+        u16 sum = 0;
+        timestamp t = now(CLOCK_ID_MONOTONIC);
+        for (u64 i = 0; i < iterations; i++)
+            sum += op(dst, src + (i & 1), size);
+        u64 ns = MAX(nsec_from_timestamp(now(CLOCK_ID_MONOTONIC) - t), 1);
+        printf(" %ld:%ldMB/s", (long)size, (long)(iterations * size * 1000 / ns));
+        test_assert(sum || !sum);
+    }
+    printf("\n");
+}
+
+static u16 bench_ref(u8 *dst, u8 *src, bytes len)
+{
+    return ref_checksum(src, len);
+}
+
+static u16 bench_checksum(u8 *dst, u8 *src, bytes len)
+{
+    return ip_checksum(src, len);
+}
+
+static u16 bench_checksum_copy(u8 *dst, u8 *src, bytes len)
+{
+    return ip_checksum_copy(dst, src, len);
+}
+
+static u16 bench_memcpy_checksum(u8 *dst, u8 *src, bytes len)
+{
+    runtime_memcpy(dst, src, len);
+    return ip_checksum(dst, len);
+}
+
+int main(int argc, char *argv[])
+{
+    boolean benchmark = false;
+    int c;
+
+    init_process_runtime();
+    while ((c = getopt(argc, argv, "b")) != -1) {
+        switch (c) {
+        case 'b':
+            benchmark = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    u8 *src = malloc(BUF_SIZE + 64), *dst = malloc(BUF_SIZE + 64);
+    test_assert(src && dst);
+    test_checksum(src, dst);
+    if (benchmark) {
+        fill_random(src, BUF_SIZE + 64);
+        bench("reference", bench_ref, dst, src);
+        bench("ip_checksum", bench_checksum, dst, src);
+        bench("ip_checksum_copy", bench_checksum_copy, dst, src);
+        bench("memcpy + ip_checksum", bench_memcpy_checksum, dst, src);
+    }
+    free(src);
+    free(dst);
+    return 0;
+}
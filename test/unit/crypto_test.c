@@ -0,0 +1,181 @@
+/* Known-answer tests for SHA-256 and the ChaCha20 keystream, and checks of the random number
+ * generator API. With -b, the throughput of SHA-256, ChaCha20 and random_buffer() is measured.
+ */
+#include <runtime.h>
+#include <crypto/chacha.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#define EXIT_FAILURE 1
+#define EXIT_SUCCESS 0
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        msg_err("%s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        return false; \
+    } \
+} while (0)
+
+static boolean hex_equal(u8 *data, const char *hex)
+{
+    buffer b = little_stack_buffer(256);
+    for (int i = 0; i < runtime_strlen(hex) / 2; i++)
+        print_byte(b, data[i]);
+    return buffer_compare_with_cstring(b, hex);
+}
+
+static boolean sha256_test(heap h)
+{
+    buffer d = allocate_buffer(h, 32);
+    test_assert(d != INVALID_ADDRESS);
+    sha256(d, alloca_wrap_cstring("abc"));
+    test_assert(hex_equal(buffer_ref(d, 0),
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+    buffer_clear(d);
+    sha256(d, alloca_wrap_cstring(""));
+    test_assert(hex_equal(buffer_ref(d, 0),
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"));
+    buffer_clear(d);
+    sha256(d, alloca_wrap_cstring("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+    test_assert(hex_equal(buffer_ref(d, 0),
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+    buffer a = allocate_buffer(h, MB);
+    test_assert(a != INVALID_ADDRESS);
+    runtime_memset(buffer_ref(a, 0), 'a', MB);
+    buffer_produce(a, 1000000);
+    buffer_clear(d);
+    sha256(d, a);
+    test_assert(hex_equal(buffer_ref(d, 0),
+        "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"));
+
+    /* input that is not aligned to a word boundary */
+    buffer_consume(a, 1000000 - 112 - 1);
+    buffer_consume(a, 1);
+    buffer_clear(d);
+    sha256(d, a);
+    buffer a2 = allocate_buffer(h, 112);
+    runtime_memset(buffer_ref(a2, 0), 'a', 112);
+    buffer_produce(a2, 112);
+    buffer d2 = allocate_buffer(h, 32);
+    sha256(d2, a2);
+    test_assert(runtime_memcmp(buffer_ref(d, 0), buffer_ref(d2, 0), 32) == 0);
+    deallocate_buffer(a);
+    deallocate_buffer(a2);
+    deallocate_buffer(d);
+    deallocate_buffer(d2);
+    return true;
+}
+
+static boolean chacha_test(void)
+{
+    /* keystream for an all-zero 256-bit key and nonce */
+    struct chacha_ctx ctx;
+    u8 key[32], iv[8];
+    u8 zeros[128], out[128];
+    zero(key, sizeof(key));
+    zero(iv, sizeof(iv));
+    zero(zeros, sizeof(zeros));
+    chacha_keysetup(&ctx, key, 256);
+    chacha_ivsetup(&ctx, iv, 0);
+    chacha_encrypt_bytes(&ctx, zeros, out, sizeof(out));
+    test_assert(hex_equal(out,
+        "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+        "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586"));
+    test_assert(hex_equal(out + 64,
+        "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+        "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f"));
+    return true;
+}
+
+static boolean random_test(heap h)
+{
+    /* successive outputs differ, and all byte values show up in a large enough output */
+    test_assert(random_u64() != random_u64());
+    bytes len = 64 * KB + 3;
+    buffer b = allocate_buffer(h, len);
+    test_assert(b != INVALID_ADDRESS);
+    buffer_produce(b, len);
+    test_assert(random_buffer(b) == len);
+    u64 seen[4] = {0};
+    for (bytes i = 0; i < len; i++) {
+        u8 c = *(u8 *)buffer_ref(b, i);
+        seen[c >> 6] |= 1ull << (c & 63);
+    }
+    for (int i = 0; i < 4; i++)
+        test_assert(seen[i] == -1ull);
+    deallocate_buffer(b);
+    return true;
+}
+
+static u64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * BILLION + ts.tv_nsec;
+}
+
+static void crypto_bench(heap h)
+{
+    const bytes len = 16 * MB;
+    buffer src = allocate_buffer(h, len);
+    buffer d = allocate_buffer(h, 32);
+    assert((src != INVALID_ADDRESS) && (d != INVALID_ADDRESS));
+    buffer_produce(src, len);
+    random_buffer(src);
+
+    u64 start = now_ns();
+    sha256(d, src);
+    u64 ns = now_ns() - start;
+    rprintf("sha256: %ld MB/s\n", len * 1000 / ns);
+
+    struct chacha_ctx ctx;
+    u8 key[32], iv[8];
+    zero(key, sizeof(key));
+    zero(iv, sizeof(iv));
+    chacha_keysetup(&ctx, key, 256);
+    chacha_ivsetup(&ctx, iv, 0);
+    start = now_ns();
+    chacha_encrypt_bytes(&ctx, buffer_ref(src, 0), buffer_ref(src, 0), len);
+    ns = now_ns() - start;
+    rprintf("chacha20 encrypt: %ld MB/s\n", len * 1000 / ns);
+
+    start = now_ns();
+    random_buffer(src);
+    ns = now_ns() - start;
+    rprintf("random_buffer: %ld MB/s\n", len * 1000 / ns);
+
+    const int iterations = 1000000;
+    u64 x = 0;
+    start = now_ns();
+    for (int i = 0; i < iterations; i++)
+        x ^= random_u64();
+    ns = now_ns() - start;
+    rprintf("random_u64: %ld ns (%lx)\n", ns / iterations, x & 0xf);
+    deallocate_buffer(src);
+    deallocate_buffer(d);
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+    boolean bench = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "b")) != -1) {
+        switch (c) {
+        case 'b':
+            bench = true;
+            break;
+        default:
+            msg_err("usage: %s [-b]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!sha256_test(h) || !chacha_test() || !random_test(h))
+        exit(EXIT_FAILURE);
+    if (bench)
+        crypto_bench(h);
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+}
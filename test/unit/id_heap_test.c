@@ -361,6 +361,183 @@ static boolean alloc_subrange_test(heap h)
     return true;
 }
 
+#define FREE_RANGE_TEST_PAGES     150
+
+closure_function(2, 1, void, free_range_test_handler,
+                 range *, ranges, int *, count,
+                 range, r)
+{
+    if (*bound(count) < 4)
+        bound(ranges)[*bound(count)] = r;
+    (*bound(count))++;
+}
+
+static boolean free_range_foreach_test(heap h)
+{
+    id_heap id = create_id_heap(h, h, 0, FREE_RANGE_TEST_PAGES * PAGESIZE, PAGESIZE, false);
+    if (id == INVALID_ADDRESS) {
+        msg_err("cannot create heap\n");
+        return false;
+    }
+
+    /* allocated areas at the start, crossing a word boundary and at the end */
+    if (!id_heap_set_area(id, 0, 2 * PAGESIZE, true, true) ||
+        !id_heap_set_area(id, 60 * PAGESIZE, 10 * PAGESIZE, true, true) ||
+        !id_heap_set_area(id, 140 * PAGESIZE, 10 * PAGESIZE, true, true)) {
+        msg_err("%s: set_area failed\n", __func__);
+        return false;
+    }
+    range expect[] = {
+        irange(2 * PAGESIZE, 60 * PAGESIZE),
+        irange(70 * PAGESIZE, 140 * PAGESIZE),
+    };
+    range ranges[4];
+    int count = 0;
+    id_heap_free_range_foreach(id, stack_closure(free_range_test_handler, ranges, &count));
+    if (count != 2) {
+        msg_err("%s: expected 2 free ranges, got %d\n", __func__, count);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!range_equal(ranges[i], expect[i])) {
+            msg_err("%s: free range %R, expected %R\n", __func__, ranges[i], expect[i]);
+            return false;
+        }
+    }
+
+    /* a free range reaching the end of the id range */
+    id_heap_set_area(id, 140 * PAGESIZE, 10 * PAGESIZE, true, false);
+    count = 0;
+    id_heap_free_range_foreach(id, stack_closure(free_range_test_handler, ranges, &count));
+    if (count != 2 || !range_equal(ranges[1], irange(70 * PAGESIZE, 150 * PAGESIZE))) {
+        msg_err("%s: unexpected free ranges after dealloc\n", __func__);
+        return false;
+    }
+
+    destroy_heap((heap)id);
+    return true;
+}
+
+#define PAGE_CACHE_TEST_MAX_ORDER   3
+#define PAGE_CACHE_TEST_ROUNDS      16
+#define PAGE_CACHE_TEST_LARGE_ORDER 9
+
+static id_heap page_cache_test_heap(heap h, u64 pages)
+{
+    id_heap id = create_id_heap(h, h, PAGESIZE_2M, pages * PAGESIZE, PAGESIZE, true);
+    if (id == INVALID_ADDRESS) {
+        msg_err("cannot create heap\n");
+        return id;
+    }
+    if (!id_heap_enable_page_caches(id, PAGE_CACHE_TEST_MAX_ORDER, PAGE_CACHE_TEST_ROUNDS,
+                                    PAGE_CACHE_TEST_LARGE_ORDER, 2, 1)) {
+        msg_err("cannot enable page caches\n");
+        destroy_heap((heap)id);
+        return INVALID_ADDRESS;
+    }
+    return id;
+}
+
+static boolean page_cache_test(heap h)
+{
+    id_heap id = page_cache_test_heap(h, 16 * U64_FROM_BIT(PAGE_CACHE_TEST_LARGE_ORDER));
+    if (id == INVALID_ADDRESS)
+        return false;
+
+    /* blocks of all cached orders are aligned to their size, and cached ones are not accounted */
+    u64 a[PAGE_CACHE_TEST_MAX_ORDER + 2];
+    u64 total = 0;
+    for (int i = 0; i < PAGE_CACHE_TEST_MAX_ORDER + 2; i++) {
+        int order = (i <= PAGE_CACHE_TEST_MAX_ORDER) ? i : PAGE_CACHE_TEST_LARGE_ORDER;
+        bytes size = PAGESIZE << order;
+        a[i] = allocate_u64((heap)id, size);
+        if ((a[i] == INVALID_PHYSICAL) || (a[i] & (size - 1))) {
+            msg_err("%s: bad allocation 0x%lx of order %d\n", __func__, a[i], order);
+            return false;
+        }
+        total += size;
+        if (heap_allocated((heap)id) != total) {
+            msg_err("%s: allocated %ld, expected %ld\n", __func__, heap_allocated((heap)id), total);
+            return false;
+        }
+    }
+    for (int i = 0; i < PAGE_CACHE_TEST_MAX_ORDER + 2; i++) {
+        int order = (i <= PAGE_CACHE_TEST_MAX_ORDER) ? i : PAGE_CACHE_TEST_LARGE_ORDER;
+        deallocate_u64((heap)id, a[i], PAGESIZE << order);
+    }
+    if (heap_allocated((heap)id) != 0) {
+        msg_err("%s: allocated %ld after free\n", __func__, heap_allocated((heap)id));
+        return false;
+    }
+
+    /* freed large blocks are reused */
+    u64 b = allocate_u64((heap)id, PAGESIZE_2M);
+    deallocate_u64((heap)id, b, PAGESIZE_2M);
+    u64 c = allocate_u64((heap)id, PAGESIZE_2M);
+    if (c != b) {
+        msg_err("%s: large block 0x%lx not reused (got 0x%lx)\n", __func__, b, c);
+        return false;
+    }
+    deallocate_u64((heap)id, c, PAGESIZE_2M);
+
+    if (id_heap_drain_page_caches(id) == 0 || id_heap_drain_page_caches(id) != 0) {
+        msg_err("%s: unexpected drain result\n", __func__);
+        return false;
+    }
+    destroy_heap((heap)id);
+
+    /* a cached block is split to serve smaller allocations, and coalesced back with its buddy */
+    id = page_cache_test_heap(h, 4);
+    if (id == INVALID_ADDRESS)
+        return false;
+    u64 a0 = allocate_u64((heap)id, 2 * PAGESIZE);   /* the other half is cached on refill */
+    u64 p0 = allocate_u64((heap)id, PAGESIZE);
+    u64 p1 = allocate_u64((heap)id, PAGESIZE);
+    if ((a0 == INVALID_PHYSICAL) || (p0 != (a0 ^ (2 * PAGESIZE))) || (p1 != p0 + PAGESIZE)) {
+        msg_err("%s: pages 0x%lx, 0x%lx not split from buddy of 0x%lx\n", __func__, p0, p1, a0);
+        return false;
+    }
+    deallocate_u64((heap)id, p0, PAGESIZE);
+    deallocate_u64((heap)id, p1, PAGESIZE);
+    deallocate_u64((heap)id, a0, 2 * PAGESIZE);
+
+    /* all four pages now make a single cached block, from which the lowest page is split */
+    b = allocate_u64((heap)id, PAGESIZE);
+    if (b != MIN(a0, p0)) {
+        msg_err("%s: pages not coalesced (got 0x%lx)\n", __func__, b);
+        return false;
+    }
+    deallocate_u64((heap)id, b, PAGESIZE);
+    destroy_heap((heap)id);
+
+    /* when the heap runs out, cached pages of all orders are drained to serve allocations */
+    u64 pages = 2 * U64_FROM_BIT(PAGE_CACHE_TEST_LARGE_ORDER);
+    id = page_cache_test_heap(h, pages);
+    if (id == INVALID_ADDRESS)
+        return false;
+    b = allocate_u64((heap)id, PAGESIZE_2M);
+    c = allocate_u64((heap)id, PAGESIZE_2M);
+    if ((b == INVALID_PHYSICAL) || (c == INVALID_PHYSICAL) ||
+        (allocate_u64((heap)id, PAGESIZE_2M) != INVALID_PHYSICAL)) {
+        msg_err("%s: unexpected large allocation result\n", __func__);
+        return false;
+    }
+    deallocate_u64((heap)id, b, PAGESIZE_2M);
+    deallocate_u64((heap)id, c, PAGESIZE_2M);
+    for (u64 n = 0; n < pages; n++) {
+        if (allocate_u64((heap)id, PAGESIZE) == INVALID_PHYSICAL) {
+            msg_err("%s: only %ld of %ld pages allocated\n", __func__, n, pages);
+            return false;
+        }
+    }
+    if (allocate_u64((heap)id, PAGESIZE) != INVALID_PHYSICAL) {
+        msg_err("%s: allocated more pages than available\n", __func__);
+        return false;
+    }
+    destroy_heap((heap)id);
+    return true;
+}
+
 int main(int argc, char **argv)
 {
     heap h = init_process_runtime();
@@ -383,6 +560,12 @@ int main(int argc, char **argv)
     if (!alloc_subrange_test(h))
         goto fail;
 
+    if (!free_range_foreach_test(h))
+        goto fail;
+
+    if (!page_cache_test(h))
+        goto fail;
+
     msg_debug("test passed\n");
     exit(EXIT_SUCCESS);
   fail:
@@ -0,0 +1,143 @@
+#include <runtime.h>
+#include <stdlib.h>
+#define EXIT_FAILURE 1
+#define EXIT_SUCCESS 0
+#include <stdio.h>
+
+#define TEST_PAGESIZE   U64_FROM_BIT(17)
+#define TEST_MIN_ORDER  5
+#define TEST_MAX_ORDER  16
+#define TEST_MAG_ORDER  10
+#define TEST_MAG_ROUNDS 8
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        msg_err("%s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        return false; \
+    } \
+} while (0)
+
+/* An empty magazine is refilled, and a full one flushed, by half its capacity, with objects
+   cached in magazines accounted as allocated in the parent mcache. */
+static boolean refill_flush_test(heap lh, heap m)
+{
+    const bytes size = 200;
+    bytes class_size = mcache_class_size(m, mcache_size_class(m, size));
+    u64 objs[TEST_MAG_ROUNDS * 2];
+    u64 base = heap_allocated(m);
+
+    /* the first allocation misses and takes half a magazine more from the mcache */
+    objs[0] = allocate_u64(lh, size);
+    test_assert(objs[0] != INVALID_PHYSICAL);
+    test_assert(heap_allocated(m) == base + (1 + TEST_MAG_ROUNDS / 2) * class_size);
+    for (int i = 1; i <= TEST_MAG_ROUNDS / 2; i++) {
+        objs[i] = allocate_u64(lh, size);
+        test_assert(objs[i] != INVALID_PHYSICAL);
+        test_assert(heap_allocated(m) == base + (1 + TEST_MAG_ROUNDS / 2) * class_size);
+    }
+
+    /* the magazine is now empty */
+    int n = TEST_MAG_ROUNDS / 2 + 1;
+    for (; n < TEST_MAG_ROUNDS * 2; n++) {
+        objs[n] = allocate_u64(lh, size);
+        test_assert(objs[n] != INVALID_PHYSICAL);
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++)
+            test_assert(objs[i] != objs[j]);
+        runtime_memset(pointer_from_u64(objs[i]), i, size);
+    }
+    u64 allocated = heap_allocated(m);
+
+    /* frees fill the magazine without returning objects to the mcache... */
+    int i;
+    for (i = 0; i < n; i++) {
+        u8 *p = pointer_from_u64(objs[i]);
+        test_assert((p[0] == (u8)i) && (p[size - 1] == (u8)i));
+        bytes before = heap_allocated(m);
+        deallocate_u64(lh, objs[i], size);
+        if (heap_allocated(m) != before)
+            break;
+    }
+    test_assert(i < n);
+
+    /* ...until a free to a full magazine flushes it down to half its capacity */
+    test_assert(heap_allocated(m) == allocated - (1 + TEST_MAG_ROUNDS / 2) * class_size);
+    for (i++; i < n; i++)
+        deallocate_u64(lh, objs[i], size);
+    test_assert(heap_allocated(m) <= base + TEST_MAG_ROUNDS * class_size);
+    return true;
+}
+
+/* An object is cached in the magazine of the class it was allocated from, whatever the size it
+   is freed with, so that no allocation is served an object smaller than requested. */
+static boolean class_mismatch_test(heap lh, heap m)
+{
+    const bytes alloc_size = 100;
+    const bytes free_size = 90;
+    test_assert(mcache_size_class(m, alloc_size) != mcache_size_class(m, free_size));
+    const int nobjs = TEST_MAG_ROUNDS * 2;
+    u64 objs[nobjs];
+    for (int i = 0; i < nobjs; i++) {
+        objs[i] = allocate_u64(lh, alloc_size);
+        test_assert(objs[i] != INVALID_PHYSICAL);
+    }
+    for (int i = 0; i < nobjs; i++)
+        deallocate_u64(lh, objs[i], free_size);
+    for (int i = 0; i < nobjs; i++) {
+        bytes size = (i & 1) ? alloc_size : free_size;
+        objs[i] = allocate_u64(lh, size);
+        test_assert(objs[i] != INVALID_PHYSICAL);
+        heap o = objcache_from_object(objs[i], TEST_PAGESIZE);
+        test_assert(o != INVALID_ADDRESS);
+        test_assert(o->pagesize == mcache_class_size(m, mcache_size_class(m, size)));
+    }
+    for (int i = 0; i < nobjs; i++)
+        deallocate_u64(lh, objs[i], -1ull);
+    return true;
+}
+
+/* Objects larger than the magazine classes are served directly by the mcache. */
+static boolean uncached_test(heap lh, heap m)
+{
+    bytes size = U64_FROM_BIT(TEST_MAG_ORDER) + 1;
+    u64 base = heap_allocated(m);
+    u64 a = allocate_u64(lh, size);
+    test_assert(a != INVALID_PHYSICAL);
+    test_assert(heap_allocated(m) == base + mcache_class_size(m, mcache_size_class(m, size)));
+    deallocate_u64(lh, a, size);
+    test_assert(heap_allocated(m) == base);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+    heap pageheap = (heap)create_id_heap_backed(h, h, allocate_mmapheap(h, 512 * MB),
+                                                TEST_PAGESIZE, false);
+    heap m = allocate_mcache(h, pageheap, TEST_MIN_ORDER, TEST_MAX_ORDER, TEST_PAGESIZE);
+    if (m == INVALID_ADDRESS) {
+        msg_err("failed to allocate mcache\n");
+        exit(EXIT_FAILURE);
+    }
+    heap lh = locking_heap_wrapper(h, m);
+    if (lh == INVALID_ADDRESS) {
+        msg_err("failed to allocate locking heap\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!locking_heap_enable_magazines(lh, TEST_MAG_ORDER, TEST_MAG_ROUNDS, 1)) {
+        msg_err("failed to enable magazines\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!refill_flush_test(lh, m) || !class_mismatch_test(lh, m) || !uncached_test(lh, m))
+        exit(EXIT_FAILURE);
+
+    /* destroying the heap flushes the magazines */
+    destroy_heap(lh);
+    if (heap_allocated(pageheap) != 0) {
+        msg_err("pages left allocated after destroy\n");
+        exit(EXIT_FAILURE);
+    }
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,149 @@
+#include <runtime.h>
+#include <stdlib.h>
+
+#define TEST_MAX_LEN    (256 * KB)
+
+static u8 workmem[LZ4_WORKMEM_SIZE];
+
+/* Fills a buffer with data of varying compressibility: runs of repeated bytes, repeated phrases
+   at various distances, and random bytes. */
+static void fill_data(u8 *p, u64 len, int random_pct)
+{
+    u64 i = 0;
+    while (i < len) {
+        u64 n = MIN(len - i, 1 + rand() % 300);
+        int kind = rand() % 100;
+        if (kind < random_pct) {
+            for (u64 j = 0; j < n; j++)
+                p[i + j] = rand();
+        } else if ((kind % 2) || (i < 8)) {
+            runtime_memset(p + i, rand(), n);
+        } else {
+            u64 offset = 1 + rand() % MIN(i, 70000);
+            for (u64 j = 0; j < n; j++)
+                p[i + j] = p[i + j - offset];
+        }
+        i += n;
+    }
+}
+
+static boolean roundtrip(heap h, u8 *src, u64 len, u64 *clen)
+{
+    u64 dst_len = len + len / 255 + 16;
+    u8 *dst = allocate(h, dst_len);
+    u8 *out = allocate(h, len + 1);
+    boolean result = false;
+    *clen = lz4_compress(src, len, dst, dst_len, workmem);
+    if (*clen == 0 && len > 0) {
+        msg_err("compression of %ld bytes failed\n", len);
+        goto out;
+    }
+    s64 dlen = lz4_decompress(dst, *clen, out, len + 1);
+    if (dlen != len) {
+        msg_err("decompressed length %ld, expected %ld\n", dlen, len);
+        goto out;
+    }
+    if (runtime_memcmp(src, out, len)) {
+        msg_err("decompressed data mismatch, length %ld\n", len);
+        goto out;
+    }
+
+    /* a too small output buffer must be detected on both sides */
+    if (len > 0 && lz4_decompress(dst, *clen, out, len - 1) != -1) {
+        msg_err("decompression overflow not detected, length %ld\n", len);
+        goto out;
+    }
+    if (*clen > 1 && lz4_compress(src, len, dst, *clen - 1, workmem) != 0) {
+        msg_err("compression overflow not detected, length %ld\n", len);
+        goto out;
+    }
+    result = true;
+  out:
+    deallocate(h, dst, dst_len);
+    deallocate(h, out, len + 1);
+    return result;
+}
+
+static boolean roundtrip_test(heap h)
+{
+    u8 *src = allocate(h, TEST_MAX_LEN);
+    u64 clen;
+    for (u64 len = 0; len < 64; len++) {
+        fill_data(src, len, 30);
+        if (!roundtrip(h, src, len, &clen))
+            return false;
+    }
+    for (int random_pct = 0; random_pct <= 100; random_pct += 10) {
+        for (int i = 0; i < 20; i++) {
+            u64 len = 1 + rand() % TEST_MAX_LEN;
+            fill_data(src, len, random_pct);
+            if (!roundtrip(h, src, len, &clen))
+                return false;
+        }
+    }
+
+    /* compressible data must shrink */
+    runtime_memset(src, 'a', TEST_MAX_LEN);
+    if (!roundtrip(h, src, TEST_MAX_LEN, &clen))
+        return false;
+    if (clen > TEST_MAX_LEN / 200) {
+        msg_err("poor compression ratio: %ld bytes compressed to %ld\n", TEST_MAX_LEN, clen);
+        return false;
+    }
+    deallocate(h, src, TEST_MAX_LEN);
+    return true;
+}
+
+/* Malformed input must never cause out-of-bounds accesses. */
+static boolean malformed_test(heap h)
+{
+    u64 len = 64 * KB;
+    u8 *src = allocate(h, len);
+    u8 *dst = allocate(h, len);
+    u8 *out = allocate(h, len);
+    fill_data(src, len, 20);
+    u64 clen = lz4_compress(src, len, dst, len, workmem);
+    if (clen == 0) {
+        msg_err("compression failed\n");
+        return false;
+    }
+    for (int i = 0; i < 1000; i++) {
+        u8 *p = dst + rand() % clen;
+        u8 old = *p;
+        *p = rand();
+        s64 dlen = lz4_decompress(dst, clen, out, len);
+        if (dlen > (s64)len) {
+            msg_err("decompressed length %ld exceeds buffer\n", dlen);
+            return false;
+        }
+        *p = old;
+        lz4_decompress(dst, rand() % clen, out, len);
+    }
+
+    /* zero offset, and offset before the start of the output */
+    u8 bad_offset[] = { 0x14, 'a', 0x00, 0x00, 0x00 };
+    u8 bad_backref[] = { 0x14, 'a', 0x02, 0x00, 0x00 };
+    if (lz4_decompress(bad_offset, sizeof(bad_offset), out, len) != -1 ||
+        lz4_decompress(bad_backref, sizeof(bad_backref), out, len) != -1) {
+        msg_err("invalid match offset not detected\n");
+        return false;
+    }
+    deallocate(h, src, len);
+    deallocate(h, dst, len);
+    deallocate(h, out, len);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+    if (!roundtrip_test(h))
+        goto fail;
+    if (!malformed_test(h))
+        goto fail;
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+  fail:
+    msg_err("test failed\n");
+    exit(EXIT_FAILURE);
+}
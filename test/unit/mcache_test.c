@@ -0,0 +1,95 @@
+#include <runtime.h>
+#include <stdlib.h>
+#define EXIT_FAILURE 1
+#define EXIT_SUCCESS 0
+#include <stdio.h>
+
+#define TEST_PAGESIZE   U64_FROM_BIT(17)
+#define TEST_MIN_ORDER  5
+#define TEST_MAX_ORDER  16
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        msg_err("%s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        return false; \
+    } \
+} while (0)
+
+/* Each allocation must be served from the smallest size class that fits it. */
+static boolean size_class_test(heap m)
+{
+    bytes prev_class_size = 0;
+    for (bytes size = 1; size <= U64_FROM_BIT(TEST_MAX_ORDER); size++) {
+        int class = mcache_size_class(m, size);
+        test_assert(class >= 0);
+        bytes class_size = mcache_class_size(m, class);
+        test_assert(class_size >= size);
+        if (class > 0)
+            test_assert(mcache_class_size(m, class - 1) < size);
+        test_assert(class_size >= prev_class_size);
+        prev_class_size = class_size;
+
+        /* internal fragmentation is bounded by the size class spacing */
+        if (size > U64_FROM_BIT(TEST_MIN_ORDER))
+            test_assert(class_size - size < MAX(size / 2, 16));
+
+        u64 a = allocate_u64(m, size);
+        test_assert(a != INVALID_PHYSICAL);
+        test_assert((a & (16 - 1)) == 0);
+        if (!(size & (size - 1)))
+            test_assert((a & (size - 1)) == 0);
+        heap o = objcache_from_object(a, TEST_PAGESIZE);
+        test_assert(o != INVALID_ADDRESS);
+        test_assert(o->pagesize == class_size);
+        test_assert(heap_allocated(m) == class_size);
+        deallocate_u64(m, a, size);
+        test_assert(heap_allocated(m) == 0);
+    }
+    test_assert(mcache_size_class(m, U64_FROM_BIT(TEST_MAX_ORDER) + 1) == -1);
+    return true;
+}
+
+/* Objects of different sizes can be freed in any order, with or without their size. */
+static boolean alloc_dealloc_test(heap m)
+{
+    const int nobjs = 1024;
+    u64 objs[nobjs];
+    bytes sizes[nobjs];
+    for (int i = 0; i < nobjs; i++) {
+        sizes[i] = 1 + (random_u64() % (PAGESIZE * 2));
+        objs[i] = allocate_u64(m, sizes[i]);
+        test_assert(objs[i] != INVALID_PHYSICAL);
+        runtime_memset(pointer_from_u64(objs[i]), i, sizes[i]);
+    }
+    for (int i = 0; i < nobjs; i++) {
+        u8 *p = pointer_from_u64(objs[i]);
+        test_assert((p[0] == (u8)i) && (p[sizes[i] - 1] == (u8)i));
+        deallocate_u64(m, objs[i], (i & 1) ? sizes[i] : -1ull);
+    }
+    test_assert(heap_allocated(m) == 0);
+
+    /* sizes larger than the largest class are served by the parent heap */
+    u64 a = allocate_u64(m, U64_FROM_BIT(TEST_MAX_ORDER) + 1);
+    test_assert(a != INVALID_PHYSICAL);
+    test_assert(heap_allocated(m) == pad(U64_FROM_BIT(TEST_MAX_ORDER) + 1, TEST_PAGESIZE));
+    deallocate_u64(m, a, U64_FROM_BIT(TEST_MAX_ORDER) + 1);
+    test_assert(heap_allocated(m) == 0);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+    heap pageheap = (heap)create_id_heap_backed(h, h, allocate_mmapheap(h, 512 * MB),
+                                                TEST_PAGESIZE, false);
+    heap m = allocate_mcache(h, pageheap, TEST_MIN_ORDER, TEST_MAX_ORDER, TEST_PAGESIZE);
+    if (m == INVALID_ADDRESS) {
+        msg_err("failed to allocate mcache\n");
+        exit(EXIT_FAILURE);
+    }
+    if (!size_class_test(m) || !alloc_dealloc_test(m))
+        exit(EXIT_FAILURE);
+    destroy_heap(m);
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+}
@@ -1,7 +1,14 @@
 #include <runtime.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #define MEM_BUF_SIZE    512
+#define LARGE_BUF_SIZE  (4 * MB + 256)
+
+#define BENCH_MAX_SIZE  (16 * MB)
+#define BENCH_BYTES     (1ull << 31)
 
 #define test_assert(expr)   do { \
     if (!(expr)) { \
@@ -108,15 +115,133 @@ static void test_memcmp(long *buf, unsigned long buf_size)
     test_assert(runtime_memcmp(buf, buf, buf_size * sizeof(long)) == 0);
 }
 
+static void test_memcmp_order(u8 *buf, unsigned long buf_size)
+{
+    for (long i = 0; i < buf_size; i++) {
+        buf[i] = i % 251;
+        buf[buf_size + i] = i % 251;
+    }
+    for (long i = 0; i < buf_size; i += 7) {
+        buf[buf_size + i]++;
+        test_assert(runtime_memcmp(buf, buf + buf_size, buf_size) < 0);
+        test_assert(runtime_memcmp(buf + buf_size, buf, buf_size) > 0);
+        test_assert(runtime_memcmp(buf, buf + buf_size, i) == 0);
+        buf[buf_size + i]--;
+    }
+    test_assert(runtime_memcmp(buf, buf + buf_size, buf_size) == 0);
+}
+
+/* Sizes and offsets large enough to exercise the string instruction and non-temporal paths. */
+static void test_large(u8 *buf1, u8 *buf2, unsigned long buf_size)
+{
+    bytes sizes[] = {127, 128, 4095, 4096, 65537, MB - 1, MB, 2 * MB + 3, 4 * MB};
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        bytes len = sizes[s];
+        for (int dst_off = 0; dst_off < 3; dst_off++) {
+            for (int src_off = 0; src_off < 3; src_off++) {
+                u8 *dst = buf2 + dst_off * 5, *src = buf1 + src_off * 3;
+                for (long i = 0; i < len + 32; i++)
+                    src[i] = i * 7 + s;
+                runtime_memset(dst, 0x5A, len + 32);
+                runtime_memcpy(dst, src, len);
+                for (long i = 0; i < len; i++)
+                    test_assert(dst[i] == src[i]);
+                for (long i = len; i < len + 32; i++)
+                    test_assert(dst[i] == 0x5A);
+                test_assert(runtime_memcmp(dst, src, len) == 0);
+            }
+        }
+    }
+
+    /* overlapping copies in both directions */
+    bytes len = buf_size - 256;
+    for (long i = 0; i < buf_size; i++)
+        buf1[i] = i % 251;
+    runtime_memcpy(buf1, buf1 + 67, len);
+    for (long i = 0; i < len; i++)
+        test_assert(buf1[i] == (i + 67) % 251);
+    for (long i = 0; i < buf_size; i++)
+        buf1[i] = i % 251;
+    runtime_memcpy(buf1 + 67, buf1, len);
+    for (long i = 0; i < len; i++)
+        test_assert(buf1[i + 67] == i % 251);
+}
+
+static void bench(const char *name, void (*op)(u8 *, u8 *, bytes), u8 *dst, u8 *src)
+{
+    printf("%s:", name);
+    for (bytes size = 64; size <= BENCH_MAX_SIZE; size *= 4) {
+        u64 iterations = BENCH_BYTES / size / 8;
+        timestamp t = now(CLOCK_ID_MONOTONIC);
+        for (u64 i = 0; i < iterations; i++)
+            op(dst + (i & 7), src + (i & 7) * 3, size);
+        u64 ns = MAX(nsec_from_timestamp(now(CLOCK_ID_MONOTONIC) - t), 1);
+        printf(" %ld:%ldMB/s", (long)size, (long)(iterations * size * 1000 / ns));
+    }
+    printf("\n");
+}
+
+static void bench_memcpy(u8 *dst, u8 *src, bytes len)
+{
+    runtime_memcpy(dst, src, len);
+}
+
+static void bench_memset(u8 *dst, u8 *src, bytes len)
+{
+    runtime_memset(dst, *src, len);
+}
+
+static void bench_memcmp(u8 *dst, u8 *src, bytes len)
+{
+    test_assert(runtime_memcmp(dst, src, len) == 0);
+}
+
+static void bench_libc_memcpy(u8 *dst, u8 *src, bytes len)
+{
+    memcpy(dst, src, len);
+}
+
 int main(int argc, char *argv[])
 {
     long buf1[MEM_BUF_SIZE], buf2[MEM_BUF_SIZE];
+    boolean benchmark = false;
+    int c;
 
     init_process_runtime();
+    while ((c = getopt(argc, argv, "b")) != -1) {
+        switch (c) {
+        case 'b':
+            benchmark = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
     test_memcpy(buf1, buf2, MEM_BUF_SIZE);
     test_memcpy(buf2, buf1, MEM_BUF_SIZE);
     test_memcpy_overlap(buf1, MEM_BUF_SIZE);
     test_memset(buf1, MEM_BUF_SIZE);
     test_memcmp(buf1, MEM_BUF_SIZE);
+    test_memcmp_order((u8 *)buf1, MEM_BUF_SIZE);
+
+    u8 *large1 = malloc(LARGE_BUF_SIZE), *large2 = malloc(LARGE_BUF_SIZE);
+    test_assert(large1 && large2);
+    test_large(large1, large2, LARGE_BUF_SIZE);
+    free(large1);
+    free(large2);
+
+    if (benchmark) {
+        u8 *dst = malloc(BENCH_MAX_SIZE + 64), *src = malloc(BENCH_MAX_SIZE + 64);
+        test_assert(dst && src);
+        memset(src, 0x3C, BENCH_MAX_SIZE + 64);
+        memset(dst, 0x3C, BENCH_MAX_SIZE + 64);
+        bench("memcpy", bench_memcpy, dst, src);
+        bench("memset", bench_memset, dst, src);
+        bench("memcmp", bench_memcmp, dst, src);
+        bench("libc memcpy", bench_libc_memcpy, dst, src);
+        free(dst);
+        free(src);
+    }
     return 0;
 }
@@ -0,0 +1,106 @@
+#include <runtime.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#define EXIT_FAILURE 1
+#define EXIT_SUCCESS 0
+
+#define SYMBOL_COUNT    (16 * 1024)
+
+#define test_assert(expr) do { \
+    if (!(expr)) { \
+        msg_err("%s -- failed at %s:%d\n", #expr, __FILE__, __LINE__); \
+        return false; \
+    } \
+} while (0)
+
+static symbol __attribute__((noinline)) sym_test(void)
+{
+    return sym(symbol_test);
+}
+
+/* Interning the same name always returns the same symbol, whether the name is copied or not, and
+   across the growth of the symbol set. */
+static boolean intern_test(heap h)
+{
+    symbol *syms = allocate(h, SYMBOL_COUNT * sizeof(symbol));
+    test_assert(syms != INVALID_ADDRESS);
+    for (int i = 0; i < SYMBOL_COUNT; i++) {
+        syms[i] = intern_u64(i);
+        test_assert(syms[i] != INVALID_ADDRESS);
+    }
+    for (int i = 0; i < SYMBOL_COUNT; i++) {
+        test_assert(intern_u64(i) == syms[i]);
+        u64 n;
+        test_assert(parse_int(alloca_wrap(symbol_string(syms[i])), 10, &n) && (n == i));
+    }
+    deallocate(h, syms, SYMBOL_COUNT * sizeof(symbol));
+
+    /* the name of an interned symbol is copied */
+    char name[] = "symbol_test_name";
+    buffer b = alloca_wrap_buffer(name, sizeof(name) - 1);
+    symbol s = intern(b);
+    name[0] = 'S';
+    test_assert(intern(alloca_wrap_buffer("symbol_test_name", sizeof(name) - 1)) == s);
+    test_assert(buffer_compare_with_cstring(symbol_string(s), "symbol_test_name"));
+
+    /* sym() refers to the same symbols as intern() */
+    symbol t = sym(symbol_test);
+    test_assert(t == sym_test());
+    test_assert(sym_test() == sym_test());
+    test_assert(intern(alloca_wrap_cstring("symbol_test")) == t);
+    test_assert(sym_cstring_compare(t, "symbol_test"));
+    test_assert(sym(symbol_test_name) == s);
+    return true;
+}
+
+static u64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * BILLION + ts.tv_nsec;
+}
+
+static void symbol_bench(void)
+{
+    const int iterations = 1000000;
+    buffer names[64];
+    for (int i = 0; i < 64; i++) {
+        names[i] = little_stack_buffer(20);
+        print_number(names[i], i * 7919, 10, 0);
+        intern(names[i]);
+    }
+    u64 start = now_ns();
+    for (int i = 0; i < iterations; i++)
+        intern(names[i & 63]);
+    u64 intern_ns = now_ns() - start;
+    start = now_ns();
+    for (int i = 0; i < iterations; i++)
+        sym_test();
+    u64 sym_ns = now_ns() - start;
+    rprintf("intern %ld ns, sym %ld ns\n", intern_ns / iterations, sym_ns / iterations);
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+    boolean bench = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "b")) != -1) {
+        switch (c) {
+        case 'b':
+            bench = true;
+            break;
+        default:
+            msg_err("usage: %s [-b]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (!intern_test(h))
+        exit(EXIT_FAILURE);
+    if (bench)
+        symbol_bench();
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+}
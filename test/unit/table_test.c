@@ -1,5 +1,7 @@
 #include <runtime.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
 
 static inline key silly_key(void *a)
 {
@@ -200,12 +202,161 @@ static boolean one_elem_table_tests(heap h, u64 n_elem)
     return true;
 }
 
+/* Removing the current element while iterating must not skip or repeat any other element. */
+static boolean foreach_remove_tests(heap h, u64 n_elem)
+{
+    table t = allocate_table(h, identity_key, pointer_equal);
+    u64 count = 0, sum = 0;
+
+    for (u64 i = 1; i <= n_elem; i++)
+        table_set(t, (void *)i, (void *)i);
+    table_foreach(t, n, v) {
+        if (n != v) {
+            msg_err("table_foreach() invalid value %ld for name %ld\n", (u64)v, (u64)n);
+            return false;
+        }
+        if ((u64)n & 1)
+            table_set(t, n, 0);
+        sum += (u64)n;
+        count++;
+    }
+    if ((count != n_elem) || (sum != n_elem * (n_elem + 1) / 2)) {
+        msg_err("table_foreach() with removal visited %ld elements, sum %ld\n", count, sum);
+        return false;
+    }
+    if (table_elements(t) != n_elem / 2) {
+        msg_err("invalid table_elements() %d after removal, should be %ld\n", table_elements(t),
+                n_elem / 2);
+        return false;
+    }
+    table_validate(t, "foreach_remove_tests");
+    deallocate_table(t);
+    return true;
+}
+
+/* Random insertions, updates and removals checked against a plain array, so that lookups and
+   removals happen at every stage of the incremental resizes. */
+static boolean random_ops_tests(heap h, u64 (*key_function)(void *x), u64 n_keys, u64 n_ops)
+{
+    u64 heap_occupancy = heap_allocated(h);
+    table t = allocate_table(h, key_function, pointer_equal);
+    u64 *model = calloc(n_keys, sizeof(u64));
+    int count = 0;
+
+    for (u64 i = 0; i < n_ops; i++) {
+        u64 k = random_u64() % n_keys;
+        u64 op = random_u64() % 8;
+        if (op < 4) {
+            if (!model[k])
+                count++;
+            model[k] = i + 1;
+            table_set(t, (void *)k, (void *)model[k]);
+        } else if (op < 6) {
+            if (model[k])
+                count--;
+            model[k] = 0;
+            table_set(t, (void *)k, 0);
+        }
+        if ((u64)table_find(t, (void *)k) != model[k]) {
+            msg_err("key %ld: found %ld, should be %ld\n", k, (u64)table_find(t, (void *)k),
+                    model[k]);
+            return false;
+        }
+        if (table_elements(t) != count) {
+            msg_err("invalid table_elements() %d, should be %d\n", table_elements(t), count);
+            return false;
+        }
+        if ((i & 0xfff) == 0)
+            table_validate(t, "random_ops_tests");
+    }
+    for (u64 k = 0; k < n_keys; k++) {
+        if ((u64)table_find(t, (void *)k) != model[k]) {
+            msg_err("key %ld: found %ld, should be %ld\n", k, (u64)table_find(t, (void *)k),
+                    model[k]);
+            return false;
+        }
+    }
+    table_validate(t, "random_ops_tests: end");
+    free(model);
+    deallocate_table(t);
+    if (heap_allocated(h) != heap_occupancy) {
+        msg_err("leak: heap_allocated(h) %ld, originally %ld\n", heap_allocated(h), heap_occupancy);
+        return false;
+    }
+    return true;
+}
+
+static u64 bench_elapsed_ns(timestamp start)
+{
+    return MAX(nsec_from_timestamp(now(CLOCK_ID_MONOTONIC) - start), 1);
+}
+
+static void table_bench(heap h, u64 n_elem)
+{
+    table t = allocate_table(h, identity_key, pointer_equal);
+    u64 *keys = malloc(n_elem * sizeof(u64));
+    for (u64 i = 0; i < n_elem; i++)
+        keys[i] = (random_u64() << 4) | 1;  /* pointer-like keys */
+
+    timestamp start = now(CLOCK_ID_MONOTONIC);
+    for (u64 i = 0; i < n_elem; i++)
+        table_set(t, (void *)keys[i], (void *)keys[i]);
+    u64 insert_ns = bench_elapsed_ns(start);
+
+    start = now(CLOCK_ID_MONOTONIC);
+    u64 found = 0;
+    for (u64 i = 0; i < n_elem; i++)
+        found += table_find(t, (void *)keys[i]) != 0;
+    u64 hit_ns = bench_elapsed_ns(start);
+
+    start = now(CLOCK_ID_MONOTONIC);
+    for (u64 i = 0; i < n_elem; i++)
+        found += table_find(t, (void *)(keys[i] + 2)) != 0;
+    u64 miss_ns = bench_elapsed_ns(start);
+
+    start = now(CLOCK_ID_MONOTONIC);
+    u64 iterated = 0;
+    table_foreach(t, k, v) {
+        (void)k;
+        (void)v;
+        iterated++;
+    }
+    u64 foreach_ns = bench_elapsed_ns(start);
+
+    start = now(CLOCK_ID_MONOTONIC);
+    for (u64 i = 0; i < n_elem; i++)
+        table_set(t, (void *)keys[i], 0);
+    u64 remove_ns = bench_elapsed_ns(start);
+
+    rprintf("%ld elements: insert %ld ns, find hit %ld ns, find miss %ld ns, "
+            "iterate %ld ns, remove %ld ns (found %ld, iterated %ld)\n", n_elem,
+            insert_ns / n_elem, hit_ns / n_elem, miss_ns / n_elem, foreach_ns / n_elem,
+            remove_ns / n_elem, found, iterated);
+    free(keys);
+    deallocate_table(t);
+}
+
 #define BASIC_ELEM_COUNT  512
 #define STRESS_ELEM_COUNT (1ull << 20)
+#define RANDOM_KEY_COUNT  4096
+#define RANDOM_OP_COUNT   (1ull << 18)
 
 int main(int argc, char **argv)
 {
     heap h = init_process_runtime();
+    boolean benchmark = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "b")) != -1) {
+        switch (c) {
+        case 'b':
+            benchmark = true;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
     if (!basic_table_tests(h, identity_key, BASIC_ELEM_COUNT)) {
         msg_err("Identity key table test failed\n");
@@ -227,10 +378,26 @@ int main(int argc, char **argv)
         goto fail;
     }
 
+    if (!foreach_remove_tests(h, BASIC_ELEM_COUNT)) {
+        msg_err("Foreach removal table test failed\n");
+        goto fail;
+    }
+
+    if (!random_ops_tests(h, identity_key, RANDOM_KEY_COUNT, RANDOM_OP_COUNT) ||
+        !random_ops_tests(h, less_silly_key, RANDOM_KEY_COUNT / 16, RANDOM_OP_COUNT / 16)) {
+        msg_err("Random operations table test failed\n");
+        goto fail;
+    }
+
     if (!basic_table_tests(h, identity_key, STRESS_ELEM_COUNT)) {
         msg_err("Stress table test failed\n");
         goto fail;
     }
+
+    if (benchmark) {
+        for (u64 n = 16; n <= STRESS_ELEM_COUNT * 4; n *= 8)
+            table_bench(h, n);
+    }
     exit(EXIT_SUCCESS);
 fail:
     exit(EXIT_FAILURE);
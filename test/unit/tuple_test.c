@@ -1,6 +1,7 @@
 #include <runtime.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #define EXIT_SUCCESS 0
 #define EXIT_FAILURE 1
@@ -190,16 +191,213 @@ fail:
     return failure;
 }
 
+boolean integer_test(heap h)
+{
+    boolean failure = true;
+    tuple t = allocate_tuple();
+    value i = allocate_integer(U64_MAX);
+    test_assert(i != INVALID_ADDRESS);
+    test_assert(is_integer(i) && !is_string(i) && !is_tuple(i));
+    set(t, sym(n), i);
+    u64 n;
+    test_assert(get_u64(t, sym(n), &n) && (n == U64_MAX));
+    test_assert(value_rewrite_u64(i, 1234) == i);
+    test_assert(get_u64(t, sym(n), &n) && (n == 1234));
+    buffer buf = allocate_buffer(h, 128);
+    bprintf(buf, "%v", t);
+    test_assert(strncmp(buf->contents, "(n:1234)", buffer_length(buf)) == 0);
+
+    /* an integer is encoded like the equivalent number string, and decoded as such */
+    tuple ts = allocate_tuple();
+    set(ts, sym(n), value_from_u64(h, 1234));
+    buffer bi = allocate_buffer(h, 128);
+    buffer bs = allocate_buffer(h, 128);
+    table tdict1 = allocate_table(h, identity_key, pointer_equal);
+    encode_tuple(bi, tdict1, t, 0);
+    table tdict2 = allocate_table(h, identity_key, pointer_equal);
+    encode_tuple(bs, tdict2, ts, 0);
+    test_assert(buffer_compare(bi, bs));
+    table tdict3 = allocate_table(h, identity_key, pointer_equal);
+    tuple td = decode_value(h, tdict3, bi, 0, 0);
+    value v = get(td, sym(n));
+    test_assert(v && is_string(v));
+    test_assert(get_u64(td, sym(n), &n) && (n == 1234));
+    destruct_tuple(td, true);
+    destruct_tuple(ts, true);
+    failure = false;
+fail:
+    destruct_tuple(t, true);
+    return failure;
+}
+
+/* same layouts as the TFS inode and extent schemas */
+static struct tuple_schema inode_schema;
+static struct tuple_schema extent_schema;
+
+static void init_test_schemas(void)
+{
+    symbol inode_attrs[] = {
+        sym_this(".."), sym(children), sym(extents), sym(filelength), sym(mtime), sym(atime),
+    };
+    symbol extent_attrs[] = {
+        sym(offset), sym(length), sym(allocated), sym(lz4),
+    };
+    inode_schema.count = sizeof(inode_attrs) / sizeof(symbol);
+    runtime_memcpy(inode_schema.attrs, inode_attrs, sizeof(inode_attrs));
+    extent_schema.count = sizeof(extent_attrs) / sizeof(symbol);
+    runtime_memcpy(extent_schema.attrs, extent_attrs, sizeof(extent_attrs));
+    register_tuple_schema(&inode_schema);
+    register_tuple_schema(&extent_schema);
+}
+
+boolean schema_tuple_test(heap h)
+{
+    boolean failure = true;
+    tuple t = allocate_schema_tuple(&inode_schema);
+    tuple td = 0;
+    test_assert(t != INVALID_ADDRESS);
+    test_assert(is_tuple(t) && (tuple_count(t) == 0));
+    test_assert(get(t, sym(mtime)) == 0);
+
+    /* attributes in the schema and outside of it */
+    set(t, sym(atime), allocate_integer(2));
+    set(t, sym(mtime), allocate_integer(1));
+    set(t, sym(linktarget), wrap_buffer_cstring(h, "target"));
+    test_assert(tuple_count(t) == 3);
+    u64 n;
+    test_assert(get_u64(t, sym(mtime), &n) && (n == 1));
+    test_assert(get_u64(t, sym(atime), &n) && (n == 2));
+    value v = get(t, sym(linktarget));
+    test_assert(v && buffer_compare_with_cstring(v, "target"));
+    test_assert(tuple_get_symbol(t, v) == sym(linktarget));
+
+    /* a decoded tuple takes the schema of its first attribute */
+    buffer b = allocate_buffer(h, 128);
+    table dict = allocate_table(h, identity_key, pointer_equal);
+    encode_tuple(b, dict, t, 0);
+    deallocate_table(dict);
+    dict = allocate_table(h, identity_key, pointer_equal);
+    td = decode_value(h, dict, b, 0, 0);
+    deallocate_table(dict);
+    test_assert(tagof(td) == tag_schema_tuple);
+    test_assert(tuple_count(td) == 3);
+    test_assert(get_u64(td, sym(mtime), &n) && (n == 1));
+    test_assert(get_u64(td, sym(atime), &n) && (n == 2));
+    v = get(td, sym(linktarget));
+    test_assert(v && buffer_compare_with_cstring(v, "target"));
+    destruct_tuple(td, true);
+
+    /* ...or is a table if no schema has that attribute */
+    td = allocate_tuple();
+    set(td, sym(linktarget), wrap_buffer_cstring(h, "target"));
+    buffer_clear(b);
+    dict = allocate_table(h, identity_key, pointer_equal);
+    encode_tuple(b, dict, td, 0);
+    deallocate_table(dict);
+    destruct_tuple(td, true);
+    dict = allocate_table(h, identity_key, pointer_equal);
+    td = decode_value(h, dict, b, 0, 0);
+    deallocate_table(dict);
+    test_assert(tagof(td) == tag_table_tuple);
+    v = get(td, sym(linktarget));
+    test_assert(v && buffer_compare_with_cstring(v, "target"));
+    destruct_tuple(td, true);
+    td = 0;
+
+    /* removal */
+    v = get(t, sym(linktarget));
+    set(t, sym(linktarget), 0);
+    deallocate_value(v);
+    v = get(t, sym(mtime));
+    set(t, sym(mtime), 0);
+    deallocate_value(v);
+    test_assert(tuple_count(t) == 1);
+    test_assert(!get(t, sym(mtime)) && !get(t, sym(linktarget)));
+    test_assert(get_u64(t, sym(atime), &n) && (n == 2));
+    deallocate_buffer(b);
+    failure = false;
+fail:
+    if (td)
+        destruct_tuple(td, true);
+    destruct_tuple(t, true);
+    return failure;
+}
+
+#define INODE_COUNT 1024
+
+/* Builds tuples with the layout of file metadata in TFS (one extent per file), with numbers
+   stored either as strings, as decoded from the filesystem log, or as integers, in tables or in
+   schema tuples, and returns the memory used per file. */
+static u64 inode_memory(heap h, boolean integers, boolean schemas)
+{
+    tuple files = allocate_tuple();
+    u64 allocated = heap_allocated(h);
+    for (int i = 0; i < INODE_COUNT; i++) {
+        u64 numbers[] = {1700000000ull << 32, 1700000000ull << 32, 4096 + i, 1024 + i * 8, 8, 8};
+        value values[sizeof(numbers) / sizeof(numbers[0])];
+        for (int j = 0; j < sizeof(numbers) / sizeof(numbers[0]); j++)
+            values[j] = integers ? allocate_integer(numbers[j]) : value_from_u64(h, numbers[j]);
+        tuple f = schemas ? allocate_schema_tuple(&inode_schema) : allocate_tuple();
+        set(f, sym(mtime), values[0]);
+        set(f, sym(atime), values[1]);
+        set(f, sym(filelength), values[2]);
+        tuple extents = allocate_tuple();
+        tuple e = schemas ? allocate_schema_tuple(&extent_schema) : allocate_tuple();
+        set(e, sym(offset), values[3]);
+        set(e, sym(length), values[4]);
+        set(e, sym(allocated), values[5]);
+        set(extents, intern_u64(0), e);
+        set(f, sym(extents), extents);
+        set(files, intern_u64(i), f);
+    }
+    u64 per_inode = (heap_allocated(h) - allocated) / INODE_COUNT;
+    destruct_tuple(files, true);
+    return per_inode;
+}
+
+boolean inode_memory_test(heap h, boolean report)
+{
+    boolean failure = true;
+    u64 strings = inode_memory(h, false, false);
+    u64 integers = inode_memory(h, true, false);
+    u64 schemas = inode_memory(h, true, true);
+    if (report)
+        rprintf("memory per inode: %ld bytes with number strings, %ld bytes with integers, "
+                "%ld bytes with integers in schema tuples\n", strings, integers, schemas);
+    test_assert(integers < strings);
+    test_assert(schemas < integers);
+    failure = false;
+fail:
+    return failure;
+}
+
 int main(int argc, char **argv)
 {
     heap h = init_process_runtime();
+    boolean report = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "m")) != -1) {
+        switch (c) {
+        case 'm':
+            report = true;
+            break;
+        default:
+            msg_err("usage: %s [-m]\n", argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
+    init_test_schemas();
     int failure = 0;
 
     failure |= all_tests(h);
     failure |= encode_decode_test(h);
     failure |= encode_decode_reference_test(h);
     failure |= encode_decode_lengthy_test(h);
+    failure |= integer_test(h);
+    failure |= schema_tuple_test(h);
+    failure |= inode_memory_test(h, report);
 
     if (failure) {
         msg_err("Test failed\n");
@@ -353,8 +353,34 @@ closure_function(0, 2, void, mkfs_write_handler,
     }
 }
 
-closure_function(4, 2, void, fsc,
-                 heap, h, descriptor, out, tuple, root, const char *, target_root,
+closure_function(1, 1, void, mkfs_compressed_write_complete,
+                 buffer, contents,
+                 status, s)
+{
+    if (!is_ok(s)) {
+        rprintf("write failed with %v\n", s);
+        exit(EXIT_FAILURE);
+    }
+    deallocate_buffer(bound(contents));
+    closure_finish();
+}
+
+/* Returns whether a file is to be stored compressed, per its "compression" contents attribute or
+   else the filesystem default. */
+static boolean file_compressed(value contents, boolean compress)
+{
+    value v = get(contents, sym(compression));
+    if (!v)
+        return compress;
+    if (!buffer_strcmp(v, "lz4"))
+        return true;
+    if (!buffer_strcmp(v, "none"))
+        return false;
+    halt("invalid compression \"%b\"\n", v);
+}
+
+closure_function(5, 2, void, fsc,
+                 heap, h, descriptor, out, tuple, root, const char *, target_root, boolean, compress,
                  filesystem, fs, status, s)
 {
     tuple root = bound(root);
@@ -379,15 +405,26 @@ closure_function(4, 2, void, fsc,
     filesystem_write_tuple(fs, md);
     vector i;
     buffer off = 0;
+    u64 compressed_files = 0, raw_bytes = 0, stored_bytes = 0;
     vector_foreach(worklist, i) {
         tuple f = vector_get(i, 0);
         buffer contents = get_file_contents(h, bound(target_root), vector_get(i, 1));
         if (contents) {
             if (buffer_length(contents) > 0) {
                 fsfile fsf = allocate_fsfile(fs, f);
-                filesystem_write_linear(fsf, buffer_ref(contents, 0), irangel(0, buffer_length(contents)),
-                                        ignore_io_status);
-                deallocate_buffer(contents);
+                if (file_compressed(vector_get(i, 1), bound(compress))) {
+                    u64 length = buffer_length(contents);
+                    filesystem_write_compressed(fsf, buffer_ref(contents, 0), length,
+                                                closure(h, mkfs_compressed_write_complete,
+                                                        contents));
+                    compressed_files++;
+                    raw_bytes += length;
+                    stored_bytes += fsfile_get_blocks(fsf) * SECTOR_SIZE;
+                } else {
+                    filesystem_write_linear(fsf, buffer_ref(contents, 0),
+                                            irangel(0, buffer_length(contents)), ignore_io_status);
+                    deallocate_buffer(contents);
+                }
             } else {
                 if (!off)
                     off = wrap_buffer_cstring(h, "0");
@@ -397,6 +434,9 @@ closure_function(4, 2, void, fsc,
             }
         }
     }
+    if (compressed_files)
+        rprintf("compressed %ld files: %ld bytes stored in %ld bytes (%ld%%)\n", compressed_files,
+                raw_bytes, stored_bytes, stored_bytes * 100 / raw_bytes);
     filesystem_flush(fs, ignore_status);
     closure_finish();
 }
@@ -620,6 +660,7 @@ int main(int argc, char **argv)
     const char *target_root = NULL;
     long long img_size = 0;
     boolean empty_fs = false;
+    boolean compress = false;
     const char *uefi_loader = NULL;
     heap h = init_process_runtime();
 
@@ -747,6 +788,14 @@ int main(int argc, char **argv)
             deallocate_buffer((buffer)v);
         }
 
+        /* default compression of file contents; the boot FS is never compressed */
+        v = get(root, sym(compression));
+        if (v) {
+            compress = file_compressed(root, false);
+            set(root, sym(compression), 0); /* consume it, kernel doesn't need it */
+            deallocate_buffer((buffer)v);
+        }
+
         tuple boot = get_tuple(root, sym(boot));
         if (kernelimg_path != NULL) {
             if (!boot)
@@ -774,7 +823,7 @@ int main(int argc, char **argv)
         }
         if (boot) {
             create_filesystem(h, SECTOR_SIZE, BOOTFS_SIZE, closure(h, bwrite, out, offset), false,
-                              "", closure(h, fsc, h, out, boot, target_root));
+                              "", closure(h, fsc, h, out, boot, target_root, false));
             offset += BOOTFS_SIZE;
 
             /* Remove tuple from root, so it doesn't end up in the root FS. */
@@ -790,7 +839,7 @@ int main(int argc, char **argv)
                       closure(h, bwrite, out, offset),
                       false,
                       label,
-                      closure(h, fsc, h, out, root, target_root));
+                      closure(h, fsc, h, out, root, target_root, compress));
 
     off_t current_size = lseek(out, 0, SEEK_END);
     if (current_size < 0) {